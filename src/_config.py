@@ -214,6 +214,7 @@ class Config:
     CONFIRM_COPY = True     # Show confirmation dialog before copying files/directories
     CONFIRM_MOVE = True     # Show confirmation dialog before moving files/directories
     CONFIRM_DUPLICATE = True  # Show confirmation dialog before duplicating files/directories
+    CONFIRM_SYNC = True     # Show confirmation dialog before syncing files/directories to the other pane
     CONFIRM_EXTRACT_ARCHIVE = True  # Show confirmation dialog before extracting archives
     CONFIRM_ARCHIVE_CREATE = True   # Show confirmation dialog before creating archives
     
@@ -398,6 +399,11 @@ class Config:
     # Performance settings
     MAX_LOG_MESSAGES = 1000
 
+    # Log file settings (used with tfm.py --log-file PATH)
+    LOG_FILE_MAX_BYTES = 10 * 1024 * 1024  # Rotate the log file past this size (0 = never)
+    LOG_FILE_BACKUP_COUNT = 3              # Rotated files kept as <file>.1 ... <file>.N
+    LOG_FILE_FORMAT = 'text'               # 'text', or 'binary' (decode with tools/decode_log.py)
+
     # History settings
     MAX_HISTORY_ENTRIES = 100  # Maximum number of history entries to keep
     
@@ -438,16 +444,39 @@ class Config:
     # - Desktop mode (coregraphics): code --diff (list format example)
     TEXT_DIFF = ['code', '--diff'] if is_desktop_mode() else 'vimdiff'
     
+    # Directory diff settings
+    DIRECTORY_DIFF_SCAN_THREADS = 4     # Directories listed at once while scanning the two trees
+    DIRECTORY_DIFF_COMPARE_THREADS = 4  # File pairs compared at once
+    
+    # Find Duplicates settings
+    DUPLICATE_FINDER_THREADS = 4  # Directories listed / files hashed at once
+    
+    # Disk usage view settings
+    DISK_USAGE_SCAN_THREADS = 8  # Directories listed at once while totalling a tree
+    
     # S3 settings
     S3_CACHE_TTL = 60  # S3 cache TTL in seconds (default: 60 seconds)
+    S3_TRANSFER_CONCURRENCY = 8  # Parallel ranged GETs / multipart part uploads per large object
+    S3_TRANSFER_PART_SIZE = 8 * 1024 * 1024  # Part size in bytes (min 5 MiB); smaller objects use one request
     
     # SSH/SFTP cache settings
     SSH_CACHE_TTL = 30        # SSH cache TTL in seconds for successful results (default: 30 seconds)
     SSH_CACHE_ERROR_TTL = 300  # SSH cache TTL in seconds for cached errors (default: 300 seconds / 5 minutes)
+    SSH_TRANSFER_CHANNELS = 4  # SFTP channels used at once when copying a folder to/from a host
+    SSH_TRANSFER_CHANNELS_PER_HOST = {}  # Per-host override, e.g. {'slow-vpn-host': 1}
+    
+    # Remote file content cache (S3 and SSH file bodies, kept in ~/.tfm/content_cache)
+    REMOTE_CONTENT_CACHE_SIZE = 512 * 1024 * 1024  # Byte budget, least recently used evicted first (0 = off)
+    
+    # Local content hash cache (SHA-256 per file version, kept in ~/.tfm/hash_cache)
+    CONTENT_HASH_CACHE_ENTRIES = 200000  # Digests kept, least recently used dropped first (0 = off)
     
     # Archive cache settings
     ARCHIVE_CACHE_MAX_OPEN = 5   # Maximum number of archives to keep open simultaneously
     ARCHIVE_CACHE_TTL = 300       # Archive cache TTL in seconds (default: 300 seconds / 5 minutes)
+    ARCHIVE_INDEX_PERSIST = True  # Keep tar.gz/tar.xz member indexes in ~/.tfm/archive_index across sessions
+    ARCHIVE_COMPRESS_THREADS = 0  # Compression threads when creating archives (0 = one per CPU core)
+    ARCHIVE_EXTRACT_THREADS = 0   # Writer threads when extracting archives (0 = one per CPU core)
     
     # File monitoring settings
     FILE_MONITORING_ENABLED = True                      # Enable/disable automatic file list reloading
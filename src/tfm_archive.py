@@ -20,6 +20,11 @@ from dataclasses import dataclass
 from pathlib import Path as PathlibPath
 from tfm_path import Path, PathImpl
 from tfm_str_format import format_size
+from tfm_lru_cache import LRUCache
+from tfm_archive_index import (
+    TarIndexStore, TarIndexMember, TarIndexError, HAS_ZSTD, HAS_LZ4,
+    ArchiveTree, ZipDirectory, ZipRecord, ZipDirectoryError, read_zip_central_directory
+)
 from typing import List, Optional, Union, Tuple, Dict, Any, Iterator
 
 
@@ -131,6 +136,51 @@ class ArchiveEntry:
             archive_type=archive_type
         )
     
+    @classmethod
+    def from_zip_record(cls, record: ZipRecord, archive_type: str = 'zip') -> 'ArchiveEntry':
+        """
+        Create an ArchiveEntry from a central-directory record.
+        
+        Mirrors from_zip_info() for entries read by read_zip_central_directory()
+        instead of zipfile, so large archives list without building ZipInfo
+        objects.
+        
+        Args:
+            record: ZipRecord from tfm_archive_index
+            archive_type: Type of archive (default: 'zip')
+            
+        Returns:
+            ArchiveEntry: New entry created from the record
+        """
+        import datetime
+        internal_path = record.filename
+        is_dir = internal_path.endswith('/')
+        
+        d, t = record.dos_date, record.dos_time
+        try:
+            mtime = datetime.datetime(
+                (d >> 9) + 1980, (d >> 5) & 0xF, d & 0x1F,
+                t >> 11, (t >> 5) & 0x3F, (t & 0x1F) * 2
+            ).timestamp()
+        except (ValueError, OverflowError):
+            mtime = 0.0
+        
+        if record.external_attr:
+            mode = (record.external_attr >> 16) & 0o777
+        else:
+            mode = 0o755 if is_dir else 0o644
+        
+        return cls(
+            name=internal_path.rstrip('/').split('/')[-1] if internal_path else '',
+            internal_path=internal_path,
+            is_dir=is_dir,
+            size=record.file_size,
+            compressed_size=record.compress_size,
+            mtime=mtime,
+            mode=mode,
+            archive_type=archive_type
+        )
+    
     @classmethod
     def from_tar_info(cls, tar_info: tarfile.TarInfo, archive_type: str = 'tar') -> 'ArchiveEntry':
         """
@@ -173,6 +223,33 @@ class ArchiveEntry:
             archive_type=archive_type
         )
 
+    @classmethod
+    def from_tar_index_member(cls, member: TarIndexMember, archive_type: str) -> 'ArchiveEntry':
+        """
+        Create an ArchiveEntry from a member recorded in a TarIndex.
+        
+        Mirrors from_tar_info() for archives listed from a persisted index
+        instead of a live TarFile.
+        
+        Args:
+            member: TarIndexMember from tfm_archive_index
+            archive_type: Type of archive (e.g., 'tar.gz', 'tar.xz')
+            
+        Returns:
+            ArchiveEntry: New entry created from the index member
+        """
+        is_dir = member.kind == 'd'
+        return cls(
+            name=member.name.rstrip('/').split('/')[-1] if member.name else '',
+            internal_path=member.name,
+            is_dir=is_dir,
+            size=member.size,
+            compressed_size=member.size,
+            mtime=member.mtime or 0.0,
+            mode=member.mode if member.mode else (0o755 if is_dir else 0o644),
+            archive_type=archive_type
+        )
+
 
 class ArchiveError(Exception):
     """Base exception for archive operations"""
@@ -327,8 +404,11 @@ class ArchiveHandler:
         """
         self._archive_path = archive_path
         self._archive_obj = None
-        self._entry_cache: Dict[str, ArchiveEntry] = {}
-        self._directory_cache: Dict[str, List[str]] = {}
+        # Member paths as a prefix tree; ArchiveEntry objects are made on
+        # first access and cached by node id.
+        self._tree = ArchiveTree()
+        self._entry_cache: Dict[int, ArchiveEntry] = {}
+        self._archive_type = ''
         self._is_open = False
         self._last_access = 0.0
     
@@ -410,6 +490,56 @@ class ArchiveHandler:
         """
         raise NotImplementedError("Subclasses must implement extract_to_file()")
     
+    def _entry_from_payload(self, payload) -> ArchiveEntry:
+        """
+        Build the ArchiveEntry for a tree payload. The default payload is an
+        ArchiveEntry already; subclasses storing lighter records override this.
+        """
+        return payload
+    
+    def _node_entry(self, node: int) -> ArchiveEntry:
+        """ArchiveEntry for a tree node, synthesizing implicit directories."""
+        entry = self._entry_cache.get(node)
+        if entry is None:
+            payload = self._tree.payload(node)
+            if payload is not None:
+                entry = self._entry_from_payload(payload)
+            else:
+                # Directory that only exists through deeper members
+                entry = ArchiveEntry(
+                    name=self._tree.name(node),
+                    internal_path=self._tree.path(node),
+                    is_dir=True,
+                    size=0,
+                    compressed_size=0,
+                    mtime=0.0,
+                    mode=0o755,
+                    archive_type=self._archive_type
+                )
+            self._entry_cache[node] = entry
+        return entry
+    
+    def _list_tree(self, internal_path: str) -> List[ArchiveEntry]:
+        """Direct children of ``internal_path`` — O(depth + children)."""
+        node = self._tree.find(self._normalize_path(internal_path))
+        if node is None:
+            raise ArchiveNavigationError(f"Path not found in archive: {internal_path}")
+        return [self._node_entry(child) for child in self._tree.children(node)]
+    
+    def _lookup_entry(self, internal_path: str) -> Optional[ArchiveEntry]:
+        """Entry at ``internal_path`` or None — O(depth)."""
+        normalized_path = self._normalize_path(internal_path)
+        if not normalized_path:
+            return None
+        node = self._tree.find(normalized_path)
+        return self._node_entry(node) if node is not None else None
+    
+    def _reset_tree(self, archive_type: str):
+        """Start a fresh tree before (re)caching entries."""
+        self._tree = ArchiveTree()
+        self._entry_cache.clear()
+        self._archive_type = archive_type
+    
     def _normalize_path(self, path: str) -> str:
         """
         Normalize internal archive path.
@@ -438,7 +568,24 @@ class ArchiveHandler:
 
 
 class ZipHandler(ArchiveHandler):
-    """Handler for ZIP archive files"""
+    """Handler for ZIP archive files
+    
+    Listing never touches zipfile: open() reads the central directory with
+    read_zip_central_directory() into an ArchiveTree. The zipfile.ZipFile
+    (which builds a ZipInfo per entry) is only opened on the first member
+    read or password check.
+    """
+    
+    def __init__(self, archive_path: Path):
+        """
+        Initialize ZIP handler.
+        
+        Args:
+            archive_path: Path to the archive file
+        """
+        super().__init__(archive_path)
+        self._directory = ZipDirectory([], [])
+        self._local_archive = None
     
     def open(self):
         """Open the ZIP archive and cache its structure"""
@@ -476,9 +623,12 @@ class ZipHandler(ArchiveHandler):
                 archive_to_open = str(self._archive_path)
                 self._temp_file = None
             
-            # Open the ZIP file
+            # Read the central directory
+            self._local_archive = archive_to_open
             try:
-                self._archive_obj = zipfile.ZipFile(archive_to_open, 'r')
+                self._directory = read_zip_central_directory(archive_to_open)
+            except ZipDirectoryError as e:
+                raise zipfile.BadZipFile(str(e))
             except PermissionError as e:
                 raise ArchivePermissionError(
                     f"Permission denied opening archive: {e}",
@@ -521,127 +671,45 @@ class ZipHandler(ArchiveHandler):
             self._temp_file = None
     
     def _cache_entries(self):
-        """Cache all entries from the ZIP file with lazy loading optimization"""
-        if not self._archive_obj:
-            return
-        
-        # Clear caches
-        self._entry_cache.clear()
-        self._directory_cache.clear()
-        
-        # Track all directories we've seen (including virtual ones)
-        all_directories = set()
-        
-        # For large archives, use lazy loading - only cache structure, not all entries
-        infolist = self._archive_obj.infolist()
-        is_large_archive = len(infolist) > 1000
-        
-        # Process all entries
-        for zip_info in infolist:
-            entry = ArchiveEntry.from_zip_info(zip_info, 'zip')
-            normalized_path = self._normalize_path(entry.internal_path)
-            
-            # For large archives, only cache directory structure initially
-            # Individual entries will be loaded on demand
-            if not is_large_archive or entry.is_dir or normalized_path.count('/') < 2:
-                # Cache the entry (all entries for small archives, only shallow for large)
-                self._entry_cache[normalized_path] = entry
-            
-            # Build directory cache and track parent directories
-            if normalized_path:
-                # Get all parent directories
-                parts = normalized_path.split('/')
-                for i in range(len(parts)):
-                    if i == 0:
-                        parent = ''
-                    else:
-                        parent = '/'.join(parts[:i])
-                    
-                    # Track this directory
-                    if i < len(parts) - 1 or entry.is_dir:
-                        dir_path = '/'.join(parts[:i+1]) if i < len(parts) - 1 else normalized_path
-                        if dir_path:
-                            all_directories.add(dir_path)
-                    
-                    # Add to parent's children list
-                    if i < len(parts):
-                        child = '/'.join(parts[:i+1])
-                        if parent not in self._directory_cache:
-                            self._directory_cache[parent] = []
-                        if child not in self._directory_cache[parent]:
-                            self._directory_cache[parent].append(child)
-        
-        # Create virtual directory entries for directories that don't have explicit entries
-        for dir_path in all_directories:
-            if dir_path and dir_path not in self._entry_cache:
-                # Create a virtual directory entry
-                virtual_entry = ArchiveEntry(
-                    name=dir_path.split('/')[-1],
-                    internal_path=dir_path,
-                    is_dir=True,
-                    size=0,
-                    compressed_size=0,
-                    mtime=0.0,
-                    mode=0o755,
-                    archive_type='zip'
-                )
-                self._entry_cache[dir_path] = virtual_entry
+        """Build the entry tree from the central directory in one pass. Tree
+        payloads are central-directory indexes; entries are built on access."""
+        self._reset_tree('zip')
+        normalize = self._normalize_path
+        self._tree.add_all(
+            (normalize(name), i, name.endswith('/'))
+            for i, name in enumerate(self._directory.names)
+        )
+    
+    def _entry_from_payload(self, payload: int) -> ArchiveEntry:
+        return ArchiveEntry.from_zip_record(self._directory.record(payload), 'zip')
+    
+    def _get_zipfile(self) -> zipfile.ZipFile:
+        """The zipfile object used for member reads, opened on first use."""
+        if self._archive_obj is None:
+            self._archive_obj = zipfile.ZipFile(self._local_archive, 'r')
+        return self._archive_obj
     
     def list_entries(self, internal_path: str = "") -> List[ArchiveEntry]:
         """List entries at the given internal path"""
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        
-        # Get direct children from directory cache
-        if normalized_path not in self._directory_cache:
-            # Path doesn't exist or has no children
-            if normalized_path and normalized_path not in self._entry_cache:
-                raise ArchiveNavigationError(f"Path not found in archive: {internal_path}")
-            return []
-        
-        # Return entries for direct children only
-        entries = []
-        for child_path in self._directory_cache[normalized_path]:
-            if child_path in self._entry_cache:
-                entries.append(self._entry_cache[child_path])
-        
-        return entries
+        return self._list_tree(internal_path)
     
     def get_entry_info(self, internal_path: str) -> Optional[ArchiveEntry]:
-        """Get information about a specific entry with lazy loading"""
+        """Get information about a specific entry"""
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        
-        # Check cache first
-        if normalized_path in self._entry_cache:
-            return self._entry_cache[normalized_path]
-        
-        # For large archives with lazy loading, load entry on demand
-        if self._archive_obj:
-            try:
-                zip_info = self._archive_obj.getinfo(normalized_path)
-                entry = ArchiveEntry.from_zip_info(zip_info, 'zip')
-                self._entry_cache[normalized_path] = entry
-                return entry
-            except KeyError:
-                # Entry doesn't exist
-                return None
-        
-        return None
+        return self._lookup_entry(internal_path)
     
     def extract_to_bytes(self, internal_path: str) -> bytes:
         """Extract a file's contents to memory"""
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        
-        # Check if entry exists (with lazy loading)
-        entry = self.get_entry_info(normalized_path)
+        # Check if entry exists
+        entry = self.get_entry_info(internal_path)
         if not entry:
             raise FileNotFoundError(
                 f"File not found in archive: {internal_path}",
@@ -657,7 +725,7 @@ class ZipHandler(ArchiveHandler):
         try:
             # Extract file contents. The registered password (if any) is only
             # consulted for encrypted entries; it is ignored otherwise.
-            return self._archive_obj.read(
+            return self._get_zipfile().read(
                 entry.internal_path, pwd=get_archive_password(self._archive_path)
             )
         except NotImplementedError as e:
@@ -709,9 +777,13 @@ class ZipHandler(ArchiveHandler):
         ``'aes'`` (see :func:`zip_encryption_status`). Opens the archive first."""
         if not self._is_open:
             self.open()
-        if not self._archive_obj:
-            return 'none'
-        return zip_encryption_status(self._archive_obj)
+        status = 'none'
+        for flag_bits, compress_type in self._directory.flags_and_methods():
+            if flag_bits & _ZIP_ENCRYPTED_FLAG:
+                if compress_type == _ZIP_AES_METHOD:
+                    return 'aes'
+                status = 'zipcrypto'
+        return status
 
     def verify_password(self, password: bytes) -> bool:
         """Return True if ``password`` correctly opens this zip's encrypted
@@ -719,10 +791,8 @@ class ZipHandler(ArchiveHandler):
         (AES) propagates, since that isn't a wrong-password condition."""
         if not self._is_open:
             self.open()
-        if not self._archive_obj:
-            return False
         try:
-            verify_zip_password(self._archive_obj, password)
+            verify_zip_password(self._get_zipfile(), password)
             return True
         except RuntimeError:
             return False
@@ -732,10 +802,8 @@ class ZipHandler(ArchiveHandler):
         if not self._is_open:
             self.open()
 
-        normalized_path = self._normalize_path(internal_path)
-
         # Check if entry exists
-        entry = self._entry_cache.get(normalized_path)
+        entry = self.get_entry_info(internal_path)
         if not entry:
             raise FileNotFoundError(
                 f"File not found in archive: {internal_path}",
@@ -751,7 +819,7 @@ class ZipHandler(ArchiveHandler):
         try:
             # Extract file contents (registered password used only if encrypted).
             try:
-                data = self._archive_obj.read(
+                data = self._get_zipfile().read(
                     entry.internal_path, pwd=get_archive_password(self._archive_path)
                 )
             except NotImplementedError as e:
@@ -801,16 +869,28 @@ class ZipHandler(ArchiveHandler):
 class TarHandler(ArchiveHandler):
     """Handler for TAR archive files (including compressed variants)"""
     
-    def __init__(self, archive_path: Path, compression: Optional[str] = None):
+    #: Compressions whose members are read through a TarIndex (when the
+    #: handler is given an index store) instead of tarfile's from-the-start seek.
+    INDEXED_COMPRESSIONS = ('gz', 'xz')
+    
+    def __init__(self, archive_path: Path, compression: Optional[str] = None,
+                 index_store: Optional[TarIndexStore] = None):
         """
         Initialize TAR handler.
         
         Args:
             archive_path: Path to the archive file
             compression: Compression type ('gz', 'bz2', 'xz', or None)
+            index_store: Optional shared TarIndexStore. When given, gz/xz
+                archives are listed and read through a TarIndex instead of
+                tarfile, so reads seek to the nearest decompressor checkpoint.
         """
         super().__init__(archive_path)
         self._compression = compression
+        self._index_store = index_store
+        self._index = None
+        self._local_archive = None
+        self._mode = 'r'
     
     def open(self):
         """Open the TAR archive and cache its structure"""
@@ -858,14 +938,25 @@ class TarHandler(ArchiveHandler):
                 archive_to_open = str(self._archive_path)
                 self._temp_file = None
             
-            # Open the TAR file
+            self._local_archive = archive_to_open
+            self._mode = mode
+            
+            # Open the TAR file, through the shared index when one applies
             try:
-                self._archive_obj = tarfile.open(archive_to_open, mode)
+                if self._index_store is not None and self._compression in self.INDEXED_COMPRESSIONS:
+                    self._index = self._load_index()
+                else:
+                    self._archive_obj = tarfile.open(archive_to_open, mode)
             except PermissionError as e:
                 raise ArchivePermissionError(
                     f"Permission denied opening archive: {e}",
                     f"Cannot open archive '{self._archive_path.name}': Permission denied"
                 )
+            except TarIndexError as e:
+                raise ArchiveCorruptedError(
+                    f"Corrupted TAR archive: {e}",
+                    f"Archive '{self._archive_path.name}' is corrupted or invalid"
+                )
             
             self._is_open = True
             
@@ -895,6 +986,7 @@ class TarHandler(ArchiveHandler):
     def close(self):
         """Close the TAR archive and clean up temp files"""
         super().close()
+        self._index = None
         if hasattr(self, '_temp_file') and self._temp_file:
             try:
                 os.unlink(self._temp_file)
@@ -902,115 +994,89 @@ class TarHandler(ArchiveHandler):
                 pass
             self._temp_file = None
     
+    def _load_index(self):
+        """Get this archive's TarIndex from the shared store, building it with
+        one scan of ``self._local_archive`` if no valid one is cached."""
+        st = self._archive_path.stat()
+        mtime_ns = getattr(st, 'st_mtime_ns', None) or int(st.st_mtime * 1e9)
+        return self._index_store.get_index(
+            str(self._archive_path.absolute()), self._local_archive,
+            self._compression, st.st_size, mtime_ns
+        )
+    
+    def _get_tarfile(self) -> tarfile.TarFile:
+        """The tarfile object, opened on first use for indexed archives (only
+        needed for members the index cannot serve, e.g. symlinks)."""
+        if self._archive_obj is None:
+            self._archive_obj = tarfile.open(self._local_archive, self._mode)
+        return self._archive_obj
+    
+    def _iter_entries(self, archive_type: str) -> Iterator[ArchiveEntry]:
+        """Yield an ArchiveEntry per member, from the index when there is one."""
+        if self._index is not None:
+            for member in self._index.members:
+                yield ArchiveEntry.from_tar_index_member(member, archive_type)
+        else:
+            for tar_info in self._archive_obj.getmembers():
+                yield ArchiveEntry.from_tar_info(tar_info, archive_type)
+    
+    def _read_member(self, entry: ArchiveEntry, internal_path: str) -> bytes:
+        """Read a member's contents, seeking via the index when possible."""
+        if self._index is not None:
+            try:
+                data = self._index.read_member(self._local_archive, entry.internal_path)
+            except TarIndexError as e:
+                raise ArchiveExtractionError(
+                    f"Error extracting file: {e}",
+                    f"Cannot extract '{internal_path}': {e}"
+                )
+            if data is not None:
+                return data
+        
+        file_obj = self._get_tarfile().extractfile(entry.internal_path)
+        if file_obj is None:
+            raise ArchiveExtractionError(
+                f"Cannot extract file: {internal_path}",
+                f"Cannot extract '{internal_path}' from archive"
+            )
+        return file_obj.read()
+    
     def _cache_entries(self):
         """Cache all entries from the TAR file"""
-        if not self._archive_obj:
+        if not self._archive_obj and self._index is None:
             return
         
-        # Clear caches
-        self._entry_cache.clear()
-        self._directory_cache.clear()
-        
-        # Determine archive type string
-        if self._compression == 'gz':
-            archive_type = 'tar.gz'
-        elif self._compression == 'bz2':
-            archive_type = 'tar.bz2'
-        elif self._compression == 'xz':
-            archive_type = 'tar.xz'
-        else:
-            archive_type = 'tar'
-        
-        # Track all directories we've seen (including virtual ones)
-        all_directories = set()
+        # Determine archive type string ('tar', 'tar.gz', 'tar.zst', ...)
+        archive_type = f'tar.{self._compression}' if self._compression else 'tar'
         
-        # Process all entries
-        for tar_info in self._archive_obj.getmembers():
-            entry = ArchiveEntry.from_tar_info(tar_info, archive_type)
-            normalized_path = self._normalize_path(entry.internal_path)
-            
-            # Cache the entry
-            self._entry_cache[normalized_path] = entry
-            
-            # Build directory cache and track parent directories
-            if normalized_path:
-                # Get all parent directories
-                parts = normalized_path.split('/')
-                for i in range(len(parts)):
-                    if i == 0:
-                        parent = ''
-                    else:
-                        parent = '/'.join(parts[:i])
-                    
-                    # Track this directory
-                    if i < len(parts) - 1 or entry.is_dir:
-                        dir_path = '/'.join(parts[:i+1]) if i < len(parts) - 1 else normalized_path
-                        if dir_path:
-                            all_directories.add(dir_path)
-                    
-                    # Add to parent's children list
-                    if i < len(parts):
-                        child = '/'.join(parts[:i+1])
-                        if parent not in self._directory_cache:
-                            self._directory_cache[parent] = []
-                        if child not in self._directory_cache[parent]:
-                            self._directory_cache[parent].append(child)
-        
-        # Create virtual directory entries for directories that don't have explicit entries
-        for dir_path in all_directories:
-            if dir_path and dir_path not in self._entry_cache:
-                # Create a virtual directory entry
-                virtual_entry = ArchiveEntry(
-                    name=dir_path.split('/')[-1],
-                    internal_path=dir_path,
-                    is_dir=True,
-                    size=0,
-                    compressed_size=0,
-                    mtime=0.0,
-                    mode=0o755,
-                    archive_type=archive_type
-                )
-                self._entry_cache[dir_path] = virtual_entry
+        self._reset_tree(archive_type)
+        normalize = self._normalize_path
+        self._tree.add_all(
+            (normalize(entry.internal_path), entry, entry.is_dir)
+            for entry in self._iter_entries(archive_type)
+        )
     
     def list_entries(self, internal_path: str = "") -> List[ArchiveEntry]:
         """List entries at the given internal path"""
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        
-        # Get direct children from directory cache
-        if normalized_path not in self._directory_cache:
-            # Path doesn't exist or has no children
-            if normalized_path and normalized_path not in self._entry_cache:
-                raise ArchiveNavigationError(f"Path not found in archive: {internal_path}")
-            return []
-        
-        # Return entries for direct children only
-        entries = []
-        for child_path in self._directory_cache[normalized_path]:
-            if child_path in self._entry_cache:
-                entries.append(self._entry_cache[child_path])
-        
-        return entries
+        return self._list_tree(internal_path)
     
     def get_entry_info(self, internal_path: str) -> Optional[ArchiveEntry]:
         """Get information about a specific entry"""
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        return self._entry_cache.get(normalized_path)
+        return self._lookup_entry(internal_path)
     
     def extract_to_bytes(self, internal_path: str) -> bytes:
         """Extract a file's contents to memory"""
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        
         # Check if entry exists
-        entry = self._entry_cache.get(normalized_path)
+        entry = self.get_entry_info(internal_path)
         if not entry:
             raise FileNotFoundError(
                 f"File not found in archive: {internal_path}",
@@ -1025,14 +1091,7 @@ class TarHandler(ArchiveHandler):
         
         try:
             # Extract file contents
-            file_obj = self._archive_obj.extractfile(entry.internal_path)
-            if file_obj is None:
-                raise ArchiveExtractionError(
-                    f"Cannot extract file: {internal_path}",
-                    f"Cannot extract '{internal_path}' from archive"
-                )
-            
-            return file_obj.read()
+            return self._read_member(entry, internal_path)
         except ArchiveExtractionError:
             # Re-raise our custom exception
             raise
@@ -1062,10 +1121,8 @@ class TarHandler(ArchiveHandler):
         if not self._is_open:
             self.open()
         
-        normalized_path = self._normalize_path(internal_path)
-        
         # Check if entry exists
-        entry = self._entry_cache.get(normalized_path)
+        entry = self.get_entry_info(internal_path)
         if not entry:
             raise FileNotFoundError(
                 f"File not found in archive: {internal_path}",
@@ -1080,14 +1137,7 @@ class TarHandler(ArchiveHandler):
         
         try:
             # Extract file contents
-            file_obj = self._archive_obj.extractfile(entry.internal_path)
-            if file_obj is None:
-                raise ArchiveExtractionError(
-                    f"Cannot extract file: {internal_path}",
-                    f"Cannot extract '{internal_path}' from archive"
-                )
-            
-            data = file_obj.read()
+            data = self._read_member(entry, internal_path)
             
             # Write to target
             try:
@@ -1125,39 +1175,130 @@ class TarHandler(ArchiveHandler):
             )
 
 
+class FramedTarHandler(TarHandler):
+    """Handler for tar archives compressed as zstd or lz4 frames (.tar.zst,
+    .tar.lz4), which tarfile cannot open.
+    
+    Everything goes through a TarIndex: listing comes from the member table
+    and reads decode from the nearest frame start. Seekable-format zstd files
+    (many small frames plus a seek table, as ``zstd --seekable`` and TFM's own
+    writer produce) therefore read any member by decoding one or two frames;
+    a single-frame file still lists without a second pass. Members the index
+    cannot serve (sparse files) are found by decoding from the start.
+    
+    Needs the optional ``zstandard`` / ``lz4`` module for the codec.
+    """
+    
+    INDEXED_COMPRESSIONS = ('zst', 'lz4')
+    
+    #: Compression -> (module available, pip package name)
+    _DECODERS = {'zst': (HAS_ZSTD, 'zstandard'), 'lz4': (HAS_LZ4, 'lz4')}
+    
+    def __init__(self, archive_path: Path, compression: str,
+                 index_store: Optional[TarIndexStore] = None):
+        """
+        Initialize a zstd / lz4 TAR handler.
+        
+        Args:
+            archive_path: Path to the archive file
+            compression: 'zst' or 'lz4'
+            index_store: Optional shared TarIndexStore; without one the
+                handler keeps a private in-memory index
+        """
+        if compression not in self.INDEXED_COMPRESSIONS:
+            raise ValueError(f"Unsupported frame compression: {compression}")
+        super().__init__(archive_path, compression,
+                         index_store if index_store is not None else TarIndexStore())
+    
+    def open(self):
+        """Open the archive, failing early when its decoder is not installed"""
+        available, package = self._DECODERS[self._compression]
+        if not available:
+            raise ArchiveFormatError(
+                f"{self._compression} support requires the '{package}' module",
+                f"Cannot open '{self._archive_path.name}': install the Python "
+                f"'{package}' package to browse {self._compression} archives"
+            )
+        super().open()
+    
+    def _get_tarfile(self) -> tarfile.TarFile:
+        raise tarfile.ReadError(f"tarfile cannot read {self._compression} archives")
+    
+    def _read_member(self, entry: ArchiveEntry, internal_path: str) -> bytes:
+        """Read a member through the index, falling back to a sequential
+        decode for the members it cannot seek to."""
+        try:
+            data = self._index.read_member(self._local_archive, entry.internal_path)
+            if data is None:
+                data = self._index.stream_member(self._local_archive, entry.internal_path)
+        except TarIndexError as e:
+            raise ArchiveExtractionError(
+                f"Error extracting file: {e}",
+                f"Cannot extract '{internal_path}': {e}"
+            )
+        if data is None:
+            raise ArchiveExtractionError(
+                f"Cannot extract file: {internal_path}",
+                f"Cannot extract '{internal_path}' from archive"
+            )
+        return data
+
 class ArchiveCache:
     """
     Cache for opened archives and their structures.
     
     Features:
-    - LRU eviction policy to limit memory usage
-    - Configurable TTL (time-to-live) for cached structures
+    - O(1) LRU eviction to limit memory usage (tfm_lru_cache.LRUCache)
+    - Configurable TTL (time-to-live) for cached structures, renewed on access
     - Thread-safe operations with locks
     - Lazy initialization of archive handlers
     - Cache statistics and monitoring
     - Performance metrics tracking
+    - Shared tar.gz/tar.xz/tar.zst/tar.lz4 indexes (TarIndexStore) that outlive evicted
+      handlers and, with an index_dir, persist across sessions
     """
     
-    def __init__(self, max_open: int = 5, ttl: int = 300):
+    def __init__(self, max_open: int = 5, ttl: int = 300, index_dir: Optional[str] = None):
         """
         Initialize cache.
         
         Args:
             max_open: Maximum number of archives to keep open (default: 5)
             ttl: Time-to-live for cached structures in seconds (default: 300)
+            index_dir: Directory for persisted tar indexes (default: None,
+                indexes are kept in memory only)
         """
-        self._max_open = max_open
         self._ttl = ttl
-        self._handlers: Dict[str, ArchiveHandler] = {}
-        self._access_times: Dict[str, float] = {}
+        # Handlers by absolute archive path; a removed handler is closed
+        self._handlers = LRUCache(max_entries=max_open, on_evict=self._close_handler)
         self._lock = threading.RLock()
+        self._index_store = TarIndexStore(index_dir)
         
         # Performance metrics
         self._cache_hits = 0
         self._cache_misses = 0
-        self._evictions = 0
         self._total_open_time = 0.0
     
+    @property
+    def _max_open(self) -> int:
+        return self._handlers.max_entries
+    
+    @_max_open.setter
+    def _max_open(self, value: int):
+        self._handlers.max_entries = value
+    
+    @property
+    def _access_times(self) -> Dict[str, float]:
+        """Last access time of each cached handler"""
+        return {entry.key: entry.last_access for entry in self._handlers.entries()}
+    
+    @staticmethod
+    def _close_handler(entry):
+        try:
+            entry.value.close()
+        except Exception:
+            pass
+    
     def get_handler(self, archive_path: Path) -> ArchiveHandler:
         """
         Get or create handler for archive with lazy initialization.
@@ -1176,33 +1317,12 @@ class ArchiveCache:
         current_time = time.time()
         
         with self._lock:
-            # Check if handler exists and is still valid
-            if cache_key in self._handlers:
-                handler = self._handlers[cache_key]
-                access_time = self._access_times.get(cache_key, 0)
-                
-                # Check if handler has expired
-                if current_time - access_time > self._ttl:
-                    # Handler expired, close and remove it
-                    try:
-                        handler.close()
-                    except Exception:
-                        pass
-                    del self._handlers[cache_key]
-                    del self._access_times[cache_key]
-                    self._cache_misses += 1
-                else:
-                    # Handler is valid, update access time and return
-                    self._access_times[cache_key] = current_time
-                    self._cache_hits += 1
-                    return handler
-            else:
-                self._cache_misses += 1
-            
-            # Need to create new handler
-            # First, enforce max_open limit using LRU eviction
-            if len(self._handlers) >= self._max_open:
-                self._evict_lru()
+            # A handler idle for longer than the TTL is closed and dropped here
+            entry = self._handlers.get_entry(cache_key, now=current_time, refresh_ttl=True)
+            if entry is not None:
+                self._cache_hits += 1
+                return entry.value
+            self._cache_misses += 1
             
             # Create appropriate handler based on archive format
             handler = self._create_handler(archive_path)
@@ -1213,9 +1333,8 @@ class ArchiveCache:
             open_duration = time.time() - open_start
             self._total_open_time += open_duration
             
-            # Cache the handler
-            self._handlers[cache_key] = handler
-            self._access_times[cache_key] = current_time
+            # Cache the handler, evicting the least recently used past max_open
+            self._handlers.put(cache_key, handler, ttl=self._ttl, now=current_time)
             
             return handler
     
@@ -1240,13 +1359,17 @@ class ArchiveCache:
         
         # Check for TAR formats
         if filename.endswith('.tar'):
-            return TarHandler(archive_path, compression=None)
+            return TarHandler(archive_path, compression=None, index_store=self._index_store)
         elif filename.endswith('.tar.gz') or filename.endswith('.tgz'):
-            return TarHandler(archive_path, compression='gz')
+            return TarHandler(archive_path, compression='gz', index_store=self._index_store)
         elif filename.endswith('.tar.bz2') or filename.endswith('.tbz2'):
-            return TarHandler(archive_path, compression='bz2')
+            return TarHandler(archive_path, compression='bz2', index_store=self._index_store)
         elif filename.endswith('.tar.xz') or filename.endswith('.txz'):
-            return TarHandler(archive_path, compression='xz')
+            return TarHandler(archive_path, compression='xz', index_store=self._index_store)
+        elif filename.endswith('.tar.zst') or filename.endswith('.tzst'):
+            return FramedTarHandler(archive_path, compression='zst', index_store=self._index_store)
+        elif filename.endswith('.tar.lz4'):
+            return FramedTarHandler(archive_path, compression='lz4', index_store=self._index_store)
         
         # Unsupported format
         raise ArchiveFormatError(f"Unsupported archive format: {filename}")
@@ -1261,48 +1384,14 @@ class ArchiveCache:
         cache_key = str(archive_path.absolute())
         
         with self._lock:
-            if cache_key in self._handlers:
-                handler = self._handlers[cache_key]
-                try:
-                    handler.close()
-                except Exception:
-                    pass
-                del self._handlers[cache_key]
-                del self._access_times[cache_key]
+            self._handlers.pop(cache_key)
+            self._index_store.invalidate(cache_key)
     
     def clear(self):
         """Clear all cached archives."""
         with self._lock:
-            # Close all handlers
-            for handler in self._handlers.values():
-                try:
-                    handler.close()
-                except Exception:
-                    pass
-            
-            # Clear caches
+            # Closes every handler
             self._handlers.clear()
-            self._access_times.clear()
-    
-    def _evict_lru(self):
-        """Evict the least recently used cache entry."""
-        if not self._handlers:
-            return
-        
-        # Find the entry with the oldest access time
-        oldest_key = min(self._access_times.keys(), 
-                        key=lambda k: self._access_times[k])
-        
-        # Close and remove the handler
-        handler = self._handlers[oldest_key]
-        try:
-            handler.close()
-        except Exception:
-            pass
-        
-        del self._handlers[oldest_key]
-        del self._access_times[oldest_key]
-        self._evictions += 1
     
     def get_stats(self) -> Dict[str, Any]:
         """
@@ -1319,13 +1408,11 @@ class ArchiveCache:
             - hit_rate: Cache hit rate (0.0 to 1.0)
             - evictions: Number of LRU evictions performed
             - avg_open_time: Average time to open an archive (seconds)
+            - tar_indexes: TarIndexStore statistics (indexes, memory_hits,
+              disk_hits, builds)
         """
         with self._lock:
-            current_time = time.time()
-            expired_count = sum(
-                1 for cache_key in self._access_times.keys()
-                if current_time - self._access_times[cache_key] > self._ttl
-            )
+            expired_count = self._handlers.expired_count()
             
             total_requests = self._cache_hits + self._cache_misses
             hit_rate = self._cache_hits / total_requests if total_requests > 0 else 0.0
@@ -1339,8 +1426,9 @@ class ArchiveCache:
                 'cache_hits': self._cache_hits,
                 'cache_misses': self._cache_misses,
                 'hit_rate': hit_rate,
-                'evictions': self._evictions,
-                'avg_open_time': avg_open_time
+                'evictions': self._handlers.evictions,
+                'avg_open_time': avg_open_time,
+                'tar_indexes': self._index_store.get_stats()
             }
 
 
@@ -1358,12 +1446,15 @@ def get_archive_cache() -> ArchiveCache:
             config = get_config()
             max_open = config.ARCHIVE_CACHE_MAX_OPEN
             ttl = config.ARCHIVE_CACHE_TTL
+            persist_index = getattr(config, 'ARCHIVE_INDEX_PERSIST', True)
         except (ImportError, Exception):
             # Fallback to defaults if config not available
             max_open = 5
             ttl = 300
+            persist_index = True
         
-        _archive_cache = ArchiveCache(max_open=max_open, ttl=ttl)
+        index_dir = str(PathlibPath.home() / '.tfm' / 'archive_index') if persist_index else None
+        _archive_cache = ArchiveCache(max_open=max_open, ttl=ttl, index_dir=index_dir)
     
     return _archive_cache
 
@@ -2032,6 +2123,8 @@ class ArchivePathImpl(PathImpl):
             'tar.gz': 'GZIP',
             'tar.bz2': 'BZIP2',
             'tar.xz': 'LZMA/XZ',
+            'tar.zst': 'Zstandard',
+            'tar.lz4': 'LZ4',
         }
         return compression_map.get(archive_type, archive_type.upper())
     
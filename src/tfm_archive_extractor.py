@@ -0,0 +1,313 @@
+#!/usr/bin/env python3
+"""
+TFM Archive Extractor - Archive extraction with parallel writes and progress
+
+``ZipFile.extractall`` / ``TarFile.extractall`` run on one thread, report
+nothing while they work and cannot be interrupted. ``extract_archive`` does the
+same job in a cancellable, progress-reporting pipeline:
+
+- zip — members are independent, so each file is decompressed and written by
+  a worker thread (``zlib`` releases the GIL). Opening and closing a member
+  touches ``ZipFile``'s shared file state, so those two steps hold a lock;
+  the reads in between run in parallel. The password is verified up front
+  with ``verify_zip_password`` so a wrong password fails before anything is
+  written, and member names are sanitized the way ``zipfile`` does.
+- tar — the stream is decompressed once, in order, on the calling thread
+  (without the ``getmembers()`` pre-pass that made ``extractall`` decompress
+  twice). Every member goes through ``tarfile.data_filter``; small regular
+  files are then handed to a writer pool while the next members decompress,
+  large ones are streamed in chunks, and links / special files are extracted
+  by ``tarfile`` itself after the pool has caught up. Directory attributes
+  are applied last, as ``extractall`` does. Without ``data_filter`` (old
+  Python) this falls back to a plain ``extractall``. tar.zst / tar.lz4,
+  which ``tarfile`` can't decompress itself, are read through the optional
+  ``zstandard`` / ``lz4`` stream decoders in ``tarfile``'s stream mode.
+
+Progress goes to an optional ``ProgressManager``: one item per member and a
+byte bar (uncompressed bytes for zip, compressed bytes consumed for tar,
+whose member count is unknown until the end). An optional ``checkpoint`` is
+polled between chunks; when it raises, in-flight writes stop at their next
+chunk and the exception propagates. Files already written are left in place.
+"""
+
+import os
+import tarfile
+import threading
+import zipfile
+from concurrent.futures import FIRST_COMPLETED, ThreadPoolExecutor, wait
+from functools import partial
+from typing import TYPE_CHECKING, Callable, Dict, Optional
+
+from tfm_archive import verify_zip_password
+from tfm_archive_index import HAS_LZ4, HAS_ZSTD
+from tfm_archive_writer import resolve_threads
+
+if HAS_ZSTD:
+    import zstandard
+if HAS_LZ4:
+    import lz4.frame
+
+if TYPE_CHECKING:
+    from tfm_progress_manager import ProgressManager
+
+
+#: Read / write granularity; also how often cancellation is checked.
+_CHUNK = 1024 * 1024
+#: Tar members up to this size are read whole and written by the pool.
+_POOL_MAX_FILE = 8 * 1024 * 1024
+#: How long the coordinator waits on the pool before refreshing progress.
+_POLL = 0.1
+
+
+class _Aborted(Exception):
+    """Raised inside a worker when the extraction was stopped elsewhere."""
+
+
+class _Pipeline:
+    """Write jobs on a thread pool with a bounded in-flight window. The
+    coordinating thread reports progress and polls ``checkpoint`` while it
+    waits; a failing job or checkpoint stops every other job at its next
+    chunk. Jobs writing the same path run in submission order."""
+
+    def __init__(self, threads: int, report: Callable[[], None],
+                 checkpoint: Optional[Callable[[], None]]):
+        self.stop = threading.Event()
+        self.lock = threading.Lock()
+        self.bytes_done = 0
+        self.completed = 0
+        self._report = report
+        self._checkpoint = checkpoint
+        self._executor = ThreadPoolExecutor(threads, thread_name_prefix='tfm-extract')
+        self._window = threads * 2
+        self._pending = set()
+        self._by_target: Dict[str, object] = {}
+
+    def add_bytes(self, n: int) -> None:
+        if self.stop.is_set():
+            raise _Aborted()
+        with self.lock:
+            self.bytes_done += n
+
+    def submit(self, target: str, job: Callable[[], None]) -> None:
+        previous = self._by_target.get(target)
+        while previous is not None and not previous.done():
+            self._wait_some()
+        while len(self._pending) >= self._window:
+            self._wait_some()
+        future = self._executor.submit(job)
+        self._pending.add(future)
+        self._by_target[target] = future
+
+    def tick(self) -> None:
+        """Report progress and poll cancellation from the coordinating thread."""
+        self._report()
+        if self._checkpoint is not None:
+            self._checkpoint()
+
+    def drain(self) -> None:
+        while self._pending:
+            self._wait_some()
+
+    def close(self) -> None:
+        self.stop.set()
+        self._executor.shutdown(wait=True)
+
+    def _wait_some(self) -> None:
+        done, self._pending = wait(self._pending, timeout=_POLL, return_when=FIRST_COMPLETED)
+        for future in done:
+            exc = future.exception()
+            if exc is not None:
+                self.stop.set()
+                raise exc
+            self.completed += 1
+        self.tick()
+
+
+def _zip_target(dest: str, filename: str) -> Optional[str]:
+    """Where ``zipfile`` would extract ``filename`` under ``dest``: drive and
+    absolute prefixes, empty, ``.`` and ``..`` components are dropped."""
+    arcname = filename.replace('/', os.path.sep)
+    if os.path.altsep:
+        arcname = arcname.replace(os.path.altsep, os.path.sep)
+    arcname = os.path.splitdrive(arcname)[1]
+    invalid = ('', os.path.curdir, os.path.pardir)
+    arcname = os.path.sep.join(x for x in arcname.split(os.path.sep) if x not in invalid)
+    if os.path.sep == '\\':
+        arcname = zipfile.ZipFile._sanitize_windows_name(arcname, os.path.sep)
+    if not arcname:
+        return None
+    return os.path.join(dest, arcname)
+
+
+def _extract_zip(archive_path: str, dest: str, pwd: Optional[bytes], threads: int,
+                 progress: Optional['ProgressManager'],
+                 checkpoint: Optional[Callable[[], None]]) -> int:
+    with zipfile.ZipFile(archive_path) as zf:
+        verify_zip_password(zf, pwd)  # no-op unless the zip is encrypted
+        infos = zf.infolist()
+        total_bytes = sum(i.file_size for i in infos)
+        open_lock = threading.Lock()
+        current = ['']
+
+        def report() -> None:
+            if progress is not None:
+                progress.update_progress(current[0], pipeline.completed)
+                progress.update_file_byte_progress(pipeline.bytes_done, total_bytes)
+
+        pipeline = _Pipeline(threads, report, checkpoint)
+
+        def job(info: zipfile.ZipInfo, target: str) -> None:
+            os.makedirs(os.path.dirname(target), exist_ok=True)
+            with open_lock:
+                src = zf.open(info, pwd=pwd)
+            try:
+                with open(target, 'wb') as dst:
+                    while True:
+                        data = src.read(_CHUNK)
+                        if not data:
+                            break
+                        dst.write(data)
+                        pipeline.add_bytes(len(data))
+            finally:
+                with open_lock:
+                    src.close()
+
+        if progress is not None:
+            progress.update_operation_total(len(infos))
+        try:
+            for info in infos:
+                pipeline.tick()
+                target = _zip_target(dest, info.filename)
+                current[0] = info.filename
+                if target is None:
+                    pipeline.completed += 1
+                elif info.is_dir():
+                    os.makedirs(target, exist_ok=True)
+                    pipeline.completed += 1
+                else:
+                    pipeline.submit(target, partial(job, info, target))
+            pipeline.drain()
+            pipeline.tick()
+        finally:
+            pipeline.close()
+        return len(infos)
+
+
+def _open_tar(raw, fmt: str) -> tarfile.TarFile:
+    """``tarfile`` over the archive file ``raw``, decompressing zstd / lz4
+    frames in stream mode; the other formats are detected by ``tarfile``."""
+    if fmt == 'tar.zst':
+        if not HAS_ZSTD:
+            raise ValueError("zstd archives require the 'zstandard' module")
+        stream = zstandard.ZstdDecompressor().stream_reader(raw, read_across_frames=True)
+    elif fmt == 'tar.lz4':
+        if not HAS_LZ4:
+            raise ValueError("lz4 archives require the 'lz4' module")
+        stream = lz4.frame.LZ4FrameFile(raw, 'rb')
+    else:
+        return tarfile.open(fileobj=raw)
+    return tarfile.open(fileobj=stream, mode='r|')
+
+
+def _extract_tar(archive_path: str, dest: str, fmt: str, threads: int,
+                 progress: Optional['ProgressManager'],
+                 checkpoint: Optional[Callable[[], None]]) -> int:
+    if not hasattr(tarfile, 'data_filter'):
+        # Older Python without extraction filters: the stdlib path, as before
+        with open(archive_path, 'rb') as raw, _open_tar(raw, fmt) as tf:
+            tf.extractall(dest)
+            return len(tf.members)
+
+    archive_size = os.path.getsize(archive_path)
+    with open(archive_path, 'rb') as raw, _open_tar(raw, fmt) as tf:
+        count = 0
+        current = ['']
+
+        def report() -> None:
+            if progress is not None:
+                progress.update_progress(current[0], count)
+                progress.update_file_byte_progress(min(raw.tell(), archive_size), archive_size)
+
+        pipeline = _Pipeline(threads, report, checkpoint)
+
+        def finish_file(member: tarfile.TarInfo, target: str) -> None:
+            tf.chmod(member, target)
+            tf.utime(member, target)
+
+        def job(member: tarfile.TarInfo, target: str, data: bytes) -> None:
+            if pipeline.stop.is_set():
+                raise _Aborted()
+            os.makedirs(os.path.dirname(target), exist_ok=True)
+            with open(target, 'wb') as dst:
+                dst.write(data)
+            finish_file(member, target)
+
+        if progress is not None:
+            progress.update_operation_total(0)  # unknown until the stream ends
+        directories = []
+        try:
+            for original in tf:
+                pipeline.tick()
+                member = tarfile.data_filter(original, dest)
+                current[0] = member.name
+                count += 1
+                target = os.path.join(dest, member.name)
+                if member.isreg():
+                    src = tf.extractfile(original)
+                    if member.size <= _POOL_MAX_FILE:
+                        pipeline.submit(target, partial(job, member, target, src.read()))
+                        continue
+                    # Large file: stream it here; the pool keeps flushing the
+                    # small ones queued before it
+                    pipeline.drain()
+                    os.makedirs(os.path.dirname(target), exist_ok=True)
+                    with open(target, 'wb') as dst:
+                        while True:
+                            data = src.read(_CHUNK)
+                            if not data:
+                                break
+                            dst.write(data)
+                            pipeline.tick()
+                    finish_file(member, target)
+                elif member.isdir():
+                    os.makedirs(target, exist_ok=True)
+                    directories.append(member)
+                else:
+                    # Links and special files: tarfile applies the same filter;
+                    # hard links need their target written first
+                    pipeline.drain()
+                    tf.extract(original, dest, filter='data')
+            pipeline.drain()
+        finally:
+            pipeline.close()
+
+        # Directory attributes last, deepest first, as extractall does
+        directories.sort(key=lambda m: m.name, reverse=True)
+        for member in directories:
+            dirpath = os.path.join(dest, member.name)
+            tf.utime(member, dirpath)
+            tf.chmod(member, dirpath)
+        if progress is not None:
+            # Trailing padding is never read; the stream is done all the same
+            progress.update_progress(current[0], count)
+            progress.update_file_byte_progress(archive_size, archive_size)
+        return count
+
+
+def extract_archive(archive_path, dest_dir, fmt: str, *, pwd: Optional[bytes] = None,
+                    threads: int = 0, progress: Optional['ProgressManager'] = None,
+                    checkpoint: Optional[Callable[[], None]] = None) -> int:
+    """Extract the local archive ``archive_path`` into ``dest_dir`` (created if
+    absent) with ``threads`` writer threads (<= 0: one per CPU). Returns the
+    number of entries.
+
+    ``fmt`` is ``'zip'`` or a tar label; ``pwd`` is the password for an
+    encrypted zip (a missing / wrong one raises ``RuntimeError`` before any
+    file is written, AES raises ``NotImplementedError``). Unsafe tar members
+    raise ``tarfile.FilterError``."""
+    dest = str(dest_dir)
+    os.makedirs(dest, exist_ok=True)
+    threads = resolve_threads(threads)
+    if fmt == "zip":
+        return _extract_zip(str(archive_path), dest, pwd, threads, progress, checkpoint)
+    return _extract_tar(str(archive_path), dest, fmt, threads, progress, checkpoint)
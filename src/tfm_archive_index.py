@@ -0,0 +1,1109 @@
+#!/usr/bin/env python3
+"""
+TFM Archive Index - Random access into compressed tar archives
+
+``tarfile`` can only reach a member of a .tar.gz / .tar.xz by decompressing the
+stream from byte 0 (and cannot open .tar.zst / .tar.lz4 at all): ``getmembers()`` decompresses everything to list the
+archive, and every ``extractfile()`` seeks by decompressing again from the
+start. For a multi-gigabyte tarball that makes both opening the archive and
+viewing a file near its end cost a full decompression.
+
+A ``TarIndex`` is built by a single sequential scan (the zran.c approach). It
+records:
+
+- every member's header (name, type, size, mtime, mode, data offset within
+  the uncompressed stream), so reopening the archive lists it without
+  decompressing anything;
+- decompressor checkpoints, so a member read starts decoding at the nearest
+  checkpoint before the member instead of at the start of the stream.
+
+Checkpoints come in three kinds:
+
+- ``'stream'`` — the start of a gzip member / xz stream / zstd or lz4 frame.
+  Restartable from the file alone, so persisted. Multi-member gzips (pigz
+  ``--independent``, bgzip), concatenated xz streams and multi-frame zstd /
+  lz4 files get one per member. A zstd file in the seekable format (``zstd
+  --seekable``, t2sz, TFM's own writer) lists its frames in a seek table at
+  the end of the file, so those checkpoints exist before the scan starts.
+- ``'xzblock'`` — an xz block boundary, read from the xz index at the end of
+  the file. Multi-threaded ``xz -T`` writes many independent blocks, so these
+  give random access without any decoder state. Persisted.
+- ``'zstate'`` — a copy of a live ``zlib`` decompressor taken every ``span``
+  uncompressed bytes. Python's zlib has no ``inflatePrime`` to resume at a bit
+  offset from a saved window, so these only live in memory; a reopened index
+  rebuilds them lazily as reads walk past the current frontier.
+
+Indexes are shared per archive through ``TarIndexStore`` (owned by
+``ArchiveCache``) and persisted as sidecar files, validated against the
+archive's size and mtime.
+
+The module also holds the pieces both archive handlers use to answer listing
+queries without per-entry object churn:
+
+- ``ArchiveTree`` — a prefix tree over member paths with per-directory child
+  maps, built in one linear pass. Listing a directory is O(children) and
+  resolving a path is O(depth).
+- ``read_zip_central_directory`` — a ZIP central-directory reader working on
+  an mmap of the archive, yielding compact per-entry tuples instead of
+  ``zipfile.ZipInfo`` objects.
+"""
+
+import bisect
+import hashlib
+import json
+import lzma
+import mmap
+import os
+import posixpath
+import struct
+import tarfile
+import threading
+import zlib
+from collections import OrderedDict
+from typing import Any, Callable, Dict, Iterator, List, NamedTuple, Optional, Tuple
+
+from tfm_log_manager import getLogger
+
+try:
+    import zstandard
+    HAS_ZSTD = True
+except ImportError:
+    HAS_ZSTD = False
+
+try:
+    import lz4.frame
+    HAS_LZ4 = True
+except ImportError:
+    HAS_LZ4 = False
+
+
+#: Bumped whenever the sidecar layout changes; older sidecars are rebuilt.
+INDEX_VERSION = 2
+
+#: Compressed bytes fed to the decompressor per read.
+_CHUNK_SIZE = 256 * 1024
+#: Upper bound on uncompressed bytes produced per decompress call, so highly
+#: compressible input doesn't balloon into one huge allocation.
+_MAX_OUTPUT = 1024 * 1024
+
+#: Default uncompressed distance between in-memory zlib checkpoints.
+DEFAULT_SPAN = 4 * 1024 * 1024
+#: Symlink chains longer than this are treated as unresolvable.
+_MAX_LINK_HOPS = 8
+#: Approximate memory held by one zlib checkpoint: the decompressor copy with
+#: its 32 KB window.
+STATE_CHECKPOINT_BYTES = 40 * 1024
+#: Memory budget for one index's zlib checkpoints. Once it would be exceeded the
+#: span doubles and every other checkpoint is dropped, so the checkpoints of a
+#: TarIndexStore never hold more than ``max_indexes`` times this, however large
+#: the archives.
+MAX_STATE_BYTES = 16 * 1024 * 1024
+MAX_STATE_CHECKPOINTS = MAX_STATE_BYTES // STATE_CHECKPOINT_BYTES
+
+# xz filter IDs (xz file format spec, section 5.3) -> lzma module filter IDs.
+_XZ_FILTER_IDS = {
+    0x21: lzma.FILTER_LZMA2,
+    0x03: lzma.FILTER_DELTA,
+    0x04: lzma.FILTER_X86,
+    0x05: lzma.FILTER_POWERPC,
+    0x06: lzma.FILTER_IA64,
+    0x07: lzma.FILTER_ARM,
+    0x08: lzma.FILTER_ARMTHUMB,
+    0x09: lzma.FILTER_SPARC,
+}
+
+#: Compressions ``TarIndex`` can scan. zst / lz4 need their optional modules.
+INDEXED_COMPRESSIONS = ('gz', 'xz', 'zst', 'lz4')
+
+# zstd seekable format: a skippable frame closing the file whose payload is
+# one (compressed, decompressed[, checksum]) entry per frame and a 9-byte footer.
+_ZSTD_SKIPPABLE_MAGIC = 0x184D2A5E
+_ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1
+_ZSTD_SEEK_FOOTER = struct.Struct('<IBI')
+#: What decompressing a corrupt archive can raise, per available module.
+_DECODE_ERRORS = (zlib.error, lzma.LZMAError, EOFError) + (
+    (zstandard.ZstdError,) if HAS_ZSTD else ()) + ((RuntimeError,) if HAS_LZ4 else ())
+
+#: zstandard's decompressobj has no output limit; feeding it input in slices
+#: this small bounds what one call can expand to.
+_ZSTD_FEED = 16 * 1024
+
+
+class TarIndexMember(NamedTuple):
+    """One tar member as recorded in the index.
+
+    ``kind`` is ``'f'`` (regular file), ``'d'`` (directory), ``'l'`` (hard
+    link to ``linkname``), ``'s'`` (symlink to ``linkname``), ``'x'`` (GNU
+    sparse file) or ``'o'`` (device, fifo, ...). ``'f'``, ``'l'`` and links
+    to regular members are served from the index; the rest fall back to
+    ``tarfile``."""
+    name: str
+    kind: str
+    size: int
+    mtime: float
+    mode: int
+    offset: int
+    linkname: str
+
+
+class Checkpoint(NamedTuple):
+    """A place decoding can restart: compressed file offset, the matching
+    uncompressed stream offset, the checkpoint kind and (``'zstate'`` only) the
+    saved decompressor."""
+    comp_offset: int
+    uncomp_offset: int
+    kind: str
+    state: object = None
+
+
+class TarIndexError(Exception):
+    """The archive could not be scanned or a member could not be read back."""
+    pass
+
+
+def _member_kind(tar_info: tarfile.TarInfo) -> str:
+    if tar_info.issparse():
+        return 'x'
+    if tar_info.isreg():
+        return 'f'
+    if tar_info.isdir():
+        return 'd'
+    if tar_info.islnk():
+        return 'l'
+    if tar_info.issym():
+        return 's'
+    return 'o'
+
+
+# --- xz container parsing -----------------------------------------------------
+
+
+def _read_varint(buf: bytes, pos: int) -> Tuple[int, int]:
+    """Decode an xz multibyte integer at ``pos``; returns (value, new_pos)."""
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(buf) or shift > 63:
+            raise TarIndexError("Truncated xz integer")
+        byte = buf[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def _lzma2_dict_size(prop: int) -> int:
+    bits = prop & 0x3F
+    if bits > 40:
+        raise TarIndexError(f"Invalid LZMA2 dictionary size property: {prop}")
+    if bits == 40:
+        return 0xFFFFFFFF
+    return (2 | (bits & 1)) << (bits // 2 + 11)
+
+
+def _parse_xz_block_header(header: bytes) -> Tuple[int, list]:
+    """Parse an xz block header; returns (header_size, lzma filter chain)."""
+    header_size = (header[0] + 1) * 4
+    if header[0] == 0 or len(header) < header_size:
+        raise TarIndexError("Invalid xz block header")
+    flags = header[1]
+    pos = 2
+    if flags & 0x40:
+        _, pos = _read_varint(header, pos)  # compressed size
+    if flags & 0x80:
+        _, pos = _read_varint(header, pos)  # uncompressed size
+    filters = []
+    for _ in range((flags & 0x03) + 1):
+        filter_id, pos = _read_varint(header, pos)
+        props_size, pos = _read_varint(header, pos)
+        props = header[pos:pos + props_size]
+        pos += props_size
+        if filter_id not in _XZ_FILTER_IDS:
+            raise TarIndexError(f"Unsupported xz filter: {filter_id:#x}")
+        spec = {'id': _XZ_FILTER_IDS[filter_id]}
+        if filter_id == 0x21:
+            spec['dict_size'] = _lzma2_dict_size(props[0])
+        elif filter_id == 0x03:
+            spec['dist'] = props[0] + 1
+        elif props_size == 4:
+            spec['start_offset'] = struct.unpack('<I', props)[0]
+        filters.append(spec)
+    return header_size, filters
+
+
+def _scan_xz_blocks(fh) -> List[Checkpoint]:
+    """Read the block lists of every stream in an xz file from their indexes
+    (walking stream footers backwards from the end of the file) and return one
+    ``'xzblock'`` checkpoint per block, in file order."""
+    fh.seek(0, os.SEEK_END)
+    end = fh.tell()
+    streams = []
+    while end > 0:
+        # Skip stream padding (zero bytes, a multiple of four).
+        fh.seek(end - 4)
+        if fh.read(4) == b'\0\0\0\0':
+            end -= 4
+            continue
+        if end < 24:
+            raise TarIndexError("Truncated xz stream")
+        fh.seek(end - 12)
+        footer = fh.read(12)
+        if footer[10:12] != b'YZ':
+            raise TarIndexError("Missing xz stream footer")
+        backward_size = (struct.unpack('<I', footer[4:8])[0] + 1) * 4
+        index_start = end - 12 - backward_size
+        fh.seek(index_start)
+        index = fh.read(backward_size)
+        if not index or index[0] != 0:
+            raise TarIndexError("Invalid xz index")
+        count, pos = _read_varint(index, 1)
+        records = []
+        for _ in range(count):
+            unpadded, pos = _read_varint(index, pos)
+            uncompressed, pos = _read_varint(index, pos)
+            records.append((unpadded, uncompressed))
+        blocks_size = sum((unpadded + 3) & ~3 for unpadded, _ in records)
+        stream_start = index_start - blocks_size - 12
+        if stream_start < 0:
+            raise TarIndexError("Inconsistent xz index")
+        streams.append((stream_start, records))
+        end = stream_start
+
+    checkpoints = []
+    uncomp = 0
+    for stream_start, records in reversed(streams):
+        comp = stream_start + 12
+        for unpadded, uncompressed in records:
+            checkpoints.append(Checkpoint(comp, uncomp, 'xzblock'))
+            comp += (unpadded + 3) & ~3
+            uncomp += uncompressed
+    return checkpoints
+
+
+def _scan_zstd_seek_table(fh) -> List[Checkpoint]:
+    """Frame starts of a zstd file in the seekable format, from the seek table
+    in its final skippable frame; ``[]`` when the file has none."""
+    fh.seek(0, os.SEEK_END)
+    end = fh.tell()
+    if end < 8 + _ZSTD_SEEK_FOOTER.size:
+        return []
+    fh.seek(end - _ZSTD_SEEK_FOOTER.size)
+    frames, descriptor, magic = _ZSTD_SEEK_FOOTER.unpack(fh.read(_ZSTD_SEEK_FOOTER.size))
+    if magic != _ZSTD_SEEKABLE_MAGIC:
+        return []
+    entry_size = 12 if descriptor & 0x80 else 8
+    table_size = frames * entry_size + _ZSTD_SEEK_FOOTER.size
+    table_start = end - table_size - 8
+    if table_start < 0:
+        raise TarIndexError("Truncated zstd seek table")
+    fh.seek(table_start)
+    table = fh.read(table_size + 8)
+    if struct.unpack_from('<II', table) != (_ZSTD_SKIPPABLE_MAGIC, table_size):
+        raise TarIndexError("Invalid zstd seek table")
+    checkpoints = []
+    comp = uncomp = 0
+    for i in range(frames):
+        frame_comp, frame_uncomp = struct.unpack_from('<II', table, 8 + i * entry_size)
+        checkpoints.append(Checkpoint(comp, uncomp, 'stream'))
+        comp += frame_comp
+        uncomp += frame_uncomp
+    if comp != table_start:
+        raise TarIndexError("Inconsistent zstd seek table")
+    return checkpoints
+
+
+# --- decoders ------------------------------------------------------------------
+#
+# Each decoder is a generator of uncompressed chunks starting at a checkpoint.
+# ``on_boundary(kind, comp_offset, uncomp_offset, state)`` is called at every
+# restartable point the decoder passes: gzip member / xz stream / zstd and lz4
+# frame starts, and (gzip) every fully consumed input chunk, with a
+# decompressor it may copy.
+
+
+def _iter_gzip(fh, checkpoint: Checkpoint, on_boundary: Optional[Callable] = None) -> Iterator[bytes]:
+    fh.seek(checkpoint.comp_offset)
+    comp = checkpoint.comp_offset
+    uncomp = checkpoint.uncomp_offset
+    if checkpoint.state is not None:
+        decomp = checkpoint.state.copy()
+        started = True
+    else:
+        decomp = zlib.decompressobj(31)
+        started = False
+    while True:
+        data = fh.read(_CHUNK_SIZE)
+        if not data:
+            if started and not decomp.eof:
+                raise TarIndexError("Unexpected end of gzip stream")
+            return
+        comp += len(data)
+        while True:
+            if not started:
+                # Zero padding after the last member is ignored, as gzip does.
+                data = data.lstrip(b'\0')
+                if not data:
+                    break
+                if on_boundary:
+                    on_boundary('stream', comp - len(data), uncomp, None)
+                started = True
+            out = decomp.decompress(data, _MAX_OUTPUT)
+            if out:
+                uncomp += len(out)
+                yield out
+            if decomp.eof:
+                # Another gzip member may follow: a clean restart point.
+                data = decomp.unused_data
+                decomp = zlib.decompressobj(31)
+                started = False
+                continue
+            data = decomp.unconsumed_tail
+            if not data and len(out) < _MAX_OUTPUT:
+                break
+        if on_boundary and started:
+            on_boundary('zstate', comp, uncomp, decomp)
+
+
+def _iter_xz_streams(fh, checkpoint: Checkpoint, on_boundary: Optional[Callable] = None) -> Iterator[bytes]:
+    fh.seek(checkpoint.comp_offset)
+    comp = checkpoint.comp_offset
+    uncomp = checkpoint.uncomp_offset
+    decomp = lzma.LZMADecompressor(lzma.FORMAT_XZ)
+    data = b''
+    while True:
+        if decomp.eof:
+            rest = decomp.unused_data.lstrip(b'\0')
+            while not rest:
+                more = fh.read(_CHUNK_SIZE)
+                if not more:
+                    return
+                comp += len(more)
+                rest = more.lstrip(b'\0')
+            if on_boundary:
+                on_boundary('stream', comp - len(rest), uncomp, None)
+            decomp = lzma.LZMADecompressor(lzma.FORMAT_XZ)
+            data = rest
+        elif decomp.needs_input and not data:
+            data = fh.read(_CHUNK_SIZE)
+            if not data:
+                raise TarIndexError("Unexpected end of xz stream")
+            comp += len(data)
+        out = decomp.decompress(data, _MAX_OUTPUT)
+        data = b''
+        if out:
+            uncomp += len(out)
+            yield out
+
+
+def _iter_xz_blocks(fh, blocks: List[Checkpoint], start: int) -> Iterator[bytes]:
+    """Decode xz blocks ``blocks[start:]`` one after another, each with a raw
+    LZMA decoder configured from its block header."""
+    for block in blocks[start:]:
+        fh.seek(block.comp_offset)
+        header_head = fh.read(1)
+        if not header_head:
+            return
+        header = header_head + fh.read((header_head[0] + 1) * 4 - 1)
+        header_size, filters = _parse_xz_block_header(header)
+        decomp = lzma.LZMADecompressor(lzma.FORMAT_RAW, filters=filters)
+        data = b''
+        while not decomp.eof:
+            if decomp.needs_input and not data:
+                data = fh.read(_CHUNK_SIZE)
+                if not data:
+                    raise TarIndexError("Unexpected end of xz block")
+            out = decomp.decompress(data, _MAX_OUTPUT)
+            data = b''
+            if out:
+                yield out
+
+
+def _iter_zstd(fh, checkpoint: Checkpoint, on_boundary: Optional[Callable] = None) -> Iterator[bytes]:
+    fh.seek(checkpoint.comp_offset)
+    comp = checkpoint.comp_offset
+    uncomp = checkpoint.uncomp_offset
+    dctx = zstandard.ZstdDecompressor()
+    decomp = None
+    data = b''
+    while True:
+        if not data:
+            data = fh.read(_CHUNK_SIZE)
+            if not data:
+                if decomp is not None and not decomp.eof:
+                    raise TarIndexError("Unexpected end of zstd frame")
+                return
+            comp += len(data)
+        if decomp is None or decomp.eof:
+            # Skippable frames (the seek table) decode as empty frames.
+            if on_boundary:
+                on_boundary('stream', comp - len(data), uncomp, None)
+            decomp = dctx.decompressobj()
+        piece, data = data[:_ZSTD_FEED], data[_ZSTD_FEED:]
+        out = decomp.decompress(piece)
+        if decomp.eof:
+            data = decomp.unused_data + data
+        if out:
+            uncomp += len(out)
+            yield out
+
+
+def _iter_lz4(fh, checkpoint: Checkpoint, on_boundary: Optional[Callable] = None) -> Iterator[bytes]:
+    fh.seek(checkpoint.comp_offset)
+    comp = checkpoint.comp_offset
+    uncomp = checkpoint.uncomp_offset
+    decomp = None
+    data = b''
+    while True:
+        if decomp is None or decomp.eof:
+            rest = decomp.unused_data if decomp is not None else data
+            while not rest:
+                rest = fh.read(_CHUNK_SIZE)
+                if not rest:
+                    return
+                comp += len(rest)
+            if on_boundary:
+                on_boundary('stream', comp - len(rest), uncomp, None)
+            decomp = lz4.frame.LZ4FrameDecompressor()
+            data = rest
+        elif decomp.needs_input and not data:
+            data = fh.read(_CHUNK_SIZE)
+            if not data:
+                raise TarIndexError("Unexpected end of lz4 frame")
+            comp += len(data)
+        out = decomp.decompress(data, _MAX_OUTPUT)
+        data = b''
+        if out:
+            uncomp += len(out)
+            yield out
+
+
+class _ChunkReader:
+    """Minimal read-only file object over a generator of byte chunks, enough
+    for ``tarfile``'s stream mode (``'r|'``)."""
+
+    def __init__(self, chunks: Iterator[bytes]):
+        self._chunks = chunks
+        self._buffer = bytearray()
+        self._eof = False
+
+    def read(self, size: int = -1) -> bytes:
+        while not self._eof and (size < 0 or len(self._buffer) < size):
+            try:
+                self._buffer += next(self._chunks)
+            except StopIteration:
+                self._eof = True
+        if size < 0:
+            size = len(self._buffer)
+        out = bytes(self._buffer[:size])
+        del self._buffer[:size]
+        return out
+
+
+class TarIndex:
+    """Member table and decompressor checkpoints for one compressed tar.
+
+    Reads are thread-safe: each opens its own handle on the archive file and
+    decodes from a private copy of the checkpoint state."""
+
+    def __init__(self, compression: str, members: List[TarIndexMember],
+                 checkpoints: List[Checkpoint], span: int = DEFAULT_SPAN):
+        self.compression = compression
+        self.members = members
+        self._by_name = {self._key(m.name): m for m in members}
+        self._span = span
+        self._lock = threading.Lock()
+        self._checkpoints = sorted(checkpoints, key=lambda c: c.uncomp_offset)
+        self._offsets = [c.uncomp_offset for c in self._checkpoints]
+        self._state_count = sum(1 for c in self._checkpoints if c.kind == 'zstate')
+        # Highest uncompressed offset covered by checkpoints so far.
+        self._frontier = self._offsets[-1] if self._offsets else 0
+
+    @staticmethod
+    def _key(name: str) -> str:
+        return name.replace('\\', '/').strip('/')
+
+    # -- building --------------------------------------------------------------
+
+    @classmethod
+    def build(cls, local_path: str, compression: str, span: int = DEFAULT_SPAN) -> 'TarIndex':
+        """Scan ``local_path`` once, recording members and checkpoints."""
+        if compression not in INDEXED_COMPRESSIONS:
+            raise TarIndexError(f"Unsupported compression for indexing: {compression}")
+        if (compression == 'zst' and not HAS_ZSTD) or (compression == 'lz4' and not HAS_LZ4):
+            raise TarIndexError(f"No decoder available for {compression} archives")
+        start = Checkpoint(0, 0, 'stream')
+        members = []
+        with open(local_path, 'rb') as fh:
+            checkpoints = [start]
+            if compression in ('xz', 'zst'):
+                scan = _scan_xz_blocks if compression == 'xz' else _scan_zstd_seek_table
+                try:
+                    checkpoints = scan(fh) or checkpoints
+                except (TarIndexError, OSError, IndexError, struct.error):
+                    # Not parseable as a seekable file: stream starts only.
+                    pass
+            index = cls(compression, [], checkpoints, span)
+            chunks = index._decoder(fh, start, index._on_boundary)
+            try:
+                with tarfile.open(fileobj=_ChunkReader(chunks), mode='r|') as tf:
+                    for tar_info in tf:
+                        members.append(TarIndexMember(
+                            tar_info.name, _member_kind(tar_info), tar_info.size,
+                            float(tar_info.mtime or 0), tar_info.mode,
+                            tar_info.offset_data, tar_info.linkname,
+                        ))
+                        # Stream mode keeps every TarInfo; drop them as we go.
+                        tf.members = []
+            except _DECODE_ERRORS as e:
+                raise TarIndexError(f"Error decompressing archive: {e}")
+        index.members = members
+        index._by_name = {cls._key(m.name): m for m in members}
+        return index
+
+    def _decoder(self, fh, checkpoint: Checkpoint, on_boundary=None) -> Iterator[bytes]:
+        if self.compression == 'gz':
+            return _iter_gzip(fh, checkpoint, on_boundary)
+        if self.compression == 'zst':
+            return _iter_zstd(fh, checkpoint, on_boundary)
+        if self.compression == 'lz4':
+            return _iter_lz4(fh, checkpoint, on_boundary)
+        if checkpoint.kind == 'xzblock':
+            blocks = [c for c in self._checkpoints if c.kind == 'xzblock']
+            return _iter_xz_blocks(fh, blocks, blocks.index(checkpoint))
+        return _iter_xz_streams(fh, checkpoint, on_boundary)
+
+    def _on_boundary(self, kind: str, comp_offset: int, uncomp_offset: int, state) -> None:
+        if kind == 'stream':
+            self._add_checkpoint(Checkpoint(comp_offset, uncomp_offset, 'stream'))
+        elif uncomp_offset >= self._frontier + self._span:
+            self._add_checkpoint(Checkpoint(comp_offset, uncomp_offset, 'zstate', state.copy()))
+
+    def _add_checkpoint(self, checkpoint: Checkpoint) -> None:
+        with self._lock:
+            pos = bisect.bisect_left(self._offsets, checkpoint.uncomp_offset)
+            if pos < len(self._offsets) and self._offsets[pos] == checkpoint.uncomp_offset:
+                return
+            self._checkpoints.insert(pos, checkpoint)
+            self._offsets.insert(pos, checkpoint.uncomp_offset)
+            self._frontier = max(self._frontier, checkpoint.uncomp_offset)
+            if checkpoint.kind == 'zstate':
+                self._state_count += 1
+                if self._state_count > MAX_STATE_CHECKPOINTS:
+                    self._thin_state_checkpoints()
+
+    def _thin_state_checkpoints(self) -> None:
+        """Double the span and drop every other zlib checkpoint (lock held)."""
+        self._span *= 2
+        kept = []
+        parity = 0
+        for c in self._checkpoints:
+            if c.kind == 'zstate':
+                parity ^= 1
+                if not parity:
+                    continue
+            kept.append(c)
+        self._checkpoints = kept
+        self._offsets = [c.uncomp_offset for c in kept]
+        self._state_count = sum(1 for c in kept if c.kind == 'zstate')
+
+    # -- reading ---------------------------------------------------------------
+
+    def get_member(self, name: str) -> Optional[TarIndexMember]:
+        return self._by_name.get(self._key(name))
+
+    def read_member(self, local_path: str, name: str) -> Optional[bytes]:
+        """Contents of member ``name``, or None when the index can't serve it
+        (non-regular, sparse, or unknown member) and the caller should fall
+        back to ``tarfile``. Hard and symbolic links resolve to their target's
+        data, as ``TarFile.extractfile`` does."""
+        member = self.get_member(name)
+        for _ in range(_MAX_LINK_HOPS):
+            if member is None or member.kind not in ('l', 's'):
+                break
+            target = member.linkname
+            if member.kind == 's':
+                target = posixpath.normpath(posixpath.join(posixpath.dirname(member.name), target))
+            member = self.get_member(target)
+        if member is None or member.kind != 'f':
+            return None
+        return self.read(local_path, member.offset, member.size)
+
+    def stream_member(self, local_path: str, name: str) -> Optional[bytes]:
+        """Contents of member ``name`` found by decoding the archive from the
+        start through ``tarfile`` — for the members ``read_member`` can't
+        serve (sparse files) when ``tarfile`` can't open the archive itself.
+        None if there is no such readable member."""
+        key = self._key(name)
+        try:
+            with open(local_path, 'rb') as fh:
+                chunks = self._decoder(fh, Checkpoint(0, 0, 'stream'))
+                with tarfile.open(fileobj=_ChunkReader(chunks), mode='r|') as tf:
+                    for tar_info in tf:
+                        if self._key(tar_info.name) == key:
+                            f = tf.extractfile(tar_info)
+                            return f.read() if f is not None else None
+                        tf.members = []
+        except _DECODE_ERRORS as e:
+            raise TarIndexError(f"Error decompressing archive: {e}")
+        return None
+
+    def read(self, local_path: str, offset: int, size: int) -> bytes:
+        """``size`` bytes of the uncompressed stream starting at ``offset``."""
+        if size <= 0:
+            return b''
+        with self._lock:
+            pos = bisect.bisect_right(self._offsets, offset) - 1
+            checkpoint = self._checkpoints[max(pos, 0)]
+        # Only extend the checkpoint set when decoding past the frontier.
+        on_boundary = self._on_boundary if checkpoint.uncomp_offset >= self._frontier else None
+        skip = offset - checkpoint.uncomp_offset
+        parts = []
+        remaining = size
+        try:
+            with open(local_path, 'rb') as fh:
+                for chunk in self._decoder(fh, checkpoint, on_boundary):
+                    if skip >= len(chunk):
+                        skip -= len(chunk)
+                        continue
+                    piece = chunk[skip:skip + remaining]
+                    skip = 0
+                    parts.append(piece)
+                    remaining -= len(piece)
+                    if not remaining:
+                        break
+        except _DECODE_ERRORS as e:
+            raise TarIndexError(f"Error decompressing archive: {e}")
+        if remaining:
+            raise TarIndexError("Unexpected end of archive data")
+        return b''.join(parts)
+
+    # -- persistence -----------------------------------------------------------
+
+    def persistent_checkpoints(self) -> List[Checkpoint]:
+        with self._lock:
+            return [c for c in self._checkpoints if c.kind != 'zstate']
+
+    def checkpoint_count(self) -> int:
+        with self._lock:
+            return len(self._checkpoints)
+
+    def to_bytes(self, source_size: int, source_mtime_ns: int) -> bytes:
+        doc = {
+            'version': INDEX_VERSION,
+            'compression': self.compression,
+            'size': source_size,
+            'mtime_ns': source_mtime_ns,
+            'members': [list(m) for m in self.members],
+            'checkpoints': [[c.comp_offset, c.uncomp_offset, c.kind]
+                            for c in self.persistent_checkpoints()],
+        }
+        return zlib.compress(json.dumps(doc, separators=(',', ':')).encode('utf-8'))
+
+    @classmethod
+    def from_bytes(cls, data: bytes, source_size: int, source_mtime_ns: int,
+                   span: int = DEFAULT_SPAN) -> Optional['TarIndex']:
+        """Decode a sidecar; None if it is stale, from another version, or
+        unreadable."""
+        try:
+            doc = json.loads(zlib.decompress(data).decode('utf-8'))
+            if (doc.get('version') != INDEX_VERSION or doc.get('size') != source_size
+                    or doc.get('mtime_ns') != source_mtime_ns):
+                return None
+            members = [TarIndexMember(*m) for m in doc['members']]
+            checkpoints = [Checkpoint(c[0], c[1], c[2]) for c in doc['checkpoints']]
+            return cls(doc['compression'], members, checkpoints, span)
+        except (ValueError, KeyError, TypeError, zlib.error):
+            return None
+
+
+class TarIndexStore:
+    """Per-archive ``TarIndex`` instances, shared by every handler opened on
+    the same archive and persisted as sidecar files under ``index_dir``.
+
+    Keeping the index here rather than on the handler means that an archive
+    evicted from ``ArchiveCache`` and reopened later keeps its member table and
+    its in-memory zlib checkpoints. ``index_dir=None`` keeps indexes in memory
+    only."""
+
+    def __init__(self, index_dir: Optional[str] = None, max_indexes: int = 16,
+                 span: int = DEFAULT_SPAN):
+        self._index_dir = index_dir
+        self._max_indexes = max_indexes
+        self._span = span
+        self._indexes: 'OrderedDict[str, Tuple[int, int, TarIndex]]' = OrderedDict()
+        self._lock = threading.RLock()
+        # Serializes builds per archive so concurrent opens scan only once.
+        self._build_locks = {}
+        self.logger = getLogger("ArchiveIdx")
+
+        # Statistics
+        self.memory_hits = 0
+        self.disk_hits = 0
+        self.builds = 0
+
+    def _sidecar_path(self, key: str) -> Optional[str]:
+        if not self._index_dir:
+            return None
+        digest = hashlib.sha1(key.encode('utf-8')).hexdigest()
+        return os.path.join(self._index_dir, f"{digest}.tfmidx")
+
+    def get_index(self, key: str, local_path: str, compression: str,
+                  source_size: int, source_mtime_ns: int) -> TarIndex:
+        """The index for the archive identified by ``key`` (its absolute path),
+        whose bytes are readable at ``local_path``. ``source_size`` and
+        ``source_mtime_ns`` identify the archive's current version; a cached or
+        persisted index for any other version is discarded.
+
+        Raises:
+            TarIndexError: If the archive cannot be scanned
+        """
+        with self._lock:
+            build_lock = self._build_locks.setdefault(key, threading.Lock())
+        with build_lock:
+            with self._lock:
+                cached = self._indexes.get(key)
+                if cached and cached[0] == source_size and cached[1] == source_mtime_ns:
+                    self._indexes.move_to_end(key)
+                    self.memory_hits += 1
+                    return cached[2]
+
+            index = self._load(key, source_size, source_mtime_ns)
+            if index is not None:
+                self.disk_hits += 1
+            else:
+                index = TarIndex.build(local_path, compression, self._span)
+                self.builds += 1
+                self._save(key, index, source_size, source_mtime_ns)
+
+            with self._lock:
+                self._indexes[key] = (source_size, source_mtime_ns, index)
+                self._indexes.move_to_end(key)
+                while len(self._indexes) > self._max_indexes:
+                    self._indexes.popitem(last=False)
+            return index
+
+    def _load(self, key: str, source_size: int, source_mtime_ns: int) -> Optional[TarIndex]:
+        sidecar = self._sidecar_path(key)
+        if not sidecar or not os.path.exists(sidecar):
+            return None
+        try:
+            with open(sidecar, 'rb') as f:
+                return TarIndex.from_bytes(f.read(), source_size, source_mtime_ns, self._span)
+        except OSError as e:
+            self.logger.warning(f"Could not read archive index {sidecar}: {e}")
+            return None
+
+    def _save(self, key: str, index: TarIndex, source_size: int, source_mtime_ns: int) -> None:
+        sidecar = self._sidecar_path(key)
+        if not sidecar:
+            return
+        try:
+            os.makedirs(self._index_dir, exist_ok=True)
+            tmp_path = f"{sidecar}.{os.getpid()}.tmp"
+            with open(tmp_path, 'wb') as f:
+                f.write(index.to_bytes(source_size, source_mtime_ns))
+            os.replace(tmp_path, sidecar)
+        except OSError as e:
+            # Persistence is an optimization; the in-memory index still works.
+            self.logger.warning(f"Could not write archive index {sidecar}: {e}")
+
+    def invalidate(self, key: str) -> None:
+        """Forget the in-memory index for ``key`` and delete its sidecar."""
+        with self._lock:
+            self._indexes.pop(key, None)
+        sidecar = self._sidecar_path(key)
+        if sidecar:
+            try:
+                os.unlink(sidecar)
+            except OSError:
+                pass
+
+    def clear(self) -> None:
+        """Drop all in-memory indexes (sidecars are kept)."""
+        with self._lock:
+            self._indexes.clear()
+
+    def get_stats(self) -> dict:
+        with self._lock:
+            return {
+                'indexes': len(self._indexes),
+                'memory_hits': self.memory_hits,
+                'disk_hits': self.disk_hits,
+                'builds': self.builds,
+            }
+
+
+# --- archive tree ----------------------------------------------------------------
+
+
+class ArchiveTree:
+    """Prefix tree over the member paths of an archive.
+
+    Nodes live in parallel lists indexed by node id (0 is the root). Directory
+    nodes own a ``{name: node_id}`` child map kept in first-seen order, so
+    listings come out in archive order. Each node carries an opaque payload
+    (the handler's record for that member) or None for a directory that only
+    exists implicitly through deeper members."""
+
+    ROOT = 0
+
+    def __init__(self):
+        self._names: List[str] = ['']
+        self._parents: List[int] = [-1]
+        self._children: List[Optional[Dict[str, int]]] = [{}]
+        self._payloads: List[Any] = [None]
+        # Directory path -> node id, so consecutive members of one directory
+        # skip the walk from the root.
+        self._dir_nodes: Dict[str, int] = {'': self.ROOT}
+
+    def __len__(self) -> int:
+        return len(self._names)
+
+    def _new_node(self, parent: int, name: str, is_dir: bool) -> int:
+        node = len(self._names)
+        self._names.append(name)
+        self._parents.append(parent)
+        self._children.append({} if is_dir else None)
+        self._payloads.append(None)
+        self._children[parent][name] = node
+        return node
+
+    def _dir_node(self, path: str) -> int:
+        node = self._dir_nodes.get(path)
+        if node is not None:
+            return node
+        parent_path, _, name = path.rpartition('/')
+        parent = self._dir_node(parent_path)
+        node = self._children[parent].get(name)
+        if node is None:
+            node = self._new_node(parent, name, True)
+        elif self._children[node] is None:
+            self._children[node] = {}
+        self._dir_nodes[path] = node
+        return node
+
+    def add(self, path: str, payload: Any, is_dir: bool) -> int:
+        """Insert (or overwrite) the member at normalized ``path``, creating
+        implicit parent directories. Returns the node id."""
+        if not path:
+            return self.ROOT
+        if is_dir:
+            node = self._dir_node(path)
+        else:
+            parent_path, _, name = path.rpartition('/')
+            parent = self._dir_node(parent_path)
+            node = self._children[parent].get(name)
+            if node is None:
+                node = self._new_node(parent, name, False)
+        self._payloads[node] = payload
+        return node
+
+    def add_all(self, items) -> None:
+        """Bulk ``add()`` over ``(path, payload, is_dir)`` tuples, with the
+        common case (a file in an already-seen directory) inlined."""
+        dir_nodes = self._dir_nodes
+        names = self._names
+        parents = self._parents
+        children = self._children
+        payloads = self._payloads
+        for path, payload, is_dir in items:
+            if not path:
+                continue
+            if is_dir:
+                node = self._dir_node(path)
+            else:
+                parent_path, _, name = path.rpartition('/')
+                parent = dir_nodes.get(parent_path)
+                if parent is None:
+                    parent = self._dir_node(parent_path)
+                siblings = children[parent]
+                node = siblings.get(name)
+                if node is None:
+                    node = len(names)
+                    names.append(name)
+                    parents.append(parent)
+                    children.append(None)
+                    payloads.append(None)
+                    siblings[name] = node
+            payloads[node] = payload
+
+    def find(self, path: str) -> Optional[int]:
+        """Node id for normalized ``path``, or None."""
+        node = self._dir_nodes.get(path)
+        if node is not None:
+            return node
+        node = self.ROOT
+        for part in path.split('/'):
+            children = self._children[node]
+            if children is None:
+                return None
+            node = children.get(part)
+            if node is None:
+                return None
+        return node
+
+    def children(self, node: int) -> List[int]:
+        """Child node ids of ``node`` (empty for files)."""
+        children = self._children[node]
+        return list(children.values()) if children else []
+
+    def has_children(self, node: int) -> bool:
+        return bool(self._children[node])
+
+    def name(self, node: int) -> str:
+        return self._names[node]
+
+    def payload(self, node: int) -> Any:
+        return self._payloads[node]
+
+    def path(self, node: int) -> str:
+        """Normalized path of ``node`` (``''`` for the root)."""
+        parts = []
+        while node > 0:
+            parts.append(self._names[node])
+            node = self._parents[node]
+        return '/'.join(reversed(parts))
+
+
+# --- ZIP central directory -------------------------------------------------------
+
+
+class ZipRecord(NamedTuple):
+    """The central-directory fields TFM needs for one ZIP entry."""
+    filename: str
+    flag_bits: int
+    compress_type: int
+    dos_time: int
+    dos_date: int
+    compress_size: int
+    file_size: int
+    external_attr: int
+
+
+class ZipDirectoryError(Exception):
+    """The ZIP end record or central directory is missing or malformed."""
+    pass
+
+
+_ZIP_EOCD = struct.Struct('<4s4H2LH')
+_ZIP_EOCD64 = struct.Struct('<4sQ2H2L4Q')
+# signature, flags, method, time, date, crc, csize, usize, name/extra/comment
+# lengths, external attributes
+_ZIP_CENTRAL = struct.Struct('<4s4x4HL2L3H4xL4x')
+_ZIP_EOCD_SIG = b'PK\x05\x06'
+_ZIP_EOCD64_SIG = b'PK\x06\x06'
+_ZIP_EOCD64_LOCATOR_SIZE = 20
+_ZIP_CENTRAL_SIG = b'PK\x01\x02'
+_ZIP_UTF8_FLAG = 0x800
+_ZIP64_MARKER = 0xFFFFFFFF
+
+
+def _zip64_sizes(extra: bytes, file_size: int, compress_size: int) -> Tuple[int, int]:
+    """Apply a zip64 extended-information extra field to the 32-bit sizes."""
+    pos = 0
+    while pos + 4 <= len(extra):
+        field_id, field_size = struct.unpack_from('<HH', extra, pos)
+        pos += 4
+        if field_id == 0x0001:
+            values = extra[pos:pos + field_size]
+            vpos = 0
+            if file_size == _ZIP64_MARKER and vpos + 8 <= len(values):
+                file_size = struct.unpack_from('<Q', values, vpos)[0]
+                vpos += 8
+            if compress_size == _ZIP64_MARKER and vpos + 8 <= len(values):
+                compress_size = struct.unpack_from('<Q', values, vpos)[0]
+            break
+        pos += field_size
+    return file_size, compress_size
+
+
+class ZipDirectory:
+    """The central directory of a ZIP file, kept as the raw unpacked header
+    tuples plus decoded names. ``record(i)`` builds a ``ZipRecord`` on demand,
+    so a million-entry archive costs two flat lists rather than a million
+    objects."""
+
+    def __init__(self, names: List[str], headers: List[tuple]):
+        self.names = names
+        self._headers = headers
+
+    def __len__(self) -> int:
+        return len(self.names)
+
+    def record(self, i: int) -> ZipRecord:
+        h = self._headers[i]
+        return ZipRecord(self.names[i], h[1], h[2], h[3], h[4], h[6], h[7], h[11])
+
+    def flags_and_methods(self) -> Iterator[Tuple[int, int]]:
+        """(flag_bits, compress_type) per entry, without building records."""
+        for h in self._headers:
+            yield h[1], h[2]
+
+
+def read_zip_central_directory(local_path: str) -> ZipDirectory:
+    """Read the central directory of the ZIP file at ``local_path``.
+
+    Only the end record and the central directory are touched (through an
+    mmap), never the member data. Handles zip64 and archives with data
+    prepended (self-extractors), like ``zipfile`` does.
+
+    Raises:
+        ZipDirectoryError: If the file is not a readable ZIP archive
+    """
+    with open(local_path, 'rb') as f:
+        try:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except ValueError:
+            raise ZipDirectoryError("File is empty")
+    with mm:
+        size = len(mm)
+        eocd_pos = mm.rfind(_ZIP_EOCD_SIG, max(0, size - _ZIP_EOCD.size - 0xFFFF))
+        if eocd_pos < 0 or eocd_pos + _ZIP_EOCD.size > size:
+            raise ZipDirectoryError("File is not a zip file")
+        _, _, _, _, _, cd_size, cd_offset, _ = _ZIP_EOCD.unpack_from(mm, eocd_pos)
+        end_pos = eocd_pos
+
+        eocd64_pos = eocd_pos - _ZIP_EOCD64_LOCATOR_SIZE - _ZIP_EOCD64.size
+        if eocd64_pos >= 0 and mm[eocd64_pos:eocd64_pos + 4] == _ZIP_EOCD64_SIG:
+            fields = _ZIP_EOCD64.unpack_from(mm, eocd64_pos)
+            cd_size, cd_offset = fields[8], fields[9]
+            end_pos = eocd64_pos
+
+        # Bytes prepended to the archive shift every recorded offset.
+        concat = end_pos - cd_size - cd_offset
+        if concat < 0:
+            raise ZipDirectoryError("Bad offset for central directory")
+        start = cd_offset + concat
+        cd = mm[start:start + cd_size]
+
+    # One tight pass over the fixed-size headers; names are sliced afterwards.
+    headers = []
+    starts = []
+    append_header = headers.append
+    append_start = starts.append
+    unpack_central = _ZIP_CENTRAL.unpack_from
+    header_size = _ZIP_CENTRAL.size
+    pos = 0
+    try:
+        while pos < cd_size:
+            header = unpack_central(cd, pos)
+            append_header(header)
+            append_start(pos)
+            pos += header_size + header[8] + header[9] + header[10]
+    except struct.error:
+        raise ZipDirectoryError("Truncated central directory")
+    if any(header[0] != _ZIP_CENTRAL_SIG for header in headers):
+        raise ZipDirectoryError("Bad magic number for central directory")
+
+    names = [
+        cd[p + header_size:p + header_size + h[8]].decode('utf-8' if h[1] & _ZIP_UTF8_FLAG else 'cp437')
+        for p, h in zip(starts, headers)
+    ]
+
+    for i, h in enumerate(headers):
+        if h[6] == _ZIP64_MARKER or h[7] == _ZIP64_MARKER:
+            extra_start = starts[i] + header_size + h[8]
+            usize, csize = _zip64_sizes(cd[extra_start:extra_start + h[9]], h[7], h[6])
+            headers[i] = h[:6] + (csize, usize) + h[8:]
+    return ZipDirectory(names, headers)
@@ -12,7 +12,8 @@ The relations subsume the legacy three-way menu and add direction:
 
 - ``size``    — ``any`` / ``equal`` / ``differs``   (ignored for directories)
 - ``mtime``   — ``any`` / ``same`` / ``newer`` / ``older``   (relative to other pane)
-- ``content`` — ``any`` / ``equal`` / ``differs``   (byte compare; ignored for dirs)
+- ``content`` — ``any`` / ``equal`` / ``differs``   (byte compare, or remote
+  digests; ignored for dirs)
 
 ``stat``-only comparisons (size / mtime) are cheap and are called only on
 name-matched pairs. A content comparison reads both files, so callers route it
@@ -27,13 +28,12 @@ import unicodedata
 from dataclasses import dataclass, field
 from typing import Any, Callable, Iterable, Optional
 
+from tfm_content_digest import compare_content
+
 # Filesystems round mtimes (FAT ≈ 2s, some networks ≈ 1s); treat timestamps
 # within this many seconds as identical, matching ttk TFM's compare.
 MTIME_TOLERANCE = 1.0
 
-# Read size for the streaming byte compare (only reached when sizes already match).
-_CHUNK = 1 << 16
-
 
 def _norm(name: str) -> str:
     return unicodedata.normalize("NFC", name)
@@ -167,16 +167,10 @@ def _matches(cur, other, is_dir: bool, criteria: CompareCriteria,
 
 def _content_equal(cur, other, cur_stat, other_stat,
                    checkpoint: Callable[[], None]) -> bool:
-    """Byte-compare two files, short-circuiting: different sizes ⇒ not equal
-    (no read), otherwise stream both and stop at the first differing chunk."""
+    """Compare two files' content, short-circuiting: different sizes ⇒ not
+    equal (no read), otherwise :func:`tfm_content_digest.compare_content` —
+    remote digests, cached local digests, or a byte compare that stops at the
+    first differing block (and caches the digests of files found equal)."""
     if cur_stat.st_size != other_stat.st_size:
         return False
-    with cur.open("rb") as fa, other.open("rb") as fb:
-        while True:
-            checkpoint()
-            a = fa.read(_CHUNK)
-            b = fb.read(_CHUNK)
-            if a != b:
-                return False
-            if not a:
-                return True
+    return compare_content(cur, other, checkpoint)
@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+"""
+TFM Content Cache - Disk-backed cache of remote file bodies
+
+Reading an S3 object or a file on an SSH host means transferring it, and the
+in-memory API caches used to keep those bodies in process memory until exit.
+``ContentCache`` keeps them on disk under ``~/.tfm/content_cache`` instead,
+shared by every remote storage and kept across sessions:
+
+- ``blobs/<sha256>`` — file content, named by its SHA-256, so the same bytes
+  reached through two remote paths are stored once;
+- ``refs/<sha1 of version key>`` — the digest of the blob holding one version
+  of one remote file. The version key names the file and what identifies its
+  version (S3: ETag and size; SSH: mtime and size), so a changed file misses
+  and its old body simply ages out.
+
+Blobs are evicted least-recently-used against a byte budget. A hit bumps the
+blob's mtime, so the LRU order survives a restart: the first use scans
+``blobs/`` once and orders it by mtime. A ref whose blob was evicted is
+removed the next time it is looked up.
+
+Hits are served by mapping the blob (``mmap``): ``open()`` reads straight from
+the page cache, and only ``read()`` makes a copy, because callers of
+``read_bytes()`` need one.
+"""
+
+import hashlib
+import io
+import mmap
+import os
+import threading
+from collections import OrderedDict
+from pathlib import Path as PathlibPath
+from typing import Optional
+
+from tfm_log_manager import getLogger
+
+#: Default byte budget for cached bodies (``REMOTE_CONTENT_CACHE_SIZE``)
+DEFAULT_MAX_BYTES = 512 * 1024 * 1024
+
+
+class _MappedReader(io.RawIOBase):
+    """Seekable raw stream over a mapped blob; closing it unmaps the blob."""
+
+    def __init__(self, mapped: mmap.mmap):
+        self._mapped = mapped
+        self._pos = 0
+
+    def readable(self) -> bool:
+        return True
+
+    def seekable(self) -> bool:
+        return True
+
+    def readinto(self, buffer) -> int:
+        end = min(len(self._mapped), self._pos + len(buffer))
+        count = max(0, end - self._pos)
+        buffer[:count] = self._mapped[self._pos:end]
+        self._pos = end if count else self._pos
+        return count
+
+    def seek(self, offset: int, whence: int = io.SEEK_SET) -> int:
+        if whence == io.SEEK_CUR:
+            offset += self._pos
+        elif whence == io.SEEK_END:
+            offset += len(self._mapped)
+        if offset < 0:
+            raise ValueError("negative seek position")
+        self._pos = offset
+        return offset
+
+    def tell(self) -> int:
+        return self._pos
+
+    def close(self) -> None:
+        if not self.closed:
+            self._mapped.close()
+        super().close()
+
+
+class ContentCache:
+    """Content-addressed store of remote file bodies with an LRU byte budget.
+
+    ``cache_dir=None`` or ``max_bytes=0`` disables the cache: every lookup
+    misses and nothing is stored. Bodies larger than ``max_object_bytes``
+    (default a quarter of the budget) are not stored, so one huge file can't
+    flush everything else."""
+
+    def __init__(self, cache_dir: Optional[str], max_bytes: int = DEFAULT_MAX_BYTES,
+                 max_object_bytes: Optional[int] = None):
+        self._dir = cache_dir if max_bytes > 0 else None
+        self.max_bytes = max_bytes
+        self.max_object_bytes = max_bytes // 4 if max_object_bytes is None else max_object_bytes
+        # digest -> size, least recently used first; None until loaded
+        self._blobs: Optional['OrderedDict[str, int]'] = None
+        self._total = 0
+        self._lock = threading.RLock()
+        self.logger = getLogger("ContentCache")
+
+        # Statistics
+        self.hits = 0
+        self.misses = 0
+        self.stores = 0
+        self.evictions = 0
+
+    @staticmethod
+    def version_key(uri: str, *version) -> str:
+        """The key for one version of the file at ``uri``, e.g.
+        ``version_key('s3://b/k', etag, size)``."""
+        return '\0'.join([uri] + [str(v) for v in version])
+
+    def _blob_path(self, digest: str) -> str:
+        return os.path.join(self._dir, 'blobs', digest)
+
+    def _ref_path(self, key: str) -> str:
+        name = hashlib.sha1(key.encode('utf-8', 'surrogateescape')).hexdigest()
+        return os.path.join(self._dir, 'refs', name)
+
+    def _load(self) -> 'OrderedDict[str, int]':
+        """Scan ``blobs/`` once and order it by last use (caller holds the lock)."""
+        if self._blobs is None:
+            found = []
+            try:
+                with os.scandir(os.path.join(self._dir, 'blobs')) as entries:
+                    for entry in entries:
+                        if entry.name.endswith('.tmp'):
+                            continue
+                        try:
+                            st = entry.stat()
+                        except OSError:
+                            continue
+                        found.append((st.st_mtime_ns, entry.name, st.st_size))
+            except OSError:
+                pass
+            found.sort()
+            self._blobs = OrderedDict((name, size) for _, name, size in found)
+            self._total = sum(self._blobs.values())
+            self._evict()
+        return self._blobs
+
+    def _lookup(self, key: str) -> Optional[str]:
+        """The blob path for ``key``, marked as just used; None on a miss."""
+        if self._dir is None:
+            return None
+        ref = self._ref_path(key)
+        with self._lock:
+            blobs = self._load()
+            try:
+                with open(ref, 'r', encoding='ascii') as f:
+                    digest = f.read().strip()
+            except OSError:
+                self.misses += 1
+                return None
+            if digest not in blobs:
+                # The blob was evicted (possibly by another TFM process)
+                self._unlink(ref)
+                self.misses += 1
+                return None
+            path = self._blob_path(digest)
+            try:
+                os.utime(path)
+            except FileNotFoundError:
+                self._total -= blobs.pop(digest)
+                self._unlink(ref)
+                self.misses += 1
+                return None
+            except OSError:
+                pass
+            blobs.move_to_end(digest)
+            self.hits += 1
+            return path
+
+    def open(self, key: str) -> Optional[io.BufferedReader]:
+        """A binary stream over the cached body for ``key``, or None on a miss."""
+        path = self._lookup(key)
+        if path is None:
+            return None
+        try:
+            with open(path, 'rb') as f:
+                if os.fstat(f.fileno()).st_size == 0:
+                    return io.BufferedReader(io.BytesIO(b''))
+                mapped = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (OSError, ValueError):
+            return None
+        return io.BufferedReader(_MappedReader(mapped), buffer_size=256 * 1024)
+
+    def read(self, key: str) -> Optional[bytes]:
+        """The cached body for ``key`` as bytes, or None on a miss."""
+        path = self._lookup(key)
+        if path is None:
+            return None
+        try:
+            with open(path, 'rb') as f:
+                if os.fstat(f.fileno()).st_size == 0:
+                    return b''
+                with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mapped:
+                    return mapped[:]
+        except (OSError, ValueError):
+            return None
+
+    def put(self, key: str, data) -> bool:
+        """Store ``data`` (bytes-like) as the body for ``key``. Returns False
+        when the cache is disabled, the body is over ``max_object_bytes``, or it
+        could not be written."""
+        if self._dir is None or len(data) > self.max_object_bytes:
+            return False
+        digest = hashlib.sha256(data).hexdigest()
+        blob = self._blob_path(digest)
+        ref = self._ref_path(key)
+        tmp_suffix = f".{os.getpid()}.{threading.get_ident()}.tmp"
+        with self._lock:
+            blobs = self._load()
+            try:
+                if digest not in blobs:
+                    os.makedirs(os.path.dirname(blob), exist_ok=True)
+                    with open(blob + tmp_suffix, 'wb') as f:
+                        f.write(data)
+                    os.replace(blob + tmp_suffix, blob)
+                    blobs[digest] = len(data)
+                    self._total += len(data)
+                blobs.move_to_end(digest)
+                os.makedirs(os.path.dirname(ref), exist_ok=True)
+                with open(ref + tmp_suffix, 'w', encoding='ascii') as f:
+                    f.write(digest)
+                os.replace(ref + tmp_suffix, ref)
+            except OSError as e:
+                # Caching is an optimization; the caller already has the data.
+                self.logger.warning(f"Could not cache remote file content: {e}")
+                self._unlink(blob + tmp_suffix)
+                self._unlink(ref + tmp_suffix)
+                return False
+            self.stores += 1
+            self._evict()
+            return True
+
+    def _evict(self) -> None:
+        """Drop least recently used blobs until the total fits the budget
+        (caller holds the lock)."""
+        blobs = self._blobs
+        while self._total > self.max_bytes and blobs:
+            digest, size = blobs.popitem(last=False)
+            self._total -= size
+            self._unlink(self._blob_path(digest))
+            self.evictions += 1
+
+    @staticmethod
+    def _unlink(path: str) -> None:
+        try:
+            os.unlink(path)
+        except OSError:
+            pass
+
+    def clear(self) -> None:
+        """Delete every cached body."""
+        if self._dir is None:
+            return
+        with self._lock:
+            for sub in ('blobs', 'refs'):
+                folder = os.path.join(self._dir, sub)
+                try:
+                    names = os.listdir(folder)
+                except OSError:
+                    continue
+                for name in names:
+                    self._unlink(os.path.join(folder, name))
+            self._blobs = OrderedDict()
+            self._total = 0
+
+    def get_stats(self) -> dict:
+        with self._lock:
+            if self._dir is not None:
+                self._load()
+            lookups = self.hits + self.misses
+            return {
+                'enabled': self._dir is not None,
+                'entries': len(self._blobs or ()),
+                'bytes': self._total,
+                'max_bytes': self.max_bytes,
+                'hits': self.hits,
+                'misses': self.misses,
+                'hit_rate': self.hits / lookups if lookups else 0.0,
+                'stores': self.stores,
+                'evictions': self.evictions,
+            }
+
+
+# Global content cache instance
+_content_cache = None
+
+
+def get_content_cache() -> ContentCache:
+    """Get or create the global remote content cache"""
+    global _content_cache
+    if _content_cache is None:
+        try:
+            from tfm_config import get_config
+            max_bytes = getattr(get_config(), 'REMOTE_CONTENT_CACHE_SIZE', DEFAULT_MAX_BYTES)
+        except (ImportError, Exception):
+            max_bytes = DEFAULT_MAX_BYTES
+        cache_dir = str(PathlibPath.home() / '.tfm' / 'content_cache')
+        _content_cache = ContentCache(cache_dir, max_bytes=max_bytes)
+    return _content_cache
@@ -0,0 +1,186 @@
+"""Content comparison by digest, for files whose bytes live across a network.
+
+Comparing two files byte by byte reads both of them. For a remote file that
+means downloading it: two 5 GB files on an SSH host cost 10 GB of transfer just
+to learn whether they match. Storage that can hash a file where it is stored
+exposes that through ``Path.content_digest()`` (SSH runs ``sha256sum`` on the
+host and caches the digest by path, size and mtime). :func:`digests_equal`
+compares those digests instead of content. A local counterpart is hashed
+locally, which reads the local disk but transfers nothing. The bytes of a
+remote file are only fetched when the user opens the diff itself.
+
+Local digests are kept in the persistent hash cache (:mod:`tfm_hash_cache`),
+keyed by the file's exact version. :func:`compare_content` — the comparison
+behind the directory diff and Compare Selection — uses them: two files whose
+digests are cached are compared without reading either, one with a cached
+digest costs a read of the other only, and a byte comparison hashes what it
+reads, so files found equal are never read again while they stay unchanged.
+
+:func:`directory_digest` folds a directory's children into one Merkle digest
+(names, types and content digests), so two listed subtrees whose digests match
+are identical without comparing their children one by one.
+"""
+
+from __future__ import annotations
+
+import hashlib
+import os
+import struct
+from typing import Callable, Iterable, Optional
+
+from tfm_hash_cache import get_hash_cache, stat_key
+
+# Read size while hashing a local file (checkpoint granularity).
+_CHUNK = 1 << 20
+#: Block size for byte comparison: large enough that per-read Python overhead
+#: vanishes next to the ``memcmp`` of two blocks, small enough that both blocks
+#: stay in the CPU cache between the read, the hash and the compare.
+_COMPARE_BLOCK = 256 * 1024
+
+
+# Per-child header in a directory digest: name length, is_dir
+_DIR_ENTRY = struct.Struct('<I?')
+
+
+def _local_key(path) -> Optional[bytes]:
+    """The hash-cache key of a local file, or None (remote, or unreadable)."""
+    if path.get_scheme() != "file":
+        return None
+    try:
+        return stat_key(os.stat(str(path)))
+    except OSError:
+        return None
+
+
+def cached_digest(key: Optional[bytes]) -> Optional[bytes]:
+    """The SHA-256 of the local file version ``key`` (:func:`tfm_hash_cache.stat_key`)
+    if it was hashed before, else None; never reads the file."""
+    if key is None:
+        return None
+    cache = get_hash_cache()
+    return cache.get(key) if cache.enabled else None
+
+
+def cached_file_digest(path) -> Optional[bytes]:
+    """:func:`cached_digest` of ``path`` as it is now (one stat), or None."""
+    return cached_digest(_local_key(path))
+
+
+def same_file(key_a: Optional[bytes], key_b: Optional[bytes]) -> bool:
+    """Whether two hash-cache keys name the same file (device and inode), as
+    for a hard link or a directory compared with itself. Inode 0 (storage
+    without inode numbers) never matches."""
+    return (key_a is not None and key_b is not None and key_a[:16] == key_b[:16]
+            and key_a[8:16] != bytes(8))
+
+
+def directory_digest(children: Iterable[tuple[str, bool, bytes]]) -> bytes:
+    """Merkle digest of a directory from its children's ``(name, is_dir,
+    digest)``: content digests for files, directory digests for directories.
+    Equal digests mean equal names, types and contents all the way down."""
+    hasher = hashlib.sha256()
+    for name, is_dir, digest in sorted(children):
+        encoded = name.encode('utf-8', 'surrogateescape')
+        hasher.update(_DIR_ENTRY.pack(len(encoded), is_dir))
+        hasher.update(encoded)
+        hasher.update(digest)
+    return hasher.digest()
+
+
+def local_sha256(path, checkpoint: Optional[Callable[[], None]] = None) -> str:
+    """SHA-256 hex digest of ``path``'s content, read in chunks (or taken from
+    the hash cache when this version of a local file was hashed before)."""
+    if path.get_scheme() == "file":
+        return get_hash_cache().file_digest(str(path), checkpoint).hex()
+    digest = hashlib.sha256()
+    with path.open("rb") as f:
+        while True:
+            if checkpoint is not None:
+                checkpoint()
+            chunk = f.read(_CHUNK)
+            if not chunk:
+                return digest.hexdigest()
+            digest.update(chunk)
+
+
+def digests_equal(a, b, checkpoint: Optional[Callable[[], None]] = None) -> Optional[bool]:
+    """Whether ``a`` and ``b`` have the same content, decided by digest.
+
+    Returns ``None`` when a digest comparison wouldn't save a transfer — neither
+    side has a storage-side digest, or a side without one isn't local — and the
+    caller should compare bytes. Sizes are assumed to be checked already."""
+    digests = [a.content_digest(), b.content_digest()]
+    if digests == [None, None]:
+        return None
+    for i, path in enumerate((a, b)):
+        if digests[i] is None:
+            if path.get_scheme() != "file":
+                return None
+            digests[i] = local_sha256(path, checkpoint)
+    return digests[0] == digests[1]
+
+
+def compare_content(a, b, checkpoint: Optional[Callable[[], None]] = None) -> bool:
+    """Whether ``a`` and ``b`` have the same content. Sizes are assumed to be
+    checked (and equal) already; I/O errors propagate.
+
+    In order: storage-side digests (:func:`digests_equal`); cached digests of
+    local files; if one side's digest is cached, a hash of the other side;
+    otherwise a block-by-block byte comparison that hashes the local sides as
+    it goes and caches their digests when the files turn out equal (a
+    difference stops the read early, and nothing is cached)."""
+    equal = digests_equal(a, b, checkpoint)
+    if equal is not None:
+        return equal
+    cache = get_hash_cache()
+    keys = [_local_key(a), _local_key(b)] if cache.enabled else [None, None]
+    cached = [cache.get(key) if key is not None else None for key in keys]
+    if cached[0] is not None and cached[1] is not None:
+        return cached[0] == cached[1]
+    for known, other, key in ((cached[0], b, keys[1]), (cached[1], a, keys[0])):
+        if known is not None and key is not None:
+            return cache.file_digest(str(other), checkpoint) == known
+    hashers = [hashlib.sha256() if key is not None else None for key in keys]
+    with a.open("rb") as fa, b.open("rb") as fb:
+        if not (hasattr(fa, "readinto") and hasattr(fb, "readinto")):
+            while True:
+                if checkpoint is not None:
+                    checkpoint()
+                ca, cb = fa.read(_COMPARE_BLOCK), fb.read(_COMPARE_BLOCK)
+                if ca != cb:
+                    return False
+                if not ca:
+                    return True
+        ba, bb = bytearray(_COMPARE_BLOCK), bytearray(_COMPARE_BLOCK)
+        views = memoryview(ba), memoryview(bb)
+        while True:
+            if checkpoint is not None:
+                checkpoint()
+            na, nb = _fill(fa, ba), _fill(fb, bb)
+            if na != nb:
+                return False
+            last = na < _COMPARE_BLOCK
+            if (ba[:na] != bb[:nb]) if last else (ba != bb):
+                return False
+            for hasher, view in zip(hashers, views):
+                if hasher is not None:
+                    hasher.update(view[:na])
+            if last:
+                break
+    for path, key, hasher in zip((a, b), keys, hashers):
+        if hasher is not None:
+            cache.put_if_unchanged(str(path), key, hasher.digest())
+    return True
+
+
+def _fill(stream, buffer: bytearray) -> int:
+    """Read into ``buffer`` until it is full or the stream ends (``readinto``
+    may return short); returns the byte count."""
+    view = memoryview(buffer)
+    total = 0
+    while total < len(buffer):
+        count = stream.readinto(view[total:])
+        if not count:
+            break
+        total += count
+    return total
@@ -8,12 +8,16 @@ expand/collapse; ``n``/``N`` jump between differences; Enter on a differing file
 opens the per-file diff (reusing :func:`tfm_diff_viewer.show_diff_viewer`).
 
 Scanning is **progressive** and breadth-first: on open the viewer scans only the
-top level of both roots (so items appear at once), then a background *scanner*
-worker pulls directories off a queue level-by-level, inserting nodes into the
-shared tree as they're discovered — the tree grows live, top-down. A decoupled
-*comparator* worker resolves each two-sided file's content verdict off its own
-queue. Both queues are priority queues so **visible / expanded** directories are
-scanned first (re-prioritised on scroll / expand / collapse). Tree mutation
+top level of both roots (so items appear at once), then a pool of background
+*scanner* workers pulls directories off a queue level-by-level, inserting nodes
+into the shared tree as they're discovered — the tree grows live, top-down. A
+decoupled pool of *comparator* workers resolves each two-sided file's content
+verdict off its own queue. Both queues are priority queues so **visible /
+expanded** directories are scanned first (re-prioritised on scroll / expand /
+collapse); the pool sizes come from ``DIRECTORY_DIFF_SCAN_THREADS`` and
+``DIRECTORY_DIFF_COMPARE_THREADS``. Listing and reading release the GIL, so
+several workers keep several directory reads / file reads in flight — what
+pays off on network and remote storage, where each one waits on a round-trip. Tree mutation
 happens under a lock and raises a dirty flag; a per-frame tick registered via
 ``panel.request_animation_ticks`` runs on the main thread and re-renders when the
 flag is set, so nothing blocks the UI. Pass ``background=False`` (tests) to scan
@@ -44,8 +48,12 @@ from puikit.text import elide, truncate_to_width
 from puikit.widgets import DragBar, show_message_box
 from puikit.widgets.base import Widget
 
+from tfm_content_digest import (cached_digest, cached_file_digest, compare_content,
+                                directory_digest, same_file)
+from tfm_hash_cache import stat_key
 from tfm_path import Path
 from tfm_str_format import abbreviate_path, format_size
+from tfm_text_width import cell_measure
 from tfm_text_viewer import (MONO, _ScrollBody, _header_bg, draw_status_bar,
                              viewer_layer_hints, viewer_pad)
 from tfm_dialog_geometry import OPEN_MS_VIEWER, animate_open
@@ -91,11 +99,20 @@ class FileInfo:
     mtime: float
     is_accessible: bool
     error_message: Optional[str] = None
+    #: Hash-cache key of this version of a local entry (``stat_key``), else None
+    version: Optional[bytes] = None
 
 
-@dataclass
+@dataclass(slots=True, eq=False)
 class TreeNode:
-    """A single node in the unified directory tree."""
+    """A single node in the unified directory tree.
+
+    Slotted and compared by identity (a large diff holds one per path, and
+    ``visible.index(node)`` must not compare trees field by field). Children are
+    found by name through a hash index, and the sibling layout the connector
+    lines need is computed once per change of ``children``, not once per drawn
+    row. Add children with :meth:`add_child`; after reordering them or changing
+    a child's paths, call :meth:`children_changed`."""
     name: str
     left_path: Optional[Path]
     right_path: Optional[Path]
@@ -111,6 +128,49 @@ class TreeNode:
     children_scanned: bool = False
     content_compared: bool = False
     _hi_pri: bool = False
+    #: Per-side content digest: a file's SHA-256 (from the hash cache), a
+    #: directory's Merkle digest once every child on that side has one.
+    left_digest: Optional[bytes] = None
+    right_digest: Optional[bytes] = None
+    _by_name: dict[str, "TreeNode"] = field(default_factory=dict, repr=False)
+    #: (child count, {child: index}, first/last index present on (left, right))
+    _layout: Optional[tuple] = field(default=None, repr=False)
+
+    def child(self, name: str) -> Optional["TreeNode"]:
+        """The child called ``name``, or None (a hash lookup)."""
+        if len(self._by_name) != len(self.children):  # appended directly
+            self._by_name = {c.name: c for c in self.children}
+        return self._by_name.get(name)
+
+    def add_child(self, child: "TreeNode") -> None:
+        self.children.append(child)
+        self._by_name[child.name] = child
+
+    def sort_children(self) -> None:
+        """Directories first, then by case-folded name."""
+        self.children.sort(key=lambda c: (not c.is_directory, c.name.lower()))
+        self._layout = None
+
+    def children_changed(self) -> None:
+        self._layout = None
+
+    def sibling_span(self, child: "TreeNode", side_is_left: bool) -> tuple[int, int, int]:
+        """``child``'s index among the children, and the first and last index
+        of a child present on the given side (-1 when there is none)."""
+        layout = self._layout
+        if layout is None or layout[0] != len(self.children):
+            index: dict[TreeNode, int] = {}
+            first, last = [-1, -1], [-1, -1]
+            for i, c in enumerate(self.children):
+                index[c] = i
+                for side, path in ((0, c.left_path), (1, c.right_path)):
+                    if path is not None:
+                        if first[side] < 0:
+                            first[side] = i
+                        last[side] = i
+            layout = self._layout = (len(self.children), index, first, last)
+        side = 0 if side_is_left else 1
+        return layout[1][child], layout[2][side], layout[3][side]
 
 
 #: Scan-task priorities (higher = pulled off the queue first).
@@ -118,6 +178,11 @@ _PRIO_IMMEDIATE = 1000  # user just expanded this directory
 _PRIO_VISIBLE = 100     # currently in the viewport
 _PRIO_NORMAL = 10       # discovered but off-screen
 
+#: Default worker-pool sizes (``DIRECTORY_DIFF_SCAN_THREADS`` /
+#: ``DIRECTORY_DIFF_COMPARE_THREADS``).
+_SCAN_THREADS = 4
+_COMPARE_THREADS = 4
+
 
 # --- scanning / classification (backend-agnostic) ---------------------------
 
@@ -138,20 +203,21 @@ class DirectoryScanner:
 
     def scan(self, root_path: Path,
              on_progress: Optional[Callable[[int], None]] = None) -> dict[str, FileInfo]:
+        tree = root_path.scan_tree()
+        if tree is not None:
+            return self._scan_bulk(root_path, tree, on_progress)
         files: dict[str, FileInfo] = {}
-        stack = [root_path]
+        # (path, FileInfo from the parent's listing, or None to stat it here)
+        stack: list[tuple[Path, Optional[FileInfo]]] = [(root_path, None)]
         count = 0
         while stack and not self._cancel:
-            current = stack.pop()
+            current, info = stack.pop()
             try:
                 relative = "" if current == root_path else str(current.relative_to(root_path))
-                try:
-                    st = current.stat()
-                    is_dir = current.is_dir()
-                    info = FileInfo(current, relative, is_dir,
-                                    0 if is_dir else st.st_size, st.st_mtime, True)
-                except (OSError, PermissionError) as exc:
-                    info = FileInfo(current, relative, False, 0, 0.0, False, str(exc))
+                if info is None:
+                    info = self._stat_info(current, relative)
+                else:
+                    info.relative_path = relative
                 if relative:
                     files[relative] = info
                     count += 1
@@ -159,10 +225,16 @@ class DirectoryScanner:
                         on_progress(count)
                 if info.is_directory and info.is_accessible:
                     try:
-                        for child in current.iterdir():
+                        listing = current.iterdir_stat()
+                        if listing is None:
+                            children = [(child, None) for child in current.iterdir()]
+                        else:
+                            children = [(child, self._entry_info(child, entry))
+                                        for child, entry in listing]
+                        for child, child_info in children:
                             if not self.show_hidden and child.name.startswith("."):
                                 continue
-                            stack.append(child)
+                            stack.append((child, child_info))
                     except (OSError, PermissionError) as exc:
                         info.is_accessible = False
                         info.error_message = f"Cannot read directory: {exc}"
@@ -172,13 +244,59 @@ class DirectoryScanner:
             on_progress(count)
         return files
 
+    def _scan_bulk(self, root_path: Path, tree: Iterator[tuple[Path, dict]],
+                   on_progress: Optional[Callable[[int], None]]) -> dict[str, FileInfo]:
+        """:meth:`scan` over a storage's bulk listing (``Path.scan_tree``): the
+        metadata comes with each entry, so nothing is stat'ed per file. An
+        unreadable root yields an empty result, as in the walk."""
+        files: dict[str, FileInfo] = {}
+        count = 0
+        try:
+            for path, entry in tree:
+                if self._cancel:
+                    break
+                relative = str(path.relative_to(root_path))
+                if not self.show_hidden and any(part.startswith(".")
+                                                for part in relative.split("/")):
+                    continue
+                if "error" in entry:
+                    info = files.get(relative)
+                    if info is not None:
+                        info.is_accessible = False
+                        info.error_message = f"Cannot read directory: {entry['error']}"
+                    continue
+                is_dir = entry["is_dir"]
+                files[relative] = FileInfo(path, relative, is_dir,
+                                           0 if is_dir else entry["size"], entry["mtime"], True)
+                count += 1
+                if on_progress is not None and count % 50 == 0:
+                    on_progress(count)
+        except Exception:
+            pass
+        finally:
+            close = getattr(tree, "close", None)
+            if close is not None:
+                close()  # stops a remote listing abandoned by cancel()
+        if on_progress is not None:
+            on_progress(count)
+        return files
+
     def scan_level(self, directory: Path) -> dict[str, FileInfo]:
         """List only the *immediate* children of ``directory`` (non-recursive),
         keyed by bare filename. Powers the progressive breadth-first scan: each
         level is scanned on demand so the tree can grow top-down without a full
-        upfront walk. Inaccessible entries are recorded, not raised."""
+        upfront walk. Inaccessible entries are recorded, not raised. Storage
+        that lists with metadata (``Path.iterdir_stat``) is stat'ed once per
+        child, in the same pass."""
         files: dict[str, FileInfo] = {}
         try:
+            listing = directory.iterdir_stat()
+            if listing is not None:
+                for child, entry in listing:
+                    name = entry["name"]
+                    if self.show_hidden or not name.startswith("."):
+                        files[name] = self._entry_info(child, entry)
+                return files
             children = list(directory.iterdir())
         except (OSError, PermissionError):
             return files
@@ -186,15 +304,31 @@ class DirectoryScanner:
             name = child.name
             if not self.show_hidden and name.startswith("."):
                 continue
-            try:
-                st = child.stat()
-                is_dir = child.is_dir()
-                files[name] = FileInfo(child, name, is_dir,
-                                       0 if is_dir else st.st_size, st.st_mtime, True)
-            except (OSError, PermissionError) as exc:
-                files[name] = FileInfo(child, name, False, 0, 0.0, False, str(exc))
+            files[name] = self._stat_info(child, name)
         return files
 
+    @staticmethod
+    def _stat_info(path: Path, relative: str) -> FileInfo:
+        try:
+            st = path.stat()
+            is_dir = path.is_dir()
+            version = stat_key(st) if path.get_scheme() == "file" else None
+            return FileInfo(path, relative, is_dir, 0 if is_dir else st.st_size, st.st_mtime,
+                            True, version=version)
+        except (OSError, PermissionError) as exc:
+            return FileInfo(path, relative, False, 0, 0.0, False, str(exc))
+
+    @staticmethod
+    def _entry_info(path: Path, entry: dict) -> FileInfo:
+        """FileInfo from an ``iterdir_stat`` entry, keyed by bare name."""
+        name = entry["name"]
+        if "error" in entry:
+            return FileInfo(path, name, False, 0, 0.0, False, entry["error"])
+        is_dir = entry["is_dir"]
+        st = entry.get("stat")
+        return FileInfo(path, name, is_dir, 0 if is_dir else entry["size"], entry["mtime"], True,
+                        version=stat_key(st) if st is not None else None)
+
 
 class DiffEngine:
     """Builds the unified tree from two scan dictionaries and classifies it.
@@ -212,36 +346,35 @@ class DiffEngine:
 
     def build_tree(self) -> TreeNode:
         root = TreeNode("", None, None, True, DifferenceType.IDENTICAL, 0, True)
-        for relative in sorted(set(self.left_files) | set(self.right_files)):
-            self._add_path(root, relative)
+        nodes = {"": root}  # relative path -> node: each path's parent is one lookup
+        for relative in set(self.left_files) | set(self.right_files):
+            self._add_path(nodes, relative)
         self._sort(root)
         self._classify(root)
         return root
 
-    def _add_path(self, root: TreeNode, relative_path: str) -> None:
-        node = root
-        current_path = ""
-        parts = relative_path.split("/")
-        for i, part in enumerate(parts):
-            current_path = f"{current_path}/{part}" if current_path else part
-            existing = next((c for c in node.children if c.name == part), None)
-            if existing is not None:
-                node = existing
-                continue
-            left = self.left_files.get(current_path)
-            right = self.right_files.get(current_path)
-            is_last = i == len(parts) - 1
-            is_dir = (not is_last
-                      or bool(left and left.is_directory)
-                      or bool(right and right.is_directory))
-            child = TreeNode(part, left.path if left else None, right.path if right else None,
-                             is_dir, DifferenceType.IDENTICAL, node.depth + 1, False,
-                             parent=node)
-            node.children.append(child)
-            node = child
+    def _add_path(self, nodes: dict[str, TreeNode], relative_path: str,
+                  is_parent: bool = False) -> TreeNode:
+        node = nodes.get(relative_path)
+        if node is not None:
+            return node
+        head, _, name = relative_path.rpartition("/")
+        parent = nodes.get(head) or self._add_path(nodes, head, is_parent=True)
+        left = self.left_files.get(relative_path)
+        right = self.right_files.get(relative_path)
+        is_dir = (is_parent
+                  or bool(left and left.is_directory)
+                  or bool(right and right.is_directory))
+        node = TreeNode(name, left.path if left else None, right.path if right else None,
+                        is_dir, DifferenceType.IDENTICAL, parent.depth + 1, False,
+                        parent=parent)
+        settle_from_digests(node, left, right)
+        parent.add_child(node)
+        nodes[relative_path] = node
+        return node
 
     def _sort(self, node: TreeNode) -> None:
-        node.children.sort(key=lambda c: (not c.is_directory, c.name.lower()))
+        node.sort_children()
         for child in node.children:
             self._sort(child)
 
@@ -258,35 +391,86 @@ class DiffEngine:
                 return DifferenceType.ONLY_LEFT
             if exists_right and not exists_left:
                 return DifferenceType.ONLY_RIGHT
+            if node.content_compared:  # settled from digests
+                return node.difference_type
             if not node.is_directory:
                 if not self.compare_content:
                     return DifferenceType.PENDING
-                return (DifferenceType.IDENTICAL
-                        if self.compare_file_content(node.left_path, node.right_path)
-                        else DifferenceType.CONTENT_DIFFERENT)
+                if not self.compare_file_content(node.left_path, node.right_path):
+                    return DifferenceType.CONTENT_DIFFERENT
+                node.left_digest = cached_file_digest(node.left_path)
+                node.right_digest = cached_file_digest(node.right_path)
+                return DifferenceType.IDENTICAL
+        update_directory_digests(node)
         return summarize_directory(node)
 
     @staticmethod
     def compare_file_content(left_path: Path, right_path: Path) -> bool:
-        """Byte-equality of two files (size check first, then 8 KB chunks)."""
+        """Content equality of two files: size check first, then
+        :func:`tfm_content_digest.compare_content` — digests the host computes
+        for remote files (nothing downloaded), digests cached from an earlier
+        comparison of the same file versions (nothing read), or a byte compare
+        in 256 KB blocks that caches the digests of files found equal."""
         try:
             if left_path.stat().st_size != right_path.stat().st_size:
                 return False
-            with left_path.open("rb") as lf, right_path.open("rb") as rf:
-                while True:
-                    lc, rc = lf.read(8192), rf.read(8192)
-                    if lc != rc:
-                        return False
-                    if not lc:
-                        return True
+            return compare_content(left_path, right_path)
         except (OSError, IOError, PermissionError):
             return False
 
 
+def settle_from_digests(node: TreeNode, left: Optional[FileInfo],
+                        right: Optional[FileInfo]) -> bool:
+    """Settle a new two-sided node without reading or listing it when that is
+    decided already: both sides are one file (a hard link, or a directory
+    compared with itself), or both files' digests are in the hash cache, which
+    also fills ``left_digest``/``right_digest``. Returns True when ``node`` got
+    its verdict (and is marked ``content_compared``)."""
+    if left is None or right is None:
+        return False
+    if same_file(left.version, right.version):
+        node.difference_type = DifferenceType.IDENTICAL
+    elif node.is_directory:
+        return False
+    else:
+        node.left_digest = cached_digest(left.version)
+        node.right_digest = cached_digest(right.version)
+        if node.left_digest is None or node.right_digest is None:
+            return False
+        node.difference_type = (DifferenceType.IDENTICAL if node.left_digest == node.right_digest
+                                else DifferenceType.CONTENT_DIFFERENT)
+    node.content_compared = True
+    return True
+
+
+def update_directory_digests(node: TreeNode) -> None:
+    """Recompute a listed directory's (or the root's) Merkle digest on each
+    side from its children's; a side stays None while any child present on it
+    has no digest yet."""
+    node.left_digest = _side_digest(node, True)
+    node.right_digest = _side_digest(node, False)
+
+
+def _side_digest(node: TreeNode, left: bool) -> Optional[bytes]:
+    if node.depth > 0 and (node.left_path if left else node.right_path) is None:
+        return None
+    entries = []
+    for child in node.children:
+        if (child.left_path if left else child.right_path) is None:
+            continue
+        digest = child.left_digest if left else child.right_digest
+        if digest is None:
+            return None
+        entries.append((child.name, child.is_directory, digest))
+    return directory_digest(entries)
+
+
 def summarize_directory(node: TreeNode) -> DifferenceType:
-    """A directory's (or the root's) verdict from its children: any real
-    difference → contains-difference; else any pending child → pending; else
-    identical."""
+    """A directory's (or the root's) verdict: identical at once when both
+    sides' Merkle digests match, else from its children — any real difference
+    → contains-difference; else any pending child → pending; else identical."""
+    if node.left_digest is not None and node.left_digest == node.right_digest:
+        return DifferenceType.IDENTICAL
     has_difference = has_pending = False
     for child in node.children:
         if child.difference_type == DifferenceType.PENDING:
@@ -355,6 +539,7 @@ class DirectoryDiffView(Widget):
         # An empty tree until the worker's first build; navigation state.
         self.root = TreeNode("", None, None, True, DifferenceType.PENDING, 0, True)
         self.visible: list[TreeNode] = []
+        self._diff_rows: tuple = (None, 0)  # (row list, differences in it) for the footer
         self.cursor = 0
         self.top = 0.0
         self.active = "left"
@@ -401,7 +586,10 @@ class DirectoryDiffView(Widget):
         self._compared = 0
         self._compare_total = 0
         self._thread: Optional[threading.Thread] = None  # the coordinator
-        self._workers: list[threading.Thread] = []       # scanner + comparator
+        self._workers: list[threading.Thread] = []       # scanners + comparators
+        self._scan_threads = max(1, getattr(config, "DIRECTORY_DIFF_SCAN_THREADS", _SCAN_THREADS))
+        self._compare_threads = max(1, getattr(config, "DIRECTORY_DIFF_COMPARE_THREADS",
+                                               _COMPARE_THREADS))
         # A rescan (after copy/delete) restores the prior expansion + cursor
         # across the freshly built tree so the user keeps their place.
         self._restore_expanded: Optional[set[str]] = None
@@ -448,17 +636,19 @@ class DirectoryDiffView(Widget):
 
     def _scan_coordinator(self) -> None:
         """Background driver (the joinable thread). Scans the roots' top level so
-        items appear immediately, starts the scanner + comparator workers, waits
+        items appear immediately, starts the scanner + comparator pools, waits
         for both queues to drain (breadth-first, visible-first), then finalises."""
         try:
             self._seed_root()
             if self._cancel:
                 return
-            scanner = threading.Thread(target=self._scanner_worker, daemon=True)
-            comparator = threading.Thread(target=self._comparator_worker, daemon=True)
-            self._workers = [scanner, comparator]
-            scanner.start()
-            comparator.start()
+            self._workers = (
+                [threading.Thread(target=self._scanner_worker, daemon=True)
+                 for _ in range(self._scan_threads)]
+                + [threading.Thread(target=self._comparator_worker, daemon=True)
+                   for _ in range(self._compare_threads)])
+            for worker in self._workers:
+                worker.start()
             self._scan_q.join()          # every directory level listed
             if self._cancel:
                 return
@@ -488,7 +678,9 @@ class DirectoryDiffView(Widget):
 
     def _scanner_worker(self) -> None:
         """Pull directories off ``_scan_q`` and list one level each, enqueuing
-        child directories (breadth-first) and file comparisons as it goes."""
+        child directories (breadth-first) and file comparisons as it goes. Runs
+        ``_scan_threads`` times over; each takes the highest-priority directory
+        next, and ``_scan_node`` claims it so a re-prioritised duplicate skips."""
         while self._scanning:
             try:
                 _, _, node = self._scan_q.get(timeout=0.1)
@@ -517,12 +709,13 @@ class DirectoryDiffView(Widget):
             self._dirs_scanned += 1
             # Reflow only if this directory's new children are actually on screen.
             if node.is_expanded and self._rendered_locked(node):
-                self._reflow_locked()
+                self._reflow_subtree_locked(node)
             self._dirty = True
 
     def _comparator_worker(self) -> None:
         """Resolve two-sided files' content verdicts off ``_cmp_q``, decoupled
-        from directory scanning so neither blocks the other."""
+        from directory scanning so neither blocks the other (one of
+        ``_compare_threads``)."""
         while self._scanning:
             try:
                 _, _, node = self._cmp_q.get(timeout=0.1)
@@ -540,9 +733,13 @@ class DirectoryDiffView(Widget):
         if node.left_path is None or node.right_path is None:
             return
         identical = DiffEngine.compare_file_content(node.left_path, node.right_path)
+        # Files found equal had their digests cached by the comparison
+        digests = ((cached_file_digest(node.left_path), cached_file_digest(node.right_path))
+                   if identical else (None, None))
         with self._lock:
             if self._cancel:
                 return
+            node.left_digest, node.right_digest = digests
             node.difference_type = (DifferenceType.IDENTICAL if identical
                                     else DifferenceType.CONTENT_DIFFERENT)
             node.content_compared = True
@@ -558,10 +755,9 @@ class DirectoryDiffView(Widget):
         """Merge a freshly scanned level into ``parent``: create/attach new child
         nodes, classify them (queuing follow-up scans/comparisons), re-sort, and
         re-summarise the ancestor chain."""
-        existing = {c.name: c for c in parent.children}
         for name in set(left) | set(right):
             li, ri = left.get(name), right.get(name)
-            child = existing.get(name)
+            child = parent.child(name)
             if child is not None:
                 if li is not None:
                     child.left_path = li.path
@@ -572,25 +768,32 @@ class DirectoryDiffView(Widget):
             child = TreeNode(name, li.path if li else None, ri.path if ri else None,
                              is_dir, DifferenceType.PENDING, parent.depth + 1, False,
                              parent=parent)
-            parent.children.append(child)
-            self._classify_new_locked(child)
-        parent.children.sort(key=lambda c: (not c.is_directory, c.name.lower()))
+            parent.add_child(child)
+            self._classify_new_locked(child, li, ri)
+        parent.sort_children()
         self._scanned += len(left) + len(right)
         # Re-summarise the scanned directory itself (an empty two-sided directory
         # has no children to trigger a later reclassify, so resolve it now) and
         # its ancestors.
         self._reclassify_self_and_ancestors_locked(parent)
 
-    def _classify_new_locked(self, node: TreeNode) -> None:
+    def _classify_new_locked(self, node: TreeNode, left_info: Optional[FileInfo],
+                             right_info: Optional[FileInfo]) -> None:
         """Assign a newly created node's initial verdict and queue any follow-up
         work: two-sided directories go on the scan queue, two-sided files on the
-        comparison queue; one-sided nodes are already fully classified."""
+        comparison queue; one-sided nodes are already fully classified, and so
+        are two-sided ones :func:`settle_from_digests` decides (cached digests,
+        or both sides one file) — those are never read or listed."""
         left = node.left_path is not None
         right = node.right_path is not None
         if left and not right:
             node.difference_type = DifferenceType.ONLY_LEFT
         elif right and not left:
             node.difference_type = DifferenceType.ONLY_RIGHT
+        elif settle_from_digests(node, left_info, right_info):
+            if not node.is_directory:
+                self._compare_total += 1
+                self._compared += 1
         elif node.is_directory:
             node.difference_type = DifferenceType.PENDING
             self._dirs_total += 1
@@ -616,6 +819,8 @@ class DirectoryDiffView(Widget):
         while node is not None:
             two_sided = node.left_path is not None and node.right_path is not None
             if node.depth == 0 or two_sided:
+                if node.children_scanned:
+                    update_directory_digests(node)
                 node.difference_type = summarize_directory(node)
             node = node.parent
 
@@ -667,6 +872,7 @@ class DirectoryDiffView(Widget):
             # this just bumps the on-screen ones ahead. One-sided branches stay
             # lazy (scanned on expand), so touching them here would skew progress.
             if (node.is_directory and not node.children_scanned and not node._hi_pri
+                    and not node.content_compared
                     and node.left_path is not None and node.right_path is not None):
                 node._hi_pri = True
                 self._enqueue_scan(node, _PRIO_VISIBLE)
@@ -768,12 +974,47 @@ class DirectoryDiffView(Widget):
         if self.cursor >= len(flat):
             self.cursor = max(0, len(flat) - 1)
 
+    def _reflow_subtree_locked(self, node: TreeNode) -> None:
+        """Re-flatten only ``node``'s rows after it was expanded, collapsed or
+        given new children (call under ``_lock``): its old descendant rows are
+        spliced out of ``visible`` and the new ones in, without walking the rest
+        of the tree. A node that isn't on screen needs nothing."""
+        if node.depth == 0:
+            self._reflow_locked()
+            return
+        rows = self.visible
+        try:
+            start = rows.index(node) + 1
+        except ValueError:
+            return
+        end = start
+        while end < len(rows) and rows[end].depth > node.depth:
+            end += 1
+        sub: list[TreeNode] = []
+        if node.is_expanded:
+            for child in node.children:
+                self._flatten(child, sub)
+        flat = rows[:start] + sub + rows[end:]
+        self.visible = flat
+        if self.cursor >= len(flat):
+            self.cursor = max(0, len(flat) - 1)
+
     def _flatten(self, node: TreeNode, out: list[TreeNode]) -> None:
+        """Append ``node`` (unless it is the root) and its expanded descendants
+        to ``out`` in display order (iterative, so depth costs no recursion)."""
         if node.depth > 0:
             out.append(node)
-        if node.is_expanded:
-            for child in node.children:
-                self._flatten(child, out)
+        if not node.is_expanded:
+            return
+        stack = [iter(node.children)]
+        while stack:
+            for child in stack[-1]:
+                out.append(child)
+                if child.is_expanded and child.children:
+                    stack.append(iter(child.children))
+                    break
+            else:
+                stack.pop()
 
     def _connector_chain(self, node: TreeNode) -> list[TreeNode]:
         """The ancestor chain from the top ancestor down to ``node`` (length ==
@@ -805,13 +1046,8 @@ class DirectoryDiffView(Widget):
         parent = node.parent
         if parent is None:
             return False
-        seen = False
-        for sib in parent.children:
-            if sib is node:
-                seen = True
-            elif seen and self._present_on_side(sib, side_is_left):
-                return True
-        return False
+        index, _, last = parent.sibling_span(node, side_is_left)
+        return last > index
 
     def _present_sibling_before(self, node: TreeNode, side_is_left: bool) -> bool:
         """Whether a sibling ordered before ``node`` is present on this side — i.e.
@@ -819,12 +1055,8 @@ class DirectoryDiffView(Widget):
         parent = node.parent
         if parent is None:
             return False
-        for sib in parent.children:
-            if sib is node:
-                return False
-            if self._present_on_side(sib, side_is_left):
-                return True
-        return False
+        index, first, _ = parent.sibling_span(node, side_is_left)
+        return 0 <= first < index
 
     def _tree_lines(self, node: TreeNode, *, branch: bool, side_is_left: bool) -> str:
         """Box-drawing prefix showing ``node``'s place in the tree on the given
@@ -895,7 +1127,8 @@ class DirectoryDiffView(Widget):
                 self._enqueue_scan(node, _PRIO_IMMEDIATE)
             else:
                 self._lazy_scan(node)
-        self._reflow()
+        with self._lock:
+            self._reflow_subtree_locked(node)
         if node in self.visible:
             self.cursor = self.visible.index(node)
         self._ensure_cursor_visible()
@@ -1173,10 +1406,10 @@ class DirectoryDiffView(Widget):
         # the tail, which is exactly the part that says which directory this is.
         ctx.draw_text(self._left_x, pad_y,
                       abbreviate_path(str(self.left_path), self._left_w,
-                                      measure=ctx.measure_text), left_head)
+                                      measure=cell_measure(ctx)), left_head)
         ctx.draw_text(self._right_x, pad_y,
                       abbreviate_path(str(self.right_path), self._right_w,
-                                      measure=ctx.measure_text), right_head)
+                                      measure=cell_measure(ctx)), right_head)
 
         self._clamp_scroll()
 
@@ -1249,8 +1482,11 @@ class DirectoryDiffView(Widget):
                     f"{self._dirs_scanned}/{self._dirs_total} "
                     f"({self._pct(self._dirs_scanned, self._dirs_total)}%) · "
                     f"{queued} queued · esc cancel ")
-        diffs = sum(1 for n in self.visible if n.difference_type in _IS_DIFF)
-        return (f" {len(self.visible)} nodes · {diffs} differences · "
+        rows = self.visible
+        if self._diff_rows[0] is not rows:  # counted once per row list, not per frame
+            self._diff_rows = (rows, sum(1 for n in rows if n.difference_type in _IS_DIFF))
+        diffs = self._diff_rows[1]
+        return (f" {len(rows)} nodes · {diffs} differences · "
                 "n/N jump · ←/→ expand · [ ] resize · tab side · enter diff · q close ")
 
     def _details_line(self) -> str:
@@ -0,0 +1,294 @@
+"""Disk usage — recursive allocated sizes behind the pane's disk-usage view
+(``toggle_disk_usage``), TFM's take on ``ncdu``.
+
+:meth:`DiskUsageCache.scan` totals a directory tree: bytes allocated on disk
+(``st_blocks``, so sparse and compressed files count for what they occupy),
+files and directories. Directories are listed in parallel by a pool of
+``threads`` workers, one directory per job. A local directory is opened once
+and its children are stat'ed relative to that descriptor (``os.scandir`` on a
+file descriptor: ``fstatat`` per name, no path resolution from the root per
+file). Symlinks count as themselves and are not followed, the walk stays on
+the filesystem it starts on (like ``du -x``), and a file with several hard
+links is counted once per scan by its ``(device, inode)``. Remote storage is
+listed through ``Path.iterdir_stat`` / ``stat`` and counts apparent sizes.
+
+Every directory's subtree total is kept in memory, so entering a subdirectory
+of an analyzed tree lists it with totals at once. A cached total is trusted
+until :meth:`DiskUsageCache.invalidate` drops it: the file monitor calls it
+for each change in a watched pane directory, which drops that directory, its
+ancestors (their totals include it) and the subtree of a changed child. A scan
+then re-lists only the dropped directories and reuses their cached children.
+A directory's own mtime can't stand in for this check: it only moves when its
+direct entries change, not when a file deep below grows. Changes made outside
+the watched directories show after a fresh scan (``fresh=True``, which the
+app's analysis task uses).
+
+The optional ``checkpoint`` is called in every job, so a task or listing
+worker can raise to cancel; ``on_progress(files, size)`` is called on the
+scanning thread.
+"""
+
+from __future__ import annotations
+
+import os
+import stat
+import threading
+from concurrent.futures import FIRST_COMPLETED, ThreadPoolExecutor, wait
+from dataclasses import dataclass
+from typing import Callable, Optional
+
+from tfm_path import STORAGE_ERRORS
+
+#: Default worker count (``DISK_USAGE_SCAN_THREADS``); listing is metadata
+#: bound, so more workers than cores keep a disk or network mount busy
+DEFAULT_THREADS = 8
+
+# os.scandir accepts a directory descriptor (POSIX)
+_SCANDIR_FD = os.scandir in os.supports_fd
+
+
+def _noop() -> None:
+    pass
+
+
+@dataclass(slots=True)
+class Usage:
+    """Totals of one directory's subtree, the directory itself excluded."""
+
+    size: int = 0              # allocated bytes
+    files: int = 0
+    dirs: int = 0
+    subdirs: tuple = ()        # str paths of child directories with totals
+
+
+def allocated_size(st) -> int:
+    """Bytes ``st`` occupies on disk: ``st_blocks`` where the storage reports
+    it, else the apparent size."""
+    blocks = getattr(st, "st_blocks", None)
+    return blocks * 512 if blocks is not None else st.st_size
+
+
+@dataclass(slots=True)
+class _Pending:
+    """A directory whose children are still being totalled."""
+
+    key: str
+    parent: Optional["_Pending"]
+    usage: Usage
+    subdirs: list
+    remaining: int = 0
+
+
+class DiskUsageCache:
+    """Subtree totals by directory (``str(path)``), computed by :meth:`scan`."""
+
+    def __init__(self):
+        self._totals: dict[str, Usage] = {}
+        self._lock = threading.Lock()
+
+    def get(self, path) -> Optional[Usage]:
+        """The cached subtree total of ``path``, or None."""
+        with self._lock:
+            return self._totals.get(str(path))
+
+    def invalidate(self, path) -> None:
+        """Forget ``path``'s total, its subtree's and its ancestors'."""
+        key = str(path)
+        with self._lock:
+            stack = [key]
+            while stack:
+                usage = self._totals.pop(stack.pop(), None)
+                if usage is not None:
+                    stack.extend(usage.subdirs)
+            parent = _parent(key)
+            while parent:
+                self._totals.pop(parent, None)
+                parent = _parent(parent)
+
+    def clear(self) -> None:
+        with self._lock:
+            self._totals.clear()
+
+    def __len__(self) -> int:
+        return len(self._totals)
+
+    def scan(self, path, *, fresh: bool = False, threads: int = DEFAULT_THREADS,
+             checkpoint: Optional[Callable[[], None]] = None,
+             on_progress: Optional[Callable[[int, int], None]] = None) -> Usage:
+        """Total ``path``'s subtree, reusing cached subdirectory totals unless
+        ``fresh``; caches the total of every directory it lists. Unreadable
+        directories count as empty."""
+        checkpoint = checkpoint or _noop
+        if fresh:
+            self.invalidate(path)
+        cached = self.get(path)
+        if cached is not None:
+            return cached
+        local = path.get_scheme() == "file"
+        try:
+            root_dev = os.stat(str(path)).st_dev if local else None
+        except OSError:
+            root_dev = None
+        inodes: set = set()
+        counted = [0, 0]  # files, bytes
+        pool = ThreadPoolExecutor(max_workers=max(1, threads),
+                                  thread_name_prefix="tfm-du")
+
+        def list_dir(node, directory):
+            checkpoint()
+            if local:
+                return node, _list_local(directory, root_dev)
+            return node, _list_generic(directory)
+
+        root = _Pending(str(path), None, Usage(), [])
+        pending = {pool.submit(list_dir, root, str(path) if local else path)}
+        try:
+            while pending:
+                done, pending = wait(pending, return_when=FIRST_COMPLETED)
+                for future in done:
+                    node, (size, files, links, subdirs) = future.result()
+                    usage = node.usage
+                    for inode, link_size in links:
+                        if inode not in inodes:
+                            inodes.add(inode)
+                            size += link_size
+                            files += 1
+                    usage.size += size
+                    usage.files += files
+                    counted[0] += files
+                    counted[1] += size
+                    for child, child_size in subdirs:
+                        key = str(child)
+                        node.subdirs.append(key)
+                        usage.size += child_size  # the directory entry itself
+                        usage.dirs += 1
+                        cached = self.get(key)
+                        if cached is not None:
+                            _add(usage, cached)
+                        else:
+                            node.remaining += 1
+                            pending.add(pool.submit(
+                                list_dir, _Pending(key, node, Usage(), []), child))
+                    if node.remaining == 0:
+                        self._settle(node)
+                checkpoint()
+                if on_progress is not None:
+                    on_progress(counted[0], counted[1])
+        finally:
+            pool.shutdown(wait=True, cancel_futures=True)
+        return root.usage
+
+    def _settle(self, node: _Pending) -> None:
+        """Cache a finished directory's total and fold it into its parent,
+        settling the parent too when this was its last child."""
+        while node is not None:
+            node.usage.subdirs = tuple(node.subdirs)
+            with self._lock:
+                self._totals[node.key] = node.usage
+            parent = node.parent
+            if parent is None:
+                return
+            _add(parent.usage, node.usage)
+            parent.remaining -= 1
+            if parent.remaining:
+                return
+            node = parent
+
+
+def _add(usage: Usage, child: Usage) -> None:
+    usage.size += child.size
+    usage.files += child.files
+    usage.dirs += child.dirs
+
+
+def _parent(key: str) -> str:
+    """The parent directory of a path key, or '' above the root."""
+    if "://" in key:
+        scheme, _, rest = key.partition("://")
+        rest = rest.rstrip("/")
+        return f"{scheme}://{rest.rpartition('/')[0]}" if "/" in rest else ""
+    parent = os.path.dirname(key)
+    return parent if parent != key else ""
+
+
+def _list_local(directory: str, root_dev: Optional[int]):
+    """``(size, files, hard_links, subdirs)`` of one local directory: the
+    allocated bytes and count of its files, ``((dev, ino), size)`` for files
+    with more than one link, and ``(path, entry size)`` per subdirectory on
+    the same device (paths as ``str``). Children are stat'ed relative to the
+    directory's descriptor."""
+    size = files = 0
+    links, subdirs = [], []
+    try:
+        if _SCANDIR_FD:
+            fd = os.open(directory, os.O_RDONLY | getattr(os, "O_DIRECTORY", 0))
+            try:
+                entries = list(_stat_entries(os.scandir(fd)))
+            finally:
+                os.close(fd)
+        else:
+            entries = list(_stat_entries(os.scandir(directory)))
+    except OSError:
+        return 0, 0, links, subdirs
+    for name, st in entries:
+        if stat.S_ISDIR(st.st_mode):
+            if root_dev is None or st.st_dev == root_dev:
+                subdirs.append((os.path.join(directory, name), allocated_size(st)))
+        elif st.st_nlink > 1:
+            links.append(((st.st_dev, st.st_ino), allocated_size(st)))
+        else:
+            size += allocated_size(st)
+            files += 1
+    return size, files, links, subdirs
+
+
+def _stat_entries(scandir):
+    """``(name, lstat)`` per entry; entries that vanish mid-listing are skipped."""
+    with scandir as it:
+        for entry in it:
+            try:
+                yield entry.name, entry.stat(follow_symlinks=False)
+            except OSError:
+                continue
+
+
+def _list_generic(directory):
+    """:func:`_list_local` for storage without descriptors: apparent sizes
+    and no hard-link tracking."""
+    size = files = 0
+    subdirs = []
+    try:
+        listing = directory.iterdir_stat()
+        if listing is None:
+            listing = ((child, None) for child in directory.iterdir())
+        for child, entry in listing:
+            if entry is None:
+                try:
+                    st = child.stat()
+                except STORAGE_ERRORS:
+                    continue
+                is_dir, child_size = stat.S_ISDIR(st.st_mode), st.st_size
+            elif "error" in entry or entry["is_symlink"]:
+                continue
+            else:
+                is_dir, child_size = entry["is_dir"], entry["size"]
+            if is_dir:
+                subdirs.append((child, 0))
+            else:
+                size += child_size
+                files += 1
+    except STORAGE_ERRORS:
+        pass  # an unreadable subtree counts as empty
+    return size, files, [], subdirs
+
+
+# Global disk usage cache instance
+_disk_usage_cache = None
+
+
+def get_disk_usage_cache() -> DiskUsageCache:
+    """Get or create the global disk usage cache"""
+    global _disk_usage_cache
+    if _disk_usage_cache is None:
+        _disk_usage_cache = DiskUsageCache()
+    return _disk_usage_cache
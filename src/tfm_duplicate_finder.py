@@ -0,0 +1,331 @@
+"""Find Duplicates — the storage-agnostic engine behind the ``find_duplicates``
+action.
+
+Finding files with equal content among N files must not read N files: nearly
+all of them are told apart by something cheaper. The search narrows the
+candidates in stages, each reading more than the last but only what survived
+the one before:
+
+1. **Walk and bucket by size.** The roots are listed in parallel by a pool of
+   ``threads`` workers, one directory per job (``Path.iterdir_stat``: one stat
+   per child on local storage). Files are bucketed by size; a size seen once
+   can't have a duplicate and is dropped without being opened. Empty files,
+   symlinks and (unless ``show_hidden``) dotfiles are skipped. Hard links to
+   one file count as one file — deleting one frees nothing.
+2. **Edge digest.** The first and last ``EDGE_BYTES`` of each remaining file
+   are hashed: files that differ almost always differ at the start (headers)
+   or the end (trailers, indexes). A file no larger than ``2 * EDGE_BYTES``
+   goes straight to the next stage: its edges are all of it.
+3. **Full digest.** Files still sharing size and edge digest are hashed in
+   full; equal SHA-256 digests form a group.
+
+Local digests go through the persistent hash cache (:mod:`tfm_hash_cache`):
+full digests under the file version's own key, edge digests under a tagged key
+derived from it. A re-run over unchanged files reads nothing, and a size bucket
+whose files all have cached full digests skips the edge stage. Remote files
+use the storage-side digest where there is one (``Path.content_digest``), so
+an SSH host hashes its own files instead of transferring them.
+
+Per file the walk keeps a directory index, the name and the 40-byte version
+key — not a ``Path`` — so memory grows with the file count at roughly a
+hundred bytes per file plus the directory list. The optional ``checkpoint``
+is called in every job, so a task worker can raise to cancel; ``on_progress``
+is called on the calling thread with ``(stage, done, total)``, ``total`` being
+0 while the walk is still counting.
+"""
+
+from __future__ import annotations
+
+import hashlib
+import io
+import os
+from collections import deque
+from concurrent.futures import FIRST_COMPLETED, ThreadPoolExecutor, wait
+from dataclasses import dataclass, field
+from typing import Callable, Iterable, Iterator, Optional
+
+from tfm_content_digest import local_sha256
+from tfm_hash_cache import get_hash_cache, stat_key
+from tfm_path import STORAGE_ERRORS
+
+#: Bytes hashed at each end of a file in the edge stage
+EDGE_BYTES = 64 * 1024
+#: Default worker count (``DUPLICATE_FINDER_THREADS``)
+DEFAULT_THREADS = 4
+
+# Edge digests are filed in the hash cache under this tag plus a hash of the
+# file version's key; a real key starts with the device number instead.
+_EDGE_TAG = b"TFMEDGE\0"
+# Jobs queued per worker while hashing, so the pool never starves but a
+# million candidates don't become a million pending futures.
+_QUEUE_DEPTH = 8
+_END = object()
+
+
+def _noop() -> None:
+    pass
+
+
+@dataclass
+class DuplicateGroup:
+    """Files with the same content, in walk order."""
+
+    size: int
+    digest: bytes
+    paths: list = field(default_factory=list)  # list[Path]
+
+    @property
+    def wasted(self) -> int:
+        """Bytes that deleting all but one copy would free."""
+        return self.size * (len(self.paths) - 1)
+
+
+@dataclass(slots=True)
+class _File:
+    """A walked file: where it is, and the version key of local files."""
+
+    dir_index: int
+    name: str
+    key: Optional[bytes]
+
+
+def find_duplicate_groups(
+    roots: Iterable,
+    *,
+    show_hidden: bool = False,
+    threads: int = DEFAULT_THREADS,
+    checkpoint: Optional[Callable[[], None]] = None,
+    on_progress: Optional[Callable[[str, int, int], None]] = None,
+) -> list[DuplicateGroup]:
+    """Groups of files with identical content under ``roots``, most wasted
+    bytes first. A root inside another root is walked once. Unreadable
+    directories and files are skipped."""
+    checkpoint = checkpoint or _noop
+    report = on_progress or (lambda stage, done, total: None)
+    roots = _outermost(roots)
+    pool = ThreadPoolExecutor(max_workers=max(1, threads),
+                              thread_name_prefix="tfm-dupes")
+    try:
+        dirs, by_size = _walk(pool, roots, show_hidden, checkpoint, report)
+        buckets = [(size, files) for size, files in by_size.items() if len(files) > 1]
+        del by_size
+        return _narrow(pool, dirs, buckets, max(1, threads), checkpoint, report)
+    finally:
+        pool.shutdown(wait=True, cancel_futures=True)
+
+
+def _outermost(roots: Iterable) -> list:
+    """``roots`` without repeats and without roots nested in another root.
+    Trailing slashes don't matter, and ``/`` contains every other root."""
+    unique = {}
+    for root in roots:
+        unique.setdefault(str(root).rstrip("/") or "/", root)
+    prefixes = {text: text if text.endswith("/") else text + "/" for text in unique}
+    return [root for text, root in unique.items()
+            if not any(other != text and text.startswith(prefix)
+                       for other, prefix in prefixes.items())]
+
+
+# --- stage 1: walk ------------------------------------------------------------
+
+def _walk(pool, roots, show_hidden, checkpoint, report):
+    """List every directory under ``roots`` on the pool. Returns the directory
+    list and the files bucketed by size (hard links folded)."""
+    dirs: list = []
+    by_size: dict[int, list[_File]] = {}
+    inodes: set[bytes] = set()
+    scanned = 0
+
+    def list_dir(directory):
+        checkpoint()
+        return directory, _list_dir(directory, show_hidden)
+
+    pending = {pool.submit(list_dir, root) for root in roots}
+    while pending:
+        done, pending = wait(pending, return_when=FIRST_COMPLETED)
+        for future in done:
+            directory, (subdirs, files) = future.result()
+            for subdir in subdirs:
+                pending.add(pool.submit(list_dir, subdir))
+            if not files:
+                continue
+            dir_index = len(dirs)
+            dirs.append(directory)
+            for name, size, key in files:
+                if key is not None:
+                    inode = key[:16]  # device and inode (see same_file)
+                    if key[8:16] != bytes(8):
+                        if inode in inodes:
+                            continue  # another link to a file already walked
+                        inodes.add(inode)
+                by_size.setdefault(size, []).append(_File(dir_index, name, key))
+            scanned += len(files)
+        checkpoint()
+        report("scan", scanned, 0)
+    return dirs, by_size
+
+
+def _list_dir(directory, show_hidden: bool):
+    """``(subdirs, [(name, size, key)])`` of one directory; symlinks, empty
+    files and special files are left out. An unreadable directory is empty."""
+    subdirs, files = [], []
+    try:
+        listing = directory.iterdir_stat()
+        if listing is None:
+            listing = _stat_each(directory)
+        for child, entry in listing:
+            name = entry["name"]
+            if "error" in entry or entry["is_symlink"]:
+                continue
+            if not show_hidden and name.startswith("."):
+                continue
+            if entry["is_dir"]:
+                subdirs.append(child)
+            elif entry["is_file"] and entry["size"] > 0:
+                st = entry.get("stat")
+                files.append((name, entry["size"], stat_key(st) if st is not None else None))
+    except STORAGE_ERRORS:
+        pass
+    return subdirs, files
+
+
+def _stat_each(directory) -> Iterator[tuple]:
+    """An ``iterdir_stat``-shaped listing for storage without one."""
+    for child in directory.iterdir():
+        try:
+            is_link = child.is_symlink()
+            st = child.stat()
+            is_dir = child.is_dir()
+        except STORAGE_ERRORS as e:
+            yield child, {"name": child.name, "error": str(e)}
+            continue
+        yield child, {"name": child.name, "size": st.st_size, "is_dir": is_dir,
+                      "is_file": not is_dir, "is_symlink": is_link}
+
+
+# --- stages 2 and 3: digests --------------------------------------------------
+
+def _narrow(pool, dirs, buckets, threads, checkpoint, report):
+    """Split each same-size bucket by edge digest, then by full digest."""
+    cache = get_hash_cache()
+    groups: list[DuplicateGroup] = []
+    # Same-size buckets still to split, by the stage that splits them next
+    full_needed: list[tuple[int, list[_File]]] = []
+    edge_needed: list[tuple[int, list[_File]]] = []
+    for size, files in buckets:
+        cached = [cache.get(f.key) if f.key is not None else None for f in files]
+        if all(d is not None for d in cached):
+            _collect(groups, dirs, ((size, f, d) for f, d in zip(files, cached)))
+        elif size <= 2 * EDGE_BYTES:
+            full_needed.append((size, files))  # the edge read would be the whole file
+        else:
+            edge_needed.append((size, files))
+
+    jobs = [(size, f) for size, files in edge_needed for f in files]
+    edge_total = len(jobs)
+    edges = _map(pool, lambda job: _edge_digest(dirs, job[1], job[0], checkpoint),
+                 jobs, threads, checkpoint, lambda n: report("edges", n, edge_total))
+    by_edge: dict[tuple[int, bytes], list[_File]] = {}
+    for (size, f), digest in zip(jobs, edges):
+        if digest is not None:
+            by_edge.setdefault((size, digest), []).append(f)
+    full_needed += [(size, files) for (size, _), files in by_edge.items() if len(files) > 1]
+    del jobs, edges, by_edge
+
+    jobs = [(size, f) for size, files in full_needed for f in files]
+    hash_total = len(jobs)
+    fulls = _map(pool, lambda job: _full_digest(dirs, job[1], checkpoint),
+                 jobs, threads, checkpoint, lambda n: report("hash", n, hash_total))
+    _collect(groups, dirs, ((size, f, d) for (size, f), d in zip(jobs, fulls)))
+    groups.sort(key=lambda g: (-g.wasted, str(g.paths[0])))
+    return groups
+
+
+def _collect(groups, dirs, hashed) -> None:
+    """Append a group per ``(size, digest)`` that two or more of the ``(size,
+    file, digest)`` triples in ``hashed`` share; a None digest is unreadable."""
+    by_digest: dict[tuple[int, bytes], list[_File]] = {}
+    for size, f, digest in hashed:
+        if digest is not None:
+            by_digest.setdefault((size, digest), []).append(f)
+    for (size, digest), files in by_digest.items():
+        if len(files) > 1:
+            groups.append(DuplicateGroup(size, digest,
+                                         [dirs[f.dir_index] / f.name for f in files]))
+
+
+def _map(pool, fn, items, threads, checkpoint, advance) -> list:
+    """``[fn(item) for item in items]`` on the pool, at most ``threads *
+    _QUEUE_DEPTH`` jobs queued at a time; ``advance(done)`` after each."""
+    results = []
+    queued: deque = deque()
+    it = iter(items)
+    for item in it:
+        queued.append(pool.submit(fn, item))
+        if len(queued) >= threads * _QUEUE_DEPTH:
+            break
+    while queued:
+        results.append(queued.popleft().result())
+        item = next(it, _END)
+        if item is not _END:
+            queued.append(pool.submit(fn, item))
+        checkpoint()
+        advance(len(results))
+    return results
+
+
+def _edge_key(key: bytes) -> bytes:
+    return _EDGE_TAG + hashlib.sha256(key).digest()
+
+
+def _edge_digest(dirs, f: _File, size: int, checkpoint) -> Optional[bytes]:
+    """SHA-256 of the first and last ``EDGE_BYTES`` of a file, or None if it
+    can't be read (or changed size since the walk)."""
+    checkpoint()
+    cache = get_hash_cache()
+    if f.key is not None:
+        digest = cache.get(_edge_key(f.key))
+        if digest is not None:
+            return digest
+    path = dirs[f.dir_index] / f.name
+    hasher = hashlib.sha256()
+    try:
+        with path.open("rb") as stream:
+            head = stream.read(EDGE_BYTES)
+            try:
+                stream.seek(size - EDGE_BYTES)
+            except (io.UnsupportedOperation, OSError):
+                while stream.tell() < size - EDGE_BYTES:  # can only read forward
+                    checkpoint()
+                    if not stream.read(min(1 << 20, size - EDGE_BYTES - stream.tell())):
+                        return None
+            tail = stream.read(EDGE_BYTES)
+    except STORAGE_ERRORS:
+        return None
+    if len(head) != EDGE_BYTES or len(tail) != EDGE_BYTES:
+        return None
+    hasher.update(head)
+    hasher.update(tail)
+    digest = hasher.digest()
+    if f.key is not None:
+        try:
+            if stat_key(os.stat(str(path))) == f.key:
+                cache.put(_edge_key(f.key), digest)
+        except OSError:
+            pass
+    return digest
+
+
+def _full_digest(dirs, f: _File, checkpoint) -> Optional[bytes]:
+    """SHA-256 of a file's content (cached, storage-side, or read), or None
+    if it can't be read."""
+    checkpoint()
+    path = dirs[f.dir_index] / f.name
+    try:
+        if f.key is None:
+            remote = path.content_digest()
+            if remote is not None:
+                return bytes.fromhex(remote)
+        return bytes.fromhex(local_sha256(path, checkpoint))
+    except STORAGE_ERRORS:
+        return None
@@ -5,7 +5,11 @@ TFM File List Manager - Manages file lists, sorting, filtering, and selection
 
 import os
 import stat
+import time
 import fnmatch
+from collections import Counter
+from operator import itemgetter
+from tfm_disk_usage import allocated_size, get_disk_usage_cache
 from tfm_path import Path
 from datetime import datetime
 from tfm_str_format import format_size
@@ -56,6 +60,13 @@ class FileListManager:
             # Re-stat the found set: drop entries that have vanished (moved/
             # deleted by a prior op) and prune their metadata in step.
             survivors = [p for p in virtual['results'] if self._path_exists(p)]
+            groups = virtual.get('groups')
+            if groups is not None:
+                # A duplicates feed: a copy whose twins are all gone is no
+                # longer a duplicate, so it leaves the listing with them.
+                counts = Counter(groups.get(str(p)) for p in survivors)
+                survivors = [p for p in survivors if counts[groups.get(str(p))] > 1]
+                virtual['group_count'] = sum(1 for n in counts.values() if n > 1)
             virtual['results'] = survivors
             keys = {str(p) for p in survivors}
             virtual['meta'] = {k: v for k, v in virtual.get('meta', {}).items()
@@ -65,6 +76,7 @@ class FileListManager:
                 filter_pattern=pane_data.get('filter_pattern'),
                 sort_mode=pane_data['sort_mode'],
                 sort_reverse=pane_data['sort_reverse'],
+                groups=groups,
             )
             self.apply_listing(pane_data, result)
             return
@@ -74,6 +86,11 @@ class FileListManager:
             sort_mode=pane_data['sort_mode'],
             sort_reverse=pane_data['sort_reverse'],
         )
+        if pane_data.get('disk_usage'):
+            # Cached totals only: this runs on the UI thread (sort keys, file
+            # operations), where a tree scan would freeze it
+            result = self.apply_disk_usage(result, pane_data['path'],
+                                           reverse=pane_data['sort_reverse'], scan=False)
         self.apply_listing(pane_data, result)
 
     @staticmethod
@@ -86,7 +103,7 @@ class FileListManager:
             return False
 
     def compute_listing(self, path, *, filter_pattern=None, sort_mode='name',
-                        sort_reverse=False):
+                        sort_reverse=False, on_partial=None):
         """Read ``path`` and return its listing as a plain dict — **no pane
         mutation**, so this is safe to call on a worker thread.
 
@@ -96,6 +113,12 @@ class FileListManager:
         ``{"ok": bool, "files": [...], "file_info": {...}}``; on any error
         ``ok`` is False with empty lists (the error is logged, as before). The
         caller installs the result with :meth:`apply_listing`.
+
+        With ``on_partial``, a path that lists in pages (S3) is read page by
+        page and ``on_partial(result)`` is called with the sorted listing so far
+        (``partial`` set in the dict) — after the first page, then at most every
+        ``_PARTIAL_INTERVAL`` — so a huge prefix shows its first rows after one
+        round-trip. The return value is still the complete listing.
         """
         try:
             # Import archive exceptions for specific error handling
@@ -104,21 +127,13 @@ class FileListManager:
                 ArchivePermissionError
             )
 
-            # Get all entries in the directory
-            all_entries = list(path.iterdir())
-
-            # Filter hidden files if needed
-            if not self.show_hidden:
-                all_entries = [entry for entry in all_entries if not entry.name.startswith('.')]
+            pages = path.iterdir_pages() if on_partial else None
+            if pages is not None:
+                return self._stream_listing(pages, filter_pattern, sort_mode,
+                                            sort_reverse, on_partial)
 
-            # Apply filename filter if active (only to files, not directories)
-            if filter_pattern:
-                filtered_entries = []
-                for entry in all_entries:
-                    # Always include directories, only filter files
-                    if entry.is_dir() or fnmatch.fnmatch(entry.name.lower(), filter_pattern.lower()):
-                        filtered_entries.append(entry)
-                all_entries = filtered_entries
+            # Get all entries in the directory
+            all_entries = self._visible_entries(path.iterdir(), filter_pattern)
 
             # Sort the entries
             files = self.sort_entries(all_entries, sort_mode, sort_reverse)
@@ -156,8 +171,83 @@ class FileListManager:
             self.logger.error(f"Unexpected error reading directory {path}: {e}")
         return {"ok": False, "files": [], "file_info": {}}
 
+    def _visible_entries(self, entries, filter_pattern):
+        """The entries a listing shows: hidden files dropped unless
+        ``show_hidden``, and files (never directories) matched against
+        ``filter_pattern``."""
+        all_entries = list(entries)
+
+        # Filter hidden files if needed
+        if not self.show_hidden:
+            all_entries = [entry for entry in all_entries if not entry.name.startswith('.')]
+
+        # Apply filename filter if active (only to files, not directories)
+        if filter_pattern:
+            filtered_entries = []
+            for entry in all_entries:
+                # Always include directories, only filter files
+                if entry.is_dir() or fnmatch.fnmatch(entry.name.lower(), filter_pattern.lower()):
+                    filtered_entries.append(entry)
+            all_entries = filtered_entries
+        return all_entries
+
+    #: Least time between two partial listings while a paged directory streams
+    #: in. Each one re-merges and copies the whole listing so far, so the gap
+    #: also stretches to ten times the last one's cost: on a prefix with
+    #: millions of keys the partial updates stay a small share of the listing.
+    _PARTIAL_INTERVAL = 0.25
+
+    def _stream_listing(self, pages, filter_pattern, sort_mode, sort_reverse, on_partial):
+        """:meth:`compute_listing` for a paged directory: sort each page into
+        the listing as it arrives and hand ``on_partial`` the listing so far.
+
+        Directories and files are kept as two sorted lists of ``(key, entry)``;
+        a page is sorted on its own and merged in (Timsort merges two sorted
+        runs in linear time), so the order is exactly what
+        :meth:`sort_entries` gives for the whole directory."""
+        sort_key = self._sort_key_func(sort_mode)
+        groups = ([], [])  # directories, files
+        pending = []
+        file_info = {}
+        next_post = 0.0  # the first page is shown straight away
+        files = []
+        for page in pages:
+            page = self._visible_entries(page, filter_pattern)
+            pending.extend(page)
+            file_info.update(self._build_file_info(page))
+            started = time.monotonic()
+            if started < next_post:
+                continue
+            files = self._merge_sorted(groups, pending, sort_key, sort_reverse)
+            pending = []
+            on_partial({"ok": True, "partial": True, "files": files,
+                        "file_info": dict(file_info)})
+            now = time.monotonic()
+            next_post = now + max(self._PARTIAL_INTERVAL, 10 * (now - started))
+        if pending or not files:
+            files = self._merge_sorted(groups, pending, sort_key, sort_reverse)
+        return {"ok": True, "files": files, "file_info": file_info}
+
+    @staticmethod
+    def _merge_sorted(groups, entries, sort_key, reverse):
+        """Merge ``entries`` into the sorted ``(directories, files)`` groups and
+        return the flat listing, directories first."""
+        added = ([], [])
+        for entry in entries:
+            try:
+                is_dir = entry.is_dir()
+            except (OSError, PermissionError):
+                is_dir = False  # Treat as file on error
+            added[0 if is_dir else 1].append((sort_key(entry), entry))
+        for group, new in zip(groups, added):
+            if new:
+                new.sort(key=itemgetter(0), reverse=reverse)
+                group.extend(new)
+                group.sort(key=itemgetter(0), reverse=reverse)
+        return [entry for _, entry in groups[0]] + [entry for _, entry in groups[1]]
+
     def compute_listing_from_paths(self, paths, *, filter_pattern=None,
-                                   sort_mode='name', sort_reverse=False):
+                                   sort_mode='name', sort_reverse=False, groups=None):
         """Build a listing dict from an explicit list of ``Path`` objects — a
         virtual / search-results pane — instead of reading a directory. Applies
         the filename filter and the sort in memory and builds the display-info
@@ -168,7 +258,11 @@ class FileListManager:
         Unlike :meth:`compute_listing` this does **not** apply the hidden-file
         filter: the search that produced ``paths`` already honoured
         ``show_hidden``, and a scattered result set has no single directory whose
-        dotfiles to hide."""
+        dotfiles to hide.
+
+        ``groups`` (``str(path)`` -> group number, as for a duplicates feed)
+        keeps each group's rows together, groups in ascending number and the
+        pane's sort within a group."""
         all_entries = list(paths)
         if filter_pattern:
             # Filter files by name; always keep directories (matches compute_listing).
@@ -176,6 +270,8 @@ class FileListManager:
                            if self._is_dir_safe(e)
                            or fnmatch.fnmatch(e.name.lower(), filter_pattern.lower())]
         files = self.sort_entries(all_entries, sort_mode, sort_reverse)
+        if groups:
+            files.sort(key=lambda e: groups.get(str(e), len(groups)))  # stable
         return {"ok": True, "files": files,
                 "file_info": self._build_file_info(files)}
 
@@ -229,18 +325,74 @@ class FileListManager:
                 }
         return file_info
 
+    def apply_disk_usage(self, result, path, *, reverse=False, checkpoint=None, scan=True):
+        """Turn a :meth:`compute_listing` result for ``path`` into its
+        disk-usage view: directories show their subtree's allocated size (from
+        the disk usage cache, scanning what isn't cached) and every entry is
+        ordered by allocated size, largest first unless ``reverse`` —
+        directories and files together, as in ``ncdu``. Adds ``usage``, the
+        directory's own total. Blocking; runs where ``compute_listing`` does.
+        ``checkpoint`` may raise to abandon the scan. With ``scan`` False
+        nothing is scanned: directories without a cached total sort last
+        and ``usage`` may be None."""
+        if not result.get("ok"):
+            return result
+        cache = get_disk_usage_cache()
+        if scan:
+            threads = getattr(self.config, 'DISK_USAGE_SCAN_THREADS', 8)
+            usage = cache.scan(path, threads=threads, checkpoint=checkpoint)
+        else:
+            usage = cache.get(path)
+        file_info = result['file_info']
+        sizes = {}
+        for entry in result['files']:
+            key = str(entry)
+            info = file_info.get(key)
+            if info is None:
+                continue
+            if info['is_dir']:
+                total = cache.get(key)
+                sizes[key] = total.size if total is not None else -1
+                if total is not None:
+                    info['size_str'] = format_size(total.size, compact=True)
+            else:
+                try:
+                    sizes[key] = allocated_size(entry.lstat())
+                except Exception:
+                    sizes[key] = -1
+        files = sorted(result['files'], key=lambda e: sizes.get(str(e), -1),
+                       reverse=not reverse)
+        return dict(result, files=files, usage=usage)
+
     def apply_listing(self, pane_data, result):
         """Install a :meth:`compute_listing` result into ``pane_data`` and
         reconcile the cursor and selection — the pane-mutating tail of a refresh,
         run on the UI thread. On an error result (``ok`` False) the pane is
         emptied and the cursor reset, matching the old ``refresh_files`` error
-        path (selection is left untouched)."""
+        path (selection is left untouched).
+
+        A partial result (a page of a streaming listing) is reconciled against
+        nothing: selected files not listed yet stay selected, and the cursor
+        index the listing was started with is held (``_held_focus``) and
+        restored when the complete result arrives, unless the cursor was moved
+        in between. Only the shown index is kept within the page."""
+        held = pane_data.pop('_held_focus', None)
         if not result.get("ok"):
             pane_data['files'] = []
             pane_data['focused_index'] = 0
             return
         pane_data['files'] = result['files']
         pane_data['file_info'] = result['file_info']
+        pane_data['usage'] = result.get('usage')
+
+        if held is not None and held[1] == pane_data['focused_index']:
+            pane_data['focused_index'] = held[0]
+        if result.get("partial"):
+            wanted = pane_data['focused_index']
+            shown = min(wanted, len(pane_data['files']) - 1) if pane_data['files'] else 0
+            pane_data['focused_index'] = shown
+            pane_data['_held_focus'] = (wanted, shown)
+            return
 
         # Ensure focused index is valid
         if pane_data['files']:
@@ -274,17 +426,9 @@ class FileListManager:
         parts = re.split(r'(\d+)', text)
         return [convert(part) for part in parts]
     
-    def sort_entries(self, entries, sort_mode, reverse=False):
-        """Sort file entries based on the specified mode
-        
-        Args:
-            entries: List of Path objects to sort
-            sort_mode: 'name', 'ext', 'size', or 'date'
-            reverse: Whether to reverse the sort order
-            
-        Returns:
-            Sorted list with directories always first
-        """
+    def _sort_key_func(self, sort_mode):
+        """The per-entry sort key for ``sort_mode`` (directories and files are
+        sorted as separate groups by the caller)."""
         def get_sort_key(entry):
             """Generate sort key for an entry"""
             try:
@@ -318,6 +462,21 @@ class FileListManager:
                 # If we can't get file info, use name as fallback
                 return self._natural_sort_key(entry.name)
         
+        return get_sort_key
+    
+    def sort_entries(self, entries, sort_mode, reverse=False):
+        """Sort file entries based on the specified mode
+        
+        Args:
+            entries: List of Path objects to sort
+            sort_mode: 'name', 'ext', 'size', or 'date'
+            reverse: Whether to reverse the sort order
+            
+        Returns:
+            Sorted list with directories always first
+        """
+        get_sort_key = self._sort_key_func(sort_mode)
+        
         # Cache is_dir() results to avoid redundant calls (optimization for remote filesystems)
         # This reduces calls from 2N to N, providing 50% reduction in network operations
         dirs_and_files = []
@@ -344,6 +503,8 @@ class FileListManager:
         """Get a human-readable description of the current sort mode"""
         mode = pane_data['sort_mode']
         reverse = pane_data['sort_reverse']
+        if pane_data.get('disk_usage') and not pane_data.get('virtual'):
+            return 'Usage ↑' if reverse else 'Usage ↓'
         
         descriptions = {
             'name': 'Name',
@@ -8,8 +8,10 @@ and triggering file list reloads via a thread-safe queue mechanism.
 
 from pathlib import Path
 from typing import Optional, Dict
+import os
 import threading
 import time
+from tfm_disk_usage import get_disk_usage_cache
 from tfm_log_manager import getLogger
 from tfm_file_monitor_observer import FileMonitorObserver, WATCHDOG_AVAILABLE
 
@@ -407,6 +409,12 @@ class FileMonitorManager:
         try:
             with self.state_lock:
                 state = self.monitoring_state[pane_name]
+                # The disk-usage totals of the watched directory (and of a
+                # changed child directory) include what just changed.
+                if state['path'] is not None:
+                    watched = str(state['path'])
+                    get_disk_usage_cache().invalidate(
+                        os.path.join(watched, filename) if filename else watched)
                 other_pane = 'right' if pane_name == 'left' else 'left'
                 other_state = self.monitoring_state[other_pane]
                 
@@ -31,18 +31,22 @@ from puikit.focus import FocusContainer, move_focus
 from puikit.widgets import Button, Checkbox, MarkdownView, show_message_box
 from puikit.widgets.base import Widget
 
+from tfm_delta_sync import COPY, UNCHANGED, SyncStats, set_synced_mtime, sync_file
 from tfm_dialog_geometry import OPEN_MS_VIEWER, animate_open, draw_title_bar
 from tfm_path import Path
 from tfm_progress_manager import OperationType, ProgressManager
+from tfm_str_format import format_size
 from tfm_task import Cancelled, Task, TaskManager
 
 #: Operation kind -> (verb label, progress-manager op type).
-_VERB = {"copy": "Copy", "move": "Move", "delete": "Delete", "duplicate": "Duplicate"}
+_VERB = {"copy": "Copy", "move": "Move", "delete": "Delete", "duplicate": "Duplicate",
+         "sync": "Sync"}
 _OP_TYPE = {
     "copy": OperationType.COPY,
     "move": OperationType.MOVE,
     "delete": OperationType.DELETE,
     "duplicate": OperationType.COPY,
+    "sync": OperationType.COPY,
 }
 
 #: Copy in 1 MiB chunks; files at least this large are chunk-copied so the byte
@@ -148,6 +152,16 @@ class FileOperationService:
         prompt, since an in-place copy always collides. Honors ``CONFIRM_DUPLICATE``."""
         self._start(panel, "duplicate", targets, dest_dir, on_complete, log, z, background)
 
+    def sync(self, panel: Any, targets: list, dest_dir: Path, *,
+             on_complete: Optional[Callable[[dict], None]] = None,
+             log: Optional[Callable[[str], None]] = None,
+             z: int = 70, background: bool = True) -> None:
+        """Bring ``dest_dir/name`` in line with each of ``targets`` without a
+        conflict prompt: unchanged files are left alone and changed ones are
+        updated by delta (``tfm_delta_sync``), so only changed blocks are
+        written or sent. Honors ``CONFIRM_SYNC``."""
+        self._start(panel, "sync", targets, dest_dir, on_complete, log, z, background)
+
     def delete(self, panel: Any, targets: list, *,
                on_complete: Optional[Callable[[dict], None]] = None,
                log: Optional[Callable[[str], None]] = None,
@@ -242,6 +256,11 @@ class FileOperationService:
                 plan = [(t, _unique_dest(dest_dir, t.name, is_dir=t.is_dir()), False)
                         for t in targets]
                 result["created"] = [dest.name for _t, dest, _o in plan]
+            elif kind == "sync":
+                # Overwriting is the point of a sync; files that already match
+                # are left alone inside _copy_file, so there is nothing to ask.
+                plan = [(t, dest_dir / t.name, True) for t in targets]
+                result["sync"] = SyncStats()
             else:
                 plan, result["skipped"] = self._resolve(task, targets, dest_dir, z, panel)
 
@@ -261,7 +280,7 @@ class FileOperationService:
                 before = len(errors)
                 try:
                     ok = self._execute_one(task, kind, target, dest_base, overwrite,
-                                           dest_dir, prog, log, errors)
+                                           dest_dir, prog, log, errors, result.get("sync"))
                 except Cancelled:
                     raise
                 except Exception as exc:  # noqa: BLE001 — unexpected; record + go on
@@ -339,6 +358,9 @@ class FileOperationService:
     def _count_node(self, task: Task, path: Path, base: int) -> tuple[int, int]:
         task.checkpoint()
         if path.is_dir() and not path.is_symlink():
+            tree = path.scan_tree()
+            if tree is not None:
+                return self._count_scanned(task, tree, base)
             items, bytes_ = 1, 0
             for child in path.iterdir():
                 n, b = self._count_node(task, child, base + items)
@@ -352,13 +374,34 @@ class FileOperationService:
             size = 0
         return 1, size
 
+    def _count_scanned(self, task: Task, tree, base: int) -> tuple[int, int]:
+        """:meth:`_count_node` for a directory whose storage lists a whole tree
+        in one go (``Path.scan_tree``) — sizes come with the listing, so remote
+        trees cost one request instead of one per directory and file."""
+        items, bytes_ = 1, 0
+        try:
+            for _, entry in tree:
+                if "error" in entry:  # unreadable directory, already counted
+                    continue
+                items += 1
+                if not entry["is_dir"] and not entry["is_symlink"]:
+                    bytes_ += entry["size"]
+                if items % 256 == 0:
+                    task.counted = base + items
+                    task.checkpoint()
+        finally:
+            tree.close()
+        task.counted = base + items
+        return items, bytes_
+
     def _execute_one(self, task: Task, kind: str, target: Path,
                      dest_base: Optional[Path], overwrite: bool,
                      dest_dir: Optional[Path], prog: ProgressManager, log,
-                     errors: list) -> int:
+                     errors: list, sync: Optional[SyncStats] = None) -> int:
         """Process one top-level target, returning the count of individual entries
         that succeeded and appending ``(path, reason)`` to ``errors`` for any that
-        failed. A single bad entry never aborts the rest of the target."""
+        failed. A single bad entry never aborts the rest of the target. ``sync``
+        (a sync only) collects what the delta transfers moved."""
         if kind == "delete":
             return self._delete_tree(task, target, prog, log, errors)
         if kind == "move" and _is_atomic_move(kind, target, dest_dir):
@@ -374,9 +417,9 @@ class FileOperationService:
             return 1
         # Copy, duplicate, or a cross-storage move (copy the tree, then — move only
         # — drop the source).
-        verb = {"move": "Moved", "duplicate": "Duplicated"}.get(kind, "Copied")
+        verb = {"move": "Moved", "duplicate": "Duplicated", "sync": "Synced"}.get(kind, "Copied")
         before = len(errors)
-        ok = self._copy_tree(task, target, dest_base, overwrite, prog, log, verb, errors)
+        ok = self._copy_tree(task, target, dest_base, overwrite, prog, log, verb, errors, sync)
         if kind == "move" and ok > 0 and len(errors) == before:
             # Only remove the source once the whole tree copied cleanly — never
             # drop files a partial copy left behind. Cleanup errors are ignored.
@@ -386,12 +429,18 @@ class FileOperationService:
     # --- per-node IO ---------------------------------------------------------
 
     def _copy_tree(self, task: Task, src: Path, dest: Path, overwrite: bool,
-                   prog: ProgressManager, log, verb: str, errors: list) -> int:
+                   prog: ProgressManager, log, verb: str, errors: list,
+                   sync: Optional[SyncStats] = None) -> int:
         """Copy one node (recursing into directories); return the number of entries
-        copied, collecting per-entry failures in ``errors`` and continuing."""
+        copied, collecting per-entry failures in ``errors`` and continuing. With
+        ``sync``, files are updated by delta and unchanged ones are not counted."""
         task.checkpoint()
         prog.update_progress(src.name)
         if src.is_dir() and not src.is_symlink():
+            remote = _ssh_transfer_side(src, dest) if sync is None else None
+            if remote is not None:
+                return self._copy_tree_batched(task, src, dest, remote, overwrite,
+                                               prog, log, verb, errors)
             try:
                 dest.mkdir(parents=True, exist_ok=True)
             except Cancelled:
@@ -402,10 +451,10 @@ class FileOperationService:
             ok = 1  # the directory itself
             for child in src.iterdir():
                 ok += self._copy_tree(task, child, dest / child.name,
-                                      overwrite, prog, log, verb, errors)
+                                      overwrite, prog, log, verb, errors, sync)
             return ok
         try:
-            copied = self._copy_file(task, src, dest, overwrite, prog)
+            copied = self._copy_file(task, src, dest, overwrite, prog, sync)
         except Cancelled:
             raise
         except Exception as exc:  # noqa: BLE001 — one bad file, keep going
@@ -414,15 +463,92 @@ class FileOperationService:
         if copied:
             _log_op(log, verb, src, dest)  # one line per file, with the real dest
             return 1
-        return 0  # skipped (inner collision under a non-overwrite dir)
+        return 0  # skipped (inner collision, or unchanged in a sync)
+
+    def _copy_tree_batched(self, task: Task, src: Path, dest: Path, remote: Path,
+                           overwrite: bool, prog: ProgressManager, log, verb: str,
+                           errors: list) -> int:
+        """:meth:`_copy_tree` for a directory copied between local storage and an
+        SSH host: the tree is created first and its files collected, then they
+        are copied over several SFTP channels at once (``tfm_ssh_transfer``) —
+        one file at a time, each small file would wait out a few round-trips."""
+        from tfm_ssh_transfer import channels_for_host, connection_for, make_job, transfer_files
+
+        planned: list = []
+        ok = self._plan_dir(task, src, dest, overwrite, prog, log, verb, errors, planned)
+        if not planned:
+            return ok
+        copied = [0]
+
+        def on_done(job, error) -> None:
+            s, d = job.tag
+            if error is not None:
+                errors.append((str(s), str(error)))
+                return
+            prog.update_progress(s.name)
+            _log_op(log, verb, s, d)
+            copied[0] += 1
+
+        conn = connection_for(remote)
+        transfer_files(conn, [make_job(s, d, size, tag=(s, d)) for s, d, size in planned],
+                       channels_for_host(self.config, conn.hostname), on_done=on_done,
+                       on_bytes=prog.update_file_byte_progress, checkpoint=task.checkpoint)
+        return ok + copied[0]
+
+    def _plan_dir(self, task: Task, src: Path, dest: Path, overwrite: bool,
+                  prog: ProgressManager, log, verb: str, errors: list, planned: list) -> int:
+        """Create ``dest`` and everything below it for a batched copy, appending
+        ``(src, dest, size)`` to ``planned`` for each regular file to transfer.
+        Symlinks are copied on the spot. Returns the entries done here (the
+        directories and symlinks)."""
+        try:
+            existed = dest.exists()
+            dest.mkdir(parents=True, exist_ok=True)
+            # One listing per directory instead of an exists() per file
+            present = {c.name for c in dest.iterdir()} if existed else set()
+        except Cancelled:
+            raise
+        except Exception as exc:  # noqa: BLE001 — can't copy into it; skip children
+            errors.append((str(src), str(exc)))
+            return 0
+        ok = 1  # the directory itself
+        for child in src.iterdir():
+            task.checkpoint()
+            target = dest / child.name
+            try:
+                if child.is_dir() and not child.is_symlink():
+                    prog.update_progress(child.name)
+                    ok += self._plan_dir(task, child, target, overwrite, prog, log, verb,
+                                         errors, planned)
+                    continue
+                if child.name in present and not overwrite:
+                    continue  # inner collision under a non-overwrite dir — leave it
+                if child.is_symlink():
+                    prog.update_progress(child.name)
+                    child.copy_to(target, overwrite=overwrite)
+                    _log_op(log, verb, child, target)
+                    ok += 1
+                    continue
+                planned.append((child, target, child.stat().st_size))
+            except Cancelled:
+                raise
+            except Exception as exc:  # noqa: BLE001 — one bad entry, keep going
+                errors.append((str(child), str(exc)))
+        return ok
 
     def _copy_file(self, task: Task, src: Path, dest: Path, overwrite: bool,
-                   prog: ProgressManager) -> bool:
+                   prog: ProgressManager, sync: Optional[SyncStats] = None) -> bool:
         """Copy one file; return True if it was written, False if skipped (an inner
-        collision under a non-overwrite directory), so the caller logs only real
-        copies."""
+        collision under a non-overwrite directory, or a synced file that already
+        matched), so the caller logs only real copies."""
         if dest.exists() and not overwrite:
             return False  # inner collision under a non-overwrite dir — leave it
+        if sync is not None and not src.is_symlink():
+            outcome = sync_file(src, dest, sync, task.checkpoint)
+            if outcome == UNCHANGED:
+                return False
+            if outcome != COPY:
+                return True  # updated by delta
         try:
             size = 0 if src.is_symlink() else src.stat().st_size
         except Exception:  # noqa: BLE001
@@ -433,16 +559,33 @@ class FileOperationService:
             self._copy_bytes(task, src, dest, size, overwrite, local, prog)
         else:
             src.copy_to(dest, overwrite=overwrite)
+        if sync is not None and not src.is_symlink():
+            set_synced_mtime(src, dest)
         return True
 
     def _copy_bytes(self, task: Task, src: Path, dest: Path, size: int,
                     overwrite: bool, local: bool, prog: ProgressManager) -> None:
         """Copy a large / cross-storage file while driving the byte bar. Local
         files are streamed in chunks here (so ``shutil`` doesn't hide progress);
-        cross-storage copies delegate to ``Path.copy_to``'s own progress callback."""
+        cross-storage copies delegate to ``Path.copy_to``'s own progress callback,
+        which also polls cancellation between the chunks of a streamed transfer."""
         if not local:
-            src.copy_to(dest, overwrite=overwrite,
-                        progress_callback=prog.update_file_byte_progress)
+            def progress(done: int, total: int) -> None:
+                prog.update_file_byte_progress(done, total)
+                task.checkpoint()
+
+            try:
+                src.copy_to(dest, overwrite=overwrite, progress_callback=progress)
+            except Exception:
+                # copy_to wraps what the callback raised; a cancel mid-stream
+                # still unwinds as Cancelled, without a partial file
+                if not task.cancelled():
+                    raise
+                try:
+                    dest.unlink()
+                except Exception:  # noqa: BLE001
+                    pass
+                raise Cancelled()
             return
         dest.parent.mkdir(parents=True, exist_ok=True)
         copied = 0
@@ -527,6 +670,10 @@ def format_op_summary(verb: str, result: dict) -> str:
         extra.append(f"{n_err} file{'s' if n_err != 1 else ''} failed")
     if extra:
         summary += f" ({', '.join(extra)})"
+    sync = result.get("sync")
+    if sync is not None and sync.total_bytes:
+        summary += (f"; sent {format_size(sync.sent_bytes)} of "
+                    f"{format_size(sync.total_bytes)}, {sync.unchanged} unchanged")
     if result.get("cancelled"):
         summary += " — cancelled"
     return summary
@@ -566,6 +713,17 @@ def _log_del(log, path: Path) -> None:
         log(f"Deleted '{path.name}': {path.parent}")
 
 
+def _ssh_transfer_side(src: Path, dest: Path) -> Optional[Path]:
+    """The SSH side of a local ↔ SSH copy (the one to open transfer channels
+    to), or ``None`` for any other pair of storages."""
+    schemes = (src.get_scheme(), dest.get_scheme())
+    if schemes == ("file", "ssh"):
+        return dest
+    if schemes == ("ssh", "file"):
+        return src
+    return None
+
+
 def _is_atomic_move(kind: str, target: Path, dest_dir: Optional[Path]) -> bool:
     """A move within one storage backend is a single rename — no per-file walk,
     no byte bar. (A cross-storage move copies the tree then deletes the source.)"""
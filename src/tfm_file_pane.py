@@ -33,6 +33,8 @@ from puikit.font import Font
 from puikit.text import elide
 from puikit.widgets.base import Widget
 
+from tfm_text_width import cell_measure
+
 #: Size and date are numeric columns: pin them to a fixed-advance face so digits
 #: line up in their right-aligned columns. (Names keep the Panel's default
 #: proportional UI font on GUI; on TUI everything is the one grid font anyway.)
@@ -327,7 +329,8 @@ class FilePane(Widget):
 
     def _ext_width(self, measure: Callable[[str], float]) -> float:
         """Width of the extension column: the widest split-off extension in the
-        pane (0 when none qualify, so the column is dropped). Cached per listing.
+        pane (0 when none qualify, so the column is dropped). Cached per listing;
+        each distinct extension is measured once.
         """
         if self.config is None or not getattr(self.config, "SEPARATE_EXTENSIONS", False):
             return 0.0
@@ -339,13 +342,14 @@ class FilePane(Widget):
         if self._ext_cache[0] == id(files):
             return self._ext_cache[1]
         info_cache = self.pane.get("file_info", {})
-        width = 0.0
+        exts = set()
         for entry in files:
             info = info_cache.get(str(entry))
             is_dir = info["is_dir"] if info else False
             _, ext = self._split_name(entry.name, is_dir)
             if ext:
-                width = max(width, measure(ext))
+                exts.add(ext)
+        width = float(max(map(measure, exts), default=0.0))
         self._ext_cache = (id(files), width)
         return width
 
@@ -442,7 +446,7 @@ class FilePane(Widget):
         # Columns, left to right: gutter | basename | ext | size | date. The
         # extension column sits between the name and size (ttk TFM layout); it is
         # dropped when the pane has no splittable extensions.
-        ext_w = self._ext_width(measure)
+        ext_w = self._ext_width(cell_measure(ctx))
         ext_block = (COL_GAP + ext_w) if ext_w > 0 else 0.0
 
         # Date column (right of size), shown only while the name still has room to
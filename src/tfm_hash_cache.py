@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""
+TFM Hash Cache - Persistent SHA-256 digests of local files
+
+Comparing two local files by content used to read both of them every time, so
+re-running a directory diff or a content-criteria Compare Selection minutes
+later re-read every two-sided file although nothing had changed. ``HashCache``
+remembers each file's SHA-256 under the identity of that exact version of the
+file: ``(device, inode, size, mtime_ns, ctime_ns)``. Any write changes mtime
+and ctime (ctime can't be set back), a replacement changes the inode, so a hit
+is the digest of the file as it is now, and an unchanged file is never read
+again.
+
+The table lives in ``~/.tfm/hash_cache`` as fixed-size records — a 40-byte key
+and a 32-byte digest — after an 8-byte header. The first use reads the file in
+one go and indexes it in a dict; new digests are appended in batches (every
+``_FLUSH_EVERY`` stores and at exit), so several TFM processes can share the
+file. When it has grown to twice the entries kept, it is rewritten with the
+live, most recently used ``max_entries`` (least recently used dropped first).
+Lookups are not written, so across sessions recency is the order of stores
+until the next rewrite.
+
+SHA-256 is used because it is what storage-side hashing reports (``sha256sum``
+on SSH hosts, see :mod:`tfm_content_digest`), so a cached local digest can be
+compared with a remote one; hashlib's OpenSSL build uses the CPU's SHA
+extensions where present.
+"""
+
+import atexit
+import hashlib
+import os
+import struct
+import threading
+from pathlib import Path as PathlibPath
+from typing import Callable, Dict, List, Optional
+
+from tfm_log_manager import getLogger
+
+#: Default number of digests kept (``CONTENT_HASH_CACHE_ENTRIES``)
+DEFAULT_MAX_ENTRIES = 200_000
+
+_MAGIC = b'TFMHSH01'
+_KEY = struct.Struct('<5Q')  # dev, ino, size, mtime_ns, ctime_ns
+KEY_SIZE = _KEY.size
+DIGEST_SIZE = 32
+_RECORD = KEY_SIZE + DIGEST_SIZE
+_MASK = (1 << 64) - 1
+# Appending is batched; this many stores are buffered at most
+_FLUSH_EVERY = 512
+# Read size while hashing
+_CHUNK = 1 << 20
+
+
+def stat_key(st: os.stat_result) -> bytes:
+    """The cache key for the file version described by ``st``."""
+    return _KEY.pack(st.st_dev & _MASK, st.st_ino & _MASK, st.st_size,
+                     st.st_mtime_ns & _MASK, st.st_ctime_ns & _MASK)
+
+
+class HashCache:
+    """Persistent map from file version (:func:`stat_key`) to SHA-256 digest.
+
+    ``cache_file=None`` or ``max_entries=0`` disables it: lookups miss and
+    nothing is stored. Keys are any ``KEY_SIZE``-byte strings, so callers can
+    file other digests of local content under keys of their own."""
+
+    def __init__(self, cache_file: Optional[str], max_entries: int = DEFAULT_MAX_ENTRIES):
+        self._file = cache_file if max_entries > 0 else None
+        self.max_entries = max_entries
+        # key -> digest, least recently used first; None until loaded
+        self._entries: Optional[Dict[bytes, bytes]] = None
+        self._pending: List[bytes] = []
+        self._records_on_disk = 0
+        self._lock = threading.RLock()
+        self.logger = getLogger("HashCache")
+
+        # Statistics
+        self.hits = 0
+        self.misses = 0
+        self.stores = 0
+
+    @property
+    def enabled(self) -> bool:
+        return self._file is not None
+
+    def _load(self) -> Dict[bytes, bytes]:
+        """Read the table once (caller holds the lock)."""
+        if self._entries is None:
+            self._entries = {}
+            try:
+                with open(self._file, 'rb') as f:
+                    data = f.read()
+            except OSError:
+                data = b''
+            if data[:len(_MAGIC)] == _MAGIC:
+                end = len(_MAGIC) + (len(data) - len(_MAGIC)) // _RECORD * _RECORD
+                entries = self._entries
+                for offset in range(len(_MAGIC), end, _RECORD):
+                    key = data[offset:offset + KEY_SIZE]
+                    entries.pop(key, None)  # a later record is more recent
+                    entries[key] = data[offset + KEY_SIZE:offset + _RECORD]
+                self._records_on_disk = (end - len(_MAGIC)) // _RECORD
+                self._trim()
+            elif data:
+                self.logger.warning(f"Ignoring unrecognized hash cache {self._file}")
+        return self._entries
+
+    def _trim(self) -> None:
+        entries = self._entries
+        while len(entries) > self.max_entries:
+            del entries[next(iter(entries))]
+
+    def get(self, key: bytes) -> Optional[bytes]:
+        """The digest stored under ``key``, or None."""
+        if self._file is None:
+            return None
+        with self._lock:
+            entries = self._load()
+            digest = entries.pop(key, None)
+            if digest is None:
+                self.misses += 1
+                return None
+            entries[key] = digest  # most recently used
+            self.hits += 1
+            return digest
+
+    def put(self, key: bytes, digest: bytes) -> None:
+        """Store ``digest`` (32 bytes) under ``key``."""
+        if self._file is None:
+            return
+        with self._lock:
+            entries = self._load()
+            if entries.get(key) == digest:
+                return
+            entries.pop(key, None)
+            entries[key] = digest
+            self._trim()
+            self._pending.append(key + digest)
+            self.stores += 1
+            if len(self._pending) >= _FLUSH_EVERY:
+                self.flush()
+
+    def flush(self) -> None:
+        """Write buffered digests to disk."""
+        if self._file is None:
+            return
+        with self._lock:
+            if not self._pending:
+                return
+            pending, self._pending = self._pending, []
+            if self._records_on_disk + len(pending) > 2 * self.max_entries:
+                self._rewrite()
+                return
+            try:
+                os.makedirs(os.path.dirname(self._file), exist_ok=True)
+                with open(self._file, 'ab') as f:
+                    if f.tell() == 0:
+                        f.write(_MAGIC)
+                    f.write(b''.join(pending))
+                self._records_on_disk += len(pending)
+            except OSError as e:
+                # Caching is an optimization; the digests are simply recomputed
+                self.logger.warning(f"Could not save content hashes: {e}")
+
+    def _rewrite(self) -> None:
+        """Replace the file with the live entries (caller holds the lock)."""
+        tmp = f"{self._file}.{os.getpid()}.tmp"
+        try:
+            os.makedirs(os.path.dirname(self._file), exist_ok=True)
+            with open(tmp, 'wb') as f:
+                f.write(_MAGIC)
+                f.write(b''.join(key + digest for key, digest in self._entries.items()))
+            os.replace(tmp, self._file)
+            self._records_on_disk = len(self._entries)
+        except OSError as e:
+            self.logger.warning(f"Could not save content hashes: {e}")
+            try:
+                os.unlink(tmp)
+            except OSError:
+                pass
+
+    def file_digest(self, path: str, checkpoint: Optional[Callable[[], None]] = None) -> bytes:
+        """SHA-256 of the local file ``path``, from the cache when this version
+        of the file was hashed before. Raises OSError if it can't be read."""
+        st = os.stat(path)
+        key = stat_key(st)
+        digest = self.get(key)
+        if digest is not None:
+            return digest
+        hasher = hashlib.sha256()
+        with open(path, 'rb') as f:
+            while True:
+                if checkpoint is not None:
+                    checkpoint()
+                chunk = f.read(_CHUNK)
+                if not chunk:
+                    break
+                hasher.update(chunk)
+        digest = hasher.digest()
+        self.put_if_unchanged(path, key, digest)
+        return digest
+
+    def put_if_unchanged(self, path: str, key: bytes, digest: bytes) -> None:
+        """Store ``digest`` for the file version ``key`` read from ``path``,
+        unless the file changed while it was being read."""
+        try:
+            if stat_key(os.stat(path)) == key:
+                self.put(key, digest)
+        except OSError:
+            pass
+
+    def clear(self) -> None:
+        """Forget every digest and delete the file."""
+        with self._lock:
+            self._entries = {}
+            self._pending = []
+            self._records_on_disk = 0
+            if self._file is not None:
+                try:
+                    os.unlink(self._file)
+                except OSError:
+                    pass
+
+    def get_stats(self) -> dict:
+        with self._lock:
+            if self._file is not None:
+                self._load()
+            lookups = self.hits + self.misses
+            return {
+                'enabled': self._file is not None,
+                'entries': len(self._entries or ()),
+                'max_entries': self.max_entries,
+                'hits': self.hits,
+                'misses': self.misses,
+                'hit_rate': self.hits / lookups if lookups else 0.0,
+                'stores': self.stores,
+            }
+
+
+# Global hash cache instance
+_hash_cache = None
+
+
+def get_hash_cache() -> HashCache:
+    """Get or create the global content hash cache"""
+    global _hash_cache
+    if _hash_cache is None:
+        try:
+            from tfm_config import get_config
+            max_entries = getattr(get_config(), 'CONTENT_HASH_CACHE_ENTRIES', DEFAULT_MAX_ENTRIES)
+        except (ImportError, Exception):
+            max_entries = DEFAULT_MAX_ENTRIES
+        cache_file = str(PathlibPath.home() / '.tfm' / 'hash_cache')
+        _hash_cache = HashCache(cache_file, max_entries=max_entries)
+        atexit.register(_hash_cache.flush)
+    return _hash_cache
@@ -9,7 +9,7 @@ import logging
 from datetime import datetime
 from collections import deque
 from dataclasses import dataclass, field
-from typing import Dict, Optional
+from typing import Dict, Optional, Tuple
 from tfm_const import LOG_TIME_FORMAT, MAX_LOG_MESSAGES
 from tfm_colors import get_log_color, get_status_color
 from tfm_logging_handlers import LogPaneHandler, StreamOutputHandler, FileLoggingHandler
@@ -31,6 +31,9 @@ class LoggingConfig:
     # File logging settings
     file_logging_enabled: bool = False
     file_logging_path: Optional[str] = None
+    file_logging_max_bytes: int = 10 * 1024 * 1024  # rotate past this size (0 = never)
+    file_logging_backup_count: int = 3
+    file_logging_format: str = 'text'  # 'text' or 'binary'
     
     # Log level settings
     default_log_level: int = logging.INFO
@@ -52,15 +55,21 @@ class LogCapture:
         self.lock = threading.RLock()  # Thread safety for buffer access
         
     def write(self, text):
+        if '\n' not in text:
+            with self.lock:
+                self.buffer += text
+            return
+        
+        level = logging.INFO if self.source == "STDOUT" else logging.WARNING
         with self.lock:
-            # Add text to buffer
-            self.buffer += text
-            
-            # Process complete lines (split on newlines)
-            while '\n' in self.buffer:
-                line, self.buffer = self.buffer.split('\n', 1)
-                
-                # Emit all lines, including empty ones (empty lines are meaningful output)
+            # Split the buffered text once; the last piece is an incomplete line
+            *lines, self.buffer = (self.buffer + text).split('\n')
+            if not self.logger.isEnabledFor(level):
+                return
+            # Emit all lines, including empty ones (empty lines are meaningful
+            # output). Under the buffer lock, so lines written by different
+            # threads reach the handlers in the order they were split off.
+            for line in lines:
                 self._emit_log_record(line)
     
     def _emit_log_record(self, text):
@@ -110,6 +119,7 @@ class LogManager:
         # Track log updates for redraw triggering
         self.has_new_messages = False
         self.last_message_count = 0
+        self._last_generation = 0  # log pane handler generation at the last redraw
         
         # Logger caching - stores created loggers by name
         self._loggers = {}
@@ -129,6 +139,8 @@ class LogManager:
         # Configure file logging
         self._config.file_logging_enabled = log_file is not None
         self._config.file_logging_path = log_file
+        (self._config.file_logging_max_bytes, self._config.file_logging_backup_count,
+         self._config.file_logging_format) = _file_logging_settings(config)
         # Configure log pane (disabled if no_log_pane is True)
         self._config.log_pane_enabled = not no_log_pane
         
@@ -225,7 +237,11 @@ class LogManager:
         if self._config.file_logging_enabled:
             if self._file_logging_handler is None and self._config.file_logging_path:
                 # Create new handler
-                self._file_logging_handler = FileLoggingHandler(self._config.file_logging_path)
+                self._file_logging_handler = FileLoggingHandler(
+                    self._config.file_logging_path,
+                    max_bytes=self._config.file_logging_max_bytes,
+                    backup_count=self._config.file_logging_backup_count,
+                    binary=self._config.file_logging_format == 'binary')
                 # Add to stream logger
                 if self._file_logging_handler not in self._stream_logger.handlers:
                     self._stream_logger.addHandler(self._file_logging_handler)
@@ -420,16 +436,15 @@ class LogManager:
         """Check if there are new log messages since last check"""
         if self._log_pane_handler is None:
             return False
-        current_count = len(self._log_pane_handler.messages)
-        if current_count != self.last_message_count or self.has_new_messages:
-            return True
-        return False
+        # The generation keeps counting once the pane is full; the count would not
+        return self._log_pane_handler.generation != self._last_generation or self.has_new_messages
     
     def mark_log_updates_processed(self):
         """Mark that log updates have been processed (redraw completed)"""
         if self._log_pane_handler is None:
             return
         self.has_new_messages = False
+        self._last_generation = self._log_pane_handler.generation
         self.last_message_count = len(self._log_pane_handler.messages)
     
     def add_message(self, source, message):
@@ -536,7 +551,7 @@ class LogManager:
     @property
     def log_messages(self):
         """Live view of captured messages — the pane handler's ``(formatted,
-        record)`` deque. Backward-compatible accessor supporting ``len()``,
+        record)`` LogRing. Backward-compatible accessor supporting ``len()``,
         indexing, and ``clear()`` on the underlying store."""
         return self._log_pane_handler.messages if self._log_pane_handler else []
 
@@ -571,9 +586,7 @@ class LogManager:
         if self._log_pane_handler is None or display_height <= 0:
             return ""
         
-        # Get all messages
-        handler_messages = self._log_pane_handler.get_messages()
-        total_messages = len(handler_messages)
+        total_messages = len(self._log_pane_handler.messages)
         
         if total_messages == 0:
             return ""
@@ -586,7 +599,8 @@ class LogManager:
         start_idx = max(0, total_messages - display_height - scroll_offset)
         end_idx = min(total_messages, start_idx + display_height)
         
-        visible_messages = handler_messages[start_idx:end_idx]
+        # Format and copy only the visible rows
+        visible_messages = self._log_pane_handler.get_message_slice(start_idx, end_idx)
         
         # Extract formatted text from tuples
         lines = [formatted_msg for formatted_msg, record in visible_messages]
@@ -659,9 +673,25 @@ class LogManager:
         self.restore_stdio()
 
 
+def _file_logging_settings(config) -> Tuple[int, int, str]:
+    """``(max_bytes, backup_count, format)`` from the LOG_FILE_* settings of
+    ``config``, with LoggingConfig's defaults for missing or invalid values."""
+    defaults = LoggingConfig()
+    max_bytes = getattr(config, 'LOG_FILE_MAX_BYTES', None)
+    backup_count = getattr(config, 'LOG_FILE_BACKUP_COUNT', None)
+    log_format = getattr(config, 'LOG_FILE_FORMAT', None)
+    return (max(0, max_bytes) if isinstance(max_bytes, int) else defaults.file_logging_max_bytes,
+            max(0, backup_count) if isinstance(backup_count, int)
+            else defaults.file_logging_backup_count,
+            log_format if log_format in ('text', 'binary') else defaults.file_logging_format)
+
+
 # Module-level singleton instance
 _log_manager_instance: Optional[LogManager] = None
 
+# Log file handler of enable_file_logging(), added to every pending logger
+_file_handler: Optional[FileLoggingHandler] = None
+
 # Pending loggers dictionary - stores loggers created before LogManager initialization
 # Key: logger name, Value: logger instance
 _pending_loggers: Dict[str, logging.Logger] = {}
@@ -689,6 +719,34 @@ def set_log_manager(log_manager: LogManager):
     _pending_loggers.clear()
 
 
+def enable_file_logging(filename: str, config) -> FileLoggingHandler:
+    """
+    Write the records of every logger obtained with getLogger() to ``filename``.
+    
+    For an app that runs without a LogManager (the PuiKit app, whose loggers
+    stay pending). Rotation and format come from the LOG_FILE_* settings of
+    ``config``. Messages at WARNING and above still reach stderr, as they did
+    through ``logging.lastResort`` while the loggers had no handlers.
+    
+    Returns:
+        The handler; close it on exit to write out what is still queued
+    """
+    global _file_handler
+    max_bytes, backup_count, log_format = _file_logging_settings(config)
+    _file_handler = FileLoggingHandler(filename, max_bytes=max_bytes, backup_count=backup_count,
+                                       binary=log_format == 'binary')
+    for logger in _pending_loggers.values():
+        _add_file_handler(logger)
+    return _file_handler
+
+
+def _add_file_handler(logger: logging.Logger) -> None:
+    if _file_handler not in logger.handlers:
+        logger.addHandler(_file_handler)
+    if logging.lastResort is not None and logging.lastResort not in logger.handlers:
+        logger.addHandler(logging.lastResort)
+
+
 def getLogger(name: str) -> logging.Logger:
     """
     Get or create a logger with TFM handlers configured.
@@ -720,6 +778,8 @@ def getLogger(name: str) -> logging.Logger:
         logger.setLevel(logging.INFO)  # Default level, will be updated when LogManager is created
         logger.propagate = False
         # Don't add any handlers - they will be added when LogManager is initialized
+        if _file_handler is not None:
+            _add_file_handler(logger)
         
         # Store in pending loggers dictionary
         _pending_loggers[name] = logger
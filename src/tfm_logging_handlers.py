@@ -6,16 +6,37 @@ This module provides custom logging handlers that integrate Python's standard
 logging framework with TFM's unique requirements:
 - LogPaneHandler: Routes messages to TFM's visual log display
 - StreamOutputHandler: Routes messages to original stdout/stderr streams
-- FileLoggingHandler: Writes messages to a log file
+- FileLoggingHandler: Writes messages to a log file from a writer thread
+
+LogPaneHandler stores records in a LogRing, which worker threads append to
+without taking a lock, so debug logging from many threads does not contend
+with the UI thread that reads the pane.
 """
 
+import os
 import sys
 import threading
 import logging
-from datetime import datetime
 from collections import deque
-from typing import List, Tuple, Optional, Dict
+from datetime import datetime
+from itertools import count
+from typing import Callable, List, Tuple, Optional, Dict
 from tfm_const import LOG_TIME_FORMAT
+from tfm_log_format import MAGIC, BinaryLogEncoder, format_text_line
+
+# FileLoggingHandler defaults: records that may wait for the writer thread,
+# records that wake it early, and the longest a record waits
+FILE_LOG_QUEUE_SIZE = 65536
+FILE_LOG_BATCH_SIZE = 512
+FILE_LOG_FLUSH_INTERVAL = 0.1
+
+_HAS_WRITEV = hasattr(os, 'writev')
+try:
+    _IOV_MAX = os.sysconf('SC_IOV_MAX') if _HAS_WRITEV else 1024
+except (AttributeError, ValueError, OSError):
+    _IOV_MAX = 1024
+if _IOV_MAX <= 0:
+    _IOV_MAX = 1024
 
 
 def should_format_record(record: logging.LogRecord) -> bool:
@@ -38,15 +59,169 @@ def should_format_record(record: logging.LogRecord) -> bool:
     return not getattr(record, 'is_stream_capture', False)
 
 
+class LogRing:
+    """
+    Fixed-capacity ring of log records: many producers, one consumer.
+    
+    A producer claims a sequence number (``next()`` on an ``itertools.count``
+    is atomic under the GIL) and stores ``(seq, record, text)`` in its slot, a
+    single atomic store: no lock. The consumer (the UI thread) reads the slots whose
+    tag matches the expected sequence, so it never sees a half-claimed slot: it
+    stops at the first slot whose record is not stored yet, and skips ahead
+    when producers have lapped it. Only the newest ``capacity`` records are
+    kept.
+    
+    A record appended without its text is formatted lazily, on first read,
+    and the text is cached per slot. ``generation`` counts the records published so far (it keeps growing
+    after the ring is full), so a redraw can fetch only what is new with
+    :meth:`read_since`, and :meth:`get_slice` formats only the visible rows.
+    Consumer methods share a lock that producers never take.
+    """
+    
+    def __init__(self, capacity: int, format_record: Callable[[logging.LogRecord], str]):
+        """
+        Args:
+            capacity: Maximum records to retain (oldest overwritten when full)
+            format_record: Turns a record into its display text
+        """
+        self.capacity = max(1, capacity)
+        self._format = format_record
+        self._slots = [None] * self.capacity   # (seq, record, text or None)
+        self._texts = [None] * self.capacity   # (seq, text), filled on first read
+        self._claim = count()
+        self._newest = -1   # a recently claimed seq: a hint for catching up after a lap
+        self._start = 0     # oldest seq the consumer still shows
+        self._end = 0       # one past the newest seq the consumer has seen published
+        self._read_lock = threading.Lock()
+    
+    @property
+    def maxlen(self) -> int:
+        return self.capacity
+    
+    def append(self, record: logging.LogRecord, text: Optional[str] = None) -> None:
+        """Publish a record, with its display text if already formatted. Safe
+        from any thread; takes no lock."""
+        seq = next(self._claim)
+        self._slots[seq % self.capacity] = (seq, record, text)
+        self._newest = seq
+    
+    def _sync(self) -> None:
+        """Advance the consumer's view over newly published records. Caller
+        holds the read lock."""
+        capacity, slots = self.capacity, self._slots
+        end = self._end
+        while True:
+            slot = slots[end % capacity]
+            if slot is None or slot[0] < end:
+                break  # not stored yet
+            if slot[0] > end:
+                # Lapped: everything from here up to the newest claim is newer,
+                # so restart at the oldest record that can still be retained
+                end = max(end + 1, max(self._newest, slot[0]) - capacity + 1)
+                self._start = end
+                continue
+            end += 1
+        self._end = end
+        self._start = max(self._start, end - capacity)
+    
+    @property
+    def generation(self) -> int:
+        """Number of records published so far."""
+        with self._read_lock:
+            self._sync()
+            return self._end
+    
+    def __len__(self) -> int:
+        with self._read_lock:
+            self._sync()
+            return self._end - self._start
+    
+    def _entry(self, seq: int, formatted: bool) -> Optional[Tuple[Optional[str], logging.LogRecord]]:
+        """``(text, record)`` for ``seq``, or None once a producer overwrote it."""
+        index = seq % self.capacity
+        slot = self._slots[index]
+        if slot is None or slot[0] != seq:
+            return None
+        if slot[2] is not None:
+            return slot[2], slot[1]
+        cached = self._texts[index]
+        if cached is not None and cached[0] == seq:
+            return cached[1], slot[1]
+        if not formatted:
+            return None, slot[1]
+        text = self._format(slot[1])
+        self._texts[index] = (seq, text)
+        return text, slot[1]
+    
+    def _read(self, start: int, stop: int, formatted: bool) -> List[Tuple[Optional[str], logging.LogRecord]]:
+        entries = []
+        for seq in range(start, stop):
+            entry = self._entry(seq, formatted)
+            if entry is not None:
+                entries.append(entry)
+        return entries
+    
+    def get_slice(self, start: int, stop: int) -> List[Tuple[str, logging.LogRecord]]:
+        """
+        Formatted ``(text, record)`` rows ``start:stop`` of the retained
+        records (oldest first; negative indexes count from the newest). Only
+        the requested rows are formatted or copied.
+        """
+        with self._read_lock:
+            self._sync()
+            first, last, _ = slice(start, stop).indices(self._end - self._start)
+            return self._read(self._start + first, self._start + max(first, last), True)
+    
+    def read_since(self, generation: int) -> Tuple[int, List[Tuple[str, logging.LogRecord]]]:
+        """
+        Records published after ``generation`` (those still retained), formatted.
+        
+        Returns:
+            ``(generation, rows)``: pass the returned generation to the next call
+        """
+        with self._read_lock:
+            self._sync()
+            return self._end, self._read(max(generation, self._start), self._end, True)
+    
+    def snapshot(self, formatted: bool = True) -> List[Tuple[Optional[str], logging.LogRecord]]:
+        """All retained records as ``(text, record)``; with ``formatted=False``,
+        records not read yet have ``None`` for their text."""
+        with self._read_lock:
+            self._sync()
+            return self._read(self._start, self._end, formatted)
+    
+    def __iter__(self):
+        return iter(self.snapshot(formatted=False))
+    
+    def __getitem__(self, index):
+        if isinstance(index, slice):
+            return self.get_slice(index.start, index.stop)[::index.step]
+        entries = self.get_slice(index, index + 1 if index != -1 else None)
+        if not entries:
+            raise IndexError("log ring index out of range")
+        return entries[0]
+    
+    def clear(self) -> None:
+        """Forget the retained records (the generation keeps counting)."""
+        with self._read_lock:
+            self._sync()
+            self._start = self._end
+
+
 class LogPaneHandler(logging.Handler):
     """
-    Custom handler that stores log messages in a deque for display in TFM's log pane.
+    Custom handler that stores log messages in a LogRing for display in TFM's log pane.
     
     This handler distinguishes between:
     - Logger messages: Formatted with timestamp, logger name, level, and message
     - Stdout/stderr: Displayed as raw text without any formatting
     
     The distinction is made using the `is_stream_capture` attribute on LogRecord.
+    
+    Neither emit nor handle takes a lock (see LogRing). While the pane is
+    visible, the logging thread formats the record before storing it, so the UI
+    thread only reads text; while hidden, records are stored unformatted and
+    formatted when the pane first reads them.
     """
     
     def __init__(self, max_messages: int = 1000):
@@ -57,17 +232,28 @@ class LogPaneHandler(logging.Handler):
             max_messages: Maximum messages to retain (oldest discarded when limit reached)
         """
         super().__init__()
-        self.messages = deque(maxlen=max_messages)
-        self.lock = threading.RLock()  # Use RLock to allow recursive acquisition
+        self.messages = LogRing(max_messages, self._format_for_read)
         self.is_visible = True  # Track whether log pane is visible (Requirement 11.3)
+    
+    def handle(self, record: logging.LogRecord):
+        """
+        Filter and emit without the handler lock that logging.Handler.handle
+        takes: emit is safe to call from any number of threads at once.
+        """
+        rv = self.filter(record)
+        if isinstance(rv, logging.LogRecord):
+            record = rv
+        if rv:
+            self.emit(record)
+        return rv
         
     def emit(self, record: logging.LogRecord):
         """
         Process a log record and add to display queue.
         
-        Formatting is determined by record source:
-        - Logger API: Format with timestamp, name, level, message
-        - stdout/stderr: Display raw message without formatting (multi-line allowed)
+        Requirement 11.3: while the pane is not visible the record is stored
+        unformatted and formatted when the pane first reads it, so a record that
+        scrolls out of the ring unread is never formatted.
         
         Error handling: All exceptions are caught and logged to sys.__stderr__
         to prevent logging failures from crashing the application. The handler
@@ -77,28 +263,8 @@ class LogPaneHandler(logging.Handler):
             record: Log record to process
         """
         try:
-            # Requirement 11.3: Performance optimization - skip rendering when not visible
-            # Messages are still stored (for when pane becomes visible), but we skip
-            # expensive formatting operations when the log pane is not visible
-            if not self.is_visible:
-                # Still store the record for later display, but skip formatting
-                with self.lock:
-                    # Store unformatted - will be formatted when pane becomes visible
-                    self.messages.append((None, record))
-                return
-            
-            with self.lock:
-                if should_format_record(record):
-                    # Logger API: format with timestamp, name, level, message
-                    formatted = self.format_logger_message(record)
-                    self.messages.append((formatted, record))
-                else:
-                    # stdout/stderr: display raw message without formatting
-                    # Note: LogCapture already handles line buffering, so we receive
-                    # complete lines here. No need to split on newlines again.
-                    # Empty lines are meaningful output and should be preserved.
-                    raw_message = record.getMessage()
-                    self.messages.append((raw_message, record))
+            text = self.format_record(record) if self.is_visible else None
+            self.messages.append(record, text)
         except Exception as e:
             # Requirement 12.1: Handler failure isolation
             # Requirement 12.5: Log errors using fallback mechanism
@@ -111,6 +277,33 @@ class LogPaneHandler(logging.Handler):
                 # Even fallback failed, but continue silently
                 pass
     
+    def format_record(self, record: logging.LogRecord) -> str:
+        """
+        Display text for a record.
+        
+        Formatting is determined by record source:
+        - Logger API: Format with timestamp, name, level, message
+        - stdout/stderr: Raw message without formatting (multi-line allowed).
+          LogCapture already handles line buffering, and empty lines are
+          meaningful output, so the message is kept as is.
+        """
+        if should_format_record(record):
+            return self.format_logger_message(record)
+        return record.getMessage()
+    
+    def _format_for_read(self, record: logging.LogRecord) -> str:
+        """format_record for a record stored while hidden; a failure falls back
+        to the raw message instead of losing the row."""
+        try:
+            return self.format_record(record)
+        except Exception as e:
+            try:
+                sys.__stderr__.write(f"[LogPaneHandler] Error formatting log record: {e}\n")
+                sys.__stderr__.flush()
+            except Exception:
+                pass
+            return str(record.msg)
+    
     def format_logger_message(self, record: logging.LogRecord) -> str:
         """
         Format a logger message with full formatting.
@@ -130,37 +323,38 @@ class LogPaneHandler(logging.Handler):
         """
         Get messages for display.
         
-        Formats any unformatted messages (those added while pane was not visible).
+        Formats any messages not read before.
         
         Returns:
             List of (formatted_message, record) tuples
         """
-        with self.lock:
-            # Format any unformatted messages (None in first element of tuple)
-            formatted_messages = []
-            for formatted_msg, record in self.messages:
-                if formatted_msg is None:
-                    # Format the message now
-                    if should_format_record(record):
-                        # Logger API: format with timestamp
-                        formatted = self.format_logger_message(record)
-                        formatted_messages.append((formatted, record))
-                    else:
-                        # stdout/stderr: display raw message
-                        # Note: LogCapture already handles line buffering
-                        # Empty lines are meaningful output and should be preserved.
-                        raw_message = record.getMessage()
-                        formatted_messages.append((raw_message, record))
-                else:
-                    formatted_messages.append((formatted_msg, record))
-            return formatted_messages
+        return self.messages.snapshot()
+    
+    def get_messages_since(self, generation: int) -> Tuple[int, List[Tuple[str, logging.LogRecord]]]:
+        """
+        Get only the messages logged after ``generation``.
+        
+        Returns:
+            (generation, messages): pass the generation to the next call
+        """
+        return self.messages.read_since(generation)
+    
+    def get_message_slice(self, start: int, stop: int) -> List[Tuple[str, logging.LogRecord]]:
+        """Get messages ``start:stop`` (oldest first), formatting only those."""
+        return self.messages.get_slice(start, stop)
+    
+    @property
+    def generation(self) -> int:
+        """Number of messages logged so far (keeps counting once the oldest
+        are discarded)."""
+        return self.messages.generation
     
     def set_visible(self, visible: bool):
         """
         Set whether the log pane is visible.
         
         When set to False, formatting operations are skipped for performance.
-        Messages are still stored and will be formatted when pane becomes visible.
+        Messages are still stored and will be formatted when the pane reads them.
         
         Args:
             visible: True if log pane is visible, False otherwise
@@ -275,26 +469,61 @@ class FileLoggingHandler(logging.Handler):
     Custom handler that writes log messages to a file.
     
     This handler:
-    - Writes formatted messages to a specified file
+    - Queues records on the logging thread and writes them from a writer thread
+    - Writes each batch with one writev() call
+    - Rotates the file by size (filename.1, filename.2, ...)
+    - Optionally writes the compact binary format of tfm_log_format
     - Handles file I/O errors gracefully
     - Formats messages consistently with other handlers
+    
+    emit() only appends the record to a bounded deque, so logging costs the
+    calling thread (often the UI thread) well under a microsecond in the
+    handler. Records are formatted on the writer thread, which wakes when a
+    batch has gathered or every flush_interval seconds. When the queue is full
+    the record is dropped and counted in ``dropped`` rather than blocking the
+    caller. flush() and close() write out everything queued.
+    
+    An existing file in the other format (text when writing binary, or the
+    reverse) is rotated away on open rather than appended to; it is kept as
+    filename.1 even when backup_count is 0.
     """
     
-    def __init__(self, filename: str):
+    def __init__(self, filename: str, max_bytes: int = 0, backup_count: int = 0,
+                 binary: bool = False, queue_size: int = FILE_LOG_QUEUE_SIZE,
+                 flush_interval: float = FILE_LOG_FLUSH_INTERVAL):
         """
         Initialize file logging handler.
         
         Args:
             filename: Path to log file
+            max_bytes: Rotate once the file would grow past this size (0 = never)
+            backup_count: Rotated files to keep (0 = truncate on rotation)
+            binary: Write the binary format of tfm_log_format instead of text
+            queue_size: Records that may wait for the writer before new ones are dropped
+            flush_interval: Longest a record waits for the writer, in seconds
         """
         super().__init__()
         self.filename = filename
+        self.max_bytes = max_bytes
+        self.backup_count = backup_count
+        self.binary = binary
+        self.queue_size = queue_size
+        self.flush_interval = flush_interval
         self.file_handle = None
-        self.lock = threading.RLock()
+        self.lock = threading.RLock()  # serializes draining, rotation and close
+        self.dropped = 0
+        self._drop_lock = threading.Lock()  # taken only when the queue is full
+        self._size = 0
+        self._encoder = BinaryLogEncoder() if binary else None
+        self._queue = deque()
+        self._batch_size = max(1, min(FILE_LOG_BATCH_SIZE, queue_size // 2))
+        self._wakeup = threading.Event()
+        self._closed = False
+        self._writer = None
         
         # Open file for writing (append mode)
         try:
-            self.file_handle = open(filename, 'a', encoding='utf-8')
+            self._open()
         except (OSError, IOError) as e:
             # Log error to fallback stream
             try:
@@ -302,55 +531,206 @@ class FileLoggingHandler(logging.Handler):
                 sys.__stderr__.flush()
             except:
                 pass
+            return
+        self._writer = threading.Thread(target=self._run, name="tfm-log-writer", daemon=True)
+        self._writer.start()
+    
+    def _open(self):
+        if self._format_differs():
+            self._shift_backups(max(1, self.backup_count))
+        self._open_file()
+    
+    def _open_file(self):
+        self.file_handle = open(self.filename, 'ab', buffering=0)
+        self._size = self.file_handle.seek(0, os.SEEK_END)
+        if self._encoder is not None:
+            self._encoder.reset()
+            if self._size == 0:
+                self._write_chunks([MAGIC])
+    
+    def handle(self, record: logging.LogRecord):
+        """
+        Filter and emit without the handler lock that logging.Handler.handle
+        takes: emit only appends to a deque, which is safe from any thread.
+        """
+        if not self.filters:
+            self.emit(record)
+            return True
+        rv = self.filter(record)
+        if isinstance(rv, logging.LogRecord):
+            record = rv
+        if rv:
+            self.emit(record)
+        return rv
     
     def emit(self, record: logging.LogRecord):
         """
-        Write log record to file.
+        Queue log record for the writer thread.
         
-        Formatting is determined by record source:
+        Formatting is determined by record source when the record is written:
         - Logger API: Write with full formatting (timestamp, name, level, message)
         - stdout/stderr: Write raw message without any formatting
         
-        Error handling: File write failures are logged to fallback stream.
-        The handler continues operating with remaining handlers even if this one fails.
+        The message is rendered on the writer thread, so arguments passed to a
+        logger call should not be mutated afterwards.
         
         Args:
             record: Log record to write
         """
-        if self.file_handle is None:
+        queue = self._queue
+        if len(queue) >= self.queue_size or self._writer is None:
+            if self._writer is not None:
+                with self._drop_lock:
+                    self.dropped += 1
             return
-        
-        try:
-            with self.lock:
-                if should_format_record(record):
-                    # Logger API: write with full formatting
-                    timestamp = datetime.fromtimestamp(record.created).strftime(LOG_TIME_FORMAT)
-                    formatted = f"{timestamp} [{record.name}] {record.levelname}: {record.getMessage()}"
-                    self.file_handle.write(formatted + '\n')
-                else:
-                    # stdout/stderr: write raw message without any formatting
-                    msg = record.getMessage()
-                    self.file_handle.write(msg)
-                    if not msg.endswith('\n'):
-                        self.file_handle.write('\n')
-                self.file_handle.flush()
-        except (OSError, IOError) as e:
-            # File write error - log to fallback stream
+        queue.append(record)
+        if len(queue) == self._batch_size:
+            self._wakeup.set()
+    
+    def _run(self):
+        """Writer thread: drain a batch when woken or every flush_interval."""
+        while not self._closed:
+            self._wakeup.wait(self.flush_interval)
+            self._wakeup.clear()
+            self.flush()
+    
+    def flush(self):
+        """Write out every queued record."""
+        with self.lock:
+            if self.file_handle is None:
+                if self._writer is None or self._closed:
+                    return
+                try:
+                    # A rotation left no file open: try again, keeping the queue
+                    self._open_file()
+                except (OSError, IOError):
+                    return
             try:
-                sys.__stderr__.write(f"[FileLoggingHandler] Error writing to log file: {e}\n")
-                sys.__stderr__.flush()
-            except:
-                pass
-        except Exception as e:
-            # Unexpected error - log to fallback stream
+                self._drain()
+            except (OSError, IOError) as e:
+                # File write error - log to fallback stream
+                try:
+                    sys.__stderr__.write(f"[FileLoggingHandler] Error writing to log file: {e}\n")
+                    sys.__stderr__.flush()
+                except:
+                    pass
+            except Exception as e:
+                # Unexpected error - log to fallback stream
+                try:
+                    sys.__stderr__.write(f"[FileLoggingHandler] Unexpected error: {e}\n")
+                    sys.__stderr__.flush()
+                except:
+                    pass
+    
+    def _drain(self):
+        """Encode the queued records and write them, rotating at max_bytes."""
+        queue = self._queue
+        popleft = queue.popleft
+        chunks = []
+        pending = 0
+        empty_size = len(MAGIC) if self._encoder is not None else 0
+        while queue:
+            record = popleft()
+            before = len(chunks)
+            try:
+                self._encode(record, chunks)
+            except Exception as e:
+                # A record that cannot be formatted is skipped, not the batch
+                del chunks[before:]
+                try:
+                    sys.__stderr__.write(f"[FileLoggingHandler] Error formatting log record: {e}\n")
+                    sys.__stderr__.flush()
+                except:
+                    pass
+                continue
+            if self.max_bytes:
+                added = sum(len(c) for c in chunks[before:])
+                if (self._size + pending + added > self.max_bytes
+                        and self._size + pending > empty_size):
+                    self._write_chunks(chunks[:before])
+                    self._rotate()
+                    if self._encoder is not None:
+                        # The new file defines the logger name again
+                        chunks = []
+                        self._encode(record, chunks)
+                    else:
+                        chunks = chunks[before:]
+                    pending = sum(len(c) for c in chunks)
+                else:
+                    pending += added
+        if chunks:
+            self._write_chunks(chunks)
+    
+    def _encode(self, record: logging.LogRecord, out: List[bytes]):
+        if self._encoder is not None:
+            self._encoder.encode(record, out)
+            return
+        is_stream_capture = not should_format_record(record)
+        out.append(format_text_line(record.created, record.name, record.levelname,
+                                    record.getMessage(), is_stream_capture).encode('utf-8'))
+    
+    def _write_chunks(self, chunks: List[bytes]):
+        """Write chunks with writev (IOV_MAX at a time), retrying short writes."""
+        fd = self.file_handle.fileno()
+        for i in range(0, len(chunks), _IOV_MAX):
+            part = chunks[i:i + _IOV_MAX]
+            total = sum(len(c) for c in part)
+            written = os.writev(fd, part) if _HAS_WRITEV else os.write(fd, b''.join(part))
+            if written < total:
+                rest = b''.join(part)[written:]
+                while rest:
+                    rest = rest[os.write(fd, rest):]
+            self._size += total
+    
+    def _format_differs(self) -> bool:
+        """True if the log file exists, is not empty and is not in this
+        handler's format (binary files start with MAGIC)."""
+        try:
+            with open(self.filename, 'rb') as f:
+                head = f.read(len(MAGIC))
+        except FileNotFoundError:
+            return False
+        return bool(head) and (head == MAGIC) != self.binary
+    
+    def _shift_backups(self, count: int):
+        """Shift filename -> filename.1 -> ... -> filename.<count>, or remove
+        filename when count is 0."""
+        if count > 0:
+            for i in range(count - 1, 0, -1):
+                source = f"{self.filename}.{i}"
+                if os.path.exists(source):
+                    os.replace(source, f"{self.filename}.{i + 1}")
+            os.replace(self.filename, f"{self.filename}.1")
+        else:
+            os.remove(self.filename)
+    
+    def _rotate(self):
+        """Shift filename -> filename.1 -> ... -> filename.<backup_count> and
+        reopen. If the rename or the reopen fails, the current file is reopened
+        for appending and rotation waits until another max_bytes is written."""
+        self.file_handle.close()
+        self.file_handle = None
+        try:
+            self._shift_backups(self.backup_count)
+            self._open()
+        except OSError as e:
             try:
-                sys.__stderr__.write(f"[FileLoggingHandler] Unexpected error: {e}\n")
+                sys.__stderr__.write(f"[FileLoggingHandler] Cannot rotate log file, appending: {e}\n")
                 sys.__stderr__.flush()
             except:
                 pass
+            if self.file_handle is None:
+                self._open_file()
+            self._size = 0
     
     def close(self):
-        """Close the log file."""
+        """Write out queued records, stop the writer and close the log file."""
+        self._closed = True
+        self._wakeup.set()
+        writer = self._writer
+        if writer is not None and writer is not threading.current_thread():
+            writer.join(timeout=5.0)
+        self.flush()
         with self.lock:
             if self.file_handle is not None:
                 try:
@@ -358,4 +738,5 @@ class FileLoggingHandler(logging.Handler):
                 except Exception:
                     pass
                 self.file_handle = None
+            self._writer = None
         super().close()
@@ -0,0 +1,446 @@
+#!/usr/bin/env python3
+"""
+TFM LRU Cache - Bounded key/value store shared by S3Cache, SSHCache and
+ArchiveCache
+
+Each of those caches used to keep a plain dict of entries and find its LRU
+victim with ``min(..., key=last_access)``, and to answer an invalidation by
+scanning every key. Both are O(n) per call, so once a cache is full, every
+insert costs a full scan. ``LRUCache`` does the bookkeeping once:
+
+- **LRU order** — an ``OrderedDict`` is a hash index over an intrusive doubly
+  linked list (both in C): lookup, move-to-end on a hit and pop-oldest on
+  eviction are O(1).
+- **TTL wheel** — entries are bucketed by the second they expire in. Expired
+  entries are dropped on lookup, and ``purge_expired`` (run by every ``put``)
+  empties the due buckets, so expired entries don't hold space until the LRU
+  reaches them. Cost is proportional to what expires.
+- **Byte accounting** — each entry carries a caller-supplied size. With
+  ``max_bytes`` set, LRU entries are evicted until the total fits.
+- **Path index** — entries may be filed under a scope (a bucket, a host) and a
+  path. Each scope has a radix trie over its paths, so "everything under this
+  prefix" and "every entry whose path is a prefix of this one" cost O(length
+  of the path + matches) instead of a scan of the whole cache.
+
+The cache is not thread-safe; its owners already serialize access with their
+own locks.
+"""
+
+import heapq
+import sys
+import time
+from collections import OrderedDict
+from typing import Any, Callable, Dict, Hashable, Iterator, List, Optional, Tuple
+
+
+def estimate_size(value: Any, _depth: int = 2) -> int:
+    """Rough in-memory size of a cached value, for byte accounting: the value
+    plus its items, two levels deep. Good enough to tell a 10-entry listing
+    from a 10,000-entry one without walking whole object graphs."""
+    size = sys.getsizeof(value)
+    if _depth and isinstance(value, (list, tuple, set, frozenset)):
+        size += sum(estimate_size(item, _depth - 1) for item in value)
+    elif _depth and isinstance(value, dict):
+        size += sum(estimate_size(k, 0) + estimate_size(v, _depth - 1)
+                    for k, v in value.items())
+    return size
+
+
+class CacheEntry:
+    """One cached value and its bookkeeping."""
+
+    __slots__ = ('key', 'value', 'ttl', 'created', 'last_access', 'expires', 'size',
+                 'scope', 'path', 'tag', 'node')
+
+    def __init__(self, key, value, ttl, now, size, scope, path, tag):
+        self.key = key
+        self.value = value
+        self.ttl = ttl
+        self.created = now
+        self.last_access = now
+        self.expires = now + ttl if ttl is not None else None
+        self.size = size
+        self.scope = scope
+        self.path = path
+        self.tag = tag
+        self.node = None
+
+
+class _TrieNode:
+    """Radix-trie node: ``label`` is the edge from the parent, ``entries``
+    the cache entries filed under exactly this node's path."""
+
+    __slots__ = ('label', 'parent', 'children', 'entries')
+
+    def __init__(self, label: str, parent: Optional['_TrieNode']):
+        self.label = label
+        self.parent = parent
+        self.children: Dict[str, '_TrieNode'] = {}
+        self.entries: Dict[Hashable, CacheEntry] = {}
+
+
+class PathTrie:
+    """Radix trie of the paths in one scope."""
+
+    def __init__(self):
+        self.root = _TrieNode('', None)
+        self.count = 0
+
+    def insert(self, path: str) -> _TrieNode:
+        """The node for ``path``, created (splitting an edge) if needed."""
+        node, i, end = self.root, 0, len(path)
+        while i < end:
+            child = node.children.get(path[i])
+            if child is None:
+                leaf = _TrieNode(path[i:], node)
+                node.children[path[i]] = leaf
+                return leaf
+            label = child.label
+            if path.startswith(label, i):
+                node, i = child, i + len(label)
+                continue
+            # Split the edge where path and label part
+            j = 1
+            while j < len(label) and i + j < end and label[j] == path[i + j]:
+                j += 1
+            middle = _TrieNode(label[:j], node)
+            node.children[path[i]] = middle
+            child.label = label[j:]
+            child.parent = middle
+            middle.children[child.label[0]] = child
+            node, i = middle, i + j
+        return node
+
+    def find(self, prefix: str) -> Optional[_TrieNode]:
+        """The highest node whose path starts with ``prefix``, or None."""
+        node, i, end = self.root, 0, len(prefix)
+        while i < end:
+            child = node.children.get(prefix[i])
+            if child is None:
+                return None
+            label = child.label
+            if prefix.startswith(label, i):
+                node, i = child, i + len(label)
+            elif label.startswith(prefix[i:]):
+                return child  # prefix ends inside this edge
+            else:
+                return None
+        return node
+
+    def ancestors(self, path: str) -> Iterator[_TrieNode]:
+        """Nodes whose path is a prefix of ``path`` (including ``path`` and
+        the empty path), shallowest first."""
+        node, i, end = self.root, 0, len(path)
+        yield node
+        while i < end:
+            child = node.children.get(path[i])
+            if child is None or not path.startswith(child.label, i):
+                return
+            node, i = child, i + len(child.label)
+            yield node
+
+    @staticmethod
+    def subtree(node: _TrieNode) -> Iterator[_TrieNode]:
+        stack = [node]
+        while stack:
+            node = stack.pop()
+            yield node
+            stack.extend(node.children.values())
+
+    def prune(self, node: _TrieNode) -> None:
+        """Remove ``node`` if it no longer holds anything, merging edges so the
+        trie stays compressed."""
+        while node.parent is not None and not node.entries:
+            parent = node.parent
+            if not node.children:
+                del parent.children[node.label[0]]
+                node = parent
+                continue
+            if len(node.children) == 1:
+                (child,) = node.children.values()
+                child.label = node.label + child.label
+                child.parent = parent
+                parent.children[child.label[0]] = child
+            return
+
+
+class LRUCache:
+    """O(1) LRU cache with per-entry TTL, byte accounting and a per-scope path
+    index. See the module docstring.
+
+    Args:
+        max_entries: Entry limit (0 for none)
+        max_bytes: Limit on the sum of entry sizes (0 for none)
+        on_evict: Called with each entry removed for any reason other than a
+            ``put`` replacing it (eviction, expiry, invalidation, ``clear``)
+        granularity: Width of a TTL wheel bucket, in seconds
+    """
+
+    def __init__(self, max_entries: int = 1000, max_bytes: int = 0,
+                 on_evict: Optional[Callable[[CacheEntry], None]] = None,
+                 granularity: float = 1.0):
+        self.max_entries = max_entries
+        self.max_bytes = max_bytes
+        self.on_evict = on_evict
+        self._granularity = granularity
+        self._entries: 'OrderedDict[Hashable, CacheEntry]' = OrderedDict()
+        self._bytes = 0
+        self._tries: Dict[Any, PathTrie] = {}
+        # TTL wheel: bucket number -> {key: entry}, and a heap of bucket numbers
+        self._wheel: Dict[int, Dict[Hashable, CacheEntry]] = {}
+        self._due: List[int] = []
+        self.evictions = 0
+        self.expirations = 0
+
+    # --- lookup ------------------------------------------------------------------
+
+    def __len__(self) -> int:
+        return len(self._entries)
+
+    def __contains__(self, key) -> bool:
+        return key in self._entries
+
+    def __iter__(self) -> Iterator[Hashable]:
+        return iter(self._entries)
+
+    def items(self) -> Iterator[Tuple[Hashable, Any]]:
+        """(key, value) pairs, least recently used first."""
+        return ((key, entry.value) for key, entry in self._entries.items())
+
+    def values(self) -> Iterator[Any]:
+        return (entry.value for entry in self._entries.values())
+
+    def entries(self) -> Iterator[CacheEntry]:
+        return iter(self._entries.values())
+
+    @property
+    def total_bytes(self) -> int:
+        return self._bytes
+
+    def get_entry(self, key, now: Optional[float] = None,
+                  refresh_ttl: bool = False) -> Optional[CacheEntry]:
+        """The live entry for ``key``, marked most recently used, or None. An
+        expired entry is removed. ``refresh_ttl`` restarts the entry's TTL
+        (expiry measured from last access rather than from insertion)."""
+        entry = self._entries.get(key)
+        if entry is None:
+            return None
+        now = time.time() if now is None else now
+        if entry.expires is not None and now > entry.expires:
+            self._remove(entry)
+            self.expirations += 1
+            if self.on_evict:
+                self.on_evict(entry)
+            return None
+        self._entries.move_to_end(key)
+        entry.last_access = now
+        if refresh_ttl and entry.ttl is not None:
+            self._unschedule(entry)
+            entry.expires = now + entry.ttl
+            self._schedule(entry)
+        return entry
+
+    def get(self, key, default=None, now: Optional[float] = None):
+        entry = self.get_entry(key, now)
+        return default if entry is None else entry.value
+
+    # --- insertion ---------------------------------------------------------------
+
+    def put(self, key, value, ttl: Optional[float] = None, size: int = 0,
+            scope=None, path: Optional[str] = None, tag=None,
+            now: Optional[float] = None, evict: bool = True) -> CacheEntry:
+        """Store ``value`` under ``key``, evicting least recently used entries
+        to stay within the limits. ``ttl`` None never expires. An entry with a
+        ``path`` is indexed under ``scope`` for the prefix queries.
+        ``evict=False`` leaves the limits to a later :meth:`enforce_limits`,
+        for a batch stored together."""
+        now = time.time() if now is None else now
+        old = self._entries.get(key)
+        if old is not None:
+            self._remove(old)
+        self.purge_expired(now)
+        entry = CacheEntry(key, value, ttl, now, size, scope, path, tag)
+        self._entries[key] = entry
+        self._bytes += size
+        if path is not None:
+            trie = self._tries.get(scope)
+            if trie is None:
+                trie = self._tries[scope] = PathTrie()
+            entry.node = trie.insert(path)
+            entry.node.entries[key] = entry
+            trie.count += 1
+        self._schedule(entry)
+        if evict:
+            self.enforce_limits(keep=(key,))
+        return entry
+
+    def enforce_limits(self, keep=()) -> None:
+        """Evict least recently used entries until the limits hold, stopping
+        at the first key in ``keep``: what was just stored is never evicted,
+        even if that leaves the cache over its limits until the next put."""
+        while ((self.max_entries and len(self._entries) > self.max_entries)
+               or (self.max_bytes and self._bytes > self.max_bytes)):
+            key = next(iter(self._entries))
+            if key in keep:
+                break
+            self.evict_lru()
+
+    def evict_lru(self) -> Optional[CacheEntry]:
+        """Remove and return the least recently used entry."""
+        if not self._entries:
+            return None
+        _, entry = self._entries.popitem(last=False)
+        self._detach(entry)
+        self.evictions += 1
+        if self.on_evict:
+            self.on_evict(entry)
+        return entry
+
+    # --- removal -----------------------------------------------------------------
+
+    def pop(self, key) -> Optional[CacheEntry]:
+        """Remove ``key`` (calling ``on_evict``) and return its entry."""
+        entry = self._entries.get(key)
+        if entry is None:
+            return None
+        self._remove(entry)
+        if self.on_evict:
+            self.on_evict(entry)
+        return entry
+
+    def remove_entries(self, entries) -> int:
+        """Remove each of ``entries``; returns how many were still present."""
+        removed = 0
+        for entry in list(entries):
+            if self._entries.get(entry.key) is entry:
+                self.pop(entry.key)
+                removed += 1
+        return removed
+
+    def clear(self) -> None:
+        entries = list(self._entries.values()) if self.on_evict else ()
+        self._entries.clear()
+        self._tries.clear()
+        self._wheel.clear()
+        self._due.clear()
+        self._bytes = 0
+        for entry in entries:
+            self.on_evict(entry)
+
+    def _remove(self, entry: CacheEntry) -> None:
+        del self._entries[entry.key]
+        self._detach(entry)
+
+    def _detach(self, entry: CacheEntry) -> None:
+        """Drop ``entry`` from the byte total, path index and TTL wheel."""
+        self._bytes -= entry.size
+        node = entry.node
+        if node is not None:
+            del node.entries[entry.key]
+            trie = self._tries[entry.scope]
+            trie.count -= 1
+            if trie.count == 0:
+                del self._tries[entry.scope]
+            else:
+                trie.prune(node)
+            entry.node = None
+        self._unschedule(entry)
+
+    # --- TTL wheel ---------------------------------------------------------------
+
+    def _bucket(self, expires: float) -> int:
+        return int(expires // self._granularity)
+
+    def _schedule(self, entry: CacheEntry) -> None:
+        if entry.expires is None:
+            return
+        bucket = self._bucket(entry.expires)
+        slot = self._wheel.get(bucket)
+        if slot is None:
+            slot = self._wheel[bucket] = {}
+            heapq.heappush(self._due, bucket)
+        slot[entry.key] = entry
+
+    def _unschedule(self, entry: CacheEntry) -> None:
+        if entry.expires is None:
+            return
+        bucket = self._bucket(entry.expires)
+        slot = self._wheel.get(bucket)
+        if slot is not None:
+            slot.pop(entry.key, None)
+            if not slot:
+                del self._wheel[bucket]  # its heap id is skipped when due
+
+    def purge_expired(self, now: Optional[float] = None) -> int:
+        """Remove every entry that has expired by ``now``; returns the count."""
+        now = time.time() if now is None else now
+        current = self._bucket(now)
+        purged = 0
+        while self._due and self._due[0] <= current:
+            bucket = self._due[0]
+            slot = self._wheel.get(bucket)
+            if slot:
+                for entry in [e for e in slot.values() if now > e.expires]:
+                    self._remove(entry)
+                    self.expirations += 1
+                    purged += 1
+                    if self.on_evict:
+                        self.on_evict(entry)
+                if slot and bucket == current:
+                    break  # the rest of this bucket expires later this tick
+            heapq.heappop(self._due)
+            self._wheel.pop(bucket, None)
+        return purged
+
+    def expired_count(self, now: Optional[float] = None) -> int:
+        """How many entries have expired but not yet been purged."""
+        now = time.time() if now is None else now
+        current = self._bucket(now)
+        return sum(1 for bucket in self._due if bucket <= current
+                   for entry in self._wheel.get(bucket, {}).values() if now > entry.expires)
+
+    # --- path index --------------------------------------------------------------
+
+    def scope_entries(self, scope) -> List[CacheEntry]:
+        """Every entry filed under ``scope``."""
+        trie = self._tries.get(scope)
+        if trie is None:
+            return []
+        return [entry for node in trie.subtree(trie.root) for entry in node.entries.values()]
+
+    def entries_at(self, scope, path: str) -> List[CacheEntry]:
+        """Entries whose path is exactly ``path``."""
+        trie = self._tries.get(scope)
+        if trie is None:
+            return []
+        node = trie.find(path)
+        if node is None or node is not trie.root and not self._node_path_is(node, path):
+            return []
+        return list(node.entries.values())
+
+    def entries_with_prefix(self, scope, prefix: str) -> List[CacheEntry]:
+        """Entries whose path starts with ``prefix``."""
+        trie = self._tries.get(scope)
+        if trie is None:
+            return []
+        node = trie.find(prefix)
+        if node is None:
+            return []
+        return [entry for sub in trie.subtree(node) for entry in sub.entries.values()]
+
+    def entries_on_path(self, scope, path: str) -> List[CacheEntry]:
+        """Entries whose path is a prefix of ``path`` (``path`` included)."""
+        trie = self._tries.get(scope)
+        if trie is None:
+            return []
+        return [entry for node in trie.ancestors(path) for entry in node.entries.values()]
+
+    @staticmethod
+    def _node_path_is(node: _TrieNode, path: str) -> bool:
+        """Whether ``node`` sits exactly at ``path`` (``find`` may stop on an
+        edge that only starts with it)."""
+        length = 0
+        while node.parent is not None:
+            length += len(node.label)
+            node = node.parent
+        return length == len(path)
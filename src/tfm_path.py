@@ -13,8 +13,16 @@ from pathlib import Path as PathlibPath, PurePath
 from datetime import datetime
 from typing import Union, Iterator, List, Optional, Any
 from tfm_str_format import format_size
+from tfm_ssh_connection import SSHError
 
+try:
+    from botocore.exceptions import ClientError as _S3ClientError
+except ImportError:
+    _S3ClientError = None
 
+#: What an unreadable directory or file raises, per storage backend. Walks
+#: that skip such entries catch this rather than ``OSError`` alone.
+STORAGE_ERRORS = (OSError, SSHError) + ((_S3ClientError,) if _S3ClientError is not None else ())
 
 
 class PathImpl(ABC):
@@ -676,6 +684,31 @@ class LocalPathImpl(PathImpl):
         for item in self._path.iterdir():
             yield Path(item)
     
+    def iterdir_stat(self) -> Iterator[tuple]:
+        """iterdir() plus metadata from one scandir() pass: one stat per child
+        instead of a stat() and an is_dir() each"""
+        # pathlib's own iterdir() joins names without re-parsing them
+        child = getattr(self._path, '_make_child_relpath', self._path.joinpath)
+        with os.scandir(self._path) as entries:
+            for entry in entries:
+                path = Path(child(entry.name))
+                try:
+                    st = entry.stat()
+                except OSError as e:
+                    yield path, {'name': entry.name, 'error': str(e)}
+                    continue
+                mode = st.st_mode
+                yield path, {
+                    'name': entry.name,
+                    'size': st.st_size,
+                    'mtime': st.st_mtime,
+                    'mode': mode,
+                    'is_dir': stat.S_ISDIR(mode),
+                    'is_file': stat.S_ISREG(mode),
+                    'is_symlink': entry.is_symlink(),
+                    'stat': st,
+                }
+    
     def glob(self, pattern: str) -> Iterator['Path']:
         """Iterate over this subtree and yield all existing files matching pattern"""
         for item in self._path.glob(pattern):
@@ -1143,6 +1176,65 @@ class Path:
     def iterdir(self) -> Iterator['Path']:
         """Iterate over the files in this directory"""
         return self._impl.iterdir()
+
+    def iterdir_pages(self) -> Optional[Iterator[list]]:
+        """
+        Paged directory listing, for storage that lists a large directory in
+        several round-trips.
+    
+        Returns:
+            None if the storage lists in one go (use iterdir()), else an iterator
+            of lists of Paths, one per page as it arrives
+        """
+        if hasattr(self._impl, 'iterdir_pages'):
+            return self._impl.iterdir_pages()
+        return None
+    
+    def scan_tree(self) -> Optional[Iterator[tuple]]:
+        """
+        Bulk recursive listing, for storage where walking with iterdir() costs
+        a round-trip per directory.
+        
+        Returns:
+            None if the storage has no bulk listing (walk with iterdir()), else an
+            iterator of (path, entry) for everything below this directory, where
+            entry is a dict with name, size, mtime, mode, is_dir, is_file and
+            is_symlink. Directories that could not be read are repeated with an
+            'error' key. Symlinks are not followed.
+        """
+        if hasattr(self._impl, 'scan_tree'):
+            return self._impl.scan_tree()
+        return None
+    
+    def iterdir_stat(self) -> Optional[Iterator[tuple]]:
+        """
+        Directory listing with each child's metadata, for storage that can
+        return both in one pass (a local scandir()).
+        
+        Returns:
+            None if the storage has no such listing (use iterdir() and stat()),
+            else an iterator of (path, entry) for the immediate children, where
+            entry is a dict with name, size, mtime, mode, is_dir, is_file and
+            is_symlink, or name and 'error' for a child that could not be
+            stat'ed. Like stat(), symlinks are followed. Local entries also
+            carry the child's os.stat_result as 'stat'.
+        """
+        if hasattr(self._impl, 'iterdir_stat'):
+            return self._impl.iterdir_stat()
+        return None
+    
+    def content_digest(self) -> Optional[str]:
+        """
+        SHA-256 hex digest of the file computed where it is stored, for storage
+        where reading the content means transferring it.
+        
+        Returns:
+            The digest, or None if the storage can't provide one (read the
+            content instead)
+        """
+        if hasattr(self._impl, 'content_digest'):
+            return self._impl.content_digest()
+        return None
     
     def glob(self, pattern: str) -> Iterator['Path']:
         """Iterate over this subtree and yield all existing files matching pattern"""
@@ -1478,26 +1570,21 @@ class Path:
             dest_scheme = destination.get_scheme()
             
             # Handle all cross-storage combinations with progress tracking
-            if source_scheme == 'file' and dest_scheme in ('s3', 'ssh'):
-                # Local → Remote (S3 or SSH)
-                # Read from local file and write to remote
-                with self.open('rb') as src:
-                    data = src.read()
+            if source_scheme == 'file' and dest_scheme == 'ssh':
+                # Local → SSH: streamed from the file, progress per chunk
+                destination._impl.upload_from_local(str(self), progress_callback)
                 
-                # Use progress-aware write if available and callback provided
-                if dest_scheme == 'ssh' and progress_callback:
-                    destination._impl.write_bytes_with_progress(data, progress_callback)
-                else:
-                    destination.write_bytes(data)
+            elif source_scheme == 'ssh' and dest_scheme == 'file':
+                # SSH → Local: streamed into the file, progress per chunk
+                self._impl.download_to_local(str(destination), progress_callback)
+                
+            elif source_scheme == 'file' and dest_scheme == 's3':
+                # Local → S3: multipart upload of file parts, progress per part
+                destination._impl.upload_from_local(str(self), progress_callback)
                     
-            elif source_scheme in ('s3', 'ssh') and dest_scheme == 'file':
-                # Remote → Local (S3 or SSH)
-                # Read from remote and write to local file
-                if source_scheme == 'ssh' and progress_callback:
-                    data = self._impl.read_bytes_with_progress(progress_callback)
-                else:
-                    data = self.read_bytes()
-                destination.write_bytes(data)
+            elif source_scheme == 's3' and dest_scheme == 'file':
+                # S3 → Local: concurrent ranged GETs into the file, progress per chunk
+                self._impl.download_to_local(str(destination), progress_callback)
                 
             elif source_scheme in ('s3', 'ssh') and dest_scheme in ('s3', 'ssh'):
                 # Remote → Remote (S3 or SSH)
@@ -17,6 +17,10 @@ import json
 from datetime import datetime
 from typing import Iterator, List, Dict, Any, Optional, Tuple
 from tfm_str_format import format_size
+from tfm_content_cache import ContentCache, get_content_cache
+from tfm_lru_cache import LRUCache, estimate_size
+from tfm_s3_transfer import (MultipartWriter, RangeReader, download_file, read_object,
+                             transfer_settings, upload_file)
 
 # Import the PathImpl base class
 try:
@@ -43,16 +47,23 @@ class S3Cache:
     Features:
     - Configurable cache TTL (default 60 seconds)
     - Thread-safe operations
-    - Partial cache invalidation
-    - LRU-style cache management
+    - Partial cache invalidation, indexed by bucket and key prefix
+    - O(1) LRU eviction (tfm_lru_cache.LRUCache)
     """
     
-    def __init__(self, default_ttl: int = 60, max_entries: int = 1000):
+    def __init__(self, default_ttl: int = 60, max_entries: int = 1000, max_bytes: int = 0):
         self.default_ttl = default_ttl
-        self.max_entries = max_entries
-        self._cache: Dict[str, Dict[str, Any]] = {}
+        self._cache = LRUCache(max_entries=max_entries, max_bytes=max_bytes)
         self._lock = threading.RLock()
     
+    @property
+    def max_entries(self) -> int:
+        return self._cache.max_entries
+    
+    @max_entries.setter
+    def max_entries(self, value: int):
+        self._cache.max_entries = value
+    
     def _generate_cache_key(self, operation: str, bucket: str, key: str = "", **kwargs) -> str:
         """Generate a unique cache key for the operation and parameters"""
         # Create a deterministic key from operation parameters
@@ -71,109 +82,54 @@ class S3Cache:
         cache_key = self._generate_cache_key(operation, bucket, key, **kwargs)
         
         with self._lock:
-            if cache_key not in self._cache:
-                return None
-            
-            entry = self._cache[cache_key]
-            current_time = time.time()
-            
-            # Check if entry has expired
-            if current_time - entry['timestamp'] > entry['ttl']:
-                del self._cache[cache_key]
-                return None
-            
-            # Update access time for LRU behavior
-            entry['last_access'] = current_time
-            return entry['data']
+            return self._cache.get(cache_key)
     
     def put(self, operation: str, bucket: str, key: str = "", data: Any = None, ttl: Optional[int] = None, **kwargs):
         """Store result in cache with optional custom TTL"""
         cache_key = self._generate_cache_key(operation, bucket, key, **kwargs)
-        current_time = time.time()
         
         with self._lock:
-            # Enforce max entries limit using LRU eviction
-            if len(self._cache) >= self.max_entries and cache_key not in self._cache:
-                self._evict_lru()
-            
-            self._cache[cache_key] = {
-                'data': data,
-                'timestamp': current_time,
-                'last_access': current_time,
-                'ttl': ttl or self.default_ttl,
-                'bucket': bucket,
-                'key': key,
-                'operation': operation
-            }
+            self._cache.put(cache_key, data, ttl=ttl or self.default_ttl,
+                            size=estimate_size(data), scope=bucket, path=key, tag=operation)
     
     def invalidate_bucket(self, bucket: str):
         """Invalidate all cache entries for a specific bucket"""
         with self._lock:
-            keys_to_remove = []
-            for cache_key, entry in self._cache.items():
-                if entry['bucket'] == bucket:
-                    keys_to_remove.append(cache_key)
-            
-            for key in keys_to_remove:
-                del self._cache[key]
+            self._cache.remove_entries(self._cache.scope_entries(bucket))
     
     def invalidate_key(self, bucket: str, key: str):
         """Invalidate cache entries for a specific S3 key and its parent directories"""
         with self._lock:
-            keys_to_remove = []
-            for cache_key, entry in self._cache.items():
-                if entry['bucket'] == bucket:
-                    # Invalidate exact key matches
-                    if entry['key'] == key:
-                        keys_to_remove.append(cache_key)
-                    # Invalidate parent directory listings
-                    elif entry['operation'] in ['list_objects_v2', 'head_bucket'] and key.startswith(entry['key']):
-                        keys_to_remove.append(cache_key)
-                    # Invalidate child directory listings if we're modifying a parent
-                    elif entry['key'].startswith(key.rstrip('/') + '/'):
-                        keys_to_remove.append(cache_key)
-            
-            for key in keys_to_remove:
-                del self._cache[key]
+            cache = self._cache
+            # Exact key matches
+            cache.remove_entries(cache.entries_at(bucket, key))
+            # Parent directory listings
+            cache.remove_entries(e for e in cache.entries_on_path(bucket, key)
+                                 if e.tag in ('list_objects_v2', 'head_bucket'))
+            # Child directory listings if we're modifying a parent
+            cache.remove_entries(cache.entries_with_prefix(bucket, key.rstrip('/') + '/'))
     
     def invalidate_prefix(self, bucket: str, prefix: str):
         """Invalidate all cache entries with keys starting with the given prefix"""
         with self._lock:
-            keys_to_remove = []
-            for cache_key, entry in self._cache.items():
-                if entry['bucket'] == bucket and entry['key'].startswith(prefix):
-                    keys_to_remove.append(cache_key)
-            
-            for key in keys_to_remove:
-                del self._cache[key]
+            self._cache.remove_entries(self._cache.entries_with_prefix(bucket, prefix))
     
     def clear(self):
         """Clear all cache entries"""
         with self._lock:
             self._cache.clear()
     
-    def _evict_lru(self):
-        """Evict the least recently used cache entry"""
-        if not self._cache:
-            return
-        
-        # Find the entry with the oldest last_access time
-        oldest_key = min(self._cache.keys(), 
-                        key=lambda k: self._cache[k]['last_access'])
-        del self._cache[oldest_key]
-    
     def get_stats(self) -> Dict[str, Any]:
         """Get cache statistics for monitoring"""
         with self._lock:
-            current_time = time.time()
-            expired_count = sum(1 for entry in self._cache.values() 
-                              if current_time - entry['timestamp'] > entry['ttl'])
-            
             return {
                 'total_entries': len(self._cache),
-                'expired_entries': expired_count,
+                'expired_entries': self._cache.expired_count(),
                 'max_entries': self.max_entries,
-                'default_ttl': self.default_ttl
+                'bytes': self._cache.total_bytes,
+                'evictions': self._cache.evictions,
+                'default_ttl': self.default_ttl,
+                'content_cache': get_content_cache().get_stats()
             }
 
 
@@ -218,7 +174,13 @@ class S3StatResult:
 
 
 class S3WriteFile:
-    """File-like object for writing to S3"""
+    """File-like object for writing to S3
+    
+    Small files are sent with one put_object on close. Once a full part has
+    been written the content goes up as a concurrent multipart upload while
+    writing continues (tfm_s3_transfer.MultipartWriter), so memory stays at a
+    few parts however large the file grows.
+    """
     
     def __init__(self, s3_client, bucket, key, mode, encoding=None, cache_invalidate_callback=None):
         self._s3_client = s3_client
@@ -226,14 +188,22 @@ class S3WriteFile:
         self._key = key
         self._mode = mode
         self._encoding = encoding or 'utf-8'
-        self._buffer = io.BytesIO() if 'b' in mode else io.StringIO()
+        self._writer = MultipartWriter(s3_client, bucket, key)
         self._closed = False
+        self._failed = False
         self._cache_invalidate_callback = cache_invalidate_callback
     
     def write(self, data):
         if self._closed:
             raise ValueError("I/O operation on closed file")
-        return self._buffer.write(data)
+        try:
+            if 'b' in self._mode:
+                return self._writer.write(data)
+            self._writer.write(data.encode(self._encoding))
+        except BaseException:
+            self._failed = True
+            raise
+        return len(data)
     
     def writelines(self, lines):
         for line in lines:
@@ -244,28 +214,27 @@ class S3WriteFile:
     
     def close(self):
         if not self._closed:
-            # Upload the content to S3
-            if 'b' in self._mode:
-                content = self._buffer.getvalue()
-            else:
-                content = self._buffer.getvalue().encode(self._encoding)
-            
-            self._s3_client.put_object(
-                Bucket=self._bucket,
-                Key=self._key,
-                Body=content
-            )
+            self._closed = True
+            if self._failed:
+                # Don't publish a file that is missing a failed write
+                self._writer.abort()
+                raise IOError(f"Write to s3://{self._bucket}/{self._key} failed; nothing was uploaded")
+            # Upload what is left and finish the upload
+            self._writer.close()
             
             # Invalidate cache after successful write
             if self._cache_invalidate_callback:
                 self._cache_invalidate_callback(self._key)
-            
-            self._closed = True
     
     def __enter__(self):
         return self
     
     def __exit__(self, exc_type, exc_val, exc_tb):
+        if exc_type is not None and not self._closed:
+            # Don't publish a half-written file
+            self._closed = True
+            self._writer.abort()
+            return
         self.close()
 
 
@@ -745,7 +714,21 @@ class S3PathImpl(PathImpl):
             if e.response['Error']['Code'] in ['404', 'NoSuchKey']:
                 raise FileNotFoundError(f"S3 object not found: {self._uri}")
             raise OSError(f"Failed to stat S3 object: {e}")
-    
+
+    def get_etag(self) -> Optional[str]:
+        """The object's ETag without quotes, or None for buckets, directories
+        and objects that can't be read"""
+        if not self._key or self._key.endswith('/'):
+            return None
+        if not self._etag_cached:
+            try:
+                response = self._cached_api_call('head_object', cache_key_override=self._key,
+                                                 Bucket=self._bucket, Key=self._key)
+            except ClientError:
+                return None
+            self._etag_cached = response.get('ETag')
+        return self._etag_cached.strip('"') if self._etag_cached else None
+
     def lstat(self):
         """Return the result of os.lstat() on this path"""
         return self.stat()  # S3 doesn't have symlinks, so lstat == stat
@@ -753,28 +736,35 @@ class S3PathImpl(PathImpl):
     # Directory operations
     def iterdir(self) -> Iterator['Path']:
         """Iterate over the files in this directory"""
-        try:
-            from .tfm_path import Path
-        except ImportError:
-            from tfm_path import Path
+        for page in self.iterdir_pages():
+            yield from page
+    
+    def iterdir_pages(self) -> Iterator[list]:
+        """
+        Iterate over this directory one ``list_objects_v2`` page at a time, so a
+        caller can show the first entries after a single round-trip instead of
+        waiting for a prefix with millions of keys to be listed in full.
+        
+        A cached complete listing comes back as one page. Otherwise the pages
+        are yielded as they arrive, and the complete listing is cached once the
+        last page has been read (not if the caller stops early).
+        """
+        if not self._key:
+            # List objects in bucket root
+            prefix = ''
+        else:
+            # List objects under this key
+            prefix = self._key.rstrip('/') + '/'
+        delimiter = '/'
+        
+        # Check if we have a cached complete directory listing first
+        cache_key_params = {
+            'prefix': prefix,
+            'delimiter': delimiter,
+            'complete_listing': True
+        }
         
         try:
-            if not self._key:
-                # List objects in bucket root
-                prefix = ''
-                delimiter = '/'
-            else:
-                # List objects under this key
-                prefix = self._key.rstrip('/') + '/'
-                delimiter = '/'
-            
-            # Check if we have a cached complete directory listing first
-            cache_key_params = {
-                'prefix': prefix,
-                'delimiter': delimiter,
-                'complete_listing': True
-            }
-            
             cached_listing = self._cache.get(
                 operation='list_objects_v2_complete',
                 bucket=self._bucket,
@@ -784,14 +774,16 @@ class S3PathImpl(PathImpl):
             
             if cached_listing is not None:
                 # Use cached complete listing - no API calls needed
-                yield from self._yield_paths_from_cached_listing(cached_listing)
+                yield list(self._paths_from_listing(cached_listing, prefix, set()))
                 return
             
-            # Cache miss - need to fetch from S3 and aggregate all pages
+            # Cache miss - stream the pages and aggregate them as they go by
             all_contents = []
             all_common_prefixes = []
+            # Subdirectories already yielded, so a directory marker object on a
+            # later page doesn't list the subdirectory a second time
+            seen_dirs = set()
             
-            # Use paginator to get all pages
             paginator = self._client.get_paginator('list_objects_v2')
             page_iterator = paginator.paginate(
                 Bucket=self._bucket,
@@ -799,10 +791,10 @@ class S3PathImpl(PathImpl):
                 Delimiter=delimiter
             )
             
-            # Aggregate all pages into complete listing
             for page in page_iterator:
                 all_contents.extend(page.get('Contents', []))
                 all_common_prefixes.extend(page.get('CommonPrefixes', []))
+                yield list(self._paths_from_listing(page, prefix, seen_dirs))
             
             # Create complete listing structure
             complete_listing = {
@@ -821,20 +813,22 @@ class S3PathImpl(PathImpl):
                 data=complete_listing,
                 **cache_key_params
             )
-            
-            # Yield paths from the complete listing
-            yield from self._yield_paths_from_cached_listing(complete_listing)
         
         except ClientError as e:
             raise OSError(f"Failed to list S3 directory: {e}")
     
-    def _yield_paths_from_cached_listing(self, cached_listing):
-        """Yield Path objects from a cached complete directory listing"""
+    def _paths_from_listing(self, listing, prefix, seen_dirs):
+        """Yield Path objects from one listing page or a cached complete listing.
+        
+        ``seen_dirs`` carries the subdirectory keys yielded so far across the
+        pages of one listing.
+        """
         # Yield directories (common prefixes)
-        common_prefix_keys = set()
-        for prefix_info in cached_listing.get('CommonPrefixes', []):
+        for prefix_info in listing.get('CommonPrefixes', []):
             dir_key = prefix_info['Prefix'].rstrip('/')
-            common_prefix_keys.add(dir_key)
+            if dir_key in seen_dirs:
+                continue
+            seen_dirs.add(dir_key)
 
             # Create directory with metadata
             dir_metadata = {
@@ -850,53 +844,56 @@ class S3PathImpl(PathImpl):
             yield S3PathImpl.create_path_with_metadata(f's3://{self._bucket}/{dir_key}/', dir_metadata)
 
         # Yield files (objects) and cache their stat information
-        prefix = cached_listing.get('Prefix', '')
-        for obj in cached_listing.get('Contents', []):
+        for obj in listing.get('Contents', []):
             key = obj['Key']
-            # Skip the directory-marker object for a subdirectory that already
-            # appeared in CommonPrefixes, otherwise the subdirectory is listed
-            # twice (once as a prefix, once as its zero-byte marker object).
-            if key.endswith('/') and key.rstrip('/') in common_prefix_keys:
+            if key == prefix:  # Don't include the directory itself
                 continue
-            if key != prefix:  # Don't include the directory itself
-                # Extract metadata from S3 object
-                size = obj.get('Size', 0)
-                last_modified = obj.get('LastModified')
-                etag = obj.get('ETag', '')
-                storage_class = obj.get('StorageClass', 'STANDARD')
-                
-                # Determine if this is a directory marker (key ends with '/')
-                is_dir = key.endswith('/')
-                is_file = not is_dir
-                
-                # Create file metadata
-                file_metadata = {
-                    'is_dir': is_dir,
-                    'is_file': is_file,
-                    'size': size,
-                    'last_modified': last_modified or datetime.now(),
-                    'etag': etag,
-                    'storage_class': storage_class
-                }
-                
-                # Create a mock head_object response for caching (for backward compatibility)
-                head_response = {
-                    'ContentLength': size,
-                    'LastModified': last_modified or datetime.now(),
-                    'ETag': etag,
-                    'StorageClass': storage_class
-                }
-                
-                # Cache this as a head_object response to avoid future API calls
-                self._cache.put(
-                    operation='head_object',
-                    bucket=self._bucket,
-                    key=key,  # Use the file's actual key, not self._key
-                    data=head_response
-                )
-                
-                # Create Path with metadata
-                yield S3PathImpl.create_path_with_metadata(f's3://{self._bucket}/{key}', file_metadata)
+            # Determine if this is a directory marker (key ends with '/')
+            is_dir = key.endswith('/')
+            if is_dir:
+                # Skip the directory-marker object for a subdirectory that
+                # already appeared in CommonPrefixes, otherwise the subdirectory
+                # is listed twice (once as a prefix, once as its zero-byte
+                # marker object).
+                if key.rstrip('/') in seen_dirs:
+                    continue
+                seen_dirs.add(key.rstrip('/'))
+            is_file = not is_dir
+            
+            # Extract metadata from S3 object
+            size = obj.get('Size', 0)
+            last_modified = obj.get('LastModified')
+            etag = obj.get('ETag', '')
+            storage_class = obj.get('StorageClass', 'STANDARD')
+            
+            # Create file metadata
+            file_metadata = {
+                'is_dir': is_dir,
+                'is_file': is_file,
+                'size': size,
+                'last_modified': last_modified or datetime.now(),
+                'etag': etag,
+                'storage_class': storage_class
+            }
+            
+            # Create a mock head_object response for caching (for backward compatibility)
+            head_response = {
+                'ContentLength': size,
+                'LastModified': last_modified or datetime.now(),
+                'ETag': etag,
+                'StorageClass': storage_class
+            }
+            
+            # Cache this as a head_object response to avoid future API calls
+            self._cache.put(
+                operation='head_object',
+                bucket=self._bucket,
+                key=key,  # Use the file's actual key, not self._key
+                data=head_response
+            )
+            
+            # Create Path with metadata
+            yield S3PathImpl.create_path_with_metadata(f's3://{self._bucket}/{key}', file_metadata)
     
     def glob(self, pattern: str) -> Iterator['Path']:
         """Iterate over this subtree and yield all existing files matching pattern"""
@@ -936,6 +933,19 @@ class S3PathImpl(PathImpl):
             return S3WriteFile(self._client, self._bucket, self._key, mode, encoding, 
                              cache_invalidate_callback=self._invalidate_cache_for_write)
         else:
+            size, etag = self._size_and_etag()
+            content_key = self._content_key(size, etag)
+            reader = get_content_cache().open(content_key) if content_key else None
+            if reader is None and size is not None and size >= transfer_settings()[1]:
+                # Large object - stream it through prefetched ranged GETs
+                raw = RangeReader(self._client, self._bucket, self._key, size, etag)
+                reader = io.BufferedReader(raw, buffer_size=1024 * 1024)
+            if reader is not None:
+                # Cached on disk (read from the mapped copy) or streamed
+                if 'b' in mode:
+                    return reader
+                return io.TextIOWrapper(reader, encoding=encoding or 'utf-8',
+                                        errors=errors, newline=newline)
             # Read mode - use read_bytes() which handles caching properly
             try:
                 content = self.read_bytes()
@@ -968,30 +978,25 @@ class S3PathImpl(PathImpl):
     def read_bytes(self) -> bytes:
         """Open the file in bytes mode, read it, and close the file"""
         try:
-            # Check if we have cached content bytes (not the response object)
-            cache_key_params = {'content_bytes': True}
-            cached_content = self._cache.get(
-                operation='get_object_content',
-                bucket=self._bucket,
-                key=self._key,
-                **cache_key_params
-            )
+            # Bodies are cached on disk by ETag and size, not in S3Cache
+            size, etag = self._size_and_etag()
+            content_key = self._content_key(size, etag)
+            cache = get_content_cache()
+            if content_key:
+                cached_content = cache.read(content_key)
+                if cached_content is not None:
+                    return cached_content
             
-            if cached_content is not None:
-                return cached_content
-            
-            # Cache miss - fetch from S3 and read the stream immediately
-            response = self._client.get_object(Bucket=self._bucket, Key=self._key)
-            content = response['Body'].read()
+            if size is not None and size >= transfer_settings()[1]:
+                # Large object - concurrent ranged GETs
+                content = read_object(self._client, self._bucket, self._key, size, etag)
+            else:
+                # Cache miss - fetch from S3 and read the stream immediately
+                response = self._client.get_object(Bucket=self._bucket, Key=self._key)
+                content = response['Body'].read()
             
-            # Cache the actual bytes content, not the response object
-            self._cache.put(
-                operation='get_object_content',
-                bucket=self._bucket,
-                key=self._key,
-                data=content,
-                **cache_key_params
-            )
+            if content_key:
+                cache.put(content_key, content)
             
             return content
         except ClientError as e:
@@ -999,6 +1004,66 @@ class S3PathImpl(PathImpl):
                 raise FileNotFoundError(f"S3 object not found: {self._uri}")
             raise OSError(f"Failed to read S3 object: {e}")
     
+    def _content_key(self, size: Optional[int], etag: Optional[str]) -> Optional[str]:
+        """Key of this version of the object in the disk content cache, or None
+        when its ETag or size is unknown"""
+        if size is None or not etag or self._key.endswith('/'):
+            return None
+        return ContentCache.version_key(f's3://{self._bucket}/{self._key}', etag, size)
+    
+    def _size_and_etag(self) -> Tuple[Optional[int], Optional[str]]:
+        """Size and ETag from listing metadata or a (cached) head_object;
+        (None, None) when unknown"""
+        size, etag = self._size_cached, self._etag_cached
+        if size is None:
+            try:
+                response = self._cached_api_call('head_object', cache_key_override=self._key,
+                                                 Bucket=self._bucket, Key=self._key)
+            except ClientError:
+                return None, None
+            size, etag = response.get('ContentLength'), response.get('ETag')
+        return (size if isinstance(size, int) else None), (etag if isinstance(etag, str) else None)
+    
+    def download_to_local(self, local_path: str, progress_callback: Optional[callable] = None) -> int:
+        """
+        Copy this object to a local path with concurrent ranged GETs, streamed
+        to disk without an in-memory copy.
+        
+        Args:
+            local_path: Local destination file
+            progress_callback: Optional callable that takes (bytes_transferred: int, total_bytes: int)
+        
+        Returns:
+            Number of bytes copied
+        """
+        size, etag = self._size_and_etag()
+        try:
+            return download_file(self._client, self._bucket, self._key, local_path,
+                                 progress_callback, size=size, etag=etag)
+        except ClientError as e:
+            if e.response['Error']['Code'] in ['404', 'NoSuchKey']:
+                raise FileNotFoundError(f"S3 object not found: {self._uri}")
+            raise OSError(f"Failed to read S3 object: {e}")
+    
+    def upload_from_local(self, local_path: str, progress_callback: Optional[callable] = None) -> int:
+        """
+        Replace this object with a local file's contents; large files go up as
+        a concurrent multipart upload.
+        
+        Args:
+            local_path: Local source file
+            progress_callback: Optional callable that takes (bytes_transferred: int, total_bytes: int)
+        
+        Returns:
+            Number of bytes copied
+        """
+        try:
+            size = upload_file(self._client, self._bucket, self._key, local_path, progress_callback)
+        except ClientError as e:
+            raise OSError(f"Failed to write S3 object: {e}")
+        self._invalidate_cache_for_write()
+        return size
+    
     def write_text(self, data: str, encoding=None, errors=None, newline=None) -> int:
         """Open the file in text mode, write to it, and close the file"""
         try:
@@ -0,0 +1,516 @@
+#!/usr/bin/env python3
+"""
+TFM S3 Transfer - Parallel ranged downloads and multipart uploads
+
+A single ``get_object`` streams an object over one connection, and reading it
+with ``Body.read()`` holds all of it in memory; a single ``put_object`` needs
+the whole body up front. For large objects both are slow and memory-hungry.
+This module splits them into parts:
+
+* Downloads fetch ``part_size`` byte ranges on ``concurrency`` threads. Each
+  range is streamed in ``_CHUNK`` pieces straight into its place in the
+  destination (a local file, or a buffer for ``read_object``), so memory stays
+  at about one chunk per thread. Every range asks for the ETag seen at the
+  start (``IfMatch``), so an object replaced mid-download fails instead of
+  producing a mix of two versions.
+* Uploads use a multipart upload with parts sent concurrently; each thread
+  holds one part. ``MultipartWriter`` does the same for data that arrives
+  through ``write()`` (``S3WriteFile``), blocking the writer once
+  ``concurrency`` parts are in flight.
+* ``RangeReader`` is a read-only file object that prefetches the next ranges
+  while the consumer works through the current one.
+
+Objects smaller than one part keep the single-request path. Progress goes to
+``progress_callback(bytes_done, bytes_total)`` on the calling thread, which is
+also where whatever the callback raises (a cancel) stops the transfer: the
+workers stop at their next chunk, a partial local file is removed and a
+multipart upload is aborted, then the exception propagates.
+
+``concurrency`` and ``part_size`` default to ``S3_TRANSFER_CONCURRENCY`` and
+``S3_TRANSFER_PART_SIZE``.
+"""
+
+import io
+import os
+import queue
+import threading
+from concurrent.futures import ThreadPoolExecutor
+from typing import Callable, Dict, List, Optional, Tuple
+
+#: Default part size; objects below it are moved with one request.
+PART_SIZE = 8 * 1024 * 1024
+#: S3 limits: at most 10,000 parts, each at least 5 MiB except the last.
+MAX_PARTS = 10000
+MIN_PART_SIZE = 5 * 1024 * 1024
+DEFAULT_CONCURRENCY = 8
+#: Read size while streaming a range, and the granularity of cancellation.
+_CHUNK = 1024 * 1024
+#: How long the coordinator waits for a result before refreshing progress.
+_POLL = 0.1
+
+
+class _Aborted(Exception):
+    """Raised inside a worker once the transfer is stopped."""
+
+
+def transfer_settings() -> Tuple[int, int]:
+    """``(concurrency, part_size)`` from the configuration."""
+    try:
+        try:
+            from .tfm_config import get_config
+        except ImportError:
+            from tfm_config import get_config
+        config = get_config()
+    except Exception:
+        config = None
+    concurrency = getattr(config, 'S3_TRANSFER_CONCURRENCY', DEFAULT_CONCURRENCY)
+    part_size = getattr(config, 'S3_TRANSFER_PART_SIZE', PART_SIZE)
+    try:
+        return max(1, int(concurrency)), max(MIN_PART_SIZE, int(part_size))
+    except (TypeError, ValueError):
+        return DEFAULT_CONCURRENCY, PART_SIZE
+
+
+def part_size_for(size: int, part_size: int = PART_SIZE) -> int:
+    """``part_size``, grown in whole MiB where ``size`` would need more than
+    ``MAX_PARTS`` parts."""
+    needed = -(-size // MAX_PARTS)
+    if needed <= part_size:
+        return part_size
+    mib = 1024 * 1024
+    return -(-needed // mib) * mib
+
+
+def _ranges(size: int, part_size: int) -> List[Tuple[int, int]]:
+    return [(start, min(size, start + part_size)) for start in range(0, size, part_size)]
+
+
+def _run_parts(parts: list, work: Callable, concurrency: int, total: int,
+               progress_callback: Optional[Callable[[int, int], None]]) -> list:
+    """
+    Run ``work(part, add_bytes, stop)`` for every part on ``concurrency``
+    threads and return the results in part order.
+
+    The calling thread reports progress and receives results. The first error,
+    from a worker or from ``progress_callback``, sets ``stop``, waits for the
+    workers and is raised.
+    """
+    todo = queue.Queue()
+    for index, part in enumerate(parts):
+        todo.put((index, part))
+    results = queue.Queue()
+    stop = threading.Event()
+    lock = threading.Lock()
+    done_bytes = [0]
+
+    def add_bytes(n: int) -> None:
+        if stop.is_set():
+            raise _Aborted()
+        with lock:
+            done_bytes[0] += n
+
+    def run_worker() -> None:
+        while not stop.is_set():
+            try:
+                index, part = todo.get_nowait()
+            except queue.Empty:
+                return
+            try:
+                results.put((index, work(part, add_bytes, stop), None))
+            except BaseException as e:  # noqa: BLE001 — handed to the caller
+                results.put((index, None, e))
+                return
+
+    workers = [threading.Thread(target=run_worker, daemon=True, name='tfm-s3-transfer')
+               for _ in range(min(concurrency, len(parts)))]
+    for worker in workers:
+        worker.start()
+    out = [None] * len(parts)
+    finished = 0
+    try:
+        while finished < len(parts):
+            try:
+                index, value, error = results.get(timeout=_POLL)
+            except queue.Empty:
+                if not any(worker.is_alive() for worker in workers) and results.empty():
+                    raise RuntimeError("S3 transfer workers exited early")
+            else:
+                if error is not None:
+                    raise error
+                out[index] = value
+                finished += 1
+            if progress_callback is not None:
+                with lock:
+                    current = done_bytes[0]
+                progress_callback(current, total)
+    finally:
+        stop.set()
+        for worker in workers:
+            worker.join()
+    return out
+
+
+def head(client, bucket: str, key: str) -> Tuple[int, Optional[str]]:
+    """``(size, etag)`` of an object."""
+    response = client.head_object(Bucket=bucket, Key=key)
+    return response.get('ContentLength', 0), response.get('ETag')
+
+
+def _get_range(client, bucket: str, key: str, start: int, end: int, etag: Optional[str]):
+    params = {'Bucket': bucket, 'Key': key, 'Range': f'bytes={start}-{end - 1}'}
+    if etag:
+        params['IfMatch'] = etag
+    return client.get_object(**params)['Body']
+
+
+def _stream_range(client, bucket, key, start, end, etag, sink, add_bytes) -> None:
+    body = _get_range(client, bucket, key, start, end, etag)
+    offset = start
+    try:
+        while offset < end:
+            chunk = body.read(min(_CHUNK, end - offset))
+            if not chunk:
+                raise IOError(f"S3 object {key} ended at byte {offset} of range {start}-{end}")
+            sink(offset, chunk)
+            offset += len(chunk)
+            add_bytes(len(chunk))
+    finally:
+        close = getattr(body, 'close', None)
+        if close is not None:
+            close()
+
+
+def download_file(client, bucket: str, key: str, local_path: str,
+                  progress_callback: Optional[Callable[[int, int], None]] = None,
+                  size: Optional[int] = None, etag: Optional[str] = None,
+                  concurrency: Optional[int] = None, part_size: Optional[int] = None) -> int:
+    """
+    Download an object to ``local_path`` with concurrent ranged GETs.
+
+    ``size`` / ``etag`` skip the initial ``head_object`` when the caller
+    already knows them. On failure or cancellation no partial file is left.
+
+    Returns:
+        Number of bytes written
+    """
+    default_concurrency, default_part = transfer_settings()
+    concurrency = concurrency or default_concurrency
+    part_size = part_size or default_part
+    if size is None:
+        size, etag = head(client, bucket, key)
+    part_size = part_size_for(size, part_size)
+
+    try:
+        if size < part_size:
+            body = client.get_object(Bucket=bucket, Key=key)['Body']
+            written = 0
+            with open(local_path, 'wb') as f:
+                while True:
+                    chunk = body.read(_CHUNK)
+                    if not chunk:
+                        break
+                    f.write(chunk)
+                    written += len(chunk)
+                    if progress_callback is not None:
+                        progress_callback(written, size)
+            return written
+
+        with open(local_path, 'wb') as f:
+            f.truncate(size)
+        local = threading.local()
+        handles = []
+        handles_lock = threading.Lock()
+
+        def sink(offset: int, chunk: bytes) -> None:
+            f = getattr(local, 'file', None)
+            if f is None:
+                f = local.file = open(local_path, 'r+b')
+                with handles_lock:
+                    handles.append(f)
+            f.seek(offset)
+            f.write(chunk)
+
+        def work(part, add_bytes, stop):
+            _stream_range(client, bucket, key, part[0], part[1], etag, sink, add_bytes)
+
+        try:
+            _run_parts(_ranges(size, part_size), work, concurrency, size, progress_callback)
+        finally:
+            for handle in handles:
+                handle.close()
+        return size
+    except BaseException:
+        try:
+            os.unlink(local_path)
+        except OSError:
+            pass
+        raise
+
+
+def read_object(client, bucket: str, key: str, size: int, etag: Optional[str] = None,
+                progress_callback: Optional[Callable[[int, int], None]] = None,
+                concurrency: Optional[int] = None, part_size: Optional[int] = None) -> bytes:
+    """Whole content of an object of ``size`` bytes, fetched as concurrent
+    ranges into one preallocated buffer."""
+    default_concurrency, default_part = transfer_settings()
+    concurrency = concurrency or default_concurrency
+    part_size = part_size_for(size, part_size or default_part)
+    buffer = bytearray(size)
+    view = memoryview(buffer)
+
+    def sink(offset: int, chunk: bytes) -> None:
+        view[offset:offset + len(chunk)] = chunk
+
+    def work(part, add_bytes, stop):
+        _stream_range(client, bucket, key, part[0], part[1], etag, sink, add_bytes)
+
+    _run_parts(_ranges(size, part_size), work, concurrency, size, progress_callback)
+    view.release()
+    return bytes(buffer)
+
+
+def _complete(client, bucket: str, key: str, upload_id: str, etags: List[str]) -> None:
+    client.complete_multipart_upload(
+        Bucket=bucket, Key=key, UploadId=upload_id,
+        MultipartUpload={'Parts': [{'ETag': etag, 'PartNumber': number}
+                                   for number, etag in enumerate(etags, 1)]})
+
+
+def _abort(client, bucket: str, key: str, upload_id: str) -> None:
+    try:
+        client.abort_multipart_upload(Bucket=bucket, Key=key, UploadId=upload_id)
+    except Exception:
+        pass  # the bucket's lifecycle rules clean up what remains
+
+
+def upload_file(client, bucket: str, key: str, local_path: str,
+                progress_callback: Optional[Callable[[int, int], None]] = None,
+                concurrency: Optional[int] = None, part_size: Optional[int] = None) -> int:
+    """
+    Upload ``local_path`` to an object, as a concurrent multipart upload once
+    it is at least one part long.
+
+    Returns:
+        Number of bytes uploaded
+    """
+    default_concurrency, default_part = transfer_settings()
+    concurrency = concurrency or default_concurrency
+    size = os.path.getsize(local_path)
+    part_size = part_size_for(size, part_size or default_part)
+    if size < part_size:
+        with open(local_path, 'rb') as f:
+            client.put_object(Bucket=bucket, Key=key, Body=f.read())
+        if progress_callback is not None:
+            progress_callback(size, size)
+        return size
+
+    upload_id = client.create_multipart_upload(Bucket=bucket, Key=key)['UploadId']
+
+    def work(part, add_bytes, stop):
+        number, (start, end) = part
+        with open(local_path, 'rb') as f:
+            f.seek(start)
+            data = f.read(end - start)
+        if stop.is_set():
+            raise _Aborted()
+        response = client.upload_part(Bucket=bucket, Key=key, UploadId=upload_id,
+                                      PartNumber=number, Body=data)
+        add_bytes(len(data))
+        return response['ETag']
+
+    try:
+        parts = list(enumerate(_ranges(size, part_size), 1))
+        etags = _run_parts(parts, work, concurrency, size, progress_callback)
+        _complete(client, bucket, key, upload_id, etags)
+    except BaseException:
+        _abort(client, bucket, key, upload_id)
+        raise
+    return size
+
+
+class MultipartWriter:
+    """
+    Upload data handed over in ``write()`` calls, part by part.
+
+    Nothing is sent until a full part has been written; ``close()`` on a
+    shorter stream makes one ``put_object``. Past that, each full part is
+    uploaded in the background and ``write()`` blocks while ``concurrency``
+    parts are in flight, so memory stays at about ``concurrency + 1`` parts.
+    """
+
+    def __init__(self, client, bucket: str, key: str,
+                 concurrency: Optional[int] = None, part_size: Optional[int] = None):
+        default_concurrency, default_part = transfer_settings()
+        self._client = client
+        self._bucket = bucket
+        self._key = key
+        self._concurrency = concurrency or default_concurrency
+        self._part_size = part_size or default_part
+        self._pending = bytearray()
+        self._upload_id: Optional[str] = None
+        self._pool: Optional[ThreadPoolExecutor] = None
+        self._slots = threading.BoundedSemaphore(self._concurrency)
+        self._futures: List = []
+        self._error: Optional[BaseException] = None
+        self._aborted = False
+        self.size = 0
+
+    def write(self, data: bytes) -> int:
+        self._raise_failure()
+        self._pending += data
+        self.size += len(data)
+        while len(self._pending) >= self._next_part_size():
+            part_size = self._next_part_size()
+            part = bytes(self._pending[:part_size])
+            del self._pending[:part_size]
+            self._submit(part)
+        return len(data)
+
+    def _next_part_size(self) -> int:
+        # The total size isn't known up front, so parts double every 2,000:
+        # 10,000 parts then hold 62,000 base parts (~480 GiB at 8 MiB)
+        return self._part_size << (len(self._futures) // (MAX_PARTS // 5))
+
+    def _submit(self, part: bytes) -> None:
+        if self._upload_id is None:
+            self._upload_id = self._client.create_multipart_upload(
+                Bucket=self._bucket, Key=self._key)['UploadId']
+            self._pool = ThreadPoolExecutor(self._concurrency, thread_name_prefix='tfm-s3-part')
+        self._slots.acquire()
+        self._raise_failure()
+        number = len(self._futures) + 1
+        self._futures.append(self._pool.submit(self._upload_part, number, part))
+
+    def _upload_part(self, number: int, part: bytes) -> str:
+        try:
+            return self._client.upload_part(Bucket=self._bucket, Key=self._key,
+                                            UploadId=self._upload_id, PartNumber=number,
+                                            Body=part)['ETag']
+        except BaseException as e:
+            self._error = e
+            raise
+        finally:
+            self._slots.release()
+
+    def _raise_failure(self) -> None:
+        if self._error is not None and not self._aborted:
+            self.abort()
+        if self._aborted:
+            raise self._error or IOError(f"Upload of {self._key} was aborted")
+
+    def close(self) -> None:
+        """Send what is left and finish the upload; after a failure, re-raise it."""
+        # Once aborted the part data is gone: a put_object now would
+        # replace the key with whatever little was left in _pending
+        self._raise_failure()
+        if self._upload_id is None:
+            self._client.put_object(Bucket=self._bucket, Key=self._key, Body=bytes(self._pending))
+            self._pending = bytearray()
+            return
+        try:
+            if self._pending:
+                self._submit(bytes(self._pending))
+                self._pending = bytearray()
+            etags = [future.result() for future in self._futures]
+            _complete(self._client, self._bucket, self._key, self._upload_id, etags)
+        except BaseException as e:
+            if self._error is None:
+                self._error = e
+            self.abort()
+            raise
+        finally:
+            self._pool.shutdown(wait=True)
+
+    def abort(self) -> None:
+        """Drop the upload; parts already sent are discarded by S3."""
+        if self._upload_id is not None:
+            for future in self._futures:
+                future.cancel()
+            self._pool.shutdown(wait=True)
+            _abort(self._client, self._bucket, self._key, self._upload_id)
+            self._upload_id = None
+            self._futures = []
+        self._pending = bytearray()
+        self._aborted = True
+
+
+class RangeReader(io.RawIOBase):
+    """
+    Sequential reader over an object that keeps up to ``concurrency`` ranges
+    in flight ahead of the read position. ``seek`` works, but restarts the
+    prefetch at the new position.
+    """
+
+    def __init__(self, client, bucket: str, key: str, size: int, etag: Optional[str] = None,
+                 concurrency: Optional[int] = None, part_size: Optional[int] = None):
+        super().__init__()
+        default_concurrency, default_part = transfer_settings()
+        self._client = client
+        self._bucket = bucket
+        self._key = key
+        self._size = size
+        self._etag = etag
+        self._concurrency = concurrency or default_concurrency
+        self._part_size = part_size or default_part
+        self._pool = ThreadPoolExecutor(self._concurrency, thread_name_prefix='tfm-s3-read')
+        self._pos = 0
+        self._ahead: Dict[int, object] = {}  # range start -> future of its bytes
+        self._current: Optional[Tuple[int, bytes]] = None
+
+    def readable(self) -> bool:
+        return True
+
+    def seekable(self) -> bool:
+        return True
+
+    def tell(self) -> int:
+        return self._pos
+
+    def seek(self, offset: int, whence: int = io.SEEK_SET) -> int:
+        base = {io.SEEK_SET: 0, io.SEEK_CUR: self._pos, io.SEEK_END: self._size}[whence]
+        self._pos = max(0, base + offset)
+        return self._pos
+
+    def _fetch(self, start: int) -> bytes:
+        end = min(self._size, start + self._part_size)
+        body = _get_range(self._client, self._bucket, self._key, start, end, self._etag)
+        try:
+            return body.read()
+        finally:
+            close = getattr(body, 'close', None)
+            if close is not None:
+                close()
+
+    def _range_at(self, start: int) -> bytes:
+        if self._current is not None and self._current[0] == start:
+            return self._current[1]
+        for begin in list(self._ahead):
+            if begin < start or begin >= start + self._concurrency * self._part_size:
+                self._ahead.pop(begin).cancel()
+        for n in range(self._concurrency):
+            begin = start + n * self._part_size
+            if begin < self._size and begin not in self._ahead:
+                self._ahead[begin] = self._pool.submit(self._fetch, begin)
+        data = self._ahead.pop(start).result()
+        self._current = (start, data)
+        return data
+
+    def readinto(self, buffer) -> int:
+        if self._pos >= self._size:
+            return 0
+        start = self._pos - self._pos % self._part_size
+        data = self._range_at(start)
+        offset = self._pos - start
+        if offset >= len(data):
+            raise IOError(f"S3 object {self._key} ended at byte {start + len(data)} of {self._size}")
+        n = min(len(buffer), len(data) - offset)
+        buffer[:n] = data[offset:offset + n]
+        self._pos += n
+        return n
+
+    def close(self) -> None:
+        if not self.closed:
+            for future in self._ahead.values():
+                future.cancel()
+            self._pool.shutdown(wait=True)
+        super().close()
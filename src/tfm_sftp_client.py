@@ -0,0 +1,684 @@
+"""
+TFM SFTP Client - A persistent SFTP version 3 session per host
+
+``SSHConnection`` used to start a new ``sftp -b -`` process for every
+operation and scrape its ``ls -la`` output. Each call paid a fork/exec, an SFTP
+handshake over the ControlMaster socket and a text parse that lost the
+seconds of every mtime. ``SFTPClient`` instead keeps one subsystem channel
+open (``ssh -s <host> sftp`` over the same ControlMaster socket) and speaks the
+binary protocol (draft-ietf-secsh-filexfer-02, the version OpenSSH serves):
+
+- every request carries an id and a reader thread hands each response to the
+  caller waiting on that id, so calls from several threads share the channel
+  and a transfer keeps up to ``MAX_REQUESTS`` READ / WRITE requests in flight;
+- ``SFTPReader`` / ``SFTPWriter`` stream a file through that window, so a
+  transfer goes straight between the channel and its destination with
+  per-chunk progress and no temporary copy;
+- attributes arrive as structured fields (size, permissions, mtime, ...)
+  instead of ``ls`` text;
+- the channel is just a pair of pipes, so the client runs unchanged over a
+  local ``sftp-server`` process (which is how the tests drive it).
+
+Failures surface as ``SFTPError`` carrying the protocol status code;
+``SFTPConnectionLost`` means the channel is gone and every pending request has
+been failed.
+"""
+
+import io
+import stat
+import struct
+import subprocess
+import threading
+from collections import deque
+from typing import Callable, Dict, List, NamedTuple, Optional, Tuple
+
+
+SFTP_VERSION = 3
+
+# Packet types
+FXP_INIT = 1
+FXP_VERSION = 2
+FXP_OPEN = 3
+FXP_CLOSE = 4
+FXP_READ = 5
+FXP_WRITE = 6
+FXP_LSTAT = 7
+FXP_FSTAT = 8
+FXP_SETSTAT = 9
+FXP_OPENDIR = 11
+FXP_READDIR = 12
+FXP_REMOVE = 13
+FXP_MKDIR = 14
+FXP_RMDIR = 15
+FXP_REALPATH = 16
+FXP_STAT = 17
+FXP_RENAME = 18
+FXP_STATUS = 101
+FXP_HANDLE = 102
+FXP_DATA = 103
+FXP_NAME = 104
+FXP_ATTRS = 105
+FXP_EXTENDED = 200
+
+# Status codes
+FX_OK = 0
+FX_EOF = 1
+FX_NO_SUCH_FILE = 2
+FX_PERMISSION_DENIED = 3
+FX_FAILURE = 4
+FX_BAD_MESSAGE = 5
+FX_NO_CONNECTION = 6
+FX_CONNECTION_LOST = 7
+FX_OP_UNSUPPORTED = 8
+
+_STATUS_NAMES = {
+    FX_EOF: "End of file",
+    FX_NO_SUCH_FILE: "No such file",
+    FX_PERMISSION_DENIED: "Permission denied",
+    FX_FAILURE: "Failure",
+    FX_BAD_MESSAGE: "Bad message",
+    FX_NO_CONNECTION: "No connection",
+    FX_CONNECTION_LOST: "Connection lost",
+    FX_OP_UNSUPPORTED: "Operation unsupported",
+}
+
+# OPEN flags
+FXF_READ = 0x01
+FXF_WRITE = 0x02
+FXF_CREAT = 0x08
+FXF_TRUNC = 0x10
+
+# Attribute flags
+_ATTR_SIZE = 0x01
+_ATTR_UIDGID = 0x02
+_ATTR_PERMISSIONS = 0x04
+_ATTR_ACMODTIME = 0x08
+_ATTR_EXTENDED = 0x80000000
+
+_POSIX_RENAME = b'posix-rename@openssh.com'
+
+
+class SFTPError(Exception):
+    """A request failed; ``code`` is the SFTP status code."""
+
+    def __init__(self, code: int, message: str = ""):
+        super().__init__(message or _STATUS_NAMES.get(code, f"SFTP status {code}"))
+        self.code = code
+
+
+class SFTPConnectionLost(SFTPError):
+    """The channel closed (or could not be started)."""
+
+    def __init__(self, message: str = "SFTP channel closed"):
+        super().__init__(FX_CONNECTION_LOST, message)
+
+
+class SFTPTimeout(SFTPError):
+    """No response arrived within the request timeout."""
+
+    def __init__(self, message: str = "SFTP request timed out"):
+        super().__init__(FX_NO_CONNECTION, message)
+
+
+class SFTPAttributes(NamedTuple):
+    """File attributes as sent by the server; absent fields are None."""
+    size: Optional[int] = None
+    uid: Optional[int] = None
+    gid: Optional[int] = None
+    permissions: Optional[int] = None
+    atime: Optional[int] = None
+    mtime: Optional[int] = None
+
+    @property
+    def is_dir(self) -> bool:
+        return self.permissions is not None and stat.S_ISDIR(self.permissions)
+
+    @property
+    def is_file(self) -> bool:
+        return self.permissions is not None and stat.S_ISREG(self.permissions)
+
+    @property
+    def is_symlink(self) -> bool:
+        return self.permissions is not None and stat.S_ISLNK(self.permissions)
+
+
+def _string(data: bytes) -> bytes:
+    return struct.pack('>I', len(data)) + data
+
+
+def _path(path: str) -> bytes:
+    # Names that aren't valid UTF-8 round-trip through surrogate escapes
+    return _string(path.encode('utf-8', 'surrogateescape'))
+
+
+def _decode_name(raw: bytes) -> str:
+    return raw.decode('utf-8', 'surrogateescape')
+
+
+class _Message:
+    """Read cursor over a response payload."""
+
+    __slots__ = ('data', 'pos')
+
+    def __init__(self, data: bytes, pos: int = 0):
+        self.data = data
+        self.pos = pos
+
+    def u32(self) -> int:
+        value = struct.unpack_from('>I', self.data, self.pos)[0]
+        self.pos += 4
+        return value
+
+    def u64(self) -> int:
+        value = struct.unpack_from('>Q', self.data, self.pos)[0]
+        self.pos += 8
+        return value
+
+    def string(self) -> bytes:
+        length = self.u32()
+        value = self.data[self.pos:self.pos + length]
+        if len(value) != length:
+            raise SFTPError(FX_BAD_MESSAGE, "Truncated SFTP packet")
+        self.pos += length
+        return value
+
+    def attrs(self) -> SFTPAttributes:
+        flags = self.u32()
+        size = self.u64() if flags & _ATTR_SIZE else None
+        uid = gid = None
+        if flags & _ATTR_UIDGID:
+            uid, gid = self.u32(), self.u32()
+        permissions = self.u32() if flags & _ATTR_PERMISSIONS else None
+        atime = mtime = None
+        if flags & _ATTR_ACMODTIME:
+            atime, mtime = self.u32(), self.u32()
+        if flags & _ATTR_EXTENDED:
+            for _ in range(self.u32()):
+                self.string()
+                self.string()
+        return SFTPAttributes(size, uid, gid, permissions, atime, mtime)
+
+
+class _Request:
+    """A sent request waiting for its response."""
+
+    __slots__ = ('event', 'type', 'payload')
+
+    def __init__(self):
+        self.event = threading.Event()
+        self.type = None
+        self.payload = b''
+
+
+class SFTPClient:
+    """One SFTP session over a subprocess's stdin / stdout.
+
+    Thread-safe: any number of threads may issue requests concurrently.
+    ``timeout`` bounds how long a metadata request waits for its response;
+    transfers wait without a limit, as the ``sftp`` tool does.
+    ``max_requests`` caps the READ / WRITE requests one transfer keeps in
+    flight; with ``CHUNK_SIZE`` it sets how much of the link's
+    bandwidth-delay product a single transfer can fill."""
+
+    #: Bytes per READ / WRITE request (what OpenSSH's sftp uses).
+    CHUNK_SIZE = 32 * 1024
+    #: READ / WRITE requests kept in flight per transfer (OpenSSH's default).
+    MAX_REQUESTS = 64
+
+    def __init__(self, process: subprocess.Popen, timeout: float = 30,
+                 max_requests: int = MAX_REQUESTS):
+        self._process = process
+        self.max_requests = max(1, max_requests)
+        self._stdin = process.stdin
+        self._stdout = process.stdout
+        self.timeout = timeout
+        self._send_lock = threading.Lock()
+        self._pending_lock = threading.Lock()
+        self._pending: Dict[int, _Request] = {}
+        self._next_id = 1
+        self._lost: Optional[str] = None
+        self._ready = threading.Event()
+        self.version = None
+        self.extensions: Dict[bytes, bytes] = {}
+
+        self._reader = threading.Thread(target=self._read_loop, name='tfm-sftp-reader', daemon=True)
+        self._reader.start()
+        try:
+            self._handshake()
+        except BaseException:
+            self.close()
+            raise
+
+    @classmethod
+    def spawn(cls, argv: List[str], timeout: float = 30,
+              max_requests: int = MAX_REQUESTS) -> 'SFTPClient':
+        """Start ``argv`` (``ssh ... -s host sftp`` or a local ``sftp-server``)
+        and open a session over its pipes."""
+        process = subprocess.Popen(
+            argv,
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+        )
+        return cls(process, timeout, max_requests)
+
+    # -- channel -----------------------------------------------------------------
+
+    def _handshake(self) -> None:
+        with self._send_lock:
+            self._stdin.write(struct.pack('>IBI', 5, FXP_INIT, SFTP_VERSION))
+            self._stdin.flush()
+        if not self._ready.wait(self.timeout):
+            raise SFTPTimeout("No SFTP version reply")
+        if self._lost is not None:
+            raise SFTPConnectionLost(self._lost)
+        if self.version is None or self.version < SFTP_VERSION:
+            raise SFTPError(FX_OP_UNSUPPORTED, f"Unsupported SFTP version: {self.version}")
+
+    def _read_exact(self, size: int) -> bytes:
+        data = self._stdout.read(size)
+        if len(data) != size:
+            raise EOFError("SFTP channel closed")
+        return data
+
+    def _read_loop(self) -> None:
+        reason = "SFTP channel closed"
+        try:
+            while True:
+                length, ptype = struct.unpack('>IB', self._read_exact(5))
+                payload = self._read_exact(length - 1)
+                if ptype == FXP_VERSION:
+                    msg = _Message(payload)
+                    self.version = msg.u32()
+                    while msg.pos < len(payload):
+                        name = msg.string()
+                        self.extensions[name] = msg.string()
+                    self._ready.set()
+                    continue
+                req_id = struct.unpack_from('>I', payload)[0]
+                with self._pending_lock:
+                    request = self._pending.pop(req_id, None)
+                if request is not None:
+                    request.type = ptype
+                    request.payload = payload
+                    request.event.set()
+        except Exception as e:
+            reason = str(e) or reason
+        finally:
+            with self._pending_lock:
+                self._lost = reason
+                pending = list(self._pending.values())
+                self._pending.clear()
+            for request in pending:
+                request.event.set()
+            self._ready.set()
+
+    @property
+    def alive(self) -> bool:
+        return self._lost is None
+
+    def close(self) -> None:
+        """End the session and its process."""
+        try:
+            self._stdin.close()
+        except Exception:
+            pass
+        try:
+            self._process.terminate()
+            self._process.wait(timeout=2)
+        except Exception:
+            try:
+                self._process.kill()
+            except Exception:
+                pass
+
+    # -- requests ----------------------------------------------------------------
+
+    def _send(self, ptype: int, payload: bytes) -> _Request:
+        request = _Request()
+        with self._send_lock:
+            with self._pending_lock:
+                if self._lost is not None:
+                    raise SFTPConnectionLost(self._lost)
+                req_id = self._next_id
+                self._next_id = (self._next_id % 0xFFFFFFFF) + 1
+                self._pending[req_id] = request
+            try:
+                self._stdin.write(struct.pack('>IBI', len(payload) + 5, ptype, req_id) + payload)
+                self._stdin.flush()
+            except (OSError, ValueError) as e:
+                with self._pending_lock:
+                    self._pending.pop(req_id, None)
+                raise SFTPConnectionLost(f"SFTP channel closed: {e}")
+        return request
+
+    def _wait(self, request: _Request, expected: int, timeout: Optional[float] = None) -> _Message:
+        """The response to ``request`` as a cursor past its id. A STATUS reply
+        raises ``SFTPError`` unless STATUS/OK is what ``expected`` allows."""
+        if not request.event.wait(timeout):
+            raise SFTPTimeout()
+        if request.type is None:
+            raise SFTPConnectionLost(self._lost or "SFTP channel closed")
+        msg = _Message(request.payload, 4)
+        if request.type == FXP_STATUS:
+            code = msg.u32()
+            if code == FX_OK and expected == FXP_STATUS:
+                return msg
+            try:
+                text = msg.string().decode('utf-8', 'replace')
+            except (SFTPError, struct.error):
+                text = ""
+            raise SFTPError(code, text)
+        if request.type != expected:
+            raise SFTPError(FX_BAD_MESSAGE, f"Unexpected SFTP response type {request.type}")
+        return msg
+
+    def _call(self, ptype: int, payload: bytes, expected: int) -> _Message:
+        return self._wait(self._send(ptype, payload), expected, self.timeout)
+
+    # -- metadata ----------------------------------------------------------------
+
+    def realpath(self, path: str) -> str:
+        msg = self._call(FXP_REALPATH, _path(path), FXP_NAME)
+        if msg.u32() < 1:
+            raise SFTPError(FX_BAD_MESSAGE, "Empty REALPATH reply")
+        return _decode_name(msg.string())
+
+    def stat(self, path: str) -> SFTPAttributes:
+        """Attributes of ``path``, following symlinks."""
+        return self._call(FXP_STAT, _path(path), FXP_ATTRS).attrs()
+
+    def lstat(self, path: str) -> SFTPAttributes:
+        """Attributes of ``path`` itself (a symlink is not followed)."""
+        return self._call(FXP_LSTAT, _path(path), FXP_ATTRS).attrs()
+
+    def listdir_attr(self, path: str) -> List[Tuple[str, SFTPAttributes]]:
+        """``(name, attributes)`` for every entry of directory ``path``,
+        including ``.`` and ``..`` when the server reports them. Attributes
+        describe the entries themselves, like ``lstat``."""
+        handle = self._call(FXP_OPENDIR, _path(path), FXP_HANDLE).string()
+        entries = []
+        try:
+            while True:
+                try:
+                    msg = self._call(FXP_READDIR, _string(handle), FXP_NAME)
+                except SFTPError as e:
+                    if e.code == FX_EOF:
+                        break
+                    raise
+                for _ in range(msg.u32()):
+                    name = _decode_name(msg.string())
+                    msg.string()  # longname: ls-style text, not needed
+                    entries.append((name, msg.attrs()))
+        finally:
+            self._close_handle(handle)
+        return entries
+
+    def utime(self, path: str, atime: int, mtime: int) -> None:
+        """Set the access and modification times of ``path`` (whole seconds)."""
+        attrs = struct.pack('>III', _ATTR_ACMODTIME, atime & 0xFFFFFFFF, mtime & 0xFFFFFFFF)
+        self._call(FXP_SETSTAT, _path(path) + attrs, FXP_STATUS)
+
+    def mkdir(self, path: str, mode: Optional[int] = None) -> None:
+        attrs = struct.pack('>II', _ATTR_PERMISSIONS, mode) if mode is not None else struct.pack('>I', 0)
+        self._call(FXP_MKDIR, _path(path) + attrs, FXP_STATUS)
+
+    def rmdir(self, path: str) -> None:
+        self._call(FXP_RMDIR, _path(path), FXP_STATUS)
+
+    def remove(self, path: str) -> None:
+        self._call(FXP_REMOVE, _path(path), FXP_STATUS)
+
+    def rename(self, old_path: str, new_path: str) -> None:
+        """Rename, replacing an existing target where the server supports
+        OpenSSH's posix-rename extension (as the ``sftp`` tool does)."""
+        if _POSIX_RENAME in self.extensions:
+            self._call(FXP_EXTENDED, _string(_POSIX_RENAME) + _path(old_path) + _path(new_path),
+                       FXP_STATUS)
+        else:
+            self._call(FXP_RENAME, _path(old_path) + _path(new_path), FXP_STATUS)
+
+    # -- file contents -----------------------------------------------------------
+
+    def _open(self, path: str, flags: int) -> bytes:
+        return self._call(FXP_OPEN, _path(path) + struct.pack('>II', flags, 0), FXP_HANDLE).string()
+
+    def _close_handle(self, handle: bytes) -> None:
+        try:
+            self._call(FXP_CLOSE, _string(handle), FXP_STATUS)
+        except SFTPConnectionLost:
+            pass
+
+    def open_read(self, path: str) -> 'SFTPReader':
+        """A streaming reader over ``path``; see ``SFTPReader``."""
+        handle = self._open(path, FXF_READ)
+        try:
+            size = self._call(FXP_FSTAT, _string(handle), FXP_ATTRS).attrs().size
+        except BaseException:
+            self._close_handle(handle)
+            raise
+        return SFTPReader(self, handle, size)
+
+    def open_write(self, path: str, size: Optional[int] = None,
+                   progress: Optional[Callable[[int, int], None]] = None) -> 'SFTPWriter':
+        """A streaming writer that creates or truncates ``path``; ``size`` is
+        only the total reported to ``progress``. See ``SFTPWriter``."""
+        return SFTPWriter(self, self._open(path, FXF_WRITE | FXF_CREAT | FXF_TRUNC), size, progress)
+
+    def read_file(self, path: str, progress: Optional[Callable[[int, int], None]] = None) -> bytes:
+        """The contents of ``path``. ``progress(done, total)`` is called as
+        data arrives."""
+        with self.open_read(path) as reader:
+            return reader.readall(progress)
+
+    def write_file(self, path: str, data: bytes,
+                   progress: Optional[Callable[[int, int], None]] = None) -> None:
+        """Create or truncate ``path`` and write ``data``. ``progress(done,
+        total)`` is called as the server acknowledges each write."""
+        with self.open_write(path, len(data), progress) as writer:
+            writer.write(data)
+
+
+class SFTPReader(io.RawIOBase):
+    """Sequential reads from an open remote file with read-ahead.
+
+    Up to ``window`` READ requests are kept in flight ahead of the consumer.
+    The window starts small (so sniffing the head of a file doesn't pull
+    megabytes) and doubles with every chunk consumed, up to the client's
+    ``max_requests``. Chunks are handed out in file order; a short read is
+    completed by re-requesting the rest of its range. When the size reported
+    by FSTAT is reached the file is considered complete (a zero size, as
+    ``/proc`` files report, reads until EOF)."""
+
+    #: READ requests in flight when the reader starts.
+    INITIAL_WINDOW = 4
+
+    def __init__(self, client: SFTPClient, handle: bytes, size: Optional[int]):
+        super().__init__()
+        self._client = client
+        self._handle = handle
+        self._handle_field = _string(handle)
+        self.size = size
+        self._limit = size or None
+        self._inflight = deque()
+        self._next_offset = 0
+        self._window = min(self.INITIAL_WINDOW, client.max_requests)
+        self._eof = False
+        self._chunk = b''
+        self._chunk_pos = 0
+        self.position = 0
+
+    def readable(self) -> bool:
+        return True
+
+    def _issue(self) -> None:
+        chunk_size = self._client.CHUNK_SIZE
+        while len(self._inflight) < self._window and not self._eof:
+            if self._limit is not None and self._next_offset >= self._limit:
+                return
+            length = chunk_size
+            if self._limit is not None:
+                length = min(length, self._limit - self._next_offset)
+            self._inflight.append((self._next_offset, length, self._request(self._next_offset, length)))
+            self._next_offset += length
+
+    def _request(self, offset: int, length: int) -> _Request:
+        return self._client._send(FXP_READ, self._handle_field + struct.pack('>QI', offset, length))
+
+    def read_chunk(self) -> bytes:
+        """The next chunk of the file as the server sent it (``b''`` at the
+        end). Consumes whatever ``read`` / ``readinto`` left buffered first."""
+        if self._chunk_pos < len(self._chunk):
+            data = self._chunk[self._chunk_pos:]
+            self._chunk = b''
+            self._chunk_pos = 0
+            return data
+        self._issue()
+        if not self._inflight:
+            return b''
+        offset, length, request = self._inflight.popleft()
+        try:
+            data = self._client._wait(request, FXP_DATA).string()
+        except SFTPError as e:
+            if e.code != FX_EOF:
+                raise
+            data = b''
+        if not data:
+            self._eof = True
+            self._inflight.clear()
+            return b''
+        if len(data) < length:
+            # Short read: ask for the rest of the range ahead of everything
+            # already in flight
+            rest = offset + len(data)
+            self._inflight.appendleft((rest, length - len(data), self._request(rest, length - len(data))))
+        self._window = min(self._window * 2, self._client.max_requests)
+        self.position += len(data)
+        return data
+
+    def readinto(self, buffer) -> int:
+        if self._chunk_pos >= len(self._chunk):
+            self._chunk = self.read_chunk()
+            self._chunk_pos = 0
+        n = min(len(buffer), len(self._chunk) - self._chunk_pos)
+        buffer[:n] = self._chunk[self._chunk_pos:self._chunk_pos + n]
+        self._chunk_pos += n
+        return n
+
+    def readall(self, progress: Optional[Callable[[int, int], None]] = None) -> bytes:
+        """The rest of the file; ``progress(done, total)`` per chunk."""
+        parts = []
+        done = 0
+        while True:
+            data = self.read_chunk()
+            if not data:
+                break
+            parts.append(data)
+            done += len(data)
+            if progress is not None:
+                progress(done, max(self.size or 0, done))
+        return b''.join(parts)
+
+    def close(self) -> None:
+        if not self.closed:
+            # Replies to read-ahead still in flight are dropped by the reader
+            # thread; CLOSE is answered after them
+            self._inflight.clear()
+            self._client._close_handle(self._handle)
+        super().close()
+
+
+class SFTPWriter(io.RawIOBase):
+    """Sequential writes to an open remote file, as ``CHUNK_SIZE`` WRITE
+    requests with up to ``max_requests`` awaiting acknowledgement.
+
+    ``progress(done, total)`` is called as writes are acknowledged. A failed
+    write raises from the ``write`` / ``close`` call that collects it. Leaving
+    a ``with`` block by an exception calls ``abort`` instead of ``close``, so
+    buffered data is dropped rather than sent."""
+
+    def __init__(self, client: SFTPClient, handle: bytes, size: Optional[int] = None,
+                 progress: Optional[Callable[[int, int], None]] = None):
+        super().__init__()
+        self._client = client
+        self._handle = handle
+        self._handle_field = _string(handle)
+        self._size = size
+        self._progress = progress
+        self._pending = bytearray()
+        self._inflight = deque()
+        self._offset = 0
+        self.done = 0
+
+    def writable(self) -> bool:
+        return True
+
+    def write(self, data) -> int:
+        chunk_size = self._client.CHUNK_SIZE
+        view = memoryview(data).cast('B')
+        total = len(view)
+        if self._pending:
+            take = chunk_size - len(self._pending)
+            self._pending += view[:take]
+            view = view[take:]
+            if len(self._pending) < chunk_size:
+                return total
+            self._send(bytes(self._pending))
+            self._pending.clear()
+        while len(view) >= chunk_size:
+            self._send(view[:chunk_size].tobytes())
+            view = view[chunk_size:]
+        self._pending += view
+        return total
+
+    def _send(self, chunk: bytes) -> None:
+        while len(self._inflight) >= self._client.max_requests:
+            self._acknowledge()
+        request = self._client._send(
+            FXP_WRITE, self._handle_field + struct.pack('>Q', self._offset) + _string(chunk))
+        self._inflight.append((len(chunk), request))
+        self._offset += len(chunk)
+
+    def _acknowledge(self) -> None:
+        length, request = self._inflight.popleft()
+        self._client._wait(request, FXP_STATUS)
+        self.done += length
+        if self._progress is not None:
+            self._progress(self.done, max(self._size or 0, self.done))
+
+    def close(self) -> None:
+        """Send what is buffered, wait for every acknowledgement and close
+        the handle."""
+        if self.closed:
+            return
+        try:
+            if self._pending:
+                self._send(bytes(self._pending))
+                self._pending.clear()
+            while self._inflight:
+                self._acknowledge()
+        finally:
+            self.abort()
+
+    def abort(self) -> None:
+        """Close the handle without sending buffered data or waiting for
+        outstanding acknowledgements."""
+        if self.closed:
+            return
+        self._pending.clear()
+        self._inflight.clear()
+        self._client._close_handle(self._handle)
+        super().close()
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        if exc_type is None:
+            self.close()
+        else:
+            self.abort()
+
+    def __del__(self):
+        # Never flush from the garbage collector
+        try:
+            self.abort()
+        except Exception:
+            pass
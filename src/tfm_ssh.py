@@ -12,6 +12,7 @@ from typing import Iterator, List, Optional
 from datetime import datetime
 from tfm_log_manager import getLogger
 from tfm_str_format import format_size
+from tfm_content_cache import ContentCache, get_content_cache
 
 
 class SSHPathImpl:
@@ -351,16 +352,33 @@ class SSHPathImpl:
         """Recursively iterate over this subtree and yield all existing files matching pattern"""
         import fnmatch
         
-        # Recursive implementation
-        def _rglob_recursive(path):
-            if path.is_dir():
-                for item in path.iterdir():
-                    if fnmatch.fnmatch(item.name, pattern):
-                        yield item
-                    if item.is_dir():
-                        yield from _rglob_recursive(item)
+        if not self.is_dir():
+            return
+        for item, entry in self.scan_tree():
+            if 'error' not in entry and fnmatch.fnmatch(entry['name'], pattern):
+                yield item
+    
+    def content_digest(self) -> Optional[str]:
+        """SHA-256 of the file computed on the remote host (cached by size and
+        mtime), or None if the host can't provide it."""
+        try:
+            return self._get_connection().hash_file(self.remote_path)
+        except Exception:
+            return None
+    
+    def scan_tree(self) -> Iterator:
+        """
+        Recursively list this directory with one remote command (see
+        SSHConnection.scan_tree). The listings also land in the cache, so
+        browsing into the tree afterwards needs no further round-trips.
         
-        yield from _rglob_recursive(self)
+        Yields:
+            (Path, entry) for every entry below this directory
+        """
+        conn = self._get_connection()
+        base = f"ssh://{self.hostname}{self.remote_path.rstrip('/')}/"
+        for relative, entry in conn.scan_tree(self.remote_path):
+            yield self._make_path(base + relative), entry
     
     def match(self, pattern: str) -> bool:
         """Return True if this path matches the given pattern"""
@@ -370,18 +388,21 @@ class SSHPathImpl:
     # File I/O operations
     def open(self, mode='r', buffering=-1, encoding=None, errors=None, newline=None):
         """Open the file pointed to by this path"""
-        # For SSH, we need to read the entire file into memory
-        # and return a file-like object
         conn = self._get_connection()
         
         if 'r' in mode:
-            # Read mode
-            data = conn.read_file(self.remote_path)
+            # Read mode: from the disk content cache when this version of the
+            # file was read before, else streamed with read-ahead, so reading
+            # only the head of a file (e.g. a binary sniff) doesn't transfer
+            # all of it
+            content_key = self._content_key()
+            stream = get_content_cache().open(content_key) if content_key else None
+            if stream is None:
+                stream = conn.open_file(self.remote_path)
             if 'b' in mode:
-                return io.BytesIO(data)
-            else:
-                text = data.decode(encoding or 'utf-8', errors or 'strict')
-                return io.StringIO(text)
+                return stream
+            return io.TextIOWrapper(stream, encoding=encoding or 'utf-8',
+                                    errors=errors or 'strict', newline=newline)
         elif 'w' in mode or 'a' in mode:
             # Write/append mode - return a writable buffer
             # that will be uploaded on close
@@ -421,14 +442,25 @@ class SSHPathImpl:
     
     def read_text(self, encoding=None, errors=None) -> str:
         """Open the file in text mode, read it, and close the file"""
-        conn = self._get_connection()
-        data = conn.read_file(self.remote_path)
+        data = self.read_bytes()
         return data.decode(encoding or 'utf-8', errors or 'strict')
     
     def read_bytes(self) -> bytes:
         """Open the file in bytes mode, read it, and close the file"""
-        conn = self._get_connection()
-        return conn.read_file(self.remote_path)
+        return self.read_bytes_with_progress(None)
+    
+    def _content_key(self) -> Optional[str]:
+        """Key of this version of the file in the disk content cache (path,
+        mtime and size from the cached stat), or None for a directory or a path
+        that can't be stat'ed"""
+        try:
+            info = self._get_connection().stat(self.remote_path)
+        except Exception:
+            return None
+        if info.get('is_dir'):
+            return None
+        return ContentCache.version_key(f"ssh://{self.hostname}{self.remote_path}",
+                                        info.get('mtime'), info.get('size'))
     
     def read_bytes_with_progress(self, progress_callback: callable) -> bytes:
         """
@@ -441,11 +473,18 @@ class SSHPathImpl:
             File contents as bytes
         """
         conn = self._get_connection()
-        conn.set_progress_callback(progress_callback)
-        try:
-            return conn.read_file(self.remote_path)
-        finally:
-            conn.set_progress_callback(None)
+        content_key = self._content_key()
+        cache = get_content_cache()
+        if content_key:
+            data = cache.read(content_key)
+            if data is not None:
+                if progress_callback:
+                    progress_callback(len(data), len(data))
+                return data
+        data = conn.read_file(self.remote_path, progress_callback)
+        if content_key:
+            cache.put(content_key, data)
+        return data
     
     def write_text(self, data: str, encoding=None, errors=None, newline=None) -> int:
         """Open the file in text mode, write to it, and close the file"""
@@ -472,12 +511,36 @@ class SSHPathImpl:
             Number of bytes written
         """
         conn = self._get_connection()
-        conn.set_progress_callback(progress_callback)
-        try:
-            conn.write_file(self.remote_path, data)
-            return len(data)
-        finally:
-            conn.set_progress_callback(None)
+        conn.write_file(self.remote_path, data, progress_callback)
+        return len(data)
+    
+    def download_to_local(self, local_path: str, progress_callback: Optional[callable] = None) -> int:
+        """
+        Copy this file to a local path, streaming it without an in-memory copy.
+        
+        Args:
+            local_path: Local destination file
+            progress_callback: Optional callable that takes (bytes_transferred: int, total_bytes: int)
+        
+        Returns:
+            Number of bytes copied
+        """
+        conn = self._get_connection()
+        return conn.download_file(self.remote_path, local_path, progress_callback)
+    
+    def upload_from_local(self, local_path: str, progress_callback: Optional[callable] = None) -> int:
+        """
+        Replace this file with a local file's contents, streaming it.
+        
+        Args:
+            local_path: Local source file
+            progress_callback: Optional callable that takes (bytes_transferred: int, total_bytes: int)
+        
+        Returns:
+            Number of bytes copied
+        """
+        conn = self._get_connection()
+        return conn.upload_file(local_path, self.remote_path, progress_callback)
     
     # File system modification operations
     def mkdir(self, mode=0o777, parents=False, exist_ok=False):
@@ -11,6 +11,8 @@ import threading
 import time
 from typing import Any, Dict, Optional
 from tfm_log_manager import getLogger
+from tfm_content_cache import get_content_cache
+from tfm_lru_cache import LRUCache, estimate_size
 
 
 class SSHCache:
@@ -20,8 +22,8 @@ class SSHCache:
     Features:
     - Configurable cache TTL (default 30 seconds for data, 300 seconds for errors)
     - Thread-safe operations
-    - Partial cache invalidation
-    - LRU-style cache management
+    - Partial cache invalidation, indexed by hostname and path prefix
+    - O(1) LRU eviction (tfm_lru_cache.LRUCache)
     - Per-hostname caching
     - Negative caching (caches errors to avoid repeated failed operations)
     
@@ -35,7 +37,8 @@ class SSHCache:
     - Examples: Permission denied, path not found
     """
     
-    def __init__(self, default_ttl: int = 30, max_entries: int = 1000, error_ttl: int = 300):
+    def __init__(self, default_ttl: int = 30, max_entries: int = 1000, error_ttl: int = 300,
+                 max_bytes: int = 0):
         """
         Initialize SSH cache.
         
@@ -43,14 +46,28 @@ class SSHCache:
             default_ttl: Default time-to-live in seconds for successful results (default: 30)
             max_entries: Maximum number of cache entries (default: 1000)
             error_ttl: Time-to-live in seconds for cached errors (default: 300 = 5 minutes)
+            max_bytes: Limit on the estimated size of cached data (default: 0 = none)
         """
         self.default_ttl = default_ttl
         self.error_ttl = error_ttl
-        self.max_entries = max_entries
-        self._cache: Dict[str, Dict[str, Any]] = {}
+        # Values are (data, error) pairs; entries are indexed by hostname and path
+        self._cache = LRUCache(max_entries=max_entries, max_bytes=max_bytes,
+                               on_evict=self._log_eviction)
         self._lock = threading.RLock()
         self.logger = getLogger("SSHCache")
     
+    @property
+    def max_entries(self) -> int:
+        return self._cache.max_entries
+    
+    @max_entries.setter
+    def max_entries(self, value: int):
+        self._cache.max_entries = value
+    
+    def _log_eviction(self, entry):
+        if entry.expires is not None and time.time() > entry.expires:
+            self.logger.debug(f"Cache expired for {entry.tag} on {entry.scope}:{entry.path}")
+    
     def _generate_cache_key(self, operation: str, hostname: str, path: str = "", **kwargs) -> str:
         """
         Generate a unique cache key for the operation and parameters.
@@ -94,29 +111,19 @@ class SSHCache:
         cache_key = self._generate_cache_key(operation, hostname, path, **kwargs)
         
         with self._lock:
-            if cache_key not in self._cache:
+            cached = self._cache.get(cache_key)
+            if cached is None:
                 return None
-            
-            entry = self._cache[cache_key]
-            current_time = time.time()
-            
-            # Check if entry has expired
-            if current_time - entry['timestamp'] > entry['ttl']:
-                del self._cache[cache_key]
-                self.logger.debug(f"Cache expired for {operation} on {hostname}:{path}")
-                return None
-            
-            # Update access time for LRU behavior
-            entry['last_access'] = current_time
+            data, error = cached
             
             # If this is a cached error, re-raise it
-            if entry.get('error'):
+            if error:
                 self.logger.debug(f"Cache hit (error) for {operation} on {hostname}:{path}")
-                raise entry['error']
+                raise error
             
             # Otherwise return cached data
             self.logger.debug(f"Cache hit for {operation} on {hostname}:{path}")
-            return entry['data']
+            return data
     
     def put(self, operation: str, hostname: str, path: str = "", data: Any = None, 
             ttl: Optional[int] = None, error: Optional[Exception] = None, **kwargs):
@@ -133,32 +140,60 @@ class SSHCache:
             **kwargs: Additional parameters
         """
         cache_key = self._generate_cache_key(operation, hostname, path, **kwargs)
-        current_time = time.time()
         
         with self._lock:
-            # Enforce max entries limit using LRU eviction
-            if len(self._cache) >= self.max_entries and cache_key not in self._cache:
-                self._evict_lru()
-            
             # Use error_ttl for errors, default_ttl for successful results
             if ttl is None:
                 ttl = self.error_ttl if error else self.default_ttl
             
-            self._cache[cache_key] = {
-                'data': data,
-                'error': error,  # Store error for negative caching
-                'timestamp': current_time,
-                'last_access': current_time,
-                'ttl': ttl,
-                'hostname': hostname,
-                'path': path,
-                'operation': operation
-            }
+            # The error is stored for negative caching
+            self._cache.put(cache_key, (data, error), ttl=ttl, size=estimate_size(data),
+                            scope=hostname, path=path, tag=operation)
             if error:
                 self.logger.debug(f"Cached error for {operation} on {hostname}:{path}: {type(error).__name__} (TTL: {ttl}s)")
             else:
                 self.logger.debug(f"Cached {operation} for {hostname}:{path} (TTL: {ttl}s)")
     
+    def put_listings(self, hostname: str, listings: Dict[str, list],
+                     errors: Optional[Dict[str, Exception]] = None):
+        """
+        Store the directory listings of a whole scanned tree in one pass.
+        
+        Shallow directories go first (they are the ones browsed next) and at
+        most half of max_entries are used, so a huge tree can't flush every
+        other cached host and path. The batch is stored before one eviction
+        pass, which stops at the batch: it is kept whole even when it alone
+        exceeds max_bytes, and later puts evict its least recent entries.
+        
+        Args:
+            hostname: Remote hostname
+            listings: Directory path -> list_directory() entries
+            errors: Directory path -> exception for directories that could not be read
+        """
+        items = [(path, entries, None) for path, entries in listings.items()]
+        items.extend((path, None, error) for path, error in (errors or {}).items())
+        items.sort(key=lambda item: item[0].count('/'))
+        del items[max(1, self.max_entries // 2):]
+        
+        current_time = time.time()
+        with self._lock:
+            evictions = self._cache.evictions
+            keys = set()
+            for path, entries, error in items:
+                cache_key = self._generate_cache_key('list_directory', hostname, path)
+                self._cache.put(cache_key, (entries, error),
+                                ttl=self.error_ttl if error else self.default_ttl,
+                                size=estimate_size(entries), scope=hostname, path=path,
+                                tag='list_directory', now=current_time, evict=False)
+                keys.add(cache_key)
+            # The batch is the most recently used run, so this takes older
+            # entries only
+            self._cache.enforce_limits(keep=keys)
+            evicted = self._cache.evictions - evictions
+            if evicted:
+                self.logger.debug(f"Evicted {evicted} LRU entries for scanned tree")
+        self.logger.debug(f"Cached {len(items)} directory listings for {hostname}")
+    
     def invalidate_hostname(self, hostname: str):
         """
         Invalidate all cache entries for a specific hostname.
@@ -167,16 +202,10 @@ class SSHCache:
             hostname: Remote hostname to invalidate
         """
         with self._lock:
-            keys_to_remove = []
-            for cache_key, entry in self._cache.items():
-                if entry['hostname'] == hostname:
-                    keys_to_remove.append(cache_key)
+            removed = self._cache.remove_entries(self._cache.scope_entries(hostname))
             
-            for key in keys_to_remove:
-                del self._cache[key]
-            
-            if keys_to_remove:
-                self.logger.debug(f"Invalidated {len(keys_to_remove)} cache entries for {hostname}")
+            if removed:
+                self.logger.debug(f"Invalidated {removed} cache entries for {hostname}")
     
     def invalidate_path(self, hostname: str, path: str):
         """
@@ -189,37 +218,28 @@ class SSHCache:
             path: Remote path that was modified
         """
         with self._lock:
-            keys_to_remove = []
+            cache = self._cache
             
             # Normalize path
             import posixpath
             normalized_path = posixpath.normpath(path)
             
-            for cache_key, entry in self._cache.items():
-                if entry['hostname'] == hostname:
-                    entry_path = entry['path']
-                    
-                    # Invalidate exact path matches
-                    if entry_path == normalized_path:
-                        keys_to_remove.append(cache_key)
-                    
-                    # Invalidate parent directory listings
-                    # If we modified /home/user/file.txt, invalidate /home/user listing
-                    elif entry['operation'] == 'list_directory':
-                        parent_dir = posixpath.dirname(normalized_path)
-                        if entry_path == parent_dir:
-                            keys_to_remove.append(cache_key)
-                    
-                    # Invalidate child paths if we're modifying a directory
-                    # If we modified /home/user, invalidate /home/user/file.txt
-                    elif entry_path.startswith(normalized_path.rstrip('/') + '/'):
-                        keys_to_remove.append(cache_key)
+            # Invalidate exact path matches
+            removed = cache.remove_entries(cache.entries_at(hostname, normalized_path))
+            
+            # Invalidate parent directory listings
+            # If we modified /home/user/file.txt, invalidate /home/user listing
+            parent_dir = posixpath.dirname(normalized_path)
+            removed += cache.remove_entries(e for e in cache.entries_at(hostname, parent_dir)
+                                            if e.tag == 'list_directory')
             
-            for key in keys_to_remove:
-                del self._cache[key]
+            # Invalidate child paths if we're modifying a directory
+            # If we modified /home/user, invalidate /home/user/file.txt
+            removed += cache.remove_entries(
+                cache.entries_with_prefix(hostname, normalized_path.rstrip('/') + '/'))
             
-            if keys_to_remove:
-                self.logger.debug(f"Invalidated {len(keys_to_remove)} cache entries for {hostname}:{path}")
+            if removed:
+                self.logger.debug(f"Invalidated {removed} cache entries for {hostname}:{path}")
     
     def invalidate_directory(self, hostname: str, directory: str):
         """
@@ -230,29 +250,19 @@ class SSHCache:
             directory: Remote directory path
         """
         with self._lock:
-            keys_to_remove = []
+            cache = self._cache
             
             # Normalize directory path
             import posixpath
             normalized_dir = posixpath.normpath(directory)
             
-            for cache_key, entry in self._cache.items():
-                if entry['hostname'] == hostname:
-                    entry_path = entry['path']
-                    
-                    # Invalidate the directory itself
-                    if entry_path == normalized_dir:
-                        keys_to_remove.append(cache_key)
-                    
-                    # Invalidate all paths under this directory
-                    elif entry_path.startswith(normalized_dir.rstrip('/') + '/'):
-                        keys_to_remove.append(cache_key)
-            
-            for key in keys_to_remove:
-                del self._cache[key]
+            # Invalidate the directory itself and all paths under it
+            removed = cache.remove_entries(cache.entries_at(hostname, normalized_dir))
+            removed += cache.remove_entries(
+                cache.entries_with_prefix(hostname, normalized_dir.rstrip('/') + '/'))
             
-            if keys_to_remove:
-                self.logger.debug(f"Invalidated {len(keys_to_remove)} cache entries for directory {hostname}:{directory}")
+            if removed:
+                self.logger.debug(f"Invalidated {removed} cache entries for directory {hostname}:{directory}")
     
     def clear(self):
         """Clear all cache entries."""
@@ -262,18 +272,6 @@ class SSHCache:
             if count > 0:
                 self.logger.debug(f"Cleared {count} cache entries")
     
-    def _evict_lru(self):
-        """Evict the least recently used cache entry."""
-        if not self._cache:
-            return
-        
-        # Find the entry with the oldest last_access time
-        oldest_key = min(self._cache.keys(), 
-                        key=lambda k: self._cache[k]['last_access'])
-        entry = self._cache[oldest_key]
-        del self._cache[oldest_key]
-        self.logger.debug(f"Evicted LRU cache entry for {entry['hostname']}:{entry['path']}")
-    
     def get_stats(self) -> Dict[str, Any]:
         """
         Get cache statistics for monitoring.
@@ -282,23 +280,22 @@ class SSHCache:
             Dictionary with cache statistics
         """
         with self._lock:
-            current_time = time.time()
-            expired_count = sum(1 for entry in self._cache.values() 
-                              if current_time - entry['timestamp'] > entry['ttl'])
-            
             # Count entries by operation type
             operation_counts = {}
-            for entry in self._cache.values():
-                op = entry['operation']
+            for entry in self._cache.entries():
+                op = entry.tag
                 operation_counts[op] = operation_counts.get(op, 0) + 1
             
             return {
                 'total_entries': len(self._cache),
-                'expired_entries': expired_count,
+                'expired_entries': self._cache.expired_count(),
                 'max_entries': self.max_entries,
+                'bytes': self._cache.total_bytes,
+                'evictions': self._cache.evictions,
                 'default_ttl': self.default_ttl,
                 'error_ttl': self.error_ttl,
-                'operation_counts': operation_counts
+                'operation_counts': operation_counts,
+                'content_cache': get_content_cache().get_stats()
             }
 
 
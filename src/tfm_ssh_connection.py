@@ -2,21 +2,90 @@
 SSH Connection Management for TFM
 
 This module provides SSH/SFTP connection management for remote file operations.
-It uses the standard sftp command-line tool via subprocess for all operations.
+Each connection keeps one SFTP session open over the ssh ControlMaster socket
+(see tfm_sftp_client) and sends binary requests on it. When the session cannot
+be started it falls back to running the sftp command-line tool in batch mode
+for each operation.
 """
 
+import io
+import stat as stat_module
 import subprocess
 import threading
 import time
 import os
 import shutil
 import traceback
+import itertools
+import re
 from pathlib import Path
-from typing import Optional, Dict, List, Tuple
+from typing import Optional, Dict, Iterator, List, Tuple
 from tfm_log_manager import getLogger
+from tfm_sftp_client import (
+    SFTPClient, SFTPError, SFTPConnectionLost, SFTPTimeout, SFTPAttributes, SFTPReader,
+    FX_NO_SUCH_FILE, FX_PERMISSION_DENIED
+)
 from tfm_ssh_cache import get_ssh_cache
 
 
+# Bytes read from the local source per call while uploading
+_UPLOAD_READ_SIZE = 1024 * 1024
+
+# scan_tree(): one record per entry - type letter, permission bits (octal), size,
+# mtime (seconds with fraction) and path relative to the root, each NUL-terminated
+_FIND_FORMAT = r'%y\0%m\0%s\0%T@\0%P\0'
+_FIND_FIELDS = 5
+# A find diagnostic in the C locale: find: '<path>': <reason>
+_FIND_ERROR = re.compile(r"^find: '(.*)': (.*)$")
+
+# hash_files(): prints one line per argument, in order - the SHA-256 of the file
+# (read on stdin, so names never need escaping) or "-" if it can't be hashed.
+# GNU coreutils has sha256sum, macOS / BSD have shasum; exit 127 if neither.
+_HASH_SCRIPT = ('if command -v sha256sum >/dev/null; then s=sha256sum; '
+                'elif command -v shasum >/dev/null; then s="shasum -a 256"; else exit 127; fi; '
+                'for f; do h=$($s < "$f" 2>/dev/null) && echo "${h%% *}" || echo -; done')
+# Arguments per remote hash command (stays well below ARG_MAX)
+_HASH_BATCH = 200
+# Digests stay valid while size and mtime match, so they outlive listings
+_HASH_TTL = 24 * 3600
+# A hash command may take the usual command timeout plus the time to read its
+# files at this slowest expected rate (bytes/s) on the host
+_HASH_TIMEOUT = 30
+_HASH_MIN_RATE = 10 * 1024 * 1024
+_SHA256_HEX = re.compile(r'^[0-9a-f]{64}$')
+
+
+def _iter_find_records(stream) -> Iterator[Tuple[str, Dict[str, any]]]:
+    """Parse _FIND_FORMAT records from a binary stream as they arrive."""
+    import posixpath
+    
+    pending = b''
+    while True:
+        data = stream.read1(65536) if hasattr(stream, 'read1') else stream.read(65536)
+        if not data:
+            break
+        fields = (pending + data).split(b'\0')
+        pending = fields.pop()
+        # Keep a partial record for the next read
+        usable = len(fields) - len(fields) % _FIND_FIELDS
+        if usable < len(fields):
+            pending = b'\0'.join(fields[usable:] + [pending])
+        for i in range(0, usable, _FIND_FIELDS):
+            kind, mode, size, mtime, relative = fields[i:i + _FIND_FIELDS]
+            relative = relative.decode('utf-8', 'surrogateescape')
+            kind = kind[:1]
+            yield relative, {
+                'name': posixpath.basename(relative),
+                'size': int(size) if size.isdigit() else 0,
+                # Whole seconds, like SFTP attributes, so cached entries compare equal
+                'mtime': int(float(mtime)) if mtime else 0,
+                'mode': int(mode, 8) if mode else 0,
+                'is_dir': kind == b'd',
+                'is_file': kind == b'f',
+                'is_symlink': kind == b'l',
+            }
+
+
 # SSH-specific exception types
 class SSHError(Exception):
     """Base exception for SSH-related errors"""
@@ -52,8 +121,8 @@ class SSHConnection:
     """
     Manages an SSH/SFTP connection to a remote host.
     
-    Provides methods for file operations over SFTP using subprocess
-    to invoke the sftp command-line tool.
+    Provides methods for file operations over a persistent SFTP session,
+    falling back to the sftp command-line tool when the session is unavailable.
     """
     
     def __init__(self, hostname: str, config: Dict[str, str]):
@@ -112,6 +181,19 @@ class SSHConnection:
         self._control_master_check_interval = 5.0  # Seconds between checks
         self._cached_control_master_status = False  # Cached status
         
+        # Persistent SFTP session (opened by connect(); None means the
+        # sftp batch-mode fallback is used)
+        self._sftp: Optional[SFTPClient] = None
+        self._sftp_lock = threading.Lock()
+        self._sftp_unavailable = True  # Set False by connect() to allow opening
+        
+        # Whether the host's find supports -printf (scan_tree); cleared on failure
+        self._find_scan_supported = True
+        # Whether the host has sha256sum or shasum (hash_files); cleared on failure
+        self._remote_hash_supported = True
+        # False once a delta sync found no python3 on the host (tfm_delta_sync)
+        self._remote_python_supported = True
+        
     def connect(self) -> bool:
         """
         Establish SSH connection.
@@ -134,7 +216,21 @@ class SSHConnection:
                 # Establish master SSH connection
                 self._establish_control_master()
                 
-                # Test connection with a simple pwd command
+                # Open the persistent SFTP session; its REALPATH of "." is
+                # the default directory
+                self._sftp_unavailable = False
+                sftp = self._get_sftp()
+                if sftp is not None:
+                    try:
+                        self.default_directory = sftp.realpath('.')
+                    except SFTPError as e:
+                        self.logger.warning(f"Could not resolve default directory on {self.hostname}: {e}")
+                        self.default_directory = '/'
+                    self._connected = True
+                    self.logger.info(f"Connected to {self.hostname}, default directory: {self.default_directory}")
+                    return True
+                
+                # Fallback: test connection with a simple pwd command
                 stdout, stderr, returncode = self._execute_sftp_command(['pwd'], timeout=10)
                 
                 if returncode == 0:
@@ -187,6 +283,7 @@ class SSHConnection:
     def disconnect(self):
         """Close the SSH connection and terminate control master."""
         with self._lock:
+            self._close_sftp_session()
             if self._connected:
                 try:
                     # Close the control master connection
@@ -403,6 +500,160 @@ class SSHConnection:
             self.logger.error(error_msg)
             raise SSHError(error_msg)
 
+    def _ssh_argv(self) -> List[str]:
+        """ssh command line (without the remote part) that runs over the control master."""
+        ssh_cmd = ['ssh', '-o', f'ControlPath={self._control_path}', '-o', 'ControlMaster=no']
+        
+        # Add port if specified
+        if self.port and self.port != '22':
+            ssh_cmd.extend(['-p', str(self.port)])
+        
+        # Add identity file if specified
+        if self.identity_file:
+            ssh_cmd.extend(['-i', self.identity_file])
+        
+        ssh_cmd.extend(['-o', 'BatchMode=yes', '-o', 'StrictHostKeyChecking=accept-new'])
+        return ssh_cmd
+    
+    def _sftp_argv(self) -> List[str]:
+        """ssh command line that starts the sftp subsystem over the control master."""
+        return self._ssh_argv() + ['-s', self.hostname, 'sftp']
+    
+    def _exec_argv(self, command: str) -> List[str]:
+        """ssh command line that runs a shell command on the host over the control master."""
+        return self._ssh_argv() + [self.hostname, command]
+    
+    def _open_sftp_session(self) -> Optional[SFTPClient]:
+        """
+        Start the SFTP subsystem and perform the protocol handshake.
+        
+        Returns:
+            SFTPClient, or None if the session could not be started (the
+            caller then uses the sftp batch-mode fallback)
+        """
+        try:
+            process = subprocess.Popen(
+                self._sftp_argv(),
+                stdin=subprocess.PIPE,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.DEVNULL
+            )
+            sftp = SFTPClient(process, timeout=30)
+            self.logger.info(f"Opened SFTP session to {self.hostname} (protocol version {sftp.version})")
+            return sftp
+        except Exception as e:
+            self.logger.warning(f"SFTP session to {self.hostname} unavailable, using sftp batch mode: {e}")
+            return None
+    
+    def open_channel(self) -> Optional[SFTPClient]:
+        """
+        Open an additional SFTP session on the control master.
+        
+        Each session is its own channel of the one multiplexed ssh connection,
+        so several of them move files concurrently without a new login. The
+        caller owns the session and closes it when done.
+        
+        Returns:
+            SFTPClient, or None if not connected or sessions are unavailable
+        """
+        if not self._connected or self._sftp_unavailable:
+            return None
+        return self._open_sftp_session()
+    
+    def _get_sftp(self) -> Optional[SFTPClient]:
+        """
+        Get the persistent SFTP session, reopening it once if it was lost.
+        
+        Returns:
+            SFTPClient, or None if the batch-mode fallback should be used
+        """
+        sftp = self._sftp
+        if sftp is not None and sftp.alive:
+            return sftp
+        if self._sftp_unavailable:
+            return None
+        
+        with self._sftp_lock:
+            if self._sftp is not None:
+                if self._sftp.alive:
+                    return self._sftp
+                self.logger.warning(f"SFTP session to {self.hostname} lost, reopening")
+                self._sftp.close()
+                self._sftp = None
+            if self._sftp_unavailable:
+                return None
+            self._sftp = self._open_sftp_session()
+            if self._sftp is None:
+                self._sftp_unavailable = True
+            return self._sftp
+    
+    def _close_sftp_session(self):
+        """Close the persistent SFTP session, if any."""
+        with self._sftp_lock:
+            if self._sftp is not None:
+                self._sftp.close()
+                self._sftp = None
+            self._sftp_unavailable = True
+    
+    def _sftp_error(self, e: SFTPError, message: str, path: str, cache_operation: Optional[str] = None) -> SSHError:
+        """
+        Map an SFTP status to the matching SSH exception.
+        
+        Args:
+            e: The SFTP error
+            message: Description of the failed action, e.g. "Failed to read file x"
+            path: Path the request was for
+            cache_operation: If set, not-found and permission errors are cached
+                             for this operation, as the batch-mode path does
+            
+        Returns:
+            Exception to raise
+        """
+        if isinstance(e, SFTPConnectionLost):
+            error = SSHConnectionLostError(f"Connection to {self.hostname} lost: {e}")
+            self.logger.error(str(error))
+            return error
+        if isinstance(e, SFTPTimeout):
+            error = SSHConnectionTimeoutError(f"SFTP request timeout for {self.hostname}: {e}")
+            self.logger.error(str(error))
+            return error
+        
+        if e.code == FX_NO_SUCH_FILE:
+            error = SSHPathNotFoundError(f"Remote path not found: {path}")
+            # Use debug level since this is often used to check if path exists
+            self.logger.debug(str(error))
+        elif e.code == FX_PERMISSION_DENIED:
+            error = SSHPermissionDeniedError(f"Permission denied accessing: {path}")
+            self.logger.error(str(error))
+        else:
+            error = SSHError(f"{message}: {e}")
+            self.logger.error(str(error))
+            return error
+        
+        if cache_operation:
+            # Cache the error to avoid repeated requests
+            self._cache.put(
+                operation=cache_operation,
+                hostname=self.hostname,
+                path=path,
+                error=error
+            )
+        return error
+    
+    @staticmethod
+    def _entry_from_attrs(name: str, attrs: SFTPAttributes) -> Dict[str, any]:
+        """Build an entry dict (same keys as _parse_ls_line) from SFTP attributes."""
+        permissions = attrs.permissions or 0
+        return {
+            'name': name,
+            'size': attrs.size or 0,
+            'mtime': float(attrs.mtime) if attrs.mtime is not None else 0,
+            'mode': stat_module.S_IMODE(permissions),
+            'is_dir': attrs.is_dir,
+            'is_file': attrs.is_file,
+            'is_symlink': attrs.is_symlink,
+        }
+
     def _quote_path(self, path: str) -> str:
         """
         Quote a path for use in SFTP commands.
@@ -623,6 +874,37 @@ class SSHConnection:
             return cached_result
         
         # Cache miss - fetch from remote
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                listing = sftp.listdir_attr(remote_path)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to list directory {remote_path}", remote_path,
+                                       cache_operation='list_directory')
+            entries = []
+            for name, attrs in listing:
+                if name in ('.', '..'):
+                    continue
+                entry = self._entry_from_attrs(name, attrs)
+                entries.append(entry)
+                
+                # Cache individual stat for this file
+                self._cache.put(
+                    operation='stat',
+                    hostname=self.hostname,
+                    path=posixpath.join(remote_path, name),
+                    data=entry
+                )
+            
+            self._cache.put(
+                operation='list_directory',
+                hostname=self.hostname,
+                path=remote_path,
+                data=entries
+            )
+            return entries
+        
+        # Fallback: parse the sftp tool's ls output
         commands = [f'ls -la {self._quote_path(remote_path)}']
         stdout, stderr, returncode = self._execute_sftp_command(commands)
         
@@ -736,9 +1018,36 @@ class SSHConnection:
         if cached_result is not None:
             self.logger.debug(f"stat() cache HIT for {remote_path}")
             return cached_result
-        
+
+        # A cached listing of the parent (e.g. from scan_tree) already has the entry
+        parent, name = posixpath.split(remote_path)
+        if name:
+            try:
+                siblings = self._cache.get(operation='list_directory', hostname=self.hostname, path=parent)
+            except SSHError:
+                siblings = None
+            for entry in siblings or ():
+                if entry['name'] == name:
+                    return entry
+
         # Cache miss - fetch from remote
         self.logger.debug(f"stat() cache MISS for {remote_path}, fetching from remote")
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                attrs = sftp.lstat(remote_path)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to stat path {remote_path}", remote_path,
+                                       cache_operation='stat')
+            entry = self._entry_from_attrs(posixpath.basename(remote_path) or '/', attrs)
+            self._cache.put(
+                operation='stat',
+                hostname=self.hostname,
+                path=remote_path,
+                data=entry
+            )
+            return entry
+        
         # SFTP's ls command doesn't support -d flag
         # Try ls -l first (works for files and will list directory contents for dirs)
         commands = [f'ls -l {self._quote_path(remote_path)}']
@@ -855,12 +1164,326 @@ class SSHConnection:
         self.logger.error(error_msg)
         raise SSHError(error_msg)
     
-    def read_file(self, remote_path: str) -> bytes:
+    def scan_tree(self, remote_path: str) -> Iterator[Tuple[str, Dict[str, any]]]:
+        """
+        Recursively list a directory tree with a single remote command.
+        
+        Runs one GNU ``find -printf`` on the host (a separate channel on the
+        control master) that streams a NUL-delimited record per entry, instead
+        of one listing round-trip per directory. Hosts without GNU find fall
+        back to listing each directory in turn. Once the tree has been read
+        completely, every directory's listing is stored in the cache at once.
+        
+        Args:
+            remote_path: Root directory of the scan
+            
+        Yields:
+            (relative_path, entry) for every entry below the root, in no
+            particular order. ``relative_path`` uses '/' separators; ``entry``
+            has the same keys as list_directory() entries (lstat semantics, so
+            symlinked directories are not descended into). A directory that
+            could not be read is yielded a second time, after the listing, with
+            an additional 'error' key.
+            
+        Raises:
+            SSHPathNotFoundError: If the root does not exist
+            SSHPermissionDeniedError: If the root cannot be read
+            SSHConnectionLostError: If connection is lost
+            SSHError: For other errors
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+        
+        import posixpath
+        remote_path = posixpath.normpath(remote_path)
+        
+        if self._find_scan_supported:
+            # find would list a plain file as an empty tree
+            if self.stat(remote_path)['is_file']:
+                raise SSHError(f"Not a directory: {remote_path}")
+            scanned = self._scan_with_find(remote_path)
+            if scanned is not None:
+                yield from scanned
+                return
+        yield from self._scan_by_listing(remote_path)
+    
+    def _scan_with_find(self, remote_path: str) -> Optional[Iterator[Tuple[str, Dict[str, any]]]]:
+        """
+        Start the remote find; None if it produced nothing and failed (the
+        caller then falls back to listing directories).
+        """
+        import posixpath
+        import shlex
+        
+        # C locale keeps stderr in the "find: 'path': reason" form parsed below
+        command = f"LC_ALL=C find -H {shlex.quote(remote_path)} -mindepth 1 -printf {shlex.quote(_FIND_FORMAT)}"
+        try:
+            process = subprocess.Popen(
+                self._exec_argv(command),
+                stdin=subprocess.DEVNULL,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE
+            )
+        except OSError as e:
+            self.logger.warning(f"Remote scan unavailable on {self.hostname}: {e}")
+            return None
+        
+        # Drain stderr on a thread so a tree full of unreadable directories
+        # can't fill the pipe and stall find
+        stderr_chunks = []
+        stderr_reader = threading.Thread(
+            target=lambda: stderr_chunks.append(process.stderr.read()), daemon=True)
+        stderr_reader.start()
+        
+        records = _iter_find_records(process.stdout)
+        try:
+            first = next(records, None)
+        except BaseException:
+            process.kill()
+            raise
+        if first is None:
+            process.wait()
+            stderr_reader.join()
+            if process.returncode != 0:
+                stderr = b''.join(stderr_chunks).decode('utf-8', 'replace')
+                if process.returncode == 127 or 'printf' in stderr or 'unknown' in stderr.lower():
+                    # Not GNU find (or no find): stop trying on this connection
+                    self._find_scan_supported = False
+                self.logger.debug(f"Remote find failed on {self.hostname} ({process.returncode}): {stderr.strip()}")
+                return None
+        
+        def generate():
+            listings: Dict[str, List[Dict[str, any]]] = {remote_path: []}
+            completed = False
+            try:
+                if first is not None:
+                    for relative, entry in itertools.chain([first], records):
+                        full_path = posixpath.join(remote_path, relative)
+                        parent = posixpath.dirname(full_path)
+                        listings.setdefault(parent, []).append(entry)
+                        if entry['is_dir']:
+                            listings.setdefault(full_path, [])
+                        yield relative, entry
+                process.wait()
+                stderr_reader.join()
+                completed = True
+            finally:
+                if not completed:
+                    # Abandoned (cancelled or failed): stop the remote find
+                    process.kill()
+                    process.wait()
+            
+            errors: Dict[str, SSHError] = {}
+            clean = True
+            stderr = b''.join(stderr_chunks).decode('utf-8', 'surrogateescape')
+            for line in stderr.splitlines():
+                match = _FIND_ERROR.match(line)
+                path = posixpath.normpath(match.group(1)) if match else None
+                if path is None or not (path + '/').startswith(remote_path.rstrip('/') + '/'):
+                    clean = False
+                    continue
+                reason = match.group(2)
+                if 'permission denied' in reason.lower():
+                    errors[path] = SSHPermissionDeniedError(f"Permission denied accessing: {path}")
+                else:
+                    errors[path] = SSHError(f"Failed to list directory {path}: {reason}")
+            
+            for path, error in errors.items():
+                listings.pop(path, None)
+                if path != remote_path:
+                    yield posixpath.relpath(path, remote_path), {'name': posixpath.basename(path),
+                                                                 'is_dir': True, 'error': str(error)}
+            if not clean:
+                # Unparsed errors: the listings may be incomplete, don't cache them
+                self.logger.warning(f"Remote scan of {self.hostname}:{remote_path} reported errors; not caching")
+                return
+            self._cache.put_listings(self.hostname, listings, errors)
+        
+        return generate()
+    
+    def _scan_by_listing(self, remote_path: str) -> Iterator[Tuple[str, Dict[str, any]]]:
+        """scan_tree() fallback: one list_directory() per directory."""
+        import posixpath
+        
+        stack = ['']
+        while stack:
+            relative = stack.pop()
+            directory = posixpath.join(remote_path, relative) if relative else remote_path
+            try:
+                entries = self.list_directory(directory)
+            except (SSHPathNotFoundError, SSHPermissionDeniedError) as e:
+                if not relative:
+                    raise
+                yield relative, {'name': posixpath.basename(relative), 'is_dir': True, 'error': str(e)}
+                continue
+            for entry in entries:
+                child = posixpath.join(relative, entry['name']) if relative else entry['name']
+                yield child, entry
+                if entry['is_dir']:
+                    stack.append(child)
+    
+    def hash_file(self, remote_path: str) -> Optional[str]:
+        """
+        SHA-256 of a remote file, computed on the host.
+        
+        Returns:
+            Hex digest, or None if the host can't hash the file (the caller
+            then compares bytes)
+        """
+        return self.hash_files([remote_path]).get(remote_path)
+    
+    def hash_files(self, remote_paths: List[str]) -> Dict[str, Optional[str]]:
+        """
+        SHA-256 of remote files, computed on the host so that comparing
+        contents doesn't transfer them.
+        
+        One command hashes a whole batch. Digests are cached keyed by host,
+        path, size and mtime, so a file is hashed again only once it changed.
+        
+        Args:
+            remote_paths: Remote file paths
+            
+        Returns:
+            Dictionary of path -> hex digest, or None for paths that could not be
+            hashed (missing, unreadable, not a regular file, or no sha256sum /
+            shasum on the host)
+        
+        Raises:
+            SSHConnectionTimeoutError: If a batch takes longer than its timeout,
+                which grows with the bytes it hashes
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+        
+        import posixpath
+        import shlex
+        
+        results: Dict[str, Optional[str]] = {}
+        wanted = []
+        for path in remote_paths:
+            try:
+                info = self.stat(posixpath.normpath(path))
+            except SSHError:
+                results[path] = None
+                continue
+            if not info.get('is_file'):
+                results[path] = None
+                continue
+            key = {'size': info.get('size', 0), 'mtime': info.get('mtime', 0)}
+            digest = self._cache.get('hash', self.hostname, posixpath.normpath(path), **key)
+            if digest is not None:
+                results[path] = digest
+            else:
+                wanted.append((path, key))
+        
+        if not self._remote_hash_supported:
+            wanted, missing = [], wanted
+            results.update((path, None) for path, _ in missing)
+        
+        for start in range(0, len(wanted), _HASH_BATCH):
+            batch = wanted[start:start + _HASH_BATCH]
+            command = 'sh -c ' + shlex.quote(_HASH_SCRIPT) + ' sh ' + ' '.join(
+                shlex.quote(path) for path, _ in batch)
+            timeout = _HASH_TIMEOUT + sum(key['size'] for _, key in batch) / _HASH_MIN_RATE
+            try:
+                result = subprocess.run(self._exec_argv(command), stdin=subprocess.DEVNULL,
+                                        capture_output=True, timeout=timeout)
+            except subprocess.TimeoutExpired:
+                raise SSHConnectionTimeoutError(
+                    f"Remote hashing timeout after {timeout:.0f}s for {self.hostname}")
+            except OSError as e:
+                self.logger.warning(f"Remote hashing unavailable on {self.hostname}: {e}")
+                results.update((path, None) for path, _ in batch)
+                continue
+            if result.returncode == 127:
+                self.logger.info(f"No sha256sum/shasum on {self.hostname}; comparing bytes instead")
+                self._remote_hash_supported = False
+                results.update((path, None) for path, _ in wanted[start:])
+                break
+            lines = result.stdout.decode('ascii', 'replace').split('\n')
+            if result.returncode != 0 or len(lines) < len(batch):
+                self.logger.warning(f"Remote hashing failed on {self.hostname} ({result.returncode}): "
+                                    f"{result.stderr.decode('utf-8', 'replace').strip()}")
+                results.update((path, None) for path, _ in batch)
+                continue
+            for (path, key), line in zip(batch, lines):
+                digest = line.strip()
+                if not _SHA256_HEX.match(digest):
+                    results[path] = None
+                    continue
+                results[path] = digest
+                self._cache.put('hash', self.hostname, posixpath.normpath(path), data=digest,
+                                ttl=_HASH_TTL, **key)
+        return results
+
+    def set_mtime(self, remote_path: str, mtime: float):
+        """
+        Set a remote file's access and modification times to ``mtime``
+        (whole seconds, which is what remote stats report).
+
+        Uses SFTP SETSTAT on the persistent session, or ``touch`` on the host
+        when SFTP is unavailable.
+
+        Raises:
+            SSHConnectionLostError: If not connected
+            SSHConnectionTimeoutError: If ``touch`` does not finish in time
+            SSHError: If the times could not be set
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+
+        seconds = int(mtime)
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                sftp.utime(remote_path, seconds, seconds)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to set mtime of {remote_path}", remote_path)
+        else:
+            import shlex
+            stamp = time.strftime('%Y%m%d%H%M.%S', time.gmtime(seconds))
+            command = f'TZ=UTC0 touch -c -t {stamp} {shlex.quote(remote_path)}'
+            try:
+                result = subprocess.run(self._exec_argv(command), stdin=subprocess.DEVNULL,
+                                        capture_output=True, timeout=_HASH_TIMEOUT)
+            except subprocess.TimeoutExpired:
+                raise SSHConnectionTimeoutError(f"Setting mtime timed out on {self.hostname}")
+            except OSError as e:
+                raise SSHError(f"Cannot run a command on {self.hostname}: {e}")
+            if result.returncode != 0:
+                raise SSHError(f"Failed to set mtime of {remote_path}: "
+                               f"{result.stderr.decode('utf-8', 'replace').strip()}")
+        self._cache.invalidate_path(self.hostname, remote_path)
+
+    def start_command(self, command: str) -> subprocess.Popen:
+        """
+        Start a shell command on the host with stdin, stdout and stderr piped.
+        
+        The caller owns the process: it feeds and drains the pipes and waits
+        for it. Used for helpers that stream in both directions, such as the
+        delta sync in tfm_delta_sync.
+        
+        Raises:
+            SSHConnectionLostError: If not connected
+            SSHError: If ssh could not be started
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+        try:
+            return subprocess.Popen(self._exec_argv(command), stdin=subprocess.PIPE,
+                                    stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        except OSError as e:
+            raise SSHError(f"Cannot run a command on {self.hostname}: {e}")
+    
+    def read_file(self, remote_path: str, progress_callback: Optional[callable] = None) -> bytes:
         """
         Read file contents.
         
         Args:
             remote_path: Remote file path
+            progress_callback: Optional (bytes_transferred, total_bytes) callback for
+                               files above the progress threshold; defaults to the
+                               one set with set_progress_callback()
             
         Returns:
             File contents as bytes
@@ -874,6 +1497,14 @@ class SSHConnection:
         if not self._connected:
             raise SSHConnectionLostError(f"Not connected to {self.hostname}")
         
+        callback = progress_callback or self._progress_callback
+        sftp = self._get_sftp()
+        if sftp is not None:
+            parts = []
+            with self._open_sftp_reader(sftp, remote_path) as reader:
+                self._pump_sftp_reader(reader, remote_path, parts.append, callback)
+            return b''.join(parts)
+        
         import tempfile
         import os
         
@@ -904,9 +1535,9 @@ class SSHConnection:
             self.logger.info(f"Downloading {file_size} bytes (no timeout - SFTP handles it)")
             
             # For large files, emit progress events
-            if file_size > self._progress_threshold and self._progress_callback:
+            if file_size > self._progress_threshold and callback:
                 # Start progress tracking
-                self._progress_callback(0, file_size)
+                callback(0, file_size)
             
             # Execute download without timeout - SFTP handles timeouts internally
             try:
@@ -935,8 +1566,8 @@ class SSHConnection:
                         raise SSHError(error_msg)
                 
                 # Report completion for large files
-                if file_size > self._progress_threshold and self._progress_callback:
-                    self._progress_callback(file_size, file_size)
+                if file_size > self._progress_threshold and callback:
+                    callback(file_size, file_size)
                 
             except (SSHPathNotFoundError, SSHPermissionDeniedError, SSHConnectionLostError):
                 # Re-raise SSH-specific errors
@@ -957,13 +1588,16 @@ class SSHConnection:
             if os.path.exists(tmp_path):
                 os.unlink(tmp_path)
     
-    def write_file(self, remote_path: str, data: bytes):
+    def write_file(self, remote_path: str, data: bytes, progress_callback: Optional[callable] = None):
         """
         Write file contents.
         
         Args:
             remote_path: Remote file path
             data: File contents as bytes
+            progress_callback: Optional (bytes_transferred, total_bytes) callback for
+                               files above the progress threshold; defaults to the
+                               one set with set_progress_callback()
             
         Raises:
             SSHPermissionDeniedError: If permission is denied
@@ -973,6 +1607,12 @@ class SSHConnection:
         if not self._connected:
             raise SSHConnectionLostError(f"Not connected to {self.hostname}")
         
+        callback = progress_callback or self._progress_callback
+        sftp = self._get_sftp()
+        if sftp is not None:
+            self._sftp_upload(sftp, remote_path, io.BytesIO(data).read, len(data), callback)
+            return
+        
         import tempfile
         import os
         
@@ -994,9 +1634,9 @@ class SSHConnection:
             self.logger.info(f"Uploading {file_size} bytes (no timeout - SFTP handles it)")
             
             # For large files, emit progress events
-            if file_size > self._progress_threshold and self._progress_callback:
+            if file_size > self._progress_threshold and callback:
                 # Start progress tracking
-                self._progress_callback(0, file_size)
+                callback(0, file_size)
             
             # Execute upload without timeout - SFTP handles timeouts internally
             try:
@@ -1025,8 +1665,8 @@ class SSHConnection:
                         raise SSHError(error_msg)
                 
                 # Report completion for large files
-                if file_size > self._progress_threshold and self._progress_callback:
-                    self._progress_callback(file_size, file_size)
+                if file_size > self._progress_threshold and callback:
+                    callback(file_size, file_size)
                 
             except (SSHPermissionDeniedError, SSHConnectionLostError):
                 # Re-raise SSH-specific errors
@@ -1044,6 +1684,174 @@ class SSHConnection:
             if os.path.exists(tmp_path):
                 os.unlink(tmp_path)
     
+    def download_file(self, remote_path: str, local_path: str,
+                      progress_callback: Optional[callable] = None,
+                      channel: Optional[SFTPClient] = None) -> int:
+        """
+        Copy a remote file to a local path.
+        
+        Over the persistent session the data is streamed straight into the local
+        file; a partially written file is removed if the transfer fails.
+        
+        Args:
+            remote_path: Remote file path
+            local_path: Local destination (created or truncated)
+            progress_callback: Optional (bytes_transferred, total_bytes) callback for
+                               files above the progress threshold
+            channel: SFTP session to use instead of the connection's own (see
+                     open_channel)
+            
+        Returns:
+            Number of bytes copied
+            
+        Raises:
+            SSHPathNotFoundError: If file does not exist
+            SSHPermissionDeniedError: If permission is denied
+            SSHConnectionLostError: If connection is lost
+            SSHError: For other errors
+            OSError: If the local file cannot be written
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+        
+        callback = progress_callback or self._progress_callback
+        sftp = channel or self._get_sftp()
+        if sftp is None:
+            data = self.read_file(remote_path, callback)
+            with open(local_path, 'wb') as f:
+                f.write(data)
+            return len(data)
+        
+        # Open the remote side first so a missing file doesn't leave an empty
+        # local one behind
+        with self._open_sftp_reader(sftp, remote_path) as reader:
+            try:
+                with open(local_path, 'wb') as f:
+                    return self._pump_sftp_reader(reader, remote_path, f.write, callback)
+            except BaseException:
+                try:
+                    os.unlink(local_path)
+                except OSError:
+                    pass
+                raise
+    
+    def upload_file(self, local_path: str, remote_path: str,
+                    progress_callback: Optional[callable] = None,
+                    channel: Optional[SFTPClient] = None) -> int:
+        """
+        Copy a local file to a remote path.
+        
+        Over the persistent session the local file is streamed to the server
+        without being read into memory first.
+        
+        Args:
+            local_path: Local source file
+            remote_path: Remote destination (created or truncated)
+            progress_callback: Optional (bytes_transferred, total_bytes) callback for
+                               files above the progress threshold
+            channel: SFTP session to use instead of the connection's own (see
+                     open_channel)
+            
+        Returns:
+            Number of bytes copied
+            
+        Raises:
+            SSHPermissionDeniedError: If permission is denied
+            SSHConnectionLostError: If connection is lost
+            SSHError: For other errors
+            OSError: If the local file cannot be read
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+        
+        callback = progress_callback or self._progress_callback
+        sftp = channel or self._get_sftp()
+        with open(local_path, 'rb') as f:
+            if sftp is None:
+                data = f.read()
+                self.write_file(remote_path, data, callback)
+                return len(data)
+            return self._sftp_upload(sftp, remote_path, f.read, os.fstat(f.fileno()).st_size, callback)
+    
+    def open_file(self, remote_path: str):
+        """
+        Open a remote file for streaming binary reads.
+        
+        Over the persistent session this returns a buffered reader that fetches
+        the file with read-ahead as it is consumed, so reading just the head of a
+        large file transfers little more than that. Otherwise the whole file is
+        read into memory.
+        
+        Args:
+            remote_path: Remote file path
+            
+        Returns:
+            Readable binary file object
+            
+        Raises:
+            SSHPathNotFoundError: If file does not exist
+            SSHPermissionDeniedError: If permission is denied
+            SSHConnectionLostError: If connection is lost
+            SSHError: For other errors
+        """
+        if not self._connected:
+            raise SSHConnectionLostError(f"Not connected to {self.hostname}")
+        
+        sftp = self._get_sftp()
+        if sftp is None:
+            return io.BytesIO(self.read_file(remote_path))
+        return io.BufferedReader(self._open_sftp_reader(sftp, remote_path), SFTPClient.CHUNK_SIZE)
+    
+    def _open_sftp_reader(self, sftp: SFTPClient, remote_path: str) -> SFTPReader:
+        try:
+            return sftp.open_read(remote_path)
+        except SFTPError as e:
+            raise self._sftp_error(e, f"Failed to read file {remote_path}", remote_path)
+    
+    def _pump_sftp_reader(self, reader: SFTPReader, remote_path: str, write: callable,
+                          callback: Optional[callable]) -> int:
+        """Pass every chunk of ``reader`` to ``write``, reporting progress per chunk."""
+        total = reader.size or 0
+        if total <= self._progress_threshold:
+            callback = None
+        if callback:
+            callback(0, total)
+        done = 0
+        try:
+            while True:
+                chunk = reader.read_chunk()
+                if not chunk:
+                    break
+                write(chunk)
+                done += len(chunk)
+                if callback:
+                    callback(done, max(total, done))
+        except SFTPError as e:
+            raise self._sftp_error(e, f"Failed to read file {remote_path}", remote_path)
+        return done
+    
+    def _sftp_upload(self, sftp: SFTPClient, remote_path: str, read: callable, total: int,
+                     callback: Optional[callable]) -> int:
+        """Write everything ``read`` returns to ``remote_path``, reporting progress
+        as the server acknowledges each chunk."""
+        if total <= self._progress_threshold:
+            callback = None
+        if callback:
+            callback(0, total)
+        try:
+            with sftp.open_write(remote_path, total, callback) as writer:
+                while True:
+                    chunk = read(_UPLOAD_READ_SIZE)
+                    if not chunk:
+                        break
+                    writer.write(chunk)
+            return writer.done
+        except SFTPError as e:
+            raise self._sftp_error(e, f"Failed to write file {remote_path}", remote_path)
+        finally:
+            # Even a failed upload may have created or truncated the file
+            self._cache.invalidate_path(self.hostname, remote_path)
+    
     def delete_file(self, remote_path: str):
         """
         Delete a file.
@@ -1060,6 +1868,15 @@ class SSHConnection:
         if not self._connected:
             raise SSHConnectionLostError(f"Not connected to {self.hostname}")
         
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                sftp.remove(remote_path)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to delete file {remote_path}", remote_path)
+            self._cache.invalidate_path(self.hostname, remote_path)
+            return
+        
         try:
             commands = [f'rm {self._quote_path(remote_path)}']
             stdout, stderr, returncode = self._execute_sftp_command(commands)
@@ -1110,6 +1927,15 @@ class SSHConnection:
         if not self._connected:
             raise SSHConnectionLostError(f"Not connected to {self.hostname}")
         
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                sftp.rmdir(remote_path)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to delete directory {remote_path}", remote_path)
+            self._cache.invalidate_directory(self.hostname, remote_path)
+            return
+        
         try:
             commands = [f'rmdir {self._quote_path(remote_path)}']
             stdout, stderr, returncode = self._execute_sftp_command(commands)
@@ -1164,6 +1990,15 @@ class SSHConnection:
         if not self._connected:
             raise SSHConnectionLostError(f"Not connected to {self.hostname}")
         
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                sftp.mkdir(remote_path)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to create directory {remote_path}", remote_path)
+            self._cache.invalidate_path(self.hostname, remote_path)
+            return
+        
         try:
             commands = [f'mkdir {self._quote_path(remote_path)}']
             stdout, stderr, returncode = self._execute_sftp_command(commands)
@@ -1215,6 +2050,16 @@ class SSHConnection:
         if not self._connected:
             raise SSHConnectionLostError(f"Not connected to {self.hostname}")
         
+        sftp = self._get_sftp()
+        if sftp is not None:
+            try:
+                sftp.rename(old_path, new_path)
+            except SFTPError as e:
+                raise self._sftp_error(e, f"Failed to rename {old_path} to {new_path}", old_path)
+            self._cache.invalidate_path(self.hostname, old_path)
+            self._cache.invalidate_path(self.hostname, new_path)
+            return
+        
         try:
             commands = [f'rename {self._quote_path(old_path)} {self._quote_path(new_path)}']
             stdout, stderr, returncode = self._execute_sftp_command(commands)
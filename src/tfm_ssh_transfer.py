@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+"""
+TFM SSH Transfer - Copy many files to or from one host over parallel channels
+
+A tree copy between local storage and an SSH host used to move one file at a
+time. Each small file then costs several round-trips (open, write or read,
+close) with the link idle in between, so thousands of small files are bound
+by latency rather than bandwidth. ``transfer_files`` spreads a batch of files
+over ``channels`` SFTP sessions. Every session is its own channel on the
+host's existing ControlMaster connection, so opening one needs no new login.
+``FILES_PER_CHANNEL`` files are in flight on each channel, and the requests of
+those files interleave on it. A large file still streams with the pipelined
+window of ``SFTPReader`` / ``SFTPWriter``.
+
+The calling thread coordinates. It reports the bytes moved so far and polls
+``checkpoint`` while it waits, and it receives every per-file result through
+``on_done``, so callers can drive a ``ProgressManager`` and log without
+locking. When ``checkpoint`` raises, in-flight files stop at their next chunk
+(small files just finish), their partial destinations are removed, and the
+exception propagates. When an extra channel drops, its file is retried on the
+connection's own session and the remaining files go to the other channels.
+"""
+
+import os
+import queue
+import threading
+from dataclasses import dataclass
+from typing import Callable, List, Optional
+
+from tfm_log_manager import getLogger
+from tfm_ssh_connection import SSHConnection, SSHConnectionLostError
+
+#: Files in flight on each channel; their requests interleave on the channel.
+FILES_PER_CHANNEL = 2
+#: Default number of channels per host (``SSH_TRANSFER_CHANNELS``).
+DEFAULT_CHANNELS = 4
+#: How long the coordinator waits for a result before refreshing progress.
+_POLL = 0.1
+
+logger = getLogger("SSHXfer")
+
+
+@dataclass
+class TransferJob:
+    """One file to copy. ``upload`` sends ``local_path`` to ``remote_path``;
+    otherwise the remote file is downloaded to ``local_path``. ``tag`` is
+    passed back untouched in ``on_done``."""
+    local_path: str
+    remote_path: str
+    upload: bool
+    size: int = 0
+    tag: object = None
+
+
+class _Aborted(Exception):
+    """Raised inside a worker's progress callback once the batch is stopped."""
+
+
+def channels_for_host(config, hostname: str) -> int:
+    """Channel count for ``hostname``: its ``SSH_TRANSFER_CHANNELS_PER_HOST``
+    entry, else ``SSH_TRANSFER_CHANNELS``, at least 1."""
+    per_host = getattr(config, "SSH_TRANSFER_CHANNELS_PER_HOST", None) or {}
+    count = per_host.get(hostname, getattr(config, "SSH_TRANSFER_CHANNELS", DEFAULT_CHANNELS))
+    try:
+        return max(1, int(count))
+    except (TypeError, ValueError):
+        return DEFAULT_CHANNELS
+
+
+def transfer_files(conn: SSHConnection, jobs: List[TransferJob], channels: int = DEFAULT_CHANNELS,
+                   on_done: Optional[Callable[[TransferJob, Optional[Exception]], None]] = None,
+                   on_bytes: Optional[Callable[[int, int], None]] = None,
+                   checkpoint: Optional[Callable[[], None]] = None) -> int:
+    """
+    Copy ``jobs`` between local storage and ``conn``'s host.
+
+    Args:
+        conn: Connected SSHConnection for the remote side of every job
+        jobs: Files to copy; directories must already exist on the target side
+        channels: SFTP sessions to use (the connection's own plus extra ones)
+        on_done: Called on the calling thread with (job, None) after each copy,
+                 or (job, exception) if it failed; failures don't stop the batch
+        on_bytes: Called on the calling thread with (bytes_done, bytes_total)
+        checkpoint: Polled on the calling thread; whatever it raises stops the
+                    batch and propagates
+
+    Returns:
+        Number of files copied
+    """
+    if not jobs:
+        return 0
+    primary = conn._get_sftp()
+    if primary is None:
+        # Batch-mode fallback: no sessions to spread over
+        return _transfer_serially(conn, jobs, on_done, on_bytes, checkpoint)
+
+    sessions = [primary]
+    wanted = min(max(1, channels), -(-len(jobs) // FILES_PER_CHANNEL))
+    while len(sessions) < wanted:
+        extra = conn.open_channel()
+        if extra is None:
+            break
+        sessions.append(extra)
+    try:
+        return _Batch(conn, jobs, sessions, on_done, on_bytes, checkpoint).run()
+    finally:
+        for extra in sessions[1:]:
+            extra.close()
+
+
+def _transfer_serially(conn, jobs, on_done, on_bytes, checkpoint) -> int:
+    total = sum(job.size for job in jobs)
+    done_bytes = copied = 0
+    for job in jobs:
+        if checkpoint is not None:
+            checkpoint()
+        try:
+            if job.upload:
+                conn.upload_file(job.local_path, job.remote_path)
+            else:
+                conn.download_file(job.remote_path, job.local_path)
+        except Exception as e:
+            error = e
+        else:
+            error = None
+            copied += 1
+        done_bytes += job.size
+        if on_bytes is not None:
+            on_bytes(done_bytes, total)
+        if on_done is not None:
+            on_done(job, error)
+    return copied
+
+
+class _Batch:
+    """Workers pulling jobs off one queue; results come back on another."""
+
+    def __init__(self, conn, jobs, sessions, on_done, on_bytes, checkpoint):
+        self.conn = conn
+        self.jobs = queue.Queue()
+        for job in jobs:
+            self.jobs.put(job)
+        self.results = queue.Queue()
+        self.stop = threading.Event()
+        self.lock = threading.Lock()
+        self.total = sum(job.size for job in jobs)
+        self.count = len(jobs)
+        self.bytes_done = 0
+        self.sessions = sessions
+        self._on_done = on_done
+        self._on_bytes = on_bytes
+        self._checkpoint = checkpoint
+        self._live_workers = 0
+
+    def run(self) -> int:
+        workers = [threading.Thread(target=self._work, args=(session,), daemon=True,
+                                    name='tfm-ssh-transfer')
+                   for session in self.sessions for _ in range(FILES_PER_CHANNEL)]
+        self._live_workers = len(workers)
+        for worker in workers:
+            worker.start()
+        copied = finished = 0
+        try:
+            while finished < self.count:
+                try:
+                    job, error = self.results.get(timeout=_POLL)
+                except queue.Empty:
+                    self._tick()
+                    if self._all_workers_gone():
+                        self._fail_remaining(SSHConnectionLostError(
+                            f"All transfer channels to {self.conn.hostname} were lost"))
+                    continue
+                finished += 1
+                if error is None:
+                    copied += 1
+                if self._on_done is not None:
+                    self._on_done(job, error)
+                self._tick()
+        finally:
+            self.stop.set()
+            for worker in workers:
+                worker.join()
+        return copied
+
+    def _tick(self) -> None:
+        if self._on_bytes is not None:
+            with self.lock:
+                done = self.bytes_done
+            self._on_bytes(done, self.total)
+        if self._checkpoint is not None:
+            self._checkpoint()
+
+    def _all_workers_gone(self) -> bool:
+        with self.lock:
+            return self._live_workers == 0
+
+    def _fail_remaining(self, error: Exception) -> None:
+        while True:
+            try:
+                job = self.jobs.get_nowait()
+            except queue.Empty:
+                return
+            self.results.put((job, error))
+
+    def _work(self, session) -> None:
+        try:
+            while not self.stop.is_set():
+                try:
+                    job = self.jobs.get_nowait()
+                except queue.Empty:
+                    return
+                if not self._copy(session, job):
+                    return  # channel lost
+        finally:
+            with self.lock:
+                self._live_workers -= 1
+
+    def _copy(self, session, job: TransferJob) -> bool:
+        """Copy one job and queue its result; False if ``session`` died, in
+        which case the job is retried on the connection's own session."""
+        reported = [0]
+
+        def progress(done, total):
+            if self.stop.is_set():
+                raise _Aborted()
+            with self.lock:
+                self.bytes_done += done - reported[0]
+            reported[0] = done
+
+        channel_alive = True
+        try:
+            try:
+                self._send(session, job, progress)
+            except SSHConnectionLostError:
+                if session is self.sessions[0] or self.stop.is_set():
+                    raise
+                logger.warning(f"Transfer channel to {self.conn.hostname} lost; "
+                               f"retrying {job.remote_path} on the main session")
+                channel_alive = False
+                self._reset(reported)
+                self._send(None, job, progress)
+        except Exception as e:
+            self._reset(reported)
+            if self.stop.is_set():
+                self._remove_partial(job)
+            self.results.put((job, e))
+            return channel_alive
+        with self.lock:
+            self.bytes_done += job.size - reported[0]
+        self.results.put((job, None))
+        return channel_alive
+
+    def _send(self, session, job: TransferJob, progress) -> None:
+        if job.upload:
+            self.conn.upload_file(job.local_path, job.remote_path, progress, channel=session)
+        else:
+            self.conn.download_file(job.remote_path, job.local_path, progress, channel=session)
+
+    def _reset(self, reported) -> None:
+        with self.lock:
+            self.bytes_done -= reported[0]
+        reported[0] = 0
+
+    def _remove_partial(self, job: TransferJob) -> None:
+        # download_file already removes its partial local file
+        if job.upload:
+            try:
+                self.conn.delete_file(job.remote_path)
+            except Exception:
+                pass
+        elif os.path.exists(job.local_path):
+            try:
+                os.unlink(job.local_path)
+            except OSError:
+                pass
+
+
+def connection_for(path) -> SSHConnection:
+    """The connection behind an ``ssh://`` Path."""
+    return path._impl._get_connection()
+
+
+def make_job(src, dest, size: int = 0, tag: object = None) -> TransferJob:
+    """Job copying Path ``src`` to Path ``dest``, one local and one ``ssh://``."""
+    if src.get_scheme() == "ssh":
+        return TransferJob(str(dest), src._impl.remote_path, False, size, tag)
+    return TransferJob(str(src), dest._impl.remote_path, True, size, tag)
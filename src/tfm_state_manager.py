@@ -4,8 +4,25 @@ TFM State Manager - Persistent Application State Management
 
 Manages persistent application state using SQLite database.
 Handles multiple TFM instances safely with proper locking and error handling.
+
+Each manager keeps one long-lived connection, opened on first use with its
+PRAGMAs applied once. :class:`TFMStateManager` (the app's state service) also
+keeps the whole store in memory and writes behind: a save updates the mirror
+and queues the row, and a writer thread commits everything queued in one
+transaction ``FLUSH_DELAY`` seconds after the first unsaved change. Reads are
+served from the mirror, so navigating (which saves a cursor position per
+directory change) never waits on the disk. :meth:`TFMStateManager.flush`
+commits at once; :meth:`TFMStateManager.cleanup_session` (on quit) calls it.
+A commit that fails is queued again under any newer changes and retried.
+Other instances share the file: at most every ``MIRROR_CHECK_INTERVAL``
+seconds an operation checks SQLite's ``data_version``, and if another
+connection committed since, the mirror is reloaded with this instance's
+uncommitted changes applied on top.
+Pane cursor histories are rows keyed by pane and directory rather than one
+JSON list per pane, so a save rewrites one row, not the whole history.
 """
 
+import atexit
 import sqlite3
 import json
 import time
@@ -17,6 +34,15 @@ from contextlib import contextmanager
 from typing import Any, Dict, Optional, List
 from tfm_log_manager import getLogger
 
+#: Seconds from the first unsaved change to the write-behind commit
+FLUSH_DELAY = 1.0
+
+#: Seconds between checks for commits by other instances
+MIRROR_CHECK_INTERVAL = 1.0
+
+# Legacy app_state keys that held a pane's cursor history as one JSON list
+_HISTORY_KEY_PREFIX = "path_history_"
+
 
 class StateManager:
     """
@@ -24,6 +50,7 @@ class StateManager:
     
     Features:
     - Thread-safe operations with proper locking
+    - One long-lived connection per manager
     - Multiple instance support with retry logic
     - Automatic database creation and migration
     - JSON serialization for complex data types
@@ -39,6 +66,13 @@ class StateManager:
         """
         self.logger = getLogger("State")
         
+        # Thread lock for database operations
+        self._lock = threading.RLock()
+        
+        # The connection, opened on first use (see _get_connection)
+        self._conn = None
+        self._db_lock = threading.RLock()
+        
         if db_path is None:
             self.db_path = Path.home() / '.tfm' / 'state.db'
         else:
@@ -47,9 +81,6 @@ class StateManager:
         # Ensure the directory exists
         self.db_path.parent.mkdir(parents=True, exist_ok=True)
         
-        # Thread lock for database operations
-        self._lock = threading.RLock()
-        
         # Connection settings for better concurrency
         self._connection_timeout = 30.0  # 30 seconds
         self._retry_attempts = 3
@@ -58,6 +89,30 @@ class StateManager:
         # Initialize database
         self._initialize_database()
     
+    @property
+    def db_path(self) -> Path:
+        """Path of the database file; assigning one closes the connection so
+        the next operation opens the new file."""
+        return self._db_path
+    
+    @db_path.setter
+    def db_path(self, value) -> None:
+        self._switch_database(Path(value))
+    
+    def _switch_database(self, db_path: Path) -> None:
+        self.close()
+        self._db_path = db_path
+    
+    def close(self):
+        """Close the database connection (reopened on the next operation)."""
+        with self._db_lock:
+            if self._conn is not None:
+                try:
+                    self._conn.close()
+                except Exception:
+                    pass
+                self._conn = None
+    
     def _initialize_database(self):
         """Initialize the database with required tables."""
         try:
@@ -91,26 +146,39 @@ class StateManager:
                     ON app_state(updated_at)
                 ''')
                 
-                conn.commit()
+                self._create_tables(cursor)
                 
         except Exception as e:
             self.logger.warning(f"Could not initialize state database: {e}")
     
+    def _create_tables(self, cursor):
+        """Hook for subclasses to create their own tables."""
+        pass
+    
     @contextmanager
     def _get_connection(self):
         """
-        Get a database connection with proper error handling and retry logic.
+        Get the database connection, opening it on first use. The caller
+        holds the connection lock for the duration of the ``with`` block.
         
         Yields:
             sqlite3.Connection: Database connection
         """
-        conn = None
+        with self._db_lock:
+            if self._conn is None:
+                self._conn = self._connect()
+            yield self._conn
+    
+    def _connect(self) -> sqlite3.Connection:
+        """Open the database with retry logic and apply the PRAGMAs."""
         for attempt in range(self._retry_attempts):
+            conn = None
             try:
                 conn = sqlite3.connect(
                     str(self.db_path),
                     timeout=self._connection_timeout,
-                    isolation_level=None  # Autocommit mode
+                    isolation_level=None,  # Autocommit mode
+                    check_same_thread=False  # Shared with the writer thread
                 )
                 
                 # Enable WAL mode for better concurrency
@@ -119,20 +187,16 @@ class StateManager:
                 conn.execute('PRAGMA temp_store=MEMORY')
                 conn.execute('PRAGMA mmap_size=268435456')  # 256MB
                 
-                yield conn
-                return
+                return conn
                 
             except sqlite3.OperationalError as e:
+                if conn is not None:
+                    conn.close()
                 if "database is locked" in str(e).lower() and attempt < self._retry_attempts - 1:
                     time.sleep(self._retry_delay * (2 ** attempt))  # Exponential backoff
                     continue
                 else:
                     raise
-            except Exception as e:
-                raise
-            finally:
-                if conn:
-                    conn.close()
     
     def _serialize_value(self, value: Any) -> str:
         """
@@ -321,9 +385,14 @@ class StateManager:
 class TFMStateManager(StateManager):
     """
     TFM-specific state manager with convenience methods for common state operations.
+    
+    State and pane cursor histories are read from an in-memory mirror and
+    written behind by a writer thread (see the module docstring). Sessions are
+    written through, since other instances read them.
     """
     
-    def __init__(self, instance_id: Optional[str] = None, db_path: Optional[Path] = None):
+    def __init__(self, instance_id: Optional[str] = None, db_path: Optional[Path] = None,
+                 flush_delay: float = FLUSH_DELAY):
         """
         Initialize TFM state manager.
 
@@ -331,8 +400,24 @@ class TFMStateManager(StateManager):
             instance_id: Optional instance identifier for this TFM session
             db_path: Optional custom database path. Defaults to ~/.tfm/state.db.
                 Mainly useful for tests that must not touch the real state store.
+            flush_delay: Seconds from the first unsaved change to its commit
         """
+        # Write-behind state, guarded by self._lock
+        self.flush_delay = flush_delay
+        self._mirror = None            # key -> JSON text, loaded on first use
+        self._histories = None         # pane -> {path: (visited_at, filename)}, oldest first
+        self._pending_states = {}      # key -> (JSON text, updated_at, instance_id), None deletes
+        self._pending_history = {}     # (pane, path) -> (visited_at, filename), None deletes
+        self._pending_clears = set()   # panes whose rows go before the ones above
+        self._inflight = None          # (states, history, clears) being committed
+        self._data_version = None      # PRAGMA data_version the mirror was read at
+        self._checked_at = 0.0         # monotonic time of the last data_version check
+        self._deadline = None          # monotonic time of the next commit
+        self._writer = None
+        self._flush_lock = threading.Lock()
+        
         super().__init__(db_path=db_path)
+        self._wakeup = threading.Condition(self._lock)
         
         # Generate instance ID if not provided
         if instance_id is None:
@@ -343,6 +428,333 @@ class TFMStateManager(StateManager):
         # Register this session
         self._register_session()
     
+    def _create_tables(self, cursor):
+        """Create the pane cursor history table: one row per pane and directory."""
+        cursor.execute('''
+            CREATE TABLE IF NOT EXISTS pane_history (
+                pane TEXT NOT NULL,
+                path TEXT NOT NULL,
+                filename TEXT NOT NULL,
+                visited_at REAL NOT NULL,
+                PRIMARY KEY (pane, path)
+            )
+        ''')
+        cursor.execute('''
+            CREATE INDEX IF NOT EXISTS idx_pane_history_visited
+            ON pane_history(pane, visited_at)
+        ''')
+    
+    def _switch_database(self, db_path: Path) -> None:
+        # Commit what was queued for the old file, then reload from the new one
+        if self._mirror is not None and not self.flush():
+            with self._lock:
+                # What could not be committed belongs to the old file
+                self._pending_states, self._pending_history = {}, {}
+                self._pending_clears = set()
+                self._deadline = None
+        super()._switch_database(db_path)
+        self._mirror = None
+        self._histories = None
+    
+    # Write-behind
+    
+    def _ensure_loaded(self):
+        """Load the mirror from the database on first use, and reload it once
+        another instance has committed. Caller holds self._lock."""
+        if self._mirror is not None:
+            now = time.monotonic()
+            if now - self._checked_at < MIRROR_CHECK_INTERVAL:
+                return
+            self._checked_at = now
+            try:
+                with self._get_connection() as conn:
+                    version = conn.execute('PRAGMA data_version').fetchone()[0]
+            except Exception as e:
+                self.logger.warning(f"Could not check state for changes: {e}")
+                return
+            if version == self._data_version:
+                return
+        else:
+            self._initialize_database()
+        mirror, histories = {}, {}
+        try:
+            with self._get_connection() as conn:
+                self._data_version = conn.execute('PRAGMA data_version').fetchone()[0]
+                self._checked_at = time.monotonic()
+                mirror = dict(conn.execute('SELECT key, value FROM app_state'))
+                for pane, path, filename, visited_at in conn.execute('''
+                    SELECT pane, path, filename, visited_at FROM pane_history
+                    ORDER BY visited_at, rowid
+                '''):
+                    histories.setdefault(pane, {})[path] = (visited_at, filename)
+        except Exception as e:
+            self.logger.warning(f"Could not load state: {e}")
+        # Changes not committed yet (or being committed) still stand
+        batches = [(self._pending_states, self._pending_history, self._pending_clears)]
+        if self._inflight is not None:
+            batches.insert(0, self._inflight)
+        for states, history, clears in batches:
+            for key, row in states.items():
+                if row is None:
+                    mirror.pop(key, None)
+                else:
+                    mirror[key] = row[0]
+            for pane in clears:
+                histories[pane] = {}
+            for (pane, path), entry in history.items():
+                pane_history = histories.setdefault(pane, {})
+                pane_history.pop(path, None)
+                if entry is not None:
+                    pane_history[path] = entry
+        self._mirror, self._histories = mirror, histories
+        
+        # Histories saved as one JSON list per pane move into rows
+        for key in [k for k in mirror if k.startswith(_HISTORY_KEY_PREFIX)]:
+            try:
+                legacy = self._deserialize_value(mirror[key])
+            except ValueError:
+                legacy = []
+            merged = _history_entries(legacy)
+            for path, entry in histories.get(key[len(_HISTORY_KEY_PREFIX):], {}).items():
+                merged.pop(path, None)
+                merged[path] = entry
+            self._set_history(key[len(_HISTORY_KEY_PREFIX):], merged)
+            del mirror[key]
+            self._pending_states[key] = None
+            self._schedule_flush()
+    
+    def _set_history(self, pane_name: str, entries: Dict[str, tuple]):
+        """Replace a pane's history. Caller holds self._lock."""
+        self._histories[pane_name] = entries
+        for key in [k for k in self._pending_history if k[0] == pane_name]:
+            del self._pending_history[key]
+        self._pending_clears.add(pane_name)
+        for path, entry in entries.items():
+            self._pending_history[(pane_name, path)] = entry
+    
+    def _schedule_flush(self):
+        """Start the commit clock and the writer thread. Caller holds self._lock."""
+        if self._deadline is None:
+            self._deadline = time.monotonic() + self.flush_delay
+        if self._writer is None:
+            self._writer = threading.Thread(target=self._write_behind,
+                                            name="tfm-state-writer", daemon=True)
+            self._writer.start()
+    
+    def _write_behind(self):
+        """Writer thread: commit at each deadline, exit once nothing is queued."""
+        while True:
+            with self._lock:
+                while self._deadline is not None:
+                    delay = self._deadline - time.monotonic()
+                    if delay <= 0:
+                        break
+                    self._wakeup.wait(delay)
+                if self._deadline is None:
+                    self._writer = None
+                    return
+            self.flush()
+    
+    def flush(self) -> bool:
+        """
+        Commit every queued change now, in one transaction.
+        
+        Returns:
+            bool: True if successful (or nothing was queued)
+        """
+        with self._flush_lock:
+            with self._lock:
+                states, history, clears = (self._pending_states, self._pending_history,
+                                           self._pending_clears)
+                self._pending_states, self._pending_history = {}, {}
+                self._pending_clears = set()
+                self._deadline = None
+                self._wakeup.notify_all()
+                if not (states or history or clears):
+                    return True
+                self._inflight = (states, history, clears)
+            try:
+                with self._get_connection() as conn:
+                    conn.execute('BEGIN')
+                    try:
+                        conn.executemany('DELETE FROM pane_history WHERE pane = ?',
+                                         [(pane,) for pane in clears])
+                        conn.executemany('''
+                            INSERT OR REPLACE INTO app_state
+                            (key, value, updated_at, instance_id)
+                            VALUES (?, ?, ?, ?)
+                        ''', [(key,) + row for key, row in states.items() if row is not None])
+                        conn.executemany('DELETE FROM app_state WHERE key = ?',
+                                         [(key,) for key, row in states.items() if row is None])
+                        conn.executemany('''
+                            INSERT OR REPLACE INTO pane_history
+                            (pane, path, filename, visited_at)
+                            VALUES (?, ?, ?, ?)
+                        ''', [(pane, path, entry[1], entry[0])
+                              for (pane, path), entry in history.items() if entry is not None])
+                        conn.executemany('DELETE FROM pane_history WHERE pane = ? AND path = ?',
+                                         [key for key, entry in history.items() if entry is None])
+                        conn.execute('COMMIT')
+                    except BaseException:
+                        conn.execute('ROLLBACK')
+                        raise
+                with self._lock:
+                    self._inflight = None
+                return True
+            except Exception as e:
+                self.logger.warning(f"Could not save state: {e}")
+                with self._lock:
+                    self._inflight = None
+                    self._requeue(states, history, clears)
+                return False
+    
+    def _requeue(self, states, history, clears):
+        """Queue a batch whose commit failed again, under the changes queued
+        since it was taken, and schedule a retry. Caller holds self._lock."""
+        for key, row in states.items():
+            self._pending_states.setdefault(key, row)
+        for key, entry in history.items():
+            if key[0] not in self._pending_clears:  # a newer clear drops it
+                self._pending_history.setdefault(key, entry)
+        self._pending_clears |= clears
+        self._schedule_flush()
+    
+    def close(self):
+        """Commit queued changes and close the database connection. Changes
+        that could not be committed stay queued for an explicit flush."""
+        if getattr(self, '_mirror', None) is not None and not self.flush():
+            with self._lock:
+                self._deadline = None
+                self._wakeup.notify_all()
+        super().close()
+    
+    # State operations, served from the mirror
+    
+    def set_state(self, key: str, value: Any, instance_id: Optional[str] = None) -> bool:
+        """
+        Set a state value. The mirror is updated at once; the database at the
+        next commit.
+        
+        Args:
+            key: State key
+            value: State value (will be JSON serialized)
+            instance_id: Optional instance identifier
+            
+        Returns:
+            bool: True if successful, False otherwise
+        """
+        try:
+            if key.startswith(_HISTORY_KEY_PREFIX):
+                entries = _history_entries(value)
+            else:
+                serialized_value = self._serialize_value(value)
+        except Exception as e:
+            self.logger.warning(f"Could not set state '{key}': {e}")
+            return False
+        
+        with self._lock:
+            self._ensure_loaded()
+            if key.startswith(_HISTORY_KEY_PREFIX):
+                self._set_history(key[len(_HISTORY_KEY_PREFIX):], entries)
+            else:
+                self._mirror[key] = serialized_value
+                self._pending_states[key] = (serialized_value, time.time(), instance_id)
+            self._schedule_flush()
+        return True
+    
+    def get_state(self, key: str, default: Any = None) -> Any:
+        """
+        Get a state value. ``path_history_<pane>`` keys read a pane's cursor
+        history as ``[timestamp, path, filename]`` lists, oldest first.
+        
+        Args:
+            key: State key
+            default: Default value if key not found
+            
+        Returns:
+            Any: State value or default
+        """
+        with self._lock:
+            self._ensure_loaded()
+            if key.startswith(_HISTORY_KEY_PREFIX):
+                history = self._histories.get(key[len(_HISTORY_KEY_PREFIX):])
+                if not history:
+                    return default
+                return [[visited_at, path, filename]
+                        for path, (visited_at, filename) in history.items()]
+            serialized_value = self._mirror.get(key)
+        
+        if serialized_value is None:
+            return default
+        try:
+            return self._deserialize_value(serialized_value)
+        except Exception as e:
+            self.logger.warning(f"Could not get state '{key}': {e}")
+            return default
+    
+    def delete_state(self, key: str) -> bool:
+        """
+        Delete a state value.
+        
+        Args:
+            key: State key to delete
+            
+        Returns:
+            bool: True if successful, False otherwise
+        """
+        with self._lock:
+            self._ensure_loaded()
+            if key.startswith(_HISTORY_KEY_PREFIX):
+                self._set_history(key[len(_HISTORY_KEY_PREFIX):], {})
+            else:
+                self._mirror.pop(key, None)
+                self._pending_states[key] = None
+            self._schedule_flush()
+        return True
+    
+    def get_all_states(self, prefix: Optional[str] = None) -> Dict[str, Any]:
+        """
+        Get all state values, optionally filtered by key prefix.
+        
+        Args:
+            prefix: Optional key prefix filter
+            
+        Returns:
+            Dict[str, Any]: Dictionary of all matching state values
+        """
+        with self._lock:
+            self._ensure_loaded()
+            items = sorted((key, value) for key, value in self._mirror.items()
+                           if not prefix or key.startswith(prefix))
+        
+        result = {}
+        for key, value in items:
+            try:
+                result[key] = self._deserialize_value(value)
+            except Exception as e:
+                self.logger.warning(f"Could not deserialize state '{key}': {e}")
+        return result
+    
+    def clear_all_states(self, prefix: Optional[str] = None) -> bool:
+        """
+        Clear all state values, optionally filtered by key prefix.
+        
+        Args:
+            prefix: Optional key prefix filter
+            
+        Returns:
+            bool: True if successful, False otherwise
+        """
+        with self._lock:
+            self._ensure_loaded()
+            for key in [k for k in self._mirror if not prefix or k.startswith(prefix)]:
+                del self._mirror[key]
+                self._pending_states[key] = None
+            self._schedule_flush()
+        return True
+    
+    # Sessions
+    
     def _register_session(self):
         """Register this TFM session in the sessions table."""
         try:
@@ -374,7 +786,7 @@ class TFMStateManager(StateManager):
             self.logger.warning(f"Could not update session heartbeat: {e}")
     
     def cleanup_session(self):
-        """Clean up this session from the sessions table."""
+        """Clean up this session from the sessions table and commit queued state."""
         try:
             with self._get_connection() as conn:
                 cursor = conn.cursor()
@@ -382,6 +794,7 @@ class TFMStateManager(StateManager):
                 
         except Exception as e:
             self.logger.warning(f"Could not cleanup session: {e}")
+        self.flush()
     
     def get_active_sessions(self, timeout_seconds: float = 300.0) -> List[Dict[str, Any]]:
         """
@@ -612,6 +1025,9 @@ class TFMStateManager(StateManager):
         """
         Save cursor position for a specific pane and directory path.
         
+        Moves the directory to the newest end of the pane's history and drops
+        the oldest entries past the limit; the rows are written behind.
+        
         Args:
             pane_name: Name of the pane ('left' or 'right')
             directory_path: Directory path
@@ -622,24 +1038,6 @@ class TFMStateManager(StateManager):
             bool: True if successful
         """
         try:
-            # Use pane-specific key
-            state_key = f"path_history_{pane_name}"
-            
-            # Get current history for this pane (list of [timestamp, path, filename])
-            history = self.get_state(state_key, [])
-            
-            # Ensure it's a list (for backward compatibility with old dict format)
-            if isinstance(history, dict):
-                # Convert old dict format to new list format
-                history = [[time.time(), path, fname] for path, fname in history.items()]
-            
-            # Remove any existing entry for this directory path
-            history = [entry for entry in history if entry[1] != directory_path]
-            
-            # Add new entry at the end (most recent)
-            current_time = time.time()
-            history.append([current_time, directory_path, filename])
-            
             # Determine maximum entries from config or parameter
             if max_entries is None:
                 # Try to get from config, default to 100
@@ -654,11 +1052,23 @@ class TFMStateManager(StateManager):
                     self.logger.warning(f"Could not get config for history limit: {e}")
                     max_entries = 100
             
-            # Limit the size of the history (keep most recent entries)
-            if len(history) > max_entries:
-                history = history[-max_entries:]
-            
-            return self.set_state(state_key, history, self.instance_id)
+            with self._lock:
+                self._ensure_loaded()
+                history = self._histories.setdefault(pane_name, {})
+                
+                # Re-insert so the entry moves to the end (most recent)
+                history.pop(directory_path, None)
+                entry = history[directory_path] = (time.time(), filename)
+                self._pending_history[(pane_name, directory_path)] = entry
+                
+                # Limit the size of the history (keep most recent entries)
+                while len(history) > max(1, max_entries):
+                    oldest = next(iter(history))
+                    del history[oldest]
+                    self._pending_history[(pane_name, oldest)] = None
+                
+                self._schedule_flush()
+            return True
             
         except Exception as e:
             self.logger.warning(f"Could not save position for {pane_name} pane: {e}")
@@ -675,25 +1085,10 @@ class TFMStateManager(StateManager):
         Returns:
             Optional[str]: Filename where cursor was positioned, or None if not found
         """
-        try:
-            # Use pane-specific key
-            state_key = f"path_history_{pane_name}"
-            history = self.get_state(state_key, [])
-            
-            # Handle backward compatibility with old dict format
-            if isinstance(history, dict):
-                return history.get(directory_path)
-            
-            # Search through the list for the directory path
-            for entry in history:
-                if len(entry) >= 3 and entry[1] == directory_path:
-                    return entry[2]  # Return filename
-            
-            return None
-            
-        except Exception as e:
-            self.logger.warning(f"Could not load position for {pane_name} pane: {e}")
-            return None
+        with self._lock:
+            self._ensure_loaded()
+            entry = self._histories.get(pane_name, {}).get(directory_path)
+        return entry[1] if entry else None
     
     def get_pane_cursor_positions(self, pane_name: str) -> Dict[str, str]:
         """
@@ -705,26 +1100,10 @@ class TFMStateManager(StateManager):
         Returns:
             Dict[str, str]: Dictionary mapping directory paths to filenames
         """
-        try:
-            # Use pane-specific key
-            state_key = f"path_history_{pane_name}"
-            history = self.get_state(state_key, [])
-            
-            # Handle backward compatibility with old dict format
-            if isinstance(history, dict):
-                return history
-            
-            # Convert list format to dictionary
-            result = {}
-            for entry in history:
-                if len(entry) >= 3:
-                    result[entry[1]] = entry[2]  # path -> filename
-            
-            return result
-            
-        except Exception as e:
-            self.logger.warning(f"Could not load positions for {pane_name} pane: {e}")
-            return {}
+        with self._lock:
+            self._ensure_loaded()
+            return {path: filename
+                    for path, (_, filename) in self._histories.get(pane_name, {}).items()}
     
     def get_ordered_pane_history(self, pane_name: str) -> List[Dict[str, Any]]:
         """
@@ -736,39 +1115,10 @@ class TFMStateManager(StateManager):
         Returns:
             List[Dict[str, Any]]: List of history entries with timestamp, path, and filename
         """
-        try:
-            # Use pane-specific key
-            state_key = f"path_history_{pane_name}"
-            history = self.get_state(state_key, [])
-            
-            # Handle backward compatibility with old dict format
-            if isinstance(history, dict):
-                # Convert to list format with current timestamp
-                current_time = time.time()
-                return [
-                    {
-                        'timestamp': current_time,
-                        'path': path,
-                        'filename': filename
-                    }
-                    for path, filename in history.items()
-                ]
-            
-            # Convert list format to structured format
-            result = []
-            for entry in history:
-                if len(entry) >= 3:
-                    result.append({
-                        'timestamp': entry[0],
-                        'path': entry[1],
-                        'filename': entry[2]
-                    })
-            
-            return result
-            
-        except Exception as e:
-            self.logger.warning(f"Could not load history for {pane_name} pane: {e}")
-            return []
+        with self._lock:
+            self._ensure_loaded()
+            return [{'timestamp': visited_at, 'path': path, 'filename': filename}
+                    for path, (visited_at, filename) in self._histories.get(pane_name, {}).items()]
     
     def clear_pane_history(self, pane_name: str) -> bool:
         """
@@ -780,13 +1130,7 @@ class TFMStateManager(StateManager):
         Returns:
             bool: True if successful
         """
-        try:
-            # Use pane-specific key
-            state_key = f"path_history_{pane_name}"
-            return self.set_state(state_key, [], self.instance_id)
-        except Exception as e:
-            self.logger.warning(f"Could not clear history for {pane_name} pane: {e}")
-            return False
+        return self.delete_state(f"{_HISTORY_KEY_PREFIX}{pane_name}")
     
     def cleanup_non_existing_directories(self) -> bool:
         """
@@ -803,72 +1147,61 @@ class TFMStateManager(StateManager):
         try:
             from tfm_path import Path
             
-            success = True
             cleaned_count = 0
             skipped_remote_count = 0
             
             # Clean up both left and right pane histories
             for pane_name in ['left', 'right']:
-                try:
-                    # Get current history for this pane
-                    state_key = f"path_history_{pane_name}"
-                    history = self.get_state(state_key, [])
-                    
-                    if not history:
-                        continue
-                    
-                    # Handle backward compatibility with old dict format
-                    if isinstance(history, dict):
-                        # Convert to list format and filter
-                        filtered_entries = []
-                        for path, filename in history.items():
-                            path_obj = Path(path)
-                            # Skip existence check for remote paths to improve performance
-                            if path_obj.is_remote():
-                                filtered_entries.append([time.time(), path, filename])
-                                skipped_remote_count += 1
-                            elif path_obj.exists():
-                                filtered_entries.append([time.time(), path, filename])
-                            else:
-                                cleaned_count += 1
-                        history = filtered_entries
-                    else:
-                        # Filter list format
-                        original_count = len(history)
-                        filtered_history = []
-                        for entry in history:
-                            if len(entry) >= 3:
-                                path_obj = Path(entry[1])
-                                # Skip existence check for remote paths to improve performance
-                                if path_obj.is_remote():
-                                    filtered_history.append(entry)
-                                    skipped_remote_count += 1
-                                elif path_obj.exists():
-                                    filtered_history.append(entry)
-                                else:
-                                    cleaned_count += 1
-                        history = filtered_history
-                    
-                    # Save the cleaned history back
-                    if not self.set_state(state_key, history, self.instance_id):
-                        success = False
-                        
-                except Exception as e:
-                    self.logger.warning(f"Could not clean history for {pane_name} pane: {e}")
-                    success = False
+                with self._lock:
+                    self._ensure_loaded()
+                    paths = list(self._histories.get(pane_name, {}))
+                
+                # Check existence without holding the lock
+                gone = []
+                for path in paths:
+                    path_obj = Path(path)
+                    # Skip existence check for remote paths to improve performance
+                    if path_obj.is_remote():
+                        skipped_remote_count += 1
+                    elif not path_obj.exists():
+                        gone.append(path)
+                
+                with self._lock:
+                    history = self._histories.get(pane_name, {})
+                    for path in gone:
+                        if history.pop(path, None) is not None:
+                            self._pending_history[(pane_name, path)] = None
+                            cleaned_count += 1
+                    if gone:
+                        self._schedule_flush()
             
             if cleaned_count > 0:
                 self.logger.info(f"Cleaned up {cleaned_count} non-existing directory entries from cursor history")
             if skipped_remote_count > 0:
                 self.logger.info(f"Skipped existence check for {skipped_remote_count} remote storage entries")
             
-            return success
+            return True
             
         except Exception as e:
             self.logger.warning(f"Could not cleanup non-existing directories: {e}")
             return False
 
 
+def _history_entries(value) -> Dict[str, tuple]:
+    """A pane history in its legacy JSON form (``[[timestamp, path, filename],
+    ...]`` or the older ``{path: filename}``) as ``{path: (timestamp,
+    filename)}``, oldest first."""
+    if isinstance(value, dict):
+        now = time.time()
+        return {path: (now, filename) for path, filename in value.items()}
+    entries = {}
+    for entry in value or ():
+        if len(entry) >= 3:
+            entries.pop(entry[1], None)
+            entries[entry[1]] = (entry[0], entry[2])
+    return entries
+
+
 # Global state manager instance
 _state_manager = None
 
@@ -883,6 +1216,8 @@ def get_state_manager() -> TFMStateManager:
     global _state_manager
     if _state_manager is None:
         _state_manager = TFMStateManager()
+        # Commit what the writer thread has not reached yet
+        atexit.register(_state_manager.flush)
     return _state_manager
 
 
@@ -891,4 +1226,5 @@ def cleanup_state_manager():
     global _state_manager
     if _state_manager is not None:
         _state_manager.cleanup_session()
+        _state_manager.close()
         _state_manager = None
\ No newline at end of file
@@ -8,6 +8,8 @@ Common string formatting functions used throughout TFM.
 import re
 from pathlib import Path
 
+from tfm_text_width import display_width, elide_middle, fit_prefix, fit_suffix
+
 
 def format_size(size: int, compact: bool = False) -> str:
     """Format file size in human-readable format.
@@ -74,10 +76,13 @@ def _fit_prefix(text: str, budget: float, measure) -> str:
 
     Assumes ``measure`` is monotonic in string length (true for any character-
     or glyph-width metric), which lets this binary-search instead of walking
-    one character at a time.
+    one character at a time. Cell widths (``display_width``) are searched
+    within a single measurement of ``text`` (tfm_text_width).
     """
     if budget <= 0:
         return ''
+    if measure is display_width:
+        return fit_prefix(text, budget)
     if measure(text) <= budget:
         return text
     lo, hi = 0, len(text)
@@ -94,6 +99,8 @@ def _fit_suffix(text: str, budget: float, measure) -> str:
     """Longest suffix of ``text`` that measures at most ``budget``."""
     if budget <= 0:
         return ''
+    if measure is display_width:
+        return fit_suffix(text, budget)
     if measure(text) <= budget:
         return text
     lo, hi = 0, len(text)
@@ -125,8 +132,10 @@ def abbreviate_path(path_str: str, avail: float, measure=None,
         path_str: The location to display.
         avail: Budget in the same units ``measure`` returns.
         measure: Callable mapping a string to its display width. Defaults to
-            ``len`` (character cells); pass ``ctx.measure_text`` on a vector
-            backend, where glyphs are not uniformly wide.
+            ``display_width`` (terminal cells, wide characters counting two);
+            pass ``tfm_text_width.cell_measure(ctx)``, which is
+            ``ctx.measure_text`` on a vector backend where glyphs are not
+            uniformly wide. With cell widths each component is measured once.
         home: Home directory to contract to ``~``. Defaults to ``Path.home()``;
             pass explicitly in tests to avoid depending on the environment.
 
@@ -142,7 +151,7 @@ def abbreviate_path(path_str: str, avail: float, measure=None,
         's3://bucket/…/leaf'
     """
     if measure is None:
-        measure = len
+        measure = display_width
     if avail <= 0:
         return ''
 
@@ -187,10 +196,23 @@ def abbreviate_path(path_str: str, avail: float, measure=None,
     # Keep the longest run of trailing components that still fits. Trailing
     # components are the ones nearest where the user is, so they are the ones
     # worth keeping when something has to go.
-    for take in range(len(components) - 2, 0, -1):
-        candidate = scheme + '/'.join([anchor, _ELLIPSIS, *components[-take:]])
-        if measure(candidate) <= avail:
-            return candidate
+    if measure is display_width:
+        # Cell widths add up: find the longest run from the component widths
+        # (separators included) instead of measuring each candidate string.
+        width = display_width(scheme) + display_width(anchor) + 1 + display_width(_ELLIPSIS)
+        fits = 0
+        for take in range(1, len(components) - 1):
+            width += 1 + display_width(components[-take])
+            if width > avail:
+                break
+            fits = take
+        if fits:
+            return scheme + '/'.join([anchor, _ELLIPSIS, *components[-fits:]])
+    else:
+        for take in range(len(components) - 2, 0, -1):
+            candidate = scheme + '/'.join([anchor, _ELLIPSIS, *components[-take:]])
+            if measure(candidate) <= avail:
+                return candidate
 
     # Even anchor + leaf alone overflows; try dropping the anchor too.
     candidate = scheme + '/'.join([anchor, _ELLIPSIS, leaf])
@@ -206,6 +228,8 @@ def abbreviate_path(path_str: str, avail: float, measure=None,
 
 def _elide_middle(text: str, avail: float, measure) -> str:
     """Character-level middle cut, for when no component boundary helps."""
+    if measure is display_width:
+        return elide_middle(text, avail, _ELLIPSIS)
     if measure(text) <= avail:
         return text
     ell_w = measure(_ELLIPSIS)
@@ -325,13 +325,21 @@ class ProgressDialog(Widget):
         if item:
             ctx.draw_text(2, 2.2, _clip(item, int(width)), text_style)
 
-        # Primary bar: items processed / total.
-        self._bar.value = self.task.progress.get_progress_percentage() / 100.0
+        # Primary bar: items processed / total. A task that cannot know its item
+        # count up front (a compressed tar stream) reports total 0; the bar then
+        # follows the byte progress instead.
+        bc, bt = op.get("file_bytes_copied", 0), op.get("file_bytes_total", 0)
+        if op["total_items"] > 0:
+            self._bar.value = self.task.progress.get_progress_percentage() / 100.0
+            items = f"{op['processed_items']} / {op['total_items']} items"
+        else:
+            self._bar.value = min(1.0, bc / bt) if bt else 0.0
+            items = f"{op['processed_items']} items"
         ctx.draw_child(self._bar, 2, 3.4, width, 1.0)
-        ctx.draw_text(2, 4.3, f"{op['processed_items']} / {op['total_items']} items", text_style)
+        ctx.draw_text(2, 4.3, items, text_style)
 
-        # Secondary bar: bytes of the current file (only when a total is known).
-        bc, bt = op.get("file_bytes_copied", 0), op.get("file_bytes_total", 0)
+        # Secondary bar: bytes of the current file, or of the whole archive for
+        # an extraction (only when a total is known).
         if bt > 0:
             self._byte_bar.value = min(1.0, bc / bt) if bt else 0.0
             ctx.draw_child(self._byte_bar, 2, 5.7, width, 1.0)
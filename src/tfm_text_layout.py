@@ -61,9 +61,10 @@ from dataclasses import dataclass
 from typing import List, Union, Optional
 import unicodedata
 
-# PuiKit text helpers for wide-character support. display_width is aliased to
-# the historical name get_display_width to avoid churning every call site.
-from puikit.text import display_width as get_display_width, truncate_to_width
+# PuiKit's cell widths for wide-character support, cached per string by
+# tfm_text_width. display_width is aliased to the historical name
+# get_display_width to avoid churning every call site.
+from tfm_text_width import display_width as get_display_width, fit_suffix, truncate_to_width
 
 # TFM unified logging system
 from tfm_log_manager import getLogger
@@ -75,8 +76,9 @@ logger = getLogger("TextLayout")
 # ============================================================================
 # Wide Character Support Utilities
 # ============================================================================
-# Note: We use PuiKit's truncate_to_width() directly with ellipsis="" for pure
-# truncation. No wrapper needed - it handles the wide-character edge cases.
+# Note: We use tfm_text_width's truncate_to_width() directly with ellipsis="" for
+# pure truncation and fit_suffix() to keep a right portion. Both measure the text
+# once and binary-search its cumulative widths, never splitting a grapheme cluster.
 
 
 @dataclass
@@ -305,18 +307,7 @@ class AbbreviationSegment(TextSegment):
             if target_width <= 0:
                 return ""
             
-            # Start from the end and work backwards
-            result = ""
-            current_width = 0
-            
-            for char in reversed(text):
-                char_width = get_display_width(char)
-                if current_width + char_width > target_width:
-                    break
-                result = char + result
-                current_width += char_width
-            
-            return result
+            return fit_suffix(text, target_width)
             
         except Exception as e:
             logger.error(f"_truncate_from_right failed: {e}")
@@ -427,12 +418,18 @@ class FilepathSegment(TextSegment):
             # This matches the legacy FilepathStrategy behavior
             num_dirs = len(directories)
             
+            # Candidates are measured as the sum of their parts: each component
+            # is measured once (and cached), not each joined candidate string
+            separator_width = get_display_width(separator)
+            
+            def parts_width(parts):
+                return sum(map(get_display_width, parts)) + separator_width * (len(parts) - 1)
+            
             # First try: keep all directories (no ellipsis)
             if num_dirs > 0:
-                test_path = separator.join(directories) + separator + filename
-                path_width = get_display_width(test_path)
+                path_width = parts_width(directories) + separator_width + get_display_width(filename)
                 if path_width <= target_width:
-                    return test_path
+                    return separator.join(directories) + separator + filename
             
             # Try removing directories from the center outward, one at a time
             # Generate removal order: center first, then alternate RIGHT-LEFT to maintain balance
@@ -520,10 +517,8 @@ class FilepathSegment(TextSegment):
                 else:
                     path_parts = [ellipsis, filename]
                 
-                test_path = separator.join(path_parts)
-                path_width = get_display_width(test_path)
-                if path_width <= target_width:
-                    return test_path
+                if parts_width(path_parts) <= target_width:
+                    return separator.join(path_parts)
             
             # All directories removed, just ellipsis + separator + filename
             abbreviated_path = ellipsis + separator + filename
@@ -631,17 +626,7 @@ class FilepathSegment(TextSegment):
             if target_width <= 0:
                 return ""
             
-            result = ""
-            current_width = 0
-            
-            for char in reversed(text):
-                char_width = get_display_width(char)
-                if current_width + char_width > target_width:
-                    break
-                result = char + result
-                current_width += char_width
-            
-            return result
+            return fit_suffix(text, target_width)
             
         except Exception as e:
             logger.error(f"_truncate_from_right failed: {e}")
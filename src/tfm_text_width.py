@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""
+TFM Text Width - Display widths in terminal cells, measured once per string
+
+Text layout (tfm_text_layout segments) and path abbreviation
+(tfm_str_format.abbreviate_path) used to fit text by calling a measure function
+over and over: once per candidate prefix, or once per character while trimming
+from the right. This module measures a string once, into cumulative cell widths
+at grapheme-cluster boundaries, and answers every later question from that:
+
+- ``display_width(text)``: printable ASCII is ``len(text)`` (``str.isascii``
+  and ``str.isprintable`` scan in C, no per-character work); other strings go
+  through the cluster scan.
+- ``fit_prefix(text, width)`` / ``fit_suffix(text, width)``: the longest
+  prefix / suffix within ``width``, by binary search over the cumulative widths.
+- ``truncate_to_width`` and ``elide_middle`` build on those.
+
+The cells a cluster takes are PuiKit's (``puikit.text.display_width``), the
+widths the renderer draws with, so what is measured here lines up with what is
+drawn. Each distinct cluster is measured through PuiKit once and memoized; in
+practice that is one call per distinct character displayed.
+
+This module only decides where clusters begin and end, so truncation never
+splits one: a base character absorbs combining marks, variation selectors,
+emoji modifiers, Hangul medial and final jamo, and tag characters; ZWJ joins
+the next character; a pair of regional indicators is one flag.
+
+Scans are cached (``_scan``), since a frame measures the same names and path
+components repeatedly.
+"""
+
+from bisect import bisect_left, bisect_right
+from functools import lru_cache
+from typing import Callable, Dict, Tuple
+import unicodedata
+
+from puikit.text import display_width as _puikit_width
+
+ELLIPSIS = "…"
+
+_ZWJ = 0x200D
+
+# Characters that extend the cluster before them, beyond the marks found by
+# category
+_EXTEND_RANGES = (
+    (0x1160, 0x11FF),    # Hangul Jungseong / Jongseong (conjoining jamo)
+    (0xD7B0, 0xD7FF),    # Hangul Jamo Extended-B
+    (0xFE00, 0xFE0F),    # variation selectors
+    (0x1F3FB, 0x1F3FF),  # emoji skin-tone modifiers
+    (0xE0020, 0xE007F),  # tag characters (subdivision flags)
+    (0xE0100, 0xE01EF),  # variation selectors supplement
+)
+
+_REGIONAL_INDICATOR = (0x1F1E6, 0x1F1FF)
+
+# Per non-ASCII code point: does it extend the cluster before it
+_extends: Dict[str, bool] = {}
+# Per cluster: PuiKit's width for it
+_cluster_width: Dict[str, int] = {}
+
+
+def _is_extend(ch: str) -> bool:
+    extend = _extends.get(ch)
+    if extend is None:
+        cp = ord(ch)
+        extend = (cp == _ZWJ or unicodedata.category(ch) in ('Mn', 'Me', 'Mc')
+                  or any(lo <= cp <= hi for lo, hi in _EXTEND_RANGES))
+        _extends[ch] = extend
+    return extend
+
+
+def _width_of(cluster: str) -> int:
+    width = _cluster_width.get(cluster)
+    if width is None:
+        width = _cluster_width[cluster] = _puikit_width(cluster)
+    return width
+
+
+@lru_cache(maxsize=4096)
+def _scan(text: str) -> Tuple[Tuple[int, ...], Tuple[int, ...]]:
+    """``(ends, widths)``: the end offset of each grapheme cluster and the
+    cumulative width up to and including it."""
+    ends = []
+    widths = []
+    total = 0
+    n = len(text)
+    i = 0
+    while i < n:
+        start = i
+        ch = text[i]
+        cp = ord(ch)
+        i += 1
+        if _REGIONAL_INDICATOR[0] <= cp <= _REGIONAL_INDICATOR[1]:
+            # A flag is a pair of regional indicators
+            if i < n and _REGIONAL_INDICATOR[0] <= ord(text[i]) <= _REGIONAL_INDICATOR[1]:
+                i += 1
+        elif ch == '\r' and i < n and text[i] == '\n':
+            i += 1
+        while i < n and not text[i].isascii() and _is_extend(text[i]):
+            i += 1
+            if ord(text[i - 1]) == _ZWJ and i < n:
+                i += 1  # the joined character is drawn as part of this cluster
+        if i - start == 1 and ch.isascii() and ch.isprintable():
+            total += 1
+        else:
+            total += _width_of(text[start:i])
+        ends.append(i)
+        widths.append(total)
+    return tuple(ends), tuple(widths)
+
+
+def display_width(text: str) -> int:
+    """Cells ``text`` takes in a terminal."""
+    if text.isascii() and text.isprintable():
+        return len(text)
+    widths = _scan(text)[1]
+    return widths[-1] if widths else 0
+
+
+def fit_prefix(text: str, width: float) -> str:
+    """Longest prefix of ``text`` that fits in ``width`` cells, ending on a
+    cluster boundary."""
+    if width <= 0:
+        return ""
+    if text.isascii() and text.isprintable():
+        return text[:int(width)]
+    ends, widths = _scan(text)
+    k = bisect_right(widths, width)
+    return text[:ends[k - 1]] if k else ""
+
+
+def fit_suffix(text: str, width: float) -> str:
+    """Longest suffix of ``text`` that fits in ``width`` cells, starting on a
+    cluster boundary."""
+    if width <= 0:
+        return ""
+    if text.isascii() and text.isprintable():
+        w = int(width)
+        return text[len(text) - w:] if w < len(text) else text
+    ends, widths = _scan(text)
+    if not widths or widths[-1] <= width:
+        return text
+    # Drop the fewest leading clusters that leave at most ``width`` cells
+    return text[ends[bisect_left(widths, widths[-1] - width)]:]
+
+
+def truncate_to_width(text: str, width: float, ellipsis: str = ELLIPSIS) -> str:
+    """``text`` if it fits in ``width`` cells, else its longest prefix that
+    fits with ``ellipsis`` appended (or without it when even the ellipsis
+    does not fit)."""
+    if display_width(text) <= width:
+        return text
+    ellipsis_width = display_width(ellipsis)
+    if not ellipsis or ellipsis_width > width:
+        return fit_prefix(text, width)
+    return fit_prefix(text, width - ellipsis_width) + ellipsis
+
+
+def elide_middle(text: str, width: float, ellipsis: str = ELLIPSIS) -> str:
+    """``text`` with its middle replaced by ``ellipsis`` to fit ``width``
+    cells; the left part gets half the room, the right part the rest."""
+    if display_width(text) <= width:
+        return text
+    ellipsis_width = display_width(ellipsis)
+    if ellipsis_width > width:
+        return fit_prefix(text, width)
+    budget = width - ellipsis_width
+    left = fit_prefix(text, budget / 2)
+    right = fit_suffix(text, budget - display_width(left))
+    return left + ellipsis + right
+
+
+def cell_measure(ctx) -> Callable[[str], float]:
+    """The measure function for drawing on ``ctx``: ``display_width`` on a
+    cell grid, where it equals the backend's measure and lets callers take the
+    fast paths, else ``ctx.measure_text`` (proportional glyphs)."""
+    if getattr(ctx, "vector_shapes", True):
+        return ctx.measure_text
+    return display_width
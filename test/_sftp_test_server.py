@@ -0,0 +1,71 @@
+"""
+Local OpenSSH sftp-server for the SFTP tests (test_sftp_client,
+test_ssh_transfer, test_ssh_tree_scan)
+
+The server runs over pipes, so no ssh daemon or network is needed.
+``SFTP_SERVER`` is None where it is not installed; the tests skip on that.
+"""
+
+import os
+import queue
+import shutil
+import subprocess
+import threading
+import time
+
+
+def find_sftp_server():
+    candidates = [shutil.which('sftp-server'),
+                  '/usr/lib/openssh/sftp-server',
+                  '/usr/libexec/sftp-server',
+                  '/usr/libexec/openssh/sftp-server',
+                  '/usr/lib/ssh/sftp-server']
+    for path in candidates:
+        if path and os.access(path, os.X_OK):
+            return path
+    return None
+
+
+SFTP_SERVER = find_sftp_server()
+
+
+class DelayedServer:
+    """sftp-server whose replies are held back by ``delay`` seconds, standing
+    in for a link's round-trip time. Quacks like the Popen SFTPClient takes."""
+
+    def __init__(self, delay):
+        self._process = subprocess.Popen([SFTP_SERVER], stdin=subprocess.PIPE,
+                                         stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        self.stdin = self._process.stdin
+        read_fd, self._write_fd = os.pipe()
+        self.stdout = os.fdopen(read_fd, 'rb')
+        self._delay = delay
+        self._queue = queue.Queue()
+        threading.Thread(target=self._receive, daemon=True).start()
+        threading.Thread(target=self._deliver, daemon=True).start()
+
+    def _receive(self):
+        fd = self._process.stdout.fileno()
+        while True:
+            data = os.read(fd, 65536)
+            self._queue.put((time.monotonic() + self._delay, data))
+            if not data:
+                return
+
+    def _deliver(self):
+        while True:
+            due, data = self._queue.get()
+            time.sleep(max(0.0, due - time.monotonic()))
+            if not data:
+                os.close(self._write_fd)
+                return
+            os.write(self._write_fd, data)
+
+    def terminate(self):
+        self._process.terminate()
+
+    def wait(self, timeout=None):
+        return self._process.wait(timeout)
+
+    def kill(self):
+        self._process.kill()
@@ -0,0 +1,175 @@
+"""
+Test suite for tfm_archive_extractor (parallel, cancellable extraction)
+
+Run with: PYTHONPATH=.:src pytest test/test_archive_extractor.py -v
+"""
+
+import io
+import os
+import random
+import shutil
+import tarfile
+import tempfile
+import zipfile
+
+import pytest
+
+from tfm_archive_extractor import extract_archive
+from tfm_archive_index import HAS_LZ4, HAS_ZSTD
+
+if HAS_ZSTD:
+    import zstandard
+if HAS_LZ4:
+    import lz4.frame
+
+
+class _Cancelled(Exception):
+    pass
+
+
+class _RecordingProgress:
+    """The slice of ProgressManager the extractor drives."""
+
+    def __init__(self):
+        self.total = None
+        self.items = []
+        self.byte_updates = []
+
+    def update_operation_total(self, total_items):
+        self.total = total_items
+
+    def update_progress(self, current_item, processed_items=None):
+        self.items.append((current_item, processed_items))
+
+    def update_file_byte_progress(self, bytes_copied, bytes_total):
+        self.byte_updates.append((bytes_copied, bytes_total))
+
+
+def _payload():
+    rng = random.Random(11)
+    files = {f'top/d{i % 3}/f{i}.bin': rng.randbytes(rng.randint(0, 300000)) for i in range(30)}
+    files['top/big.bin'] = rng.randbytes(9 * 1024 * 1024)  # streamed, not pooled
+    return files
+
+
+def _tar_bytes(files, mode='w:gz', extra=()):
+    if mode == 'zst':
+        return zstandard.ZstdCompressor().compress(_tar_bytes(files, 'w', extra))
+    if mode == 'lz4':
+        return lz4.frame.compress(_tar_bytes(files, 'w', extra))
+    buf = io.BytesIO()
+    with tarfile.open(fileobj=buf, mode=mode) as tf:
+        for name, data in files.items():
+            info = tarfile.TarInfo(name)
+            info.size = len(data)
+            info.mode = 0o644
+            tf.addfile(info, io.BytesIO(data))
+        for info in extra:
+            tf.addfile(info)
+    return buf.getvalue()
+
+
+class TestExtractArchive:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.dest = os.path.join(self.temp_dir, 'out')
+        self.files = _payload()
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _write(self, name, data):
+        path = os.path.join(self.temp_dir, name)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    def _assert_extracted(self, files):
+        for name, data in files.items():
+            with open(os.path.join(self.dest, name), 'rb') as f:
+                assert f.read() == data, name
+
+    def _zip(self, files, name='a.zip'):
+        path = os.path.join(self.temp_dir, name)
+        with zipfile.ZipFile(path, 'w', zipfile.ZIP_DEFLATED) as zf:
+            zf.writestr('top/empty/', b'')
+            for n, data in files.items():
+                zf.writestr(n, data)
+        return path
+
+    @pytest.mark.parametrize('threads', [1, 4])
+    def test_zip(self, threads):
+        """Every member lands intact; progress covers all entries and bytes"""
+        progress = _RecordingProgress()
+        count = extract_archive(self._zip(self.files), self.dest, 'zip',
+                                threads=threads, progress=progress)
+        assert count == len(self.files) + 1
+        self._assert_extracted(self.files)
+        assert os.path.isdir(os.path.join(self.dest, 'top', 'empty'))
+        total = sum(len(d) for d in self.files.values())
+        assert progress.total == count
+        assert progress.items[-1][1] == count
+        assert progress.byte_updates[-1] == (total, total)
+
+    @pytest.mark.parametrize('mode,fmt', [
+        ('w', 'tar'), ('w:gz', 'tar.gz'), ('w:xz', 'tar.xz'),
+        pytest.param('zst', 'tar.zst', marks=pytest.mark.skipif(not HAS_ZSTD, reason="no zstandard")),
+        pytest.param('lz4', 'tar.lz4', marks=pytest.mark.skipif(not HAS_LZ4, reason="no lz4")),
+    ])
+    def test_tar(self, mode, fmt):
+        """Tar streams extract in one pass, with links and attributes"""
+        link = tarfile.TarInfo('top/link.bin')
+        link.type = tarfile.SYMTYPE
+        link.linkname = 'd0/f0.bin'
+        hard = tarfile.TarInfo('top/hard.bin')
+        hard.type = tarfile.LNKTYPE
+        hard.linkname = 'top/big.bin'
+        path = self._write(f'a.{fmt}', _tar_bytes(self.files, mode, (link, hard)))
+
+        progress = _RecordingProgress()
+        count = extract_archive(path, self.dest, fmt, threads=3, progress=progress)
+        assert count == len(self.files) + 2
+        self._assert_extracted(self.files)
+        assert os.readlink(os.path.join(self.dest, 'top', 'link.bin')) == 'd0/f0.bin'
+        with open(os.path.join(self.dest, 'top', 'hard.bin'), 'rb') as f:
+            assert f.read() == self.files['top/big.bin']
+        # Member count is unknown up front; bytes track the compressed stream
+        assert progress.total == 0
+        size = os.path.getsize(path)
+        assert progress.byte_updates[-1] == (size, size)
+
+    def test_zip_names_are_sanitized(self):
+        """Absolute and parent components are dropped, as zipfile does"""
+        path = os.path.join(self.temp_dir, 'evil.zip')
+        with zipfile.ZipFile(path, 'w') as zf:
+            zf.writestr('../../escape.txt', b'x')
+            zf.writestr('/abs/file.txt', b'y')
+        extract_archive(path, self.dest, 'zip', threads=2)
+        assert not os.path.exists(os.path.join(self.temp_dir, 'escape.txt'))
+        assert open(os.path.join(self.dest, 'escape.txt'), 'rb').read() == b'x'
+        assert open(os.path.join(self.dest, 'abs', 'file.txt'), 'rb').read() == b'y'
+
+    @pytest.mark.skipif(not hasattr(tarfile, 'data_filter'), reason='needs tarfile filters')
+    def test_tar_unsafe_member_rejected(self):
+        """The data filter's path rules still apply"""
+        path = self._write('evil.tar', _tar_bytes({'ok.txt': b'1', '../escape.txt': b'2'}, 'w'))
+        with pytest.raises(tarfile.FilterError):
+            extract_archive(path, self.dest, 'tar', threads=2)
+        assert not os.path.exists(os.path.join(self.temp_dir, 'escape.txt'))
+
+    @pytest.mark.parametrize('fmt', ['zip', 'tar.gz'])
+    def test_cancel(self, fmt):
+        """A raising checkpoint stops the extraction and propagates"""
+        path = (self._zip(self.files) if fmt == 'zip'
+                else self._write('a.tar.gz', _tar_bytes(self.files)))
+        calls = [0]
+
+        def checkpoint():
+            calls[0] += 1
+            if calls[0] > 3:
+                raise _Cancelled()
+
+        with pytest.raises(_Cancelled):
+            extract_archive(path, self.dest, fmt, threads=2, checkpoint=checkpoint)
+        assert calls[0] == 4  # stopped at the first raise
@@ -0,0 +1,440 @@
+"""
+Test suite for tfm_archive_index: TarIndex / TarIndexStore (random access
+into tar.gz / tar.xz / tar.zst / tar.lz4), ArchiveTree and the ZIP central-directory reader
+
+Run with: PYTHONPATH=.:src pytest test/test_archive_index.py -v
+"""
+
+import gzip
+import io
+import lzma
+import os
+import random
+import shutil
+import tarfile
+import tempfile
+import zipfile
+from pathlib import Path as PathlibPath
+
+import pytest
+
+import tfm_archive_index
+
+from tfm_archive import (
+    TarHandler, FramedTarHandler, ZipHandler, ArchiveCache, ArchiveEntry, ArchiveFormatError
+)
+from tfm_archive_index import (
+    TarIndex, TarIndexStore, TarIndexError, HAS_ZSTD, HAS_LZ4, _scan_zstd_seek_table,
+    ArchiveTree, ZipDirectoryError, read_zip_central_directory
+)
+from tfm_archive_writer import ParallelCompressedWriter
+from tfm_path import Path
+
+if HAS_ZSTD:
+    import zstandard
+if HAS_LZ4:
+    import lz4.frame
+
+needs_zstd = pytest.mark.skipif(not HAS_ZSTD, reason="zstandard module not installed")
+needs_lz4 = pytest.mark.skipif(not HAS_LZ4, reason="lz4 module not installed")
+
+
+def _make_members(count=40, seed=7):
+    """Deterministic member contents mixing compressible and random data."""
+    rng = random.Random(seed)
+    members = {}
+    for i in range(count):
+        if i % 2:
+            data = rng.randbytes(rng.randint(0, 40000))
+        else:
+            data = (b'line %d\n' % i) * rng.randint(1, 20000)
+        members[f'dir{i % 4}/file{i}.bin'] = data
+    return members
+
+
+def _tar_bytes(members):
+    buf = io.BytesIO()
+    with tarfile.open(fileobj=buf, mode='w') as tf:
+        for name, data in members.items():
+            info = tarfile.TarInfo(name)
+            info.size = len(data)
+            info.mtime = 1700000000
+            tf.addfile(info, io.BytesIO(data))
+        link = tarfile.TarInfo('hardlink.bin')
+        link.type = tarfile.LNKTYPE
+        link.linkname = next(iter(members))
+        tf.addfile(link)
+        symlink = tarfile.TarInfo('dir0/symlink.bin')
+        symlink.type = tarfile.SYMTYPE
+        symlink.linkname = '../' + next(iter(members))
+        tf.addfile(symlink)
+    return buf.getvalue()
+
+
+def _multi_member_gzip(raw, piece=100000):
+    """Compress ``raw`` as a sequence of independent gzip members (bgzip-like)."""
+    return b''.join(gzip.compress(raw[i:i + piece]) for i in range(0, len(raw), piece))
+
+
+def _multi_block_xz(raw, piece=100000):
+    """Concatenated xz streams, one per ``piece`` (stands in for xz -T blocks)."""
+    return b''.join(lzma.compress(raw[i:i + piece]) for i in range(0, len(raw), piece))
+
+
+class TestTarIndex:
+    """Build an index and read every member back through it"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.members = _make_members()
+        self.raw = _tar_bytes(self.members)
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _write(self, name, data):
+        path = os.path.join(self.temp_dir, name)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    @pytest.mark.parametrize('name,compression,encode', [
+        ('single.tar.gz', 'gz', gzip.compress),
+        ('multi.tar.gz', 'gz', _multi_member_gzip),
+        ('single.tar.xz', 'xz', lzma.compress),
+        ('multi.tar.xz', 'xz', _multi_block_xz),
+    ])
+    def test_reads_match_tarfile(self, name, compression, encode):
+        """Every member read through the index matches its original bytes"""
+        path = self._write(name, encode(self.raw))
+        index = TarIndex.build(path, compression, span=64 * 1024)
+
+        assert [m.name for m in index.members if m.kind == 'f'] == list(self.members)
+        # Read back to front so each read starts from a different checkpoint
+        for member_name, data in reversed(list(self.members.items())):
+            assert index.read_member(path, member_name) == data
+
+    def test_checkpoints_recorded(self):
+        """Single-member gzip gets zlib checkpoints; multi-member gets member starts"""
+        single = self._write('single.tar.gz', gzip.compress(self.raw))
+        index = TarIndex.build(single, 'gz', span=64 * 1024)
+        assert index.checkpoint_count() > 1
+        # zlib state is memory-only; just the stream start persists
+        assert len(index.persistent_checkpoints()) == 1
+
+        multi = self._write('multi.tar.gz', _multi_member_gzip(self.raw))
+        index = TarIndex.build(multi, 'gz', span=64 * 1024)
+        assert len(index.persistent_checkpoints()) > 1
+
+    def test_state_checkpoints_stay_within_budget(self, monkeypatch):
+        """Past the checkpoint cap the span doubles and the count stays bounded"""
+        monkeypatch.setattr(tfm_archive_index, 'MAX_STATE_CHECKPOINTS', 4)
+        rng = random.Random(3)
+        members = {f'big{i}.bin': rng.randbytes(64 * 1024) for i in range(64)}
+        path = self._write('big.tar.gz', gzip.compress(_tar_bytes(members), compresslevel=1))
+        index = TarIndex.build(path, 'gz', span=64 * 1024)
+        states = index.checkpoint_count() - len(index.persistent_checkpoints())
+        assert 0 < states <= 4
+        assert index._state_count == states
+        assert index._span > 64 * 1024
+        for member_name in ('big63.bin', 'big20.bin', 'big0.bin'):
+            assert index.read_member(path, member_name) == members[member_name]
+
+    def test_hardlink_resolves_to_target(self):
+        """Hard links are read from their target member's data"""
+        path = self._write('a.tar.gz', gzip.compress(self.raw))
+        index = TarIndex.build(path, 'gz')
+        first_name, first_data = next(iter(self.members.items()))
+        assert index.read_member(path, 'hardlink.bin') == first_data
+
+    def test_symlink_resolves_relative_to_its_directory(self):
+        """Symlinks are read from their target, as TarFile.extractfile does"""
+        path = self._write('a.tar.gz', gzip.compress(self.raw))
+        index = TarIndex.build(path, 'gz')
+        assert index.get_member('dir0/symlink.bin').kind == 's'
+        with tarfile.open(path) as tf:
+            expected = tf.extractfile('dir0/symlink.bin').read()
+        assert index.read_member(path, 'dir0/symlink.bin') == expected
+
+    def test_round_trip_serialization(self):
+        """A reloaded index serves reads and rebuilds zlib checkpoints lazily"""
+        path = self._write('a.tar.gz', gzip.compress(self.raw))
+        index = TarIndex.build(path, 'gz', span=64 * 1024)
+        blob = index.to_bytes(123, 456)
+
+        reloaded = TarIndex.from_bytes(blob, 123, 456, span=64 * 1024)
+        assert reloaded is not None
+        assert reloaded.checkpoint_count() == 1
+        last_name = list(self.members)[-1]
+        assert reloaded.read_member(path, last_name) == self.members[last_name]
+        assert reloaded.checkpoint_count() > 1
+
+    def test_stale_serialization_rejected(self):
+        """A sidecar for another size/mtime is ignored"""
+        path = self._write('a.tar.gz', gzip.compress(self.raw))
+        blob = TarIndex.build(path, 'gz').to_bytes(123, 456)
+        assert TarIndex.from_bytes(blob, 124, 456) is None
+        assert TarIndex.from_bytes(blob, 123, 457) is None
+        assert TarIndex.from_bytes(b'garbage', 123, 456) is None
+
+    def test_corrupt_archive_raises(self):
+        """A truncated stream raises TarIndexError"""
+        data = gzip.compress(self.raw)
+        path = self._write('bad.tar.gz', data[:len(data) // 2])
+        with pytest.raises(TarIndexError):
+            TarIndex.build(path, 'gz')
+
+
+def _seekable_zstd(raw, frame=100000):
+    """Independent zstd frames plus a seek table, as TFM's writer emits."""
+    buf = io.BytesIO()
+    writer = ParallelCompressedWriter(buf, 'zst', 1, block_size=frame)
+    writer.write(raw)
+    writer.close()
+    return buf.getvalue()
+
+
+def _multi_frame_lz4(raw, frame=100000):
+    return b''.join(lz4.frame.compress(raw[i:i + frame]) for i in range(0, len(raw), frame))
+
+
+class TestFramedTarIndex:
+    """zstd / lz4 archives, which only the index can read"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.members = _make_members()
+        self.raw = _tar_bytes(self.members)
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _write(self, name, data):
+        path = os.path.join(self.temp_dir, name)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    @pytest.mark.parametrize('name,compression,encode', [
+        pytest.param('single.tar.zst', 'zst', lambda raw: zstandard.ZstdCompressor().compress(raw),
+                     marks=needs_zstd),
+        pytest.param('seekable.tar.zst', 'zst', _seekable_zstd, marks=needs_zstd),
+        pytest.param('single.tar.lz4', 'lz4', lambda raw: lz4.frame.compress(raw), marks=needs_lz4),
+        pytest.param('multi.tar.lz4', 'lz4', _multi_frame_lz4, marks=needs_lz4),
+    ])
+    def test_reads_match_original(self, name, compression, encode):
+        """Every member read through the index matches its original bytes"""
+        path = self._write(name, encode(self.raw))
+        index = TarIndex.build(path, compression)
+
+        assert [m.name for m in index.members if m.kind == 'f'] == list(self.members)
+        for member_name, data in reversed(list(self.members.items())):
+            assert index.read_member(path, member_name) == data
+        if name.startswith(('seekable', 'multi')):
+            assert len(index.persistent_checkpoints()) > 1
+
+    @needs_zstd
+    def test_seek_table_read_up_front(self):
+        """A seekable zstd file's frames are known from its seek table alone"""
+        frames = -(-len(self.raw) // 100000)
+        path = self._write('a.tar.zst', _seekable_zstd(self.raw))
+        with open(path, 'rb') as fh:
+            checkpoints = _scan_zstd_seek_table(fh)
+        assert [c.uncomp_offset for c in checkpoints] == [i * 100000 for i in range(frames)]
+        reloaded = TarIndex.from_bytes(TarIndex.build(path, 'zst').to_bytes(1, 2), 1, 2)
+        assert reloaded.checkpoint_count() == frames
+
+    @needs_zstd
+    def test_handler_lists_and_reads(self):
+        """FramedTarHandler serves listing, members and symlinks from the index"""
+        path = self._write('a.tar.zst', _seekable_zstd(self.raw))
+        with FramedTarHandler(Path(path), 'zst') as handler:
+            assert {e.name for e in handler.list_entries('dir0')} >= {'file0.bin', 'symlink.bin'}
+            for name, data in self.members.items():
+                assert handler.extract_to_bytes(name) == data
+            first = next(iter(self.members.values()))
+            assert handler.extract_to_bytes('dir0/symlink.bin') == first
+            assert handler.get_entry_info('dir1/file1.bin').archive_type == 'tar.zst'
+
+    @needs_lz4
+    def test_cache_routes_lz4(self):
+        cache = ArchiveCache(max_open=2)
+        path = self._write('a.tar.lz4', _multi_frame_lz4(self.raw))
+        handler = cache.get_handler(Path(path))
+        assert isinstance(handler, FramedTarHandler)
+        assert handler.extract_to_bytes('dir2/file2.bin') == self.members['dir2/file2.bin']
+
+    def test_missing_module_reported(self, monkeypatch):
+        """Without the codec module, opening fails with a format error"""
+        path = self._write('a.tar.zst', b'\x28\xb5\x2f\xfd')
+        monkeypatch.setitem(FramedTarHandler._DECODERS, 'zst', (False, 'zstandard'))
+        with pytest.raises(ArchiveFormatError):
+            FramedTarHandler(Path(path), 'zst').open()
+
+
+class TestTarIndexStore:
+    """Sharing and persistence of indexes"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.index_dir = os.path.join(self.temp_dir, 'index')
+        self.members = _make_members(count=10)
+        self.archive = os.path.join(self.temp_dir, 'a.tar.gz')
+        with open(self.archive, 'wb') as f:
+            f.write(gzip.compress(_tar_bytes(self.members)))
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_memory_then_disk_hits(self):
+        """The first lookup builds, the next is a memory hit, a new store loads from disk"""
+        store = TarIndexStore(self.index_dir)
+        first = store.get_index(self.archive, self.archive, 'gz', 1, 2)
+        assert store.get_index(self.archive, self.archive, 'gz', 1, 2) is first
+        assert store.get_stats()['builds'] == 1
+        assert store.get_stats()['memory_hits'] == 1
+        assert len(os.listdir(self.index_dir)) == 1
+
+        other = TarIndexStore(self.index_dir)
+        loaded = other.get_index(self.archive, self.archive, 'gz', 1, 2)
+        assert other.get_stats() == {'indexes': 1, 'memory_hits': 0, 'disk_hits': 1, 'builds': 0}
+        assert [m.name for m in loaded.members] == [m.name for m in first.members]
+
+    def test_changed_archive_rebuilds(self):
+        """A different size/mtime invalidates both memory and disk copies"""
+        store = TarIndexStore(self.index_dir)
+        store.get_index(self.archive, self.archive, 'gz', 1, 2)
+        store.get_index(self.archive, self.archive, 'gz', 1, 3)
+        assert store.get_stats()['builds'] == 2
+
+    def test_memory_only_store(self):
+        """Without an index_dir nothing is written"""
+        store = TarIndexStore(None)
+        store.get_index(self.archive, self.archive, 'gz', 1, 2)
+        assert not os.path.exists(self.index_dir)
+
+
+class TestIndexedTarHandler:
+    """TarHandler and ArchiveCache wired to a TarIndexStore"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.temp_path = PathlibPath(self.temp_dir)
+        self.members = _make_members(count=12)
+        self.tar_gz = self.temp_path / 'test.tar.gz'
+        self.tar_gz.write_bytes(gzip.compress(_tar_bytes(self.members)))
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_handler_lists_and_reads_via_index(self):
+        """Listing and extraction match the tarfile-backed handler"""
+        store = TarIndexStore(None)
+        with TarHandler(Path(self.tar_gz), compression='gz', index_store=store) as indexed, \
+                TarHandler(Path(self.tar_gz), compression='gz') as plain:
+            assert indexed._index is not None
+            assert indexed._archive_obj is None
+            for directory in ('', 'dir0', 'dir3'):
+                assert ([e.internal_path for e in indexed.list_entries(directory)] ==
+                        [e.internal_path for e in plain.list_entries(directory)])
+            for name, data in self.members.items():
+                assert indexed.extract_to_bytes(name) == data
+                assert indexed.get_entry_info(name) == plain.get_entry_info(name)
+
+    def test_cache_shares_index_across_reopen(self):
+        """An invalidated handler reopens from the cached index without rescanning"""
+        cache = ArchiveCache(max_open=2, index_dir=str(self.temp_path / 'index'))
+        handler = cache.get_handler(Path(self.tar_gz))
+        assert handler.extract_to_bytes('dir1/file1.bin') == self.members['dir1/file1.bin']
+        cache.clear()
+
+        handler = cache.get_handler(Path(self.tar_gz))
+        assert handler.extract_to_bytes('dir2/file2.bin') == self.members['dir2/file2.bin']
+        stats = cache.get_stats()['tar_indexes']
+        assert stats['builds'] == 1
+        assert stats['memory_hits'] == 1
+
+
+class TestArchiveTree:
+    """Prefix tree used by both handlers for listings"""
+
+    def test_implicit_directories_and_order(self):
+        """Parents are created on demand and children keep archive order"""
+        tree = ArchiveTree()
+        tree.add_all([
+            ('b/x.txt', 'bx', False),
+            ('a', 'a-dir', True),
+            ('b/c/y.txt', 'bcy', False),
+            ('a/z.txt', 'az', False),
+        ])
+        root_children = [tree.name(n) for n in tree.children(ArchiveTree.ROOT)]
+        assert root_children == ['b', 'a']
+        b = tree.find('b')
+        assert tree.payload(b) is None  # implicit
+        assert [tree.name(n) for n in tree.children(b)] == ['x.txt', 'c']
+        assert tree.payload(tree.find('a')) == 'a-dir'
+        assert tree.path(tree.find('b/c/y.txt')) == 'b/c/y.txt'
+        assert tree.find('b/nope') is None
+        assert tree.find('b/x.txt/deeper') is None
+
+    def test_duplicate_path_keeps_last_payload(self):
+        """A member stored twice resolves to its last copy, like zipfile/tarfile"""
+        tree = ArchiveTree()
+        tree.add_all([('f.txt', 1, False), ('f.txt', 2, False)])
+        assert len(tree.children(ArchiveTree.ROOT)) == 1
+        assert tree.payload(tree.find('f.txt')) == 2
+
+
+class TestZipCentralDirectory:
+    """Central-directory reader compared against zipfile"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _zip(self, name, prefix=b''):
+        path = os.path.join(self.temp_dir, name)
+        buf = io.BytesIO()
+        with zipfile.ZipFile(buf, 'w', zipfile.ZIP_DEFLATED) as zf:
+            zf.writestr('dir/', b'')
+            zf.writestr('dir/a.txt', b'a' * 100)
+            zf.writestr('\u65e5\u672c/b.txt', b'b')
+            with zf.open('big.bin', 'w', force_zip64=True) as f:
+                f.write(b'c' * 1000)
+        with open(path, 'wb') as f:
+            f.write(prefix + buf.getvalue())
+        return path
+
+    @pytest.mark.parametrize('prefix', [b'', b'#!/bin/sh\nexit 0\n'])
+    def test_matches_zipfile(self, prefix):
+        """Names, sizes and entries match zipfile, including zip64 and prepended data"""
+        path = self._zip('t.zip', prefix)
+        directory = read_zip_central_directory(path)
+        with zipfile.ZipFile(path) as zf:
+            infos = zf.infolist()
+        assert directory.names == [i.filename for i in infos]
+        for i, info in enumerate(infos):
+            assert ArchiveEntry.from_zip_record(directory.record(i)) == ArchiveEntry.from_zip_info(info)
+
+    def test_not_a_zip(self):
+        """Garbage and empty files raise ZipDirectoryError"""
+        path = os.path.join(self.temp_dir, 'bad.zip')
+        with open(path, 'wb') as f:
+            f.write(b'not a zip at all')
+        with pytest.raises(ZipDirectoryError):
+            read_zip_central_directory(path)
+        open(path, 'wb').close()
+        with pytest.raises(ZipDirectoryError):
+            read_zip_central_directory(path)
+
+    def test_handler_reads_lazily(self):
+        """Listing does not open zipfile; the first read does"""
+        path = self._zip('t.zip')
+        with ZipHandler(Path(path)) as handler:
+            assert [e.name for e in handler.list_entries('')] == ['dir', '\u65e5\u672c', 'big.bin']
+            assert handler.get_entry_info('\u65e5\u672c').is_dir
+            assert handler._archive_obj is None
+            assert handler.extract_to_bytes('dir/a.txt') == b'a' * 100
+            assert handler._archive_obj is not None
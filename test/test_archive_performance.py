@@ -6,6 +6,8 @@ Tests verify:
 - Lazy loading for archive directory structures
 - Memory usage optimization for large archives
 - Hot path optimization in ArchivePathImpl
+- Large ZIPs open from the central directory without per-entry ZipInfo
+- Archive creation throughput across compression thread counts
 
 Run with: PYTHONPATH=.:src pytest test/test_archive_performance.py -v
 """
@@ -159,6 +161,130 @@ def test_lazy_loading():
         print("\n✓ Lazy loading test passed")
 
 
+def test_large_zip_open():
+    """Test that a large ZIP opens from its central directory in one linear pass"""
+    print("\n=== Testing Large ZIP Open ===")
+    
+    from tfm_archive import ZipHandler
+    
+    with tempfile.TemporaryDirectory() as temp_dir:
+        temp_path = PathlibPath(temp_dir)
+        
+        num_entries = 100000
+        print(f"Creating archive with {num_entries} entries...")
+        large_archive = temp_path / "huge.zip"
+        with zipfile.ZipFile(str(large_archive), 'w', zipfile.ZIP_STORED) as zf:
+            for i in range(num_entries):
+                zf.writestr(f"dir_{i % 50}/sub_{i % 7}/file_{i}.txt", b'')
+        
+        start_time = time.time()
+        handler = ZipHandler(Path(large_archive))
+        handler.open()
+        open_elapsed = time.time() - start_time
+        print(f"Opened {num_entries} entries in {open_elapsed:.3f}s")
+        
+        # Deep lookups and listings are O(depth) / O(children)
+        start_time = time.time()
+        for i in range(0, num_entries, 1000):
+            entry = handler.get_entry_info(f"dir_{i % 50}/sub_{i % 7}/file_{i}.txt")
+            assert entry is not None and not entry.is_dir
+        entries = handler.list_entries("dir_3/sub_4")
+        lookup_elapsed = time.time() - start_time
+        print(f"100 deep lookups + listing {len(entries)} entries in {lookup_elapsed:.3f}s")
+        handler.close()
+        
+        expected = sum(1 for i in range(num_entries) if i % 50 == 3 and i % 7 == 4)
+        assert len(entries) == expected
+        # zipfile alone needs seconds here on slow machines; keep the bound loose
+        assert open_elapsed < 5.0, f"Large ZIP open should be fast, took {open_elapsed:.3f}s"
+        assert lookup_elapsed < 0.5, f"Lookups should be fast, took {lookup_elapsed:.3f}s"
+        
+        print("\n✓ Large ZIP open test passed")
+
+
+def test_parallel_compression_throughput():
+    """Benchmark archive creation throughput across compression thread counts"""
+    print("\n=== Testing Parallel Compression Throughput ===")
+    
+    from tfm_archive_writer import write_archive
+    import os
+    import random
+    
+    with tempfile.TemporaryDirectory() as temp_dir:
+        temp_path = PathlibPath(temp_dir)
+        source = temp_path / "payload"
+        source.mkdir()
+        rng = random.Random(1)
+        for i in range(8):
+            # Half compressible text, half random bytes: 1 MiB per file
+            text = ''.join(f'{i} {rng.random()}\n' for _ in range(20000)).encode()[:512 * 1024]
+            (source / f"part_{i}.dat").write_bytes(text + rng.randbytes(512 * 1024))
+        total_mb = sum(f.stat().st_size for f in source.iterdir()) / (1024 * 1024)
+        
+        cpus = os.cpu_count() or 1
+        thread_counts = sorted({1, 2, 4, cpus})
+        for fmt in ("tar.gz", "zip"):
+            sizes = set()
+            for threads in thread_counts:
+                target = temp_path / f"out_{threads}.{fmt}"
+                start_time = time.time()
+                added = write_archive([Path(source)], Path(target), fmt, threads=threads)
+                elapsed = time.time() - start_time
+                sizes.add(target.stat().st_size)
+                print(f"{fmt:7s} threads={threads:2d}: {total_mb / elapsed:7.1f} MB/s "
+                      f"({elapsed:.3f}s, {added} members)")
+            # Blocks are cut the same way for every thread count
+            assert len(sizes) == 1
+        print(f"({cpus} CPU(s) available)")
+        
+        print("\n✓ Parallel compression benchmark passed")
+
+
+def test_decompression_throughput():
+    """Benchmark tar decompression per codec: full decode and a random member read"""
+    print("\n=== Testing Decompression Throughput ===")
+    
+    from tfm_archive_writer import write_archive
+    from tfm_archive_index import TarIndex, HAS_ZSTD, HAS_LZ4
+    import random
+    
+    with tempfile.TemporaryDirectory() as temp_dir:
+        temp_path = PathlibPath(temp_dir)
+        source = temp_path / "payload"
+        source.mkdir()
+        rng = random.Random(2)
+        for i in range(64):
+            # Mostly compressible text with some random bytes: 256 KiB per file
+            text = ''.join(f'{i} {rng.random()}\n' for _ in range(10000)).encode()[:192 * 1024]
+            (source / f"part_{i}.dat").write_bytes(text + rng.randbytes(64 * 1024))
+        total_mb = sum(f.stat().st_size for f in source.iterdir()) / (1024 * 1024)
+        
+        codecs = ["gz", "xz"] + (["zst"] if HAS_ZSTD else []) + (["lz4"] if HAS_LZ4 else [])
+        for codec in codecs:
+            target = temp_path / f"out.tar.{codec}"
+            write_archive([Path(source)], Path(target), f"tar.{codec}")
+            ratio = target.stat().st_size / (total_mb * 1024 * 1024)
+            
+            start_time = time.time()
+            index = TarIndex.build(str(target), codec)
+            scan_time = time.time() - start_time
+            
+            # A fresh index from persisted checkpoints only, as after a restart
+            index = TarIndex.from_bytes(index.to_bytes(1, 2), 1, 2)
+            last = [m for m in index.members if m.kind == 'f'][-1]
+            start_time = time.time()
+            data = index.read_member(str(target), last.name)
+            read_time = time.time() - start_time
+            assert len(data) == last.size
+            print(f"tar.{codec:3s}: ratio {ratio:5.3f}, full decode {total_mb / scan_time:7.1f} MB/s, "
+                  f"last member (cold) {read_time * 1000:7.1f} ms, "
+                  f"{len(index.persistent_checkpoints())} checkpoints")
+        if not (HAS_ZSTD and HAS_LZ4):
+            print("(install zstandard / lz4 to include tar.zst / tar.lz4)")
+        
+        print("\n✓ Decompression throughput benchmark passed")
+
+
 def test_memory_optimization():
     """Test memory usage optimization for large archives"""
     print("\n=== Testing Memory Optimization ===")
@@ -0,0 +1,212 @@
+"""
+Test suite for tfm_archive_writer (parallel archive creation)
+
+Run with: PYTHONPATH=.:src pytest test/test_archive_writer.py -v
+"""
+
+import bz2
+import gzip
+import io
+import lzma
+import os
+import random
+import shutil
+import struct
+import tarfile
+import tempfile
+import zipfile
+import zlib
+
+import pytest
+
+from tfm_archive_index import HAS_LZ4, HAS_ZSTD
+from tfm_archive_writer import (
+    ParallelCompressedWriter, write_archive, ARCHIVE_FORMATS
+)
+from tfm_path import Path
+
+if HAS_ZSTD:
+    import zstandard
+if HAS_LZ4:
+    import lz4.frame
+
+#: Formats whose codec module is optional -> whether it is installed
+_OPTIONAL = {'tar.zst': HAS_ZSTD, 'tar.lz4': HAS_LZ4, 'zst': HAS_ZSTD, 'lz4': HAS_LZ4}
+
+
+def _available(formats):
+    """Parametrize values, skipping those whose codec module is missing."""
+    return [pytest.param(f, marks=pytest.mark.skipif(not _OPTIONAL.get(f, True),
+                                                     reason=f"{f} module not installed"))
+            for f in formats]
+
+
+def _decompress(codec, data):
+    if codec == 'zst':
+        return zstandard.ZstdDecompressor().stream_reader(
+            io.BytesIO(data), read_across_frames=True).read()
+    if codec == 'lz4':
+        return lz4.frame.LZ4FrameFile(io.BytesIO(data)).read()
+    return {'xz': lzma.decompress, 'bz2': bz2.decompress, 'gz': gzip.decompress}[codec](data)
+
+
+def _open_tar(path):
+    """tarfile over ``path``, decompressing zstd / lz4 first."""
+    codec = path.rpartition('.')[2]
+    if codec in ('zst', 'lz4'):
+        with open(path, 'rb') as f:
+            return tarfile.open(fileobj=io.BytesIO(_decompress(codec, f.read())))
+    return tarfile.open(path)
+
+
+class _Cancelled(Exception):
+    pass
+
+
+class _RecordingProgress:
+    """The slice of ProgressManager the writer drives."""
+
+    def __init__(self):
+        self.total = None
+        self.items = []
+        self.byte_updates = []
+
+    def update_operation_total(self, total_items):
+        self.total = total_items
+
+    def update_progress(self, current_item):
+        self.items.append(current_item)
+
+    def update_file_byte_progress(self, bytes_copied, bytes_total):
+        self.byte_updates.append((bytes_copied, bytes_total))
+
+
+def _fill_tree(root):
+    """A small tree: text, random (incompressible) data spanning several
+    blocks, an empty file and an empty directory."""
+    rng = random.Random(3)
+    os.makedirs(os.path.join(root, 'src', 'sub', 'empty'))
+    with open(os.path.join(root, 'src', 'text.txt'), 'w') as f:
+        f.write(''.join(f'line {i} {rng.random()}\n' for i in range(60000)))
+    with open(os.path.join(root, 'src', 'rand.bin'), 'wb') as f:
+        f.write(rng.randbytes(2 * 1024 * 1024 + 123))
+    with open(os.path.join(root, 'src', 'sub', 'a.txt'), 'w') as f:
+        f.write('hello\n')
+    open(os.path.join(root, 'src', 'sub', 'zero'), 'wb').close()
+
+
+class TestParallelCompressedWriter:
+    """Block-parallel compressed streams decode with the standard tools"""
+
+    @pytest.mark.parametrize('codec', _available(['gz', 'xz', 'bz2', 'zst', 'lz4']))
+    def test_stream_round_trip(self, codec):
+        """Output decompresses to the input and does not depend on thread count"""
+        rng = random.Random(5)
+        data = b''.join(rng.choice([b'abc' * 3000, rng.randbytes(5000)]) for _ in range(200))
+        outputs = []
+        for threads in (1, 3):
+            buf = io.BytesIO()
+            writer = ParallelCompressedWriter(buf, codec, threads, block_size=64 * 1024)
+            for i in range(0, len(data), 7000):
+                writer.write(data[i:i + 7000])
+            assert writer.tell() == len(data)
+            writer.close()
+            outputs.append(buf.getvalue())
+
+        # gzip headers carry the write time; everything after it must match
+        skip = 10 if codec == 'gz' else 0
+        assert outputs[0][skip:] == outputs[1][skip:]
+        if codec == 'gz':
+            assert gzip.decompress(outputs[1]) == data
+            # A single member: the whole body is one deflate stream
+            d = zlib.decompressobj(-15)
+            assert d.decompress(outputs[1][10:]) == data and len(d.unused_data) == 8
+        else:
+            assert _decompress(codec, outputs[1]) == data
+
+    @pytest.mark.skipif(not HAS_ZSTD, reason="zstandard module not installed")
+    def test_zstd_seek_table(self):
+        """zstd output ends with a seek table listing every frame"""
+        buf = io.BytesIO()
+        writer = ParallelCompressedWriter(buf, 'zst', 2, block_size=1000)
+        writer.write(b'x' * 4500)
+        writer.close()
+        frames, descriptor, magic = struct.unpack('<LBL', buf.getvalue()[-9:])
+        assert (frames, descriptor, magic) == (5, 0, 0x8F92EAB1)
+
+    def test_empty_gzip(self):
+        """Closing with nothing written still yields a valid gzip file"""
+        buf = io.BytesIO()
+        ParallelCompressedWriter(buf, 'gz', 2).close()
+        assert gzip.decompress(buf.getvalue()) == b''
+
+
+class TestWriteArchive:
+    """write_archive against the stdlib readers"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        _fill_tree(self.temp_dir)
+        self.sources = [Path(os.path.join(self.temp_dir, 'src'))]
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _read(self, name):
+        with open(os.path.join(self.temp_dir, 'src', *name.split('/')[1:]), 'rb') as f:
+            return f.read()
+
+    @pytest.mark.parametrize('fmt', _available(ARCHIVE_FORMATS))
+    def test_round_trip(self, fmt):
+        """Every format holds the tree and reads back with tarfile / zipfile"""
+        target = os.path.join(self.temp_dir, f'out.{fmt}')
+        progress = _RecordingProgress()
+        added = write_archive(self.sources, Path(target), fmt, threads=4, progress=progress)
+
+        assert progress.total == added == len(progress.items)
+        if fmt == 'zip':
+            with zipfile.ZipFile(target) as zf:
+                assert zf.testzip() is None
+                names = sorted(zf.namelist())
+                assert names == ['src/rand.bin', 'src/sub/a.txt', 'src/sub/zero', 'src/text.txt']
+                for name in names:
+                    assert zf.read(name) == self._read(name)
+        else:
+            with _open_tar(target) as tf:
+                members = {m.name: m for m in tf.getmembers()}
+                assert len(members) == added == 7
+                assert members['src/sub/empty'].isdir()
+                for name in ('src/rand.bin', 'src/sub/a.txt', 'src/sub/zero', 'src/text.txt'):
+                    assert tf.extractfile(name).read() == self._read(name)
+        # The 2 MiB file reported byte progress up to its full size
+        assert (2 * 1024 * 1024 + 123, 2 * 1024 * 1024 + 123) in progress.byte_updates
+
+    @pytest.mark.parametrize('fmt', ['zip', 'tar.xz'])
+    def test_identical_across_thread_counts(self, fmt):
+        """The thread count changes speed, not bytes"""
+        blobs = []
+        for threads in (1, 2, 5):
+            target = os.path.join(self.temp_dir, f'{threads}.{fmt}')
+            write_archive(self.sources, Path(target), fmt, threads=threads)
+            with open(target, 'rb') as f:
+                blobs.append(f.read())
+        assert blobs[0] == blobs[1] == blobs[2]
+
+    @pytest.mark.parametrize('fmt', ['zip', 'tar.gz'])
+    def test_cancel_removes_partial_archive(self, fmt):
+        """A checkpoint that raises aborts the write and deletes the output"""
+        target = os.path.join(self.temp_dir, f'out.{fmt}')
+        calls = [0]
+
+        def checkpoint():
+            calls[0] += 1
+            if calls[0] > 5:
+                raise _Cancelled()
+
+        with pytest.raises(_Cancelled):
+            write_archive(self.sources, Path(target), fmt, threads=2, checkpoint=checkpoint)
+        assert not os.path.exists(target)
+
+    def test_unknown_format(self):
+        with pytest.raises(ValueError):
+            write_archive(self.sources, Path(os.path.join(self.temp_dir, 'x.rar')), 'rar')
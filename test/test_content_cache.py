@@ -0,0 +1,211 @@
+"""
+Test suite for tfm_content_cache (disk-backed cache of remote file bodies)
+
+S3 reads go through an in-memory bucket and SSH reads through a stub
+connection; both count what they transfer.
+
+Run with: PYTHONPATH=.:src pytest test/test_content_cache.py -v
+"""
+
+import io
+import os
+import shutil
+import tempfile
+import time
+
+import tfm_content_cache
+import tfm_s3
+from tfm_content_cache import ContentCache
+from tfm_path import Path
+from tfm_ssh import SSHPathImpl
+
+KB = 1024
+
+
+class TestContentCache:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.cache = ContentCache(self.temp_dir, max_bytes=100 * KB)
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_put_read_and_mapped_open(self):
+        key = ContentCache.version_key('s3://b/k', '"etag"', 5)
+        assert self.cache.read(key) is None
+        assert self.cache.put(key, b'hello')
+        assert self.cache.read(key) == b'hello'
+        with self.cache.open(key) as f:
+            assert f.read(2) == b'he'
+            f.seek(-2, os.SEEK_END)
+            assert f.read() == b'lo'
+        assert self.cache.put('empty', b'') and self.cache.read('empty') == b''
+        assert self.cache.open('empty').read() == b''
+        stats = self.cache.get_stats()
+        assert (stats['hits'], stats['misses'], stats['stores']) == (4, 1, 2)
+
+    def test_same_content_is_stored_once(self):
+        data = os.urandom(10 * KB)
+        self.cache.put('ssh://a/f\x001\x0010240', data)
+        self.cache.put('s3://b/f\x00"e"\x0010240', data)
+        assert self.cache.get_stats()['entries'] == 1
+        assert self.cache.get_stats()['bytes'] == 10 * KB
+
+    def test_lru_eviction_by_bytes(self):
+        for name in 'abcd':
+            self.cache.put(name, os.urandom(20 * KB))
+        self.cache.read('a')  # a is now the most recently used
+        self.cache.put('e', os.urandom(25 * KB))  # 105 KB > 100 KB budget
+        assert self.cache.read('b') is None
+        assert all(self.cache.read(k) is not None for k in 'acde')
+        stats = self.cache.get_stats()
+        assert stats['evictions'] == 1 and stats['bytes'] == 85 * KB
+        assert len(os.listdir(os.path.join(self.temp_dir, 'blobs'))) == 4
+
+    def test_order_survives_restart(self):
+        blobs = os.path.join(self.temp_dir, 'blobs')
+        for i, name in enumerate('abc'):
+            self.cache.put(name, os.urandom(25 * KB))
+            newest = max(os.listdir(blobs), key=lambda n: os.stat(os.path.join(blobs, n)).st_mtime_ns)
+            os.utime(os.path.join(blobs, newest), (1000 + i, 1000 + i))
+        self.cache.put('d', os.urandom(25 * KB))
+        reopened = ContentCache(self.temp_dir, max_bytes=100 * KB)
+        assert reopened.read('a') is not None  # bumps a past b, c and d
+        reopened.put('e', os.urandom(25 * KB))
+        assert reopened.read('b') is None and reopened.read('c') is not None
+        assert reopened.get_stats()['bytes'] == 100 * KB
+
+    def test_oversized_and_disabled(self):
+        assert not self.cache.put('big', os.urandom(26 * KB))  # over a quarter
+        disabled = ContentCache(self.temp_dir, max_bytes=0)
+        assert not disabled.put('k', b'x') and disabled.read('k') is None
+        assert not disabled.get_stats()['enabled']
+
+
+class _Body:
+
+    def __init__(self, data):
+        self._data = data
+
+    def read(self):
+        return self._data
+
+
+class _FakeS3:
+
+    def __init__(self, latency=0.0):
+        self.objects = {}
+        self.latency = latency
+        self.gets = 0
+
+    def head_object(self, Bucket, Key):
+        data, etag = self.objects[Key]
+        return {'ContentLength': len(data), 'ETag': etag}
+
+    def get_object(self, Bucket, Key, **kwargs):
+        time.sleep(self.latency)
+        self.gets += 1
+        return {'Body': _Body(self.objects[Key][0])}
+
+
+class _RemoteTest:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self._saved = tfm_content_cache._content_cache
+        self.cache = tfm_content_cache._content_cache = ContentCache(self.temp_dir)
+        self._had_boto3 = tfm_s3.HAS_BOTO3
+        tfm_s3.HAS_BOTO3 = True
+        tfm_s3.get_s3_cache().clear()
+
+    def teardown_method(self):
+        tfm_content_cache._content_cache = self._saved
+        tfm_s3.HAS_BOTO3 = self._had_boto3
+        tfm_s3.get_s3_cache().clear()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+
+class TestS3Bodies(_RemoteTest):
+
+    def _path(self, fake, key):
+        path = Path(f's3://content-bucket/{key}')
+        path._impl._s3_client = fake
+        return path
+
+    def test_reopen_costs_no_get(self):
+        fake = _FakeS3()
+        fake.objects['doc.txt'] = (b'line one\nline two\n', '"v1"')
+        assert self._path(fake, 'doc.txt').read_text() == 'line one\nline two\n'
+        tfm_s3.get_s3_cache().clear()  # even with the metadata refetched
+        with self._path(fake, 'doc.txt').open('r') as f:
+            assert f.readline() == 'line one\n'
+        assert self._path(fake, 'doc.txt').read_bytes() == b'line one\nline two\n'
+        assert fake.gets == 1
+        assert tfm_s3.get_s3_cache().get_stats()['content_cache']['hits'] == 2
+
+    def test_new_etag_is_fetched(self):
+        fake = _FakeS3()
+        fake.objects['doc.txt'] = (b'old', '"v1"')
+        self._path(fake, 'doc.txt').read_bytes()
+        fake.objects['doc.txt'] = (b'new', '"v2"')
+        tfm_s3.get_s3_cache().clear()
+        assert self._path(fake, 'doc.txt').read_bytes() == b'new'
+        assert fake.gets == 2
+
+    def test_reopen_benchmark(self):
+        """Benchmark: opening a 2 MB object again, 50 ms per GET"""
+        fake = _FakeS3(latency=0.05)
+        fake.objects['image.png'] = (os.urandom(2 * 1024 * KB), '"img"')
+        start = time.perf_counter()
+        first = self._path(fake, 'image.png').read_bytes()
+        cold = time.perf_counter() - start
+        tfm_s3.get_s3_cache().clear()
+        # A new session: nothing in memory, only the disk cache
+        tfm_content_cache._content_cache = ContentCache(self.temp_dir)
+        start = time.perf_counter()
+        again = self._path(fake, 'image.png').read_bytes()
+        warm = time.perf_counter() - start
+        assert again == first and fake.gets == 1
+        print(f"\n2 MB object: first open {cold * 1000:.1f} ms, reopened after restart "
+              f"{warm * 1000:.1f} ms, no GET")
+        assert warm < cold / 5
+
+
+class _StubConnection:
+
+    def __init__(self, files):
+        self.files = files
+        self.reads = 0
+
+    def stat(self, remote_path):
+        data, mtime = self.files[remote_path]
+        return {'size': len(data), 'mtime': mtime, 'is_dir': False}
+
+    def read_file(self, remote_path, progress_callback=None):
+        self.reads += 1
+        return self.files[remote_path][0]
+
+    def open_file(self, remote_path):
+        self.reads += 1
+        return io.BufferedReader(io.BytesIO(self.files[remote_path][0]))
+
+
+class TestSSHBodies(_RemoteTest):
+
+    def _path(self, conn, remote_path):
+        impl = SSHPathImpl.__new__(SSHPathImpl)
+        impl.hostname, impl.remote_path = 'host', remote_path
+        impl._get_connection = lambda: conn
+        return impl
+
+    def test_reopen_and_changed_mtime(self):
+        conn = _StubConnection({'/etc/motd': (b'welcome\x00', 100)})
+        assert self._path(conn, '/etc/motd').read_bytes() == b'welcome\x00'
+        with self._path(conn, '/etc/motd').open('rb') as f:
+            assert f.read(7) == b'welcome'
+        assert self._path(conn, '/etc/motd').read_text() == 'welcome\x00'
+        assert conn.reads == 1
+        conn.files['/etc/motd'] = (b'changed!', 200)
+        assert self._path(conn, '/etc/motd').read_bytes() == b'changed!'
+        assert conn.reads == 2
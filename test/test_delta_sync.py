@@ -0,0 +1,280 @@
+"""
+Test suite for tfm_delta_sync (rsync-style delta updates)
+
+The SSH host is the local machine: the helper runs through ``sh -c`` in place
+of ssh, with the local ``python3``.
+
+Run with: PYTHONPATH=.:src pytest test/test_delta_sync.py -v
+"""
+
+import hashlib
+import io
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+import pytest
+
+import tfm_delta_sync
+from tfm_delta_sync import (COPY, UNCHANGED, SyncStats, apply_delta, block_size_for,
+                            compute_delta, file_signature, local_etag, set_synced_mtime,
+                            sync_file, sync_ssh)
+from tfm_path import Path
+from tfm_ssh_connection import SSHConnection, SSHError
+
+
+def _rebuild(old: bytes, new: bytes, block_size: int = 2048):
+    """(rebuilt bytes, ops) for the delta from ``old`` to ``new``."""
+    sig = file_signature(io.BytesIO(old), block_size)
+    ops = list(compute_delta(new, sig))
+    out = io.BytesIO()
+    apply_delta(io.BytesIO(old), ops, out, block_size)
+    return out.getvalue(), ops
+
+
+def _literal(ops):
+    return sum(len(op[1]) for op in ops if op[0] == "D")
+
+
+class TestComputeDelta:
+    """Signature, delta and apply round-trip"""
+
+    def setup_method(self):
+        rng = random.Random(7)
+        self.base = bytes(rng.getrandbits(8) for _ in range(100_000))
+
+    def test_unchanged_is_one_copy_run(self):
+        rebuilt, ops = _rebuild(self.base, self.base)
+        assert rebuilt == self.base
+        assert ops == [("C", 0, 49)]  # 48 full blocks and the short tail, merged
+
+    @pytest.mark.parametrize("edit", ["insert", "delete", "modify", "append", "truncate", "prepend"])
+    def test_edits(self, edit):
+        b = self.base
+        new = {
+            "insert": b[:30_001] + b"inserted" + b[30_001:],
+            "delete": b[:30_001] + b[30_500:],
+            "modify": b[:50_000] + b"X" * 10 + b[50_010:],
+            "append": b + b"tail" * 100,
+            "truncate": b[:77_777],
+            "prepend": b"head" + b,
+        }[edit]
+        rebuilt, ops = _rebuild(b, new)
+        assert rebuilt == new
+        # Off-block-boundary edits are found by rolling: only the block around
+        # the edit is sent as literal bytes
+        assert _literal(ops) <= 2 * 2048 + 400
+
+    def test_roll_budget_sends_the_rest_literally(self, monkeypatch):
+        monkeypatch.setattr(tfm_delta_sync, '_ROLL_LIMIT', 10_000)
+        new = os.urandom(20_000) + self.base  # the base blocks are found only by rolling
+        rebuilt, ops = _rebuild(self.base, new)
+        assert rebuilt == new
+        assert _literal(ops) == len(new) - len(self.base) % 2048  # all but the short tail block
+
+    def test_empty_sides(self):
+        assert _rebuild(b"", self.base)[0] == self.base
+        rebuilt, ops = _rebuild(self.base, b"")
+        assert rebuilt == b"" and ops == []
+        assert _rebuild(b"short", b"short")[0] == b"short"
+
+    def test_block_size(self):
+        assert block_size_for(0) == 2048
+        assert block_size_for(100 * 1024 * 1024) == 16384
+        assert block_size_for(1 << 40) == 1 << 17
+
+
+class TestSyncLocal:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.src = os.path.join(self.temp_dir, 'src')
+        self.dest = os.path.join(self.temp_dir, 'dest')
+        data = os.urandom(300_000)
+        for path in (self.src, self.dest):
+            with open(path, 'wb') as f:
+                f.write(data)
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _touch_src(self, offset, data):
+        with open(self.src, 'r+b') as f:
+            f.seek(offset)
+            f.write(data)
+        os.utime(self.src, (2_000_000, 2_000_000))
+
+    def test_quick_check_and_whole_copy(self):
+        os.utime(self.dest, (1_000_000, 1_000_000))
+        os.utime(self.src, (1_000_000, 1_000_000))
+        stats = SyncStats()
+        assert sync_file(Path(self.src), Path(self.dest), stats) == UNCHANGED
+
+        # A local destination is copied whole (rsync -W): nothing is read for a delta
+        self._touch_src(123_456, b'changed')
+        assert sync_file(Path(self.src), Path(self.dest), stats) == COPY
+        assert stats.unchanged == 1 and stats.whole_files == 1
+        assert stats.received_bytes == 0 and stats.literal_bytes == 0
+
+    def test_missing_dest_is_copied_by_caller(self):
+        os.unlink(self.dest)
+        assert sync_file(Path(self.src), Path(self.dest)) == COPY
+        shutil.copyfile(self.src, self.dest)
+        set_synced_mtime(Path(self.src), Path(self.dest))
+        assert os.stat(self.dest).st_mtime_ns == os.stat(self.src).st_mtime_ns
+        assert sync_file(Path(self.src), Path(self.dest)) == UNCHANGED
+
+class TestLocalEtag:
+
+    def test_single_and_multipart(self, tmp_path):
+        path = tmp_path / 'f'
+        data = os.urandom(9 * 1024 * 1024)
+        path.write_bytes(data)
+        assert local_etag(str(path), 'x' * 32) == hashlib.md5(data).hexdigest()
+        parts = hashlib.md5(data[:8 << 20]).digest() + hashlib.md5(data[8 << 20:]).digest()
+        etag = f"{hashlib.md5(parts).hexdigest()}-2"
+        assert local_etag(str(path), etag) == etag
+        assert local_etag(str(path), 'abc-5') is None
+
+
+class TestSyncSSH:
+    """The host computes the signature and applies the delta"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.conn = SSHConnection('sync-test', {})
+        self.conn._exec_argv = lambda command: ['sh', '-c', command.replace('python3', sys.executable, 1)]
+        self.conn._connected = True
+        self.conn._cache.clear()
+
+    def teardown_method(self):
+        self.conn._cache.clear()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _pair(self, name, size, seed=0):
+        rng = random.Random(seed)
+        data = bytes(rng.getrandbits(8) for _ in range(size))
+        src = os.path.join(self.temp_dir, name + '.src')
+        dest = os.path.join(self.temp_dir, name + '.dest')
+        for path in (src, dest):
+            with open(path, 'wb') as f:
+                f.write(data)
+        return src, dest
+
+    def test_patch_on_host(self):
+        src, dest = self._pair('f', 200_000)
+        with open(src, 'r+b') as f:
+            f.seek(70_001)
+            f.write(b'remote edit')
+        os.chmod(dest, 0o640)
+        stats = SyncStats()
+        assert sync_ssh(src, self.conn, dest, os.path.getsize(dest), stats)
+        assert open(src, 'rb').read() == open(dest, 'rb').read()
+        assert os.stat(dest).st_mode & 0o777 == 0o640
+        assert int(os.stat(dest).st_mtime) == int(os.stat(src).st_mtime)
+        assert stats.literal_bytes <= 2 * 2048 and stats.sent_bytes < 5000
+        assert stats.received_bytes == 8 + 20 * -(-200_000 // 2048)  # size + one record per block
+
+    def test_failures(self):
+        src, dest = self._pair('f', 1000)
+        with pytest.raises(SSHError):
+            sync_ssh(src, self.conn, os.path.join(self.temp_dir, 'missing'), 0)
+        self.conn._exec_argv = lambda command: ['sh', '-c', 'exit 127']
+        assert sync_ssh(src, self.conn, dest, 1000) is False
+
+    def test_cancel_leaves_dest_intact(self):
+        src, dest = self._pair('f', 200_000)
+        with open(src, 'r+b') as f:
+            f.write(b'new')
+        before = open(dest, 'rb').read()
+
+        class Stop(Exception):
+            pass
+
+        def checkpoint():
+            raise Stop()
+
+        with pytest.raises(Stop):
+            sync_ssh(src, self.conn, dest, len(before), checkpoint=checkpoint)
+        assert open(dest, 'rb').read() == before
+
+    def _remote(self, path):
+        """A Path-like SSH destination for ``path``, served by ``self.conn``"""
+        conn = self.conn
+
+        class Impl:
+            remote_path = path
+
+            def _get_connection(self):
+                return conn
+
+        class Remote:
+            _impl = Impl()
+
+            def __str__(self):
+                return f'ssh://sync-test{path}'
+
+            def get_scheme(self):
+                return 'ssh'
+
+            def is_file(self):
+                return os.path.isfile(path)
+
+            def stat(self):
+                return os.stat(path)
+
+        return Remote()
+
+    def test_helper_failure_falls_back_to_whole_copy(self):
+        src, dest = self._pair('f', 1000)
+        with open(src, 'ab') as f:
+            f.write(b'more')
+        self.conn._exec_argv = lambda command: ['sh', '-c', 'echo broken >&2; exit 1']
+        stats = SyncStats()
+        assert sync_file(Path(src), self._remote(dest), stats) == COPY
+        assert stats.whole_files == 1
+        assert self.conn._remote_python_supported  # a failure isn't a missing helper
+
+    def test_whole_copy_gets_source_mtime(self):
+        src, dest = self._pair('f', 1000)
+        os.utime(src, (1_500_000_000.7, 1_500_000_000.7))
+        self.conn._sftp_unavailable = True  # set through ``touch`` on the host
+        set_synced_mtime(Path(src), self._remote(dest))
+        assert os.stat(dest).st_mtime == 1_500_000_000
+        assert sync_file(Path(src), self._remote(dest)) == UNCHANGED
+
+    def test_mostly_unchanged_tree(self):
+        """Benchmark: bytes sent and wall time, whole copy vs delta"""
+        files, size = 24, 512 * 1024
+        pairs = [self._pair(f'f{i}', size, seed=i) for i in range(files)]
+        for src, dest in pairs:
+            shutil.copyfile(dest, dest + '.ssh')
+        for i, (src, _) in enumerate(pairs):
+            if i % 4 == 0:  # a quarter of the files get a small edit
+                with open(src, 'r+b') as f:
+                    f.seek(size // 3 + i)
+                    f.write(b'edit %d' % i)
+
+        start = time.perf_counter()
+        for src, dest in pairs:
+            shutil.copyfile(src, dest + '.copy')
+        copy_time = time.perf_counter() - start
+
+        stats = SyncStats()
+        start = time.perf_counter()
+        for src, dest in pairs:
+            sync_ssh(src, self.conn, dest + '.ssh', size, stats)
+        elapsed = time.perf_counter() - start
+        for src, dest in pairs:
+            assert open(src, 'rb').read() == open(dest + '.ssh', 'rb').read()
+
+        total = files * size
+        print(f"\n{files} x {size // 1024} KB, {files // 4} edited: whole copy sends {total} B, "
+              f"{copy_time * 1000:.0f} ms locally")
+        print(f"  delta over ssh: sent {stats.sent_bytes} B, received {stats.received_bytes} B, "
+              f"{elapsed * 1000:.0f} ms")
+        assert stats.literal_bytes <= files // 4 * 2 * block_size_for(size)
+        assert stats.sent_bytes < total // 100
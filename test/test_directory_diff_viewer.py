@@ -543,3 +543,242 @@ def test_deferred_build_leaves_files_pending():
     tree = DiffEngine(left, right, compare_content=False).build_tree()
     assert _find(tree, "a.txt").difference_type is DifferenceType.PENDING
     assert tree.difference_type is DifferenceType.PENDING
+
+
+# --- worker pools and listing throughput --------------------------------------
+
+
+def test_scan_level_reports_unstatable_children(tmp_path):
+    d = tmp_path / "d"
+    d.mkdir()
+    (d / "f.txt").write_text("abc")
+    (d / "dangling").symlink_to(d / "missing")
+    level = DirectoryScanner().scan_level(Path(str(d)))
+    assert level["f.txt"].size == 3 and level["f.txt"].is_accessible
+    assert not level["dangling"].is_accessible and level["dangling"].error_message
+
+
+def _synthetic_trees(tmp_path, dirs, files):
+    """Two identical trees of ``dirs`` directories × ``files`` files, except
+    that the last file of every directory differs."""
+    for side in ("L", "R"):
+        for d in range(dirs):
+            folder = tmp_path / side / f"d{d:03}"
+            folder.mkdir(parents=True)
+            for f in range(files):
+                tail = side if f == files - 1 else ""
+                (folder / f"f{f:04}.txt").write_text(f"{d}/{f}{tail}")
+    return Path(str(tmp_path / "L")), Path(str(tmp_path / "R"))
+
+
+def test_scan_and_compare_throughput_benchmark(tmp_path, monkeypatch):
+    """Benchmark: synthetic trees — listing, 1 MB compare blocks, worker pools"""
+    import tfm_directory_diff_viewer as ddv
+    import tfm_hash_cache
+    import time
+
+    # Raw comparison throughput: no digests remembered between runs
+    monkeypatch.setattr(tfm_hash_cache, "_hash_cache", tfm_hash_cache.HashCache(None))
+    left, right = _synthetic_trees(tmp_path, 40, 250)
+
+    # Listing: stat() + is_dir() per child vs one scandir() pass
+    start = time.perf_counter()
+    with_scandir = DirectoryScanner().scan(left)
+    scandir_s = time.perf_counter() - start
+    with monkeypatch.context() as patch:
+        patch.setattr(Path, "iterdir_stat", lambda self: None)
+        start = time.perf_counter()
+        per_child = DirectoryScanner().scan(left)
+        per_child_s = time.perf_counter() - start
+    assert {k: (v.size, v.is_directory) for k, v in with_scandir.items()} == \
+        {k: (v.size, v.is_directory) for k, v in per_child.items()}
+
+    # Byte comparison of two identical 32 MB files: 8 KB vs 1 MB blocks
+    data = os.urandom(32 * 1024 * 1024)
+    (tmp_path / "big_l").write_bytes(data)
+    (tmp_path / "big_r").write_bytes(data)
+    big_l, big_r = Path(str(tmp_path / "big_l")), Path(str(tmp_path / "big_r"))
+
+    def compare_8k(left_path, right_path):  # the loop compare_file_content replaced
+        with left_path.open("rb") as lf, right_path.open("rb") as rf:
+            while True:
+                lc, rc = lf.read(8192), rf.read(8192)
+                if lc != rc:
+                    return False
+                if not lc:
+                    return True
+
+    rates = {}
+    for name, compare in (("8k", compare_8k), ("new", DiffEngine.compare_file_content)):
+        start = time.perf_counter()
+        assert compare(big_l, big_r)
+        rates[name] = 32 / (time.perf_counter() - start)
+
+    # Whole diff on storage with 2 ms per listing / comparison: 1 vs 4 workers
+    real_scan_level, real_compare = DirectoryScanner.scan_level, DiffEngine.compare_file_content
+
+    def slow_scan_level(self, directory):
+        time.sleep(0.002)
+        return real_scan_level(self, directory)
+
+    def slow_compare(left_path, right_path):
+        time.sleep(0.002)
+        return real_compare(left_path, right_path)
+
+    monkeypatch.setattr(DirectoryScanner, "scan_level", slow_scan_level)
+    monkeypatch.setattr(DiffEngine, "compare_file_content", staticmethod(slow_compare))
+    small_l, small_r = _synthetic_trees(tmp_path / "small", 20, 20)
+    timings = {}
+    for threads in (1, 4):
+        monkeypatch.setattr(ddv, "_SCAN_THREADS", threads)
+        monkeypatch.setattr(ddv, "_COMPARE_THREADS", threads)
+        start = time.perf_counter()
+        view = DirectoryDiffView(small_l, small_r, background=True)
+        view.join(timeout=60)
+        timings[threads] = time.perf_counter() - start
+        assert view._compared == 400
+        assert view.root.difference_type is DifferenceType.CONTAINS_DIFFERENCE
+        assert all(n.difference_type is DifferenceType.CONTAINS_DIFFERENCE
+                   for n in view.root.children)
+
+    print(f"\n10,000-file tree: scan {per_child_s * 1000:.0f} -> {scandir_s * 1000:.0f} ms "
+          f"(stat+is_dir -> scandir); compare {rates['8k']:.0f} -> "
+          f"{rates['new']:.0f} MB/s (8 KB reads -> 256 KB buffers); 400-file diff at "
+          f"2 ms per request {timings[1]:.2f} -> {timings[4]:.2f} s (1 -> 4 workers)")
+    assert scandir_s < per_child_s
+    assert rates["new"] > rates["8k"]
+    assert timings[4] * 2 < timings[1]
+
+
+# --- Merkle digests -----------------------------------------------------------
+
+
+@pytest.fixture
+def hash_cache(tmp_path, monkeypatch):
+    """A fresh persistent hash cache in the test's temporary directory."""
+    import tfm_hash_cache
+    cache = tfm_hash_cache.HashCache(str(tmp_path / "state" / "hash_cache"))
+    monkeypatch.setattr(tfm_hash_cache, "_hash_cache", cache)
+    return cache
+
+
+def test_repeat_diff_settles_from_cached_digests(tmp_path, hash_cache, monkeypatch):
+    """Benchmark: a second diff of unchanged identical trees reads no file and
+    queues no comparison; every directory's Merkle digests match"""
+    import time
+
+    left, right = _synthetic_trees(tmp_path, 20, 50)
+    (tmp_path / "L" / "d000" / "f0049.txt").write_text("same")
+    (tmp_path / "R" / "d000" / "f0049.txt").write_text("same")
+    start = time.perf_counter()
+    first = DirectoryDiffView(left, right, background=True)
+    first.join(timeout=60)
+    cold = time.perf_counter() - start
+    assert first.root.difference_type is DifferenceType.CONTAINS_DIFFERENCE
+    assert _find(first.root, "d000").difference_type is DifferenceType.IDENTICAL
+
+    # Make the differing files equal too: only they are read again
+    for d in range(1, 20):
+        (tmp_path / "R" / f"d{d:03}" / "f0049.txt").write_text(f"{d}/49L")
+    second = DirectoryDiffView(left, right, background=True)
+    second.join(timeout=60)
+    assert second.root.difference_type is DifferenceType.IDENTICAL
+
+    def no_read(*args, **kwargs):
+        raise AssertionError("content read")
+    monkeypatch.setattr(Path, "open", no_read)
+    start = time.perf_counter()
+    third = DirectoryDiffView(left, right, background=True)
+    third.join(timeout=60)
+    warm = time.perf_counter() - start
+    assert third.root.difference_type is DifferenceType.IDENTICAL
+    assert third._compared == third._compare_total == 1000
+    assert third._cmp_q.unfinished_tasks == 0
+    for node in [third.root, *third._iter_nodes(third.root)]:
+        assert node.left_digest is not None and node.left_digest == node.right_digest
+    print(f"\n1000 file pairs: first diff {cold * 1000:.0f} ms, unchanged again "
+          f"{warm * 1000:.0f} ms, no content read")
+
+
+def test_directory_compared_with_itself_is_not_scanned(tmp_path, hash_cache):
+    root = tmp_path / "T"
+    (root / "big" / "deep").mkdir(parents=True)
+    (root / "big" / "deep" / "x.txt").write_text("x")
+    (root / "f.txt").write_text("f")
+    view = DirectoryDiffView(Path(str(root)), Path(str(root)), background=True)
+    view.join()
+    big = _find(view.root, "big")
+    assert big.difference_type is DifferenceType.IDENTICAL
+    assert not big.children_scanned and view._dirs_total == 0
+    assert _find(view.root, "f.txt").difference_type is DifferenceType.IDENTICAL
+    assert view.root.difference_type is DifferenceType.IDENTICAL
+
+
+def test_sync_build_fills_merkle_digests(trees, hash_cache):
+    view = _sync_view(*trees)
+    same = _find(view.root, "same.txt")
+    assert same.left_digest is not None and same.left_digest == same.right_digest
+    assert _find(view.root, "diff.txt").left_digest is None
+    # A difference anywhere keeps the root's sides from matching
+    assert view.root.left_digest is None
+    assert view.root.difference_type is DifferenceType.CONTAINS_DIFFERENCE
+
+
+# --- tree model at scale ------------------------------------------------------
+
+
+def test_large_tree_model_benchmark():
+    """Benchmark: 200,000-node tree — build, expand/collapse, connector lines"""
+    import time
+    from tfm_directory_diff_viewer import FileInfo
+
+    def info(rel, is_dir=False):
+        return FileInfo(Path("/x/" + rel), rel, is_dir, 0, 0.0, True)
+
+    # One flat directory of 100,000 files plus 1,000 directories of 99 files
+    left: dict = {"flat": info("flat", True)}
+    for i in range(100_000):
+        left[f"flat/f{i:06}"] = info(f"flat/f{i:06}")
+    for d in range(1_000):
+        left[f"d{d:04}"] = info(f"d{d:04}", True)
+        for f in range(99):
+            left[f"d{d:04}/f{f:02}"] = info(f"d{d:04}/f{f:02}")
+    right = dict(left)
+    del right["flat/f050000"]          # one one-sided file mid-directory
+
+    start = time.perf_counter()
+    root = DiffEngine(left, right, compare_content=False).build_tree()
+    build_s = time.perf_counter() - start
+
+    view = DirectoryDiffView.__new__(DirectoryDiffView)
+    view.root, view.visible, view.cursor = root, [], 0
+    view._reflow_locked()
+    flat = root.child("flat")
+    start = time.perf_counter()
+    flat.is_expanded = True
+    view._reflow_subtree_locked(flat)
+    expand_s = time.perf_counter() - start
+    assert len(view.visible) == 1_001 + 100_000
+
+    # A viewport of 60 rows in the middle of the 100,000-file directory
+    # The first frame indexes the directory's sibling layout; later ones reuse it
+    rows = view.visible[50_000:50_060]
+    lines_s = []
+    for _ in range(2):
+        start = time.perf_counter()
+        for node in rows:
+            for side_is_left in (True, False):
+                view._tree_lines(node, branch=True, side_is_left=side_is_left)
+        lines_s.append(time.perf_counter() - start)
+
+    start = time.perf_counter()
+    flat.is_expanded = False
+    view._reflow_subtree_locked(flat)
+    collapse_s = time.perf_counter() - start
+    assert len(view.visible) == 1_001
+
+    print(f"\n200k nodes: build {build_s * 1000:.0f} ms, expand 100k rows "
+          f"{expand_s * 1000:.1f} ms, collapse {collapse_s * 1000:.1f} ms, "
+          f"connector lines for a 60-row viewport {lines_s[0] * 1000:.1f} ms first, "
+          f"{lines_s[1] * 1000:.2f} ms after")
+    assert lines_s[1] < 0.01
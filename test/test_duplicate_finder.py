@@ -0,0 +1,209 @@
+"""
+Test suite for tfm_duplicate_finder (Find Duplicates: size buckets, edge
+digests, full digests)
+
+Each test swaps the global hash cache for one in a temporary directory.
+
+Run with: PYTHONPATH=.:src pytest test/test_duplicate_finder.py -v
+"""
+
+import os
+import shutil
+import tempfile
+import time
+
+import pytest
+
+import tfm_hash_cache
+from tfm_duplicate_finder import EDGE_BYTES, _outermost, find_duplicate_groups
+from tfm_hash_cache import HashCache
+from tfm_path import Path
+from tfm_ssh_connection import SSHPermissionDeniedError
+from tfm_task import Cancelled
+
+
+class _DeniedRemote:
+    """A remote directory or file where every read fails, as over SSH
+    without permission; ``files`` are the ``(name, size)`` a directory lists."""
+
+    def __init__(self, text, files=None):
+        self._text = text
+        self._files = files
+
+    def __str__(self):
+        return self._text
+
+    def __truediv__(self, name):
+        return _DeniedRemote(f'{self._text}/{name}')
+
+    def _denied(self, *args, **kwargs):
+        raise SSHPermissionDeniedError(f'Permission denied: {self._text}')
+
+    def iterdir_stat(self):
+        if self._files is None:
+            self._denied()
+        return [(self / name, {'name': name, 'size': size, 'is_dir': False,
+                               'is_file': True, 'is_symlink': False})
+                for name, size in self._files]
+
+    iterdir = content_digest = open = _denied
+
+
+class TestFindDuplicates:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self._saved = tfm_hash_cache._hash_cache
+        self.cache = tfm_hash_cache._hash_cache = HashCache(
+            os.path.join(self.temp_dir, 'state', 'hash_cache'))
+        self.root = os.path.join(self.temp_dir, 'root')
+
+    def teardown_method(self):
+        tfm_hash_cache._hash_cache = self._saved
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _file(self, rel, data):
+        path = os.path.join(self.root, rel)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    def _names(self, groups):
+        return [sorted(os.path.relpath(str(p), self.root) for p in g.paths) for g in groups]
+
+    def test_groups_identical_files_across_directories(self):
+        self._file('a/one.txt', b'same content')
+        self._file('b/two.txt', b'same content')
+        self._file('c/three.txt', b'same content')
+        self._file('a/other.txt', b'other content')  # same size, different bytes
+        self._file('b/unique.bin', b'x' * 100)
+        groups = find_duplicate_groups([Path(self.root)])
+        assert self._names(groups) == [['a/one.txt', 'b/two.txt', 'c/three.txt']]
+        assert groups[0].size == len(b'same content')
+        assert groups[0].wasted == 2 * len(b'same content')
+
+    def test_groups_sorted_by_wasted_bytes(self):
+        self._file('small1', b'a' * 10)
+        self._file('small2', b'a' * 10)
+        self._file('big1', b'b' * 5000)
+        self._file('big2', b'b' * 5000)
+        groups = find_duplicate_groups([Path(self.root)])
+        assert self._names(groups) == [['big1', 'big2'], ['small1', 'small2']]
+
+    def test_large_files_differing_only_in_the_middle(self):
+        size = 4 * EDGE_BYTES
+        base = bytearray(os.urandom(size))
+        self._file('a', bytes(base))
+        self._file('b', bytes(base))
+        base[size // 2] ^= 0xFF
+        self._file('c', bytes(base))  # same edges, so only the full digest tells
+        groups = find_duplicate_groups([Path(self.root)])
+        assert self._names(groups) == [['a', 'b']]
+
+    def test_large_files_differing_at_an_edge_are_not_hashed_in_full(self):
+        size = 4 * EDGE_BYTES
+        data = os.urandom(size)
+        self._file('a', data)
+        self._file('b', data[:-1] + b'\0' if data[-1] else data[:-1] + b'\1')
+        assert find_duplicate_groups([Path(self.root)]) == []
+        assert self.cache.get_stats()['entries'] == 2  # two edge digests, no full ones
+
+    def test_skips_empty_files_symlinks_and_hidden(self):
+        self._file('empty1', b'')
+        self._file('empty2', b'')
+        target = self._file('real', b'content')
+        os.symlink(target, os.path.join(self.root, 'link'))
+        self._file('.hidden', b'content')
+        assert find_duplicate_groups([Path(self.root)]) == []
+        groups = find_duplicate_groups([Path(self.root)], show_hidden=True)
+        assert self._names(groups) == [['.hidden', 'real']]
+
+    def test_hard_links_count_once(self):
+        target = self._file('real', b'content')
+        os.link(target, os.path.join(self.root, 'hardlink'))
+        assert find_duplicate_groups([Path(self.root)]) == []
+
+    def test_nested_roots_are_walked_once(self):
+        self._file('a/one', b'content')
+        self._file('a/sub/two', b'content')
+        roots = [Path(self.root), Path(os.path.join(self.root, 'a')), Path(self.root)]
+        groups = find_duplicate_groups(roots)
+        assert self._names(groups) == [['a/one', 'a/sub/two']]
+
+    def test_outermost_roots(self):
+        assert _outermost(['/']) == ['/']
+        assert _outermost(['/tmp', '/']) == ['/']
+        assert _outermost(['/tmp/', '/tmp', '/tmp/a/']) == ['/tmp/']
+        assert _outermost(['/tmp/a', '/tmp/ab', '/tmp/a/b']) == ['/tmp/a', '/tmp/ab']
+
+    def test_unreadable_remote_entries_are_skipped(self):
+        self._file('a', b'content')
+        self._file('b', b'content')
+        roots = [Path(self.root), _DeniedRemote('/remote/locked'),
+                 _DeniedRemote('/remote/open', [('c', 7), ('d', 7)])]
+        groups = find_duplicate_groups(roots)
+        assert self._names(groups) == [['a', 'b']]
+
+    def test_repeat_run_reads_nothing(self):
+        big = os.urandom(3 * EDGE_BYTES)
+        for i in range(3):
+            self._file(f'd{i}/small', b'small')
+            self._file(f'd{i}/big', big)
+        first = find_duplicate_groups([Path(self.root)])
+        misses = self.cache.misses
+        second = find_duplicate_groups([Path(self.root)])
+        assert self._names(second) == self._names(first)
+        assert self.cache.misses == misses
+
+    def test_changed_file_is_rehashed(self):
+        a = self._file('a', b'content')
+        self._file('b', b'content')
+        assert len(find_duplicate_groups([Path(self.root)])) == 1
+        time.sleep(0.01)
+        with open(a, 'wb') as f:
+            f.write(b'CONTENT')
+        assert find_duplicate_groups([Path(self.root)]) == []
+
+    def test_progress_reports_each_stage(self):
+        big = os.urandom(3 * EDGE_BYTES)
+        self._file('a', big)
+        self._file('b', big)
+        stages = []
+        find_duplicate_groups([Path(self.root)],
+                              on_progress=lambda stage, done, total: stages.append(stage))
+        assert stages[0] == 'scan'
+        assert 'edges' in stages and 'hash' in stages
+
+    def test_checkpoint_cancels(self):
+        self._file('a', b'content')
+        self._file('b', b'content')
+
+        def checkpoint():
+            raise Cancelled()
+
+        with pytest.raises(Cancelled):
+            find_duplicate_groups([Path(self.root)], checkpoint=checkpoint)
+
+    def test_duplicate_finder_benchmark(self):
+        # 4,000 small files in 200 directories, 1,000 of them in duplicate
+        # pairs, plus 32 x 1 MB files of one size that differ at their first byte.
+        payload = os.urandom(1 << 20)
+        for d in range(200):
+            for i in range(20):
+                n = d * 20 + i
+                self._file(f'd{d}/f{i}', b'%08d' % (n // 2 if n % 4 == 0 else n))
+        for i in range(32):
+            self._file(f'big/{i}', bytes([i]) + payload[1:])
+
+        start = time.perf_counter()
+        groups = find_duplicate_groups([Path(self.root)], threads=4)
+        cold = time.perf_counter() - start
+        start = time.perf_counter()
+        again = find_duplicate_groups([Path(self.root)], threads=4)
+        warm = time.perf_counter() - start
+
+        assert len(groups) == len(again) == 500
+        print(f"\nduplicates over 4,032 files: {cold * 1000:.0f} ms cold, "
+              f"{warm * 1000:.0f} ms from the hash cache")
+        assert warm < cold
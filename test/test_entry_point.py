@@ -65,3 +65,11 @@ class TestEntryPoint(unittest.TestCase):
             
         except ImportError as e:
             self.fail(f"Failed to import create_parser function: {e}")
+
+    def test_log_file_option(self):
+        """--log-file names the log file; without it there is none"""
+        from tfm import create_parser
+        parser = create_parser()
+        self.assertIsNone(parser.parse_args([]).log_file)
+        self.assertEqual(parser.parse_args(["--log-file", "/tmp/tfm.log"]).log_file,
+                         "/tmp/tfm.log")
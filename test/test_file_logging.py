@@ -7,10 +7,16 @@ Run with: PYTHONPATH=.:src pytest test/test_file_logging.py -v
 
 import unittest
 import tempfile
+import logging
 import os
+import threading
+import time
 from pathlib import Path
 from unittest.mock import Mock
-from tfm_log_manager import LogManager
+import tfm_log_manager
+from tfm_log_manager import LogManager, enable_file_logging, getLogger
+from tfm_logging_handlers import FileLoggingHandler
+from tfm_log_format import decode_to_text, iter_records
 
 
 class TestFileLogging(unittest.TestCase):
@@ -143,5 +149,250 @@ class TestFileLogging(unittest.TestCase):
         log_manager.restore_stdio()
 
 
+    def _record(self, msg, name="Test", level=logging.INFO, stream=False):
+        record = logging.LogRecord(name, level, __file__, 1, msg, None, None)
+        if stream:
+            record.is_stream_capture = True
+        return record
+    
+    def test_records_are_written_by_the_writer_thread(self):
+        """emit only queues; the writer thread writes without a flush call"""
+        handler = FileLoggingHandler(self.log_file_path, flush_interval=0.01)
+        try:
+            handler.emit(self._record("queued message"))
+            deadline = time.monotonic() + 5
+            while time.monotonic() < deadline:
+                with open(self.log_file_path) as f:
+                    if "queued message" in f.read():
+                        break
+                time.sleep(0.01)
+            with open(self.log_file_path) as f:
+                self.assertIn("[Test] INFO: queued message", f.read())
+        finally:
+            handler.close()
+    
+    def test_concurrent_records_keep_per_thread_order(self):
+        """Every record arrives once, in order per producing thread"""
+        handler = FileLoggingHandler(self.log_file_path)
+        
+        def produce(t):
+            for i in range(2000):
+                handler.handle(self._record(f"t{t} {i}", stream=True))
+        
+        threads = [threading.Thread(target=produce, args=(t,)) for t in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        handler.close()
+        with open(self.log_file_path) as f:
+            lines = f.read().splitlines()
+        self.assertEqual(len(lines), 8000)
+        for t in range(4):
+            self.assertEqual([l for l in lines if l.startswith(f"t{t} ")],
+                             [f"t{t} {i}" for i in range(2000)])
+    
+    def test_full_queue_drops_and_counts(self):
+        """A full queue drops new records instead of blocking the caller"""
+        handler = FileLoggingHandler(self.log_file_path, queue_size=10, flush_interval=60)
+        try:
+            with handler.lock:  # hold the writer off
+                for i in range(15):
+                    handler.emit(self._record(f"m{i}"))
+                self.assertEqual(handler.dropped, 5)
+        finally:
+            handler.close()
+        with open(self.log_file_path) as f:
+            content = f.read()
+        self.assertIn("m9", content)
+        self.assertNotIn("m10", content)
+    
+    def test_concurrent_drops_are_all_counted(self):
+        """Drops from several threads at once are each counted"""
+        handler = FileLoggingHandler(self.log_file_path, queue_size=10, flush_interval=60)
+        try:
+            with handler.lock:
+                def produce():
+                    for i in range(5000):
+                        handler.emit(self._record(f"m{i}"))
+                threads = [threading.Thread(target=produce) for _ in range(4)]
+                for thread in threads:
+                    thread.start()
+                for thread in threads:
+                    thread.join()
+                self.assertEqual(handler.dropped, 4 * 5000 - 10)
+        finally:
+            handler.close()
+    
+    def test_format_switch_rotates_existing_file(self):
+        """A log in the other format is moved to .1 instead of appended to"""
+        backup = self.log_file_path + ".1"
+        try:
+            handler = FileLoggingHandler(self.log_file_path)
+            handler.emit(self._record("as text"))
+            handler.close()
+            
+            handler = FileLoggingHandler(self.log_file_path, binary=True)
+            handler.emit(self._record("as binary"))
+            handler.close()
+            with open(backup) as f:
+                self.assertIn("as text", f.read())
+            with open(self.log_file_path, 'rb') as f:
+                self.assertEqual([r.message for r in iter_records(f)], ["as binary"])
+            
+            # Back to text, with no backups configured: the binary log is still kept
+            handler = FileLoggingHandler(self.log_file_path, backup_count=0)
+            handler.emit(self._record("text again"))
+            handler.close()
+            with open(backup, 'rb') as f:
+                self.assertEqual([r.message for r in iter_records(f)], ["as binary"])
+            with open(self.log_file_path) as f:
+                self.assertEqual(f.read().count("INFO:"), 1)
+        finally:
+            if os.path.exists(backup):
+                os.unlink(backup)
+    
+    def test_enable_file_logging_without_log_manager(self):
+        """Pending loggers, and ones created later, write to the file"""
+        config = Mock(LOG_FILE_MAX_BYTES=0, LOG_FILE_BACKUP_COUNT=0, LOG_FILE_FORMAT='text')
+        saved = (tfm_log_manager._log_manager_instance, tfm_log_manager._file_handler,
+                 dict(tfm_log_manager._pending_loggers))
+        tfm_log_manager._log_manager_instance = None
+        before = getLogger("FileLogBefore")
+        handler = enable_file_logging(self.log_file_path, config)
+        after = getLogger("FileLogAfter")
+        try:
+            before.info("from before")
+            after.warning("from after")
+            self.assertIn(logging.lastResort, after.handlers)
+        finally:
+            handler.close()
+            for logger in (before, after):
+                logger.handlers.clear()
+            (tfm_log_manager._log_manager_instance, tfm_log_manager._file_handler,
+             pending) = saved
+            tfm_log_manager._pending_loggers.clear()
+            tfm_log_manager._pending_loggers.update(pending)
+        with open(self.log_file_path) as f:
+            content = f.read()
+        self.assertIn("[FileLogBefore] INFO: from before", content)
+        self.assertIn("[FileLogAfter] WARNING: from after", content)
+    
+    def test_rotation_by_size(self):
+        """The file rotates to .1, .2 past max_bytes and keeps backup_count files"""
+        handler = FileLoggingHandler(self.log_file_path, max_bytes=1000, backup_count=2)
+        for i in range(100):
+            handler.emit(self._record(f"line {i:03d} " + "x" * 40, stream=True))
+            if i % 7 == 0:
+                handler.flush()
+        handler.close()
+        try:
+            lines = []
+            for suffix in (".2", ".1", ""):
+                path = self.log_file_path + suffix
+                self.assertLessEqual(os.path.getsize(path), 1000)
+                with open(path) as f:
+                    lines += f.read().splitlines()
+            self.assertFalse(os.path.exists(self.log_file_path + ".3"))
+            numbers = [int(l.split()[1]) for l in lines]
+            self.assertEqual(numbers, list(range(numbers[0], 100)))
+        finally:
+            for suffix in (".1", ".2"):
+                if os.path.exists(self.log_file_path + suffix):
+                    os.unlink(self.log_file_path + suffix)
+    
+    def test_failed_rotation_keeps_appending(self):
+        """A rotation whose rename fails appends to the current file instead of
+        dropping every later record"""
+        handler = FileLoggingHandler(self.log_file_path, max_bytes=200, backup_count=1)
+
+        def fail(count):
+            raise PermissionError("rename refused")
+
+        handler._shift_backups = fail
+        try:
+            for i in range(20):
+                handler.emit(self._record(f"line {i:02d} " + "x" * 40, stream=True))
+                handler.flush()
+            self.assertIsNotNone(handler.file_handle)
+        finally:
+            handler.close()
+        with open(self.log_file_path) as f:
+            numbers = [int(l.split()[1]) for l in f.read().splitlines()]
+        self.assertEqual(numbers, list(range(20)))
+        self.assertFalse(os.path.exists(self.log_file_path + ".1"))
+    
+    def test_binary_format_round_trip(self):
+        """A binary log decodes to the lines the text log holds"""
+        text_path = self.log_file_path + ".txt"
+        records = [self._record("first", "Main"), self._record("second %d", "FileOp", logging.ERROR),
+                   self._record("raw output", stream=True), self._record("third é", "Main")]
+        records[1].args = (2,)
+        try:
+            for path, binary in ((self.log_file_path, True), (text_path, False)):
+                handler = FileLoggingHandler(path, binary=binary)
+                for record in records:
+                    handler.emit(record)
+                handler.close()
+            with open(self.log_file_path, 'rb') as f:
+                decoded = list(iter_records(f))
+            self.assertEqual([r.name for r in decoded], ["Main", "FileOp", "Test", "Main"])
+            self.assertEqual(decoded[1].levelname, "ERROR")
+            self.assertTrue(decoded[2].is_stream_capture)
+            with open(self.log_file_path, 'rb') as f:
+                text = "".join(decode_to_text(f))
+            with open(text_path, encoding='utf-8') as f:
+                self.assertEqual(text, f.read())
+            
+            # Appending after a restart, and a frame cut short by a crash
+            handler = FileLoggingHandler(self.log_file_path, binary=True)
+            handler.emit(self._record("after restart", "Other"))
+            handler.close()
+            with open(self.log_file_path, 'ab') as f:
+                f.write(b"\x02\x00\x00")
+            with open(self.log_file_path, 'rb') as f:
+                decoded = list(iter_records(f))
+            self.assertEqual((decoded[-1].name, decoded[-1].message), ("Other", "after restart"))
+            self.assertEqual(len(decoded), 5)
+        finally:
+            os.unlink(text_path)
+    
+    def test_file_logging_benchmark(self):
+        """Per-record cost on the logging thread, and writer throughput"""
+        n = 100_000
+        records = [self._record(f"debug message {i}", "Bench", logging.DEBUG) for i in range(n)]
+        
+        # Before: format, write and flush on the calling thread
+        with open(self.log_file_path + ".sync", 'a', encoding='utf-8') as f:
+            start = time.perf_counter()
+            for record in records[:20_000]:
+                f.write(f"{time.strftime('%H:%M:%S')} [{record.name}] "
+                        f"{record.levelname}: {record.getMessage()}\n")
+                f.flush()
+            sync = (time.perf_counter() - start) / 20_000
+        os.unlink(self.log_file_path + ".sync")
+        
+        results = {}
+        for binary in (False, True):
+            open(self.log_file_path, 'w').close()
+            handler = FileLoggingHandler(self.log_file_path, binary=binary, queue_size=n)
+            handle = handler.handle
+            start = time.perf_counter()
+            for record in records:
+                handle(record)
+            caller = (time.perf_counter() - start) / n
+            handler.close()
+            total = time.perf_counter() - start
+            self.assertEqual(handler.dropped, 0)
+            results[binary] = (caller, n / total)
+        
+        print(f"\nfile log: synchronous {sync * 1e6:.2f} µs/record; queued "
+              f"{results[False][0] * 1e6:.2f} µs/record on the caller "
+              f"({results[False][1] / 1000:.0f}k records/s written as text, "
+              f"{results[True][1] / 1000:.0f}k/s binary, binary caller "
+              f"{results[True][0] * 1e6:.2f} µs)")
+        self.assertLess(results[False][0], sync)
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,149 @@
+"""
+Test suite for tfm_hash_cache (persistent SHA-256 digests of local files) and
+tfm_content_digest.compare_content, the comparison that uses it
+
+Each test swaps the global cache for one in a temporary directory.
+
+Run with: PYTHONPATH=.:src pytest test/test_hash_cache.py -v
+"""
+
+import hashlib
+import os
+import shutil
+import tempfile
+import time
+
+import tfm_hash_cache
+from tfm_content_digest import compare_content, directory_digest
+from tfm_hash_cache import KEY_SIZE, HashCache, stat_key
+from tfm_path import Path
+
+KB = 1024
+
+
+class _HashCacheTest:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.cache_file = os.path.join(self.temp_dir, 'state', 'hash_cache')
+        self._saved = tfm_hash_cache._hash_cache
+        self.cache = tfm_hash_cache._hash_cache = HashCache(self.cache_file)
+
+    def teardown_method(self):
+        tfm_hash_cache._hash_cache = self._saved
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _file(self, name, data):
+        path = os.path.join(self.temp_dir, name)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+
+class TestHashCache(_HashCacheTest):
+
+    def test_digest_persists_across_instances(self):
+        path = self._file('a.bin', b'hello' * 1000)
+        digest = self.cache.file_digest(path)
+        assert digest == hashlib.sha256(b'hello' * 1000).digest()
+        self.cache.flush()
+        reopened = HashCache(self.cache_file)
+        assert reopened.get(stat_key(os.stat(path))) == digest
+        assert reopened.get_stats()['entries'] == 1 and reopened.hits == 1
+
+    def test_modified_file_misses(self):
+        path = self._file('a.bin', b'one')
+        old = self.cache.file_digest(path)
+        time.sleep(0.01)
+        self._file('a.bin', b'two')  # same size, new mtime/ctime
+        assert self.cache.file_digest(path) == hashlib.sha256(b'two').digest() != old
+        assert self.cache.misses == 2
+
+    def test_least_recently_used_dropped_and_file_rewritten(self):
+        cache = HashCache(self.cache_file, max_entries=4)
+        keys = [bytes([i]) * KEY_SIZE for i in range(12)]
+        for key in keys[:4]:
+            cache.put(key, key[:1] * 32)
+        assert cache.get(keys[0]) is not None  # keys[0] is now the most recently used
+        for key in keys[4:7]:
+            cache.put(key, key[:1] * 32)
+        assert [k[0] for k in cache._load()] == [0, 4, 5, 6]
+        cache.flush()  # appended: the on-disk order is the order of stores
+        assert [k[0] for k in HashCache(self.cache_file, max_entries=4)._load()] == [3, 4, 5, 6]
+        for key in keys[7:]:
+            cache.put(key, key[:1] * 32)
+        cache.flush()  # 12 records on disk > 2 x 4: rewritten with the live 4
+        assert os.path.getsize(self.cache_file) == 8 + 4 * (KEY_SIZE + 32)
+        assert [k[0] for k in HashCache(self.cache_file, max_entries=4)._load()] == [8, 9, 10, 11]
+
+    def test_disabled_and_corrupt(self):
+        disabled = HashCache(self.cache_file, max_entries=0)
+        disabled.put(b'k' * KEY_SIZE, b'd' * 32)
+        assert disabled.get(b'k' * KEY_SIZE) is None and not disabled.enabled
+        os.makedirs(os.path.dirname(self.cache_file))
+        with open(self.cache_file, 'wb') as f:
+            f.write(b'not a hash cache')
+        assert HashCache(self.cache_file).get(b'k' * KEY_SIZE) is None
+
+
+class TestCompareContent(_HashCacheTest):
+
+    def test_equal_files_compare_without_reading_again(self, monkeypatch):
+        data = os.urandom(600 * KB)
+        a, b = Path(self._file('a', data)), Path(self._file('b', data))
+        assert compare_content(a, b)
+        assert self.cache.get_stats()['stores'] == 2
+
+        def no_read(*args, **kwargs):
+            raise AssertionError('content read')
+        monkeypatch.setattr(Path, 'open', no_read)
+        assert compare_content(b, a)
+
+    def test_one_cached_side_hashes_only_the_other(self, monkeypatch):
+        data = os.urandom(300 * KB)
+        a, b = Path(self._file('a', data)), Path(self._file('b', data))
+        c = Path(self._file('c', data[:-1] + bytes([data[-1] ^ 1])))
+        self.cache.file_digest(str(a))
+        monkeypatch.setattr(Path, 'open', lambda *args, **kwargs: 1 / 0)
+        assert compare_content(a, b)
+        assert not compare_content(c, a)
+
+    def test_difference_stores_nothing(self):
+        a = Path(self._file('a', b'x' * 400 * KB))
+        b = Path(self._file('b', b'x' * 300 * KB + b'y' * 100 * KB))
+        assert not compare_content(a, b)
+        assert self.cache.get_stats()['stores'] == 0
+
+    def test_rerun_benchmark(self):
+        """Benchmark: comparing 200 pairs of 256 KB files again after a restart"""
+        pairs = []
+        for i in range(200):
+            data = os.urandom(256 * KB)
+            pairs.append((Path(self._file(f'l{i}', data)), Path(self._file(f'r{i}', data))))
+        start = time.perf_counter()
+        assert all(compare_content(a, b) for a, b in pairs)
+        cold = time.perf_counter() - start
+        self.cache.flush()
+        # A new session: the digests come from the cache file
+        self.cache = tfm_hash_cache._hash_cache = HashCache(self.cache_file)
+        start = time.perf_counter()
+        assert all(compare_content(a, b) for a, b in pairs)
+        warm = time.perf_counter() - start
+        stats = self.cache.get_stats()
+        assert (stats['hits'], stats['misses'], stats['stores']) == (400, 0, 0)
+        print(f"\n200 x 256 KB pairs: first compare {cold * 1000:.1f} ms, again after "
+              f"restart {warm * 1000:.1f} ms, no content read")
+        assert warm < cold / 5
+
+
+class TestDirectoryDigest:
+
+    def test_names_types_and_contents_count(self):
+        a, b = b'a' * 32, b'b' * 32
+        base = directory_digest([('x', False, a), ('y', True, b)])
+        assert directory_digest([('y', True, b), ('x', False, a)]) == base  # order-free
+        assert directory_digest([('x', False, a), ('y', False, b)]) != base
+        assert directory_digest([('x', False, a), ('z', True, b)]) != base
+        assert directory_digest([('x', False, b), ('y', True, b)]) != base
+        # Lengths are framed: moving bytes between name and digest changes it
+        assert directory_digest([('ab', False, a)]) != directory_digest([('a', False, b'b' + a[:31])])
@@ -6,9 +6,10 @@ Run with: PYTHONPATH=.:src pytest test/test_logcapture_integration.py -v
 
 import sys
 import logging
+import threading
 from collections import deque
 
-from tfm_log_manager import LogManager
+from tfm_log_manager import LogCapture, LogManager
 
 
 class MockConfig:
@@ -85,3 +86,42 @@ def test_getlogger_returns_logger():
     
     # Now we can print
     print("✓ getLogger returns logger instance")
+
+
+def test_lines_from_threads_keep_their_order():
+    """A line split off first reaches the handlers first, even when another
+    thread writes while the first line is still being handled"""
+    received = []
+    handling_a = threading.Event()
+    b_written = threading.Event()
+
+    def slow_filter(record):
+        # Logger filters run before any handler lock is taken
+        if record.msg == 'a':
+            handling_a.set()
+            b_written.wait(0.5)  # times out unless 'b' can overtake
+        return True
+
+    class Handler(logging.Handler):
+        def emit(self, record):
+            received.append(record.msg)
+
+    logger = logging.getLogger("test_logcapture_order")
+    logger.propagate = False
+    logger.setLevel(logging.DEBUG)
+    handler = Handler()
+    logger.addHandler(handler)
+    logger.addFilter(slow_filter)
+    try:
+        capture = LogCapture("STDOUT", logger=logger)
+        first = threading.Thread(target=capture.write, args=('a\n',))
+        first.start()
+        handling_a.wait(5)
+        second = threading.Thread(target=lambda: (capture.write('b\n'), b_written.set()))
+        second.start()
+        first.join()
+        second.join()
+        assert received == ['a', 'b']
+    finally:
+        logger.removeFilter(slow_filter)
+        logger.removeHandler(handler)
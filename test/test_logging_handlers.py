@@ -5,10 +5,11 @@ Run with: PYTHONPATH=.:src pytest test/test_logging_handlers.py -v
 """
 
 import logging
+import threading
 import time
 from datetime import datetime
 
-from tfm_logging_handlers import LogPaneHandler, StreamOutputHandler
+from tfm_logging_handlers import LogPaneHandler, LogRing, StreamOutputHandler
 
 
 
@@ -237,3 +238,142 @@ def test_is_stream_capture_flag():
     assert "INFO: Default output" in _entry_text(messages[2])
     
     print("✓ is_stream_capture flag test passed")
+
+
+def _record(msg, name="Logger"):
+    return logging.LogRecord(name=name, level=logging.INFO, pathname="", lineno=0,
+                             msg=msg, args=(), exc_info=None)
+
+
+def test_log_ring_generation_and_read_since():
+    """The generation keeps counting past capacity; read_since returns only
+    what is new and still retained"""
+    ring = LogRing(4, lambda record: record.getMessage())
+    for i in range(3):
+        ring.append(_record(f"m{i}"))
+    generation, rows = ring.read_since(0)
+    assert generation == 3 and [text for text, _ in rows] == ["m0", "m1", "m2"]
+
+    ring.append(_record("m3"))
+    generation, rows = ring.read_since(generation)
+    assert generation == 4 and [text for text, _ in rows] == ["m3"]
+
+    for i in range(4, 10):
+        ring.append(_record(f"m{i}"))
+    generation, rows = ring.read_since(generation)
+    assert generation == 10 and [text for text, _ in rows] == ["m6", "m7", "m8", "m9"]
+    assert len(ring) == 4
+    assert ring[-1][0] == "m9" and [text for text, _ in ring[1:3]] == ["m7", "m8"]
+
+    ring.clear()
+    assert len(ring) == 0 and ring.generation == 10
+    print("✓ LogRing generation test passed")
+
+
+def test_log_ring_formats_lazily():
+    """While the pane is hidden, only rows that are read get formatted, each once"""
+    formatted = []
+
+    def fmt(record):
+        formatted.append(record.getMessage())
+        return record.getMessage().upper()
+
+    handler = LogPaneHandler(max_messages=100)
+    handler.set_visible(False)
+    handler.messages._format = fmt
+    for i in range(50):
+        handler.handle(_record(f"row{i}", name="STDOUT"))
+    assert formatted == []
+
+    rows = handler.get_message_slice(-3, None)
+    assert [text for text, _ in rows] == ["ROW47", "ROW48", "ROW49"]
+    handler.get_message_slice(-3, None)
+    assert formatted == ["row47", "row48", "row49"]
+    print("✓ LogRing lazy formatting test passed")
+
+
+def test_log_ring_concurrent_producers():
+    """Records from many threads all arrive, in order per thread, while the
+    consumer keeps reading"""
+    ring = LogRing(1000, lambda record: record.getMessage())
+    threads, per_thread = 8, 5000
+    seen = []
+    done = threading.Event()
+
+    def produce(t):
+        for i in range(per_thread):
+            ring.append(_record(f"{t}:{i}"))
+
+    def consume():
+        generation = 0
+        while not done.is_set() or generation < threads * per_thread:
+            generation, rows = ring.read_since(generation)
+            seen.extend(text for text, _ in rows)
+
+    consumer = threading.Thread(target=consume)
+    consumer.start()
+    producers = [threading.Thread(target=produce, args=(t,)) for t in range(threads)]
+    for p in producers:
+        p.start()
+    for p in producers:
+        p.join()
+    done.set()
+    consumer.join()
+
+    assert ring.generation == threads * per_thread
+    assert len(ring) == 1000
+    assert len(seen) == len(set(seen))
+    last = {}
+    for text in seen:
+        t, i = map(int, text.split(":"))
+        assert i > last.get(t, -1)
+        last[t] = i
+    print("✓ LogRing concurrency test passed")
+
+
+def test_log_pane_contention_benchmark():
+    """8 threads logging 100k records through a logger while the UI thread
+    redraws a 40-row pane every 16 ms"""
+    handler = LogPaneHandler(max_messages=1000)
+    logger = logging.getLogger("tfm_bench_log_ring")
+    logger.handlers[:] = [handler]
+    logger.setLevel(logging.DEBUG)
+    logger.propagate = False
+    threads, per_thread = 8, 12_500
+    done = threading.Event()
+    redraws = []
+
+    def produce(t):
+        for i in range(per_thread):
+            logger.debug("ssh: channel %d read %d bytes", t, i)
+
+    def redraw():
+        generation = 0
+        while not done.is_set():
+            start = time.perf_counter()
+            if handler.generation != generation:
+                generation = handler.generation
+                handler.get_message_slice(-40, None)
+            redraws.append(time.perf_counter() - start)
+            time.sleep(0.016)
+
+    ui = threading.Thread(target=redraw)
+    ui.start()
+    start = time.perf_counter()
+    producers = [threading.Thread(target=produce, args=(t,)) for t in range(threads)]
+    for p in producers:
+        p.start()
+    for p in producers:
+        p.join()
+    elapsed = time.perf_counter() - start
+    done.set()
+    ui.join()
+    logger.handlers[:] = []
+
+    rate = threads * per_thread / elapsed
+    redraws.sort()
+    print(f"\nlog pane: {rate / 1000:.0f}k records/s from {threads} threads, "
+          f"redraw median {redraws[len(redraws) // 2] * 1e6:.0f} µs, "
+          f"max {redraws[-1] * 1e3:.1f} ms over {len(redraws)} redraws")
+    assert handler.generation == threads * per_thread
+    assert [text for text, _ in handler.get_message_slice(-1, None)]
@@ -0,0 +1,184 @@
+"""
+Test suite for tfm_lru_cache (LRU core of S3Cache, SSHCache and ArchiveCache)
+
+The path-index queries are checked against a brute-force scan over random
+paths; the benchmark compares S3Cache with the dict-and-scan cache it replaced.
+
+Run with: PYTHONPATH=.:src pytest test/test_lru_cache.py -v
+"""
+
+import hashlib
+import json
+import random
+import time
+
+from tfm_lru_cache import LRUCache
+from tfm_s3 import S3Cache
+from tfm_ssh_cache import SSHCache
+
+
+class TestLRUCore:
+
+    def test_lru_order_and_limits(self):
+        evicted = []
+        cache = LRUCache(max_entries=3, on_evict=lambda e: evicted.append(e.key))
+        for key in 'abc':
+            cache.put(key, key.upper())
+        assert cache.get('a') == 'A'  # a is now the most recently used
+        cache.put('d', 'D')
+        assert evicted == ['b'] and list(cache) == ['c', 'a', 'd']
+        cache.put('c', 'C2')  # replacing is not an eviction
+        assert evicted == ['b'] and cache.get('c') == 'C2' and cache.evictions == 1
+
+    def test_byte_budget(self):
+        cache = LRUCache(max_entries=0, max_bytes=100)
+        for key in 'abcd':
+            cache.put(key, None, size=30)
+        assert list(cache) == ['b', 'c', 'd'] and cache.total_bytes == 90
+        cache.put('big', None, size=500)  # kept alone rather than refused
+        assert list(cache) == ['big'] and cache.total_bytes == 500
+        cache.pop('big')
+        assert cache.total_bytes == 0
+
+    def test_ttl_wheel(self):
+        cache = LRUCache(max_entries=0)
+        cache.put('short', 1, ttl=5, now=1000.0)
+        cache.put('long', 2, ttl=50, now=1000.0)
+        cache.put('forever', 3, now=1000.0)
+        assert cache.expired_count(now=1004.0) == 0
+        assert cache.get('short', now=1005.0) == 1  # not past its TTL yet
+        assert cache.expired_count(now=1006.0) == 1
+        assert cache.purge_expired(now=1006.0) == 1 and 'short' not in cache
+        assert cache.get('long', now=1051.0) is None and len(cache) == 1
+        assert cache.expirations == 2 and not cache._wheel
+
+    def test_sliding_ttl(self):
+        cache = LRUCache()
+        cache.put('k', 'v', ttl=10, now=0.0)
+        for now in (8.0, 16.0, 24.0):
+            assert cache.get_entry('k', now=now, refresh_ttl=True) is not None
+        assert cache.get_entry('k', now=35.0) is None
+
+    def test_path_queries_match_scan(self):
+        rng = random.Random(7)
+        words = ['a', 'ab', 'abc', 'b', 'docs', 'docs2', 'x']
+        cache = LRUCache(max_entries=0)
+        paths = {}
+        for i in range(600):
+            path = '/'.join(rng.choice(words) for _ in range(rng.randint(0, 4)))
+            paths[i] = path
+            cache.put(i, path, scope=i % 2, path=path)
+        for i in rng.sample(range(600), 200):  # exercise pruning and edge merging
+            cache.pop(i)
+            del paths[i]
+        for query in ['', 'a', 'ab', 'ab/', 'abc/x', 'docs', 'docs/', 'do', 'z', 'b/ab/docs2']:
+            for scope in (0, 1):
+                live = {i: p for i, p in paths.items() if i % 2 == scope}
+                keys = lambda entries: sorted(e.key for e in entries)
+                assert keys(cache.entries_at(scope, query)) == sorted(
+                    i for i, p in live.items() if p == query)
+                assert keys(cache.entries_with_prefix(scope, query)) == sorted(
+                    i for i, p in live.items() if p.startswith(query))
+                assert keys(cache.entries_on_path(scope, query)) == sorted(
+                    i for i, p in live.items() if query.startswith(p))
+        cache.remove_entries(cache.scope_entries(0))
+        assert all(key % 2 for key in cache) and 0 not in cache._tries
+
+
+class TestRemoteCaches:
+
+    def test_s3_invalidate_key(self):
+        cache = S3Cache(max_entries=100)
+        cache.put('list_objects_v2', 'b', 'docs/', data=['listing'])
+        cache.put('head_object', 'b', 'docs/a.txt', data={'size': 1})
+        cache.put('head_object', 'b', 'docs/a.txt.bak', data={'size': 2})
+        cache.put('head_object', 'b', 'docs/sub/c', data={'size': 3})
+        cache.put('head_object', 'b', 'docs', data={'size': 4})
+        cache.put('list_objects_v2', 'other', 'docs/', data=['kept'])
+        cache.invalidate_key('b', 'docs/a.txt')
+        assert cache.get('list_objects_v2', 'b', 'docs/') is None
+        assert cache.get('head_object', 'b', 'docs/a.txt') is None
+        assert cache.get('head_object', 'b', 'docs/a.txt.bak') == {'size': 2}
+        assert cache.get('head_object', 'b', 'docs') == {'size': 4}  # not a listing
+        cache.invalidate_key('b', 'docs')
+        assert cache.get('head_object', 'b', 'docs/sub/c') is None
+        assert cache.get('list_objects_v2', 'other', 'docs/') == ['kept']
+        assert cache.get_stats()['bytes'] > 0
+
+    def test_ssh_invalidate_path(self):
+        cache = SSHCache(max_entries=100)
+        cache.put('list_directory', 'h', '/home/u', data=['f.txt'])
+        cache.put('stat', 'h', '/home/u', data={'is_dir': True})
+        cache.put('stat', 'h', '/home/u/f.txt', data={'size': 1})
+        cache.put('stat', 'h', '/home/u2', data={'size': 2})
+        cache.put('stat', 'h', '/home/u/f.txt', error=PermissionError('denied'))
+        cache.invalidate_path('h', '/home/u/f.txt/')
+        assert cache.get('list_directory', 'h', '/home/u') is None
+        assert cache.get('stat', 'h', '/home/u') == {'is_dir': True}
+        assert cache.get('stat', 'h', '/home/u/f.txt') is None
+        cache.invalidate_directory('h', '/home/u')
+        assert cache.get('stat', 'h', '/home/u') is None
+        assert cache.get('stat', 'h', '/home/u2') == {'size': 2}
+
+    def test_ssh_put_listings_keeps_whole_batch(self):
+        # The batch alone is over the byte limit: older entries go, the
+        # batch stays whole, and the next put evicts its least recent entry
+        cache = SSHCache(max_entries=100, max_bytes=2000)
+        cache.put('stat', 'h', '/old', data={'size': 1})
+        listings = {f'/tree/d{i}': [f'name{j}' for j in range(20)] for i in range(20)}
+        cache.put_listings('h', listings)
+        assert cache.get('stat', 'h', '/old') is None
+        assert all(cache.get('list_directory', 'h', path) == entries
+                   for path, entries in listings.items())
+        cache.put('stat', 'h', '/new', data={'size': 2})
+        assert cache.get('stat', 'h', '/new') == {'size': 2}
+        assert sum(cache.get('list_directory', 'h', path) is not None
+                   for path in listings) < len(listings)
+
+
+class _ScanCache:
+    """The S3Cache storage before tfm_lru_cache: a dict, a min() over every
+    entry to evict, and a scan of every entry to invalidate."""
+
+    def __init__(self, max_entries):
+        self.max_entries = max_entries
+        self._cache = {}
+
+    def put(self, operation, bucket, key, data):
+        cache_key = hashlib.md5(json.dumps({'operation': operation, 'bucket': bucket, 'key': key},
+                                           sort_keys=True).encode()).hexdigest()
+        now = time.time()
+        if len(self._cache) >= self.max_entries and cache_key not in self._cache:
+            del self._cache[min(self._cache, key=lambda k: self._cache[k]['last_access'])]
+        self._cache[cache_key] = {'data': data, 'timestamp': now, 'last_access': now, 'ttl': 60,
+                                  'bucket': bucket, 'key': key, 'operation': operation}
+
+    def invalidate_prefix(self, bucket, prefix):
+        for cache_key in [k for k, e in self._cache.items()
+                          if e['bucket'] == bucket and e['key'].startswith(prefix)]:
+            del self._cache[cache_key]
+
+
+class TestBenchmark:
+
+    def test_full_cache_benchmark(self):
+        """Benchmark: puts into a full 20,000-entry cache, and prefix invalidations"""
+        size, puts, invalidations = 20000, 1000, 200
+        timings = {}
+        for name, cache in (('scan', _ScanCache(size)), ('lru', S3Cache(max_entries=size))):
+            for i in range(size):
+                cache.put('head_object', 'bucket', f'dir{i % 100}/file{i}', data=None)
+            start = time.perf_counter()
+            for i in range(size, size + puts):
+                cache.put('head_object', 'bucket', f'dir{i % 100}/file{i}', data=None)
+            timings[(name, 'put')] = (time.perf_counter() - start) / puts
+            start = time.perf_counter()
+            for i in range(invalidations):
+                cache.invalidate_prefix('bucket', f'dir{i % 100}/file{i}')
+            timings[(name, 'invalidate')] = (time.perf_counter() - start) / invalidations
+        print(f"\nFull {size}-entry cache: put {timings[('scan', 'put')] * 1e6:.0f} -> "
+              f"{timings[('lru', 'put')] * 1e6:.0f} us, invalidate_prefix "
+              f"{timings[('scan', 'invalidate')] * 1e6:.0f} -> "
+              f"{timings[('lru', 'invalidate')] * 1e6:.0f} us (scan -> LRU core)")
+        assert timings[('lru', 'put')] * 10 < timings[('scan', 'put')]
+        assert timings[('lru', 'invalidate')] * 10 < timings[('scan', 'invalidate')]
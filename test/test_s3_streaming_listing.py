@@ -0,0 +1,208 @@
+"""
+Test suite for streaming S3 directory listings
+
+``S3PathImpl.iterdir_pages`` yields each ``list_objects_v2`` page as it
+arrives, and ``FileListManager.compute_listing`` sorts the pages into the
+listing and hands the partial results to the pane. The bucket is an in-memory
+paginator with a per-page round-trip delay.
+
+Run with: PYTHONPATH=.:src pytest test/test_s3_streaming_listing.py -v
+"""
+
+import time
+from datetime import datetime
+
+import tfm_s3
+from tfm_const import DATE_FORMAT_SHORT
+from tfm_file_list_manager import FileListManager
+from tfm_path import Path
+
+
+class _Paginator:
+
+    def __init__(self, fake):
+        self._fake = fake
+
+    def paginate(self, Bucket, Prefix, Delimiter):
+        fake = self._fake
+        fake.list_calls += 1
+        keys = sorted(k for k in fake.keys if k.startswith(Prefix))
+        contents, prefixes = [], []
+        for key in keys:
+            rest = key[len(Prefix):]
+            if Delimiter in rest[:-1]:
+                common = Prefix + rest.split(Delimiter, 1)[0] + Delimiter
+                if not prefixes or prefixes[-1] != common:
+                    prefixes.append(common)
+            else:
+                contents.append(key)
+        # Like S3, pages hold up to page_size keys and common prefixes together
+        entries = sorted([(k, 'key') for k in contents] + [(p, 'prefix') for p in prefixes])
+        for start in range(0, max(len(entries), 1), fake.page_size):
+            time.sleep(fake.latency)
+            fake.pages_sent += 1
+            page = entries[start:start + fake.page_size]
+            yield {
+                'Contents': [{'Key': k, 'Size': fake.keys[k], 'ETag': '"e"',
+                              'LastModified': datetime(2024, 1, 1)}
+                             for k, kind in page if kind == 'key'],
+                'CommonPrefixes': [{'Prefix': k} for k, kind in page if kind == 'prefix'],
+            }
+
+
+class _FakeS3:
+    """In-memory bucket: key -> size"""
+
+    def __init__(self, keys, page_size=1000, latency=0.0):
+        self.keys = keys
+        self.page_size = page_size
+        self.latency = latency
+        self.list_calls = 0
+        self.pages_sent = 0
+
+    def get_paginator(self, name):
+        assert name == 'list_objects_v2'
+        return _Paginator(self)
+
+
+class _Config:
+    SHOW_HIDDEN_FILES = False
+    MAX_EXTENSION_LENGTH = 5
+    DATE_FORMAT = DATE_FORMAT_SHORT
+
+
+class _S3Test:
+
+    def setup_method(self):
+        self._had_boto3 = tfm_s3.HAS_BOTO3
+        tfm_s3.HAS_BOTO3 = True  # the fake client stands in for boto3
+        tfm_s3.get_s3_cache().clear()
+
+    def teardown_method(self):
+        tfm_s3.get_s3_cache().clear()
+        tfm_s3.HAS_BOTO3 = self._had_boto3
+
+    def _dir(self, uri, fake):
+        path = Path(uri)
+        path._impl._s3_client = fake
+        return path
+
+
+class TestIterdirPages(_S3Test):
+
+    def test_pages_stream_and_complete_listing_is_cached(self):
+        keys = {f'dir/f{i:03d}.txt': i for i in range(250)}
+        keys.update({'dir/sub/a': 1, 'dir/sub/': 0, 'dir/': 0, 'dir/.hidden': 3})
+        fake = _FakeS3(keys, page_size=100)
+        pages = list(self._dir('s3://bucket-a/dir', fake).iterdir_pages())
+        assert [len(p) for p in pages] == [99, 100, 53]  # 'dir/' itself is not listed
+        names = [p.name for page in pages for p in page]
+        assert names.count('sub') == 1 and 'dir' not in names
+        assert next(p for page in pages for p in page if p.name == 'sub').is_dir()
+
+        # The second listing is served from the cache as one page
+        again = list(self._dir('s3://bucket-a/dir', fake).iterdir_pages())
+        assert fake.list_calls == 1 and len(again) == 1
+        assert sorted(p.name for p in again[0]) == sorted(names)
+
+    def test_abandoned_listing_is_not_cached(self):
+        fake = _FakeS3({f'k{i}': 1 for i in range(300)}, page_size=100)
+        pages = self._dir('s3://bucket-b/', fake).iterdir_pages()
+        assert len(next(pages)) == 100
+        pages.close()
+        assert len(list(self._dir('s3://bucket-b/', fake).iterdir())) == 300
+        assert fake.list_calls == 2
+
+
+class TestStreamingListing(_S3Test):
+
+    def setup_method(self):
+        super().setup_method()
+        self.flm = FileListManager(_Config())
+        keys = {f'p/file{(i * 7919) % 1200}.{"txt" if i % 3 else "md"}': (i * 37) % 500
+                for i in range(1200)}
+        keys.update({f'p/d{i}/x': 1 for i in range(0, 1200, 100)})
+        self.fake = _FakeS3(keys, page_size=100)
+
+    def test_partials_are_sorted_and_grow_to_the_full_listing(self):
+        for sort_mode, reverse in (('name', False), ('size', True), ('ext', False)):
+            tfm_s3.get_s3_cache().clear()
+            self.flm._PARTIAL_INTERVAL = 0.0
+            partials = []
+            path = self._dir('s3://bucket-c/p', self.fake)
+            result = self.flm.compute_listing(path, sort_mode=sort_mode, sort_reverse=reverse,
+                                              on_partial=partials.append)
+            expected = self.flm.sort_entries(list(path.iterdir()), sort_mode, reverse)
+            assert [str(p) for p in result['files']] == [str(p) for p in expected]
+            assert len(result['file_info']) == len(expected) and 'partial' not in result
+            assert len(partials) > 1 and all(p['partial'] for p in partials)
+            sizes = [len(p['files']) for p in partials]
+            assert sizes == sorted(sizes) and sizes[-1] <= len(expected)
+            for partial in partials:
+                subset = {str(p) for p in partial['files']}
+                assert [str(p) for p in partial['files']] == [str(p) for p in expected
+                                                              if str(p) in subset]
+                assert set(partial['file_info']) == subset
+
+    def test_partials_keep_selection_and_cursor(self):
+        self.flm._PARTIAL_INTERVAL = 0.0
+        partials = []
+        path = self._dir('s3://bucket-f/p', self.fake)
+        result = self.flm.compute_listing(path, on_partial=partials.append)
+        last = str(result['files'][-1])
+        pane = {'files': [], 'selected_files': {last}, 'focused_index': 1000}
+        for partial in partials:
+            self.flm.apply_listing(pane, partial)
+            assert pane['selected_files'] == {last}
+            assert pane['focused_index'] == min(1000, len(partial['files']) - 1)
+        self.flm.apply_listing(pane, result)
+        assert pane['selected_files'] == {last} and pane['focused_index'] == 1000
+        assert '_held_focus' not in pane
+
+        # A cursor moved while the listing streams stays where it was moved
+        pane['focused_index'] = 1000
+        self.flm.apply_listing(pane, partials[0])
+        pane['focused_index'] = 3
+        self.flm.apply_listing(pane, partials[1])
+        self.flm.apply_listing(pane, result)
+        assert pane['focused_index'] == 3
+
+        # The complete listing still prunes what no longer exists
+        pane['selected_files'].add('s3://bucket-f/p/gone')
+        self.flm.apply_listing(pane, result)
+        assert pane['selected_files'] == {last}
+
+    def test_partials_are_throttled(self):
+        self.fake.latency = 0.005
+        partials = []
+        self.flm.compute_listing(self._dir('s3://bucket-d/p', self.fake),
+                                 on_partial=partials.append)
+        assert self.fake.pages_sent == 13
+        assert 1 <= len(partials) < 13  # the first page, then every 0.25 s
+
+    def test_local_directory_lists_in_one_go(self, tmp_path):
+        (tmp_path / 'a').write_text('x')
+        partials = []
+        result = self.flm.compute_listing(Path(str(tmp_path)), on_partial=partials.append)
+        assert [p.name for p in result['files']] == ['a'] and partials == []
+
+    def test_first_rows_latency(self):
+        """Benchmark: time until the pane has rows, whole listing vs streamed"""
+        keys = {f'big/obj{i:06d}.dat': i for i in range(10_000)}
+        fake = _FakeS3(keys, page_size=1000, latency=0.02)
+        start = time.perf_counter()
+        whole = self.flm.compute_listing(self._dir('s3://bucket-e/big', fake))
+        whole_time = time.perf_counter() - start
+
+        tfm_s3.get_s3_cache().clear()
+        first = []
+        start = time.perf_counter()
+        streamed = self.flm.compute_listing(
+            self._dir('s3://bucket-e/big', fake),
+            on_partial=lambda r: first or first.append(time.perf_counter() - start))
+        stream_time = time.perf_counter() - start
+        assert [str(p) for p in streamed['files']] == [str(p) for p in whole['files']]
+        print(f"\n10,000 keys in 10 pages, 20 ms per page: first rows after "
+              f"{whole_time * 1000:.0f} ms whole vs {first[0] * 1000:.0f} ms streamed "
+              f"(complete in {stream_time * 1000:.0f} ms)")
+        assert first[0] < whole_time / 5
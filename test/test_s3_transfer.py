@@ -0,0 +1,289 @@
+"""
+Test suite for tfm_s3_transfer (parallel ranged GETs and multipart uploads)
+
+The bucket is an in-memory S3 stand-in that answers the handful of client
+calls the engine makes, with per-request latency and a per-connection
+bandwidth limit, and records how many requests overlap.
+
+Run with: PYTHONPATH=.:src pytest test/test_s3_transfer.py -v
+"""
+
+import hashlib
+import os
+import shutil
+import tempfile
+import threading
+import time
+
+import pytest
+
+from tfm_s3_transfer import (MultipartWriter, RangeReader, download_file, part_size_for,
+                             read_object, upload_file)
+
+KB = 1024
+MB = 1024 * 1024
+
+
+class _Body:
+    """Streaming body; each read takes len / bandwidth seconds."""
+
+    def __init__(self, data, fake):
+        self._data = data
+        self._pos = 0
+        self._fake = fake
+
+    def read(self, n=-1):
+        end = len(self._data) if n is None or n < 0 else min(len(self._data), self._pos + n)
+        chunk = self._data[self._pos:end]
+        self._pos = end
+        if self._fake.bandwidth:
+            time.sleep(len(chunk) / self._fake.bandwidth)
+        return chunk
+
+    def close(self):
+        pass
+
+
+class _FakeS3:
+    """In-memory bucket answering the client calls tfm_s3_transfer makes."""
+
+    def __init__(self, latency=0.0, bandwidth=0):
+        self.objects = {}
+        self.uploads = {}
+        self.latency = latency
+        self.bandwidth = bandwidth
+        self.calls = []
+        self.active = 0
+        self.peak = 0
+        self.fail_part = None
+        self._etags = {}
+        self._lock = threading.Lock()
+
+    def _request(self, name):
+        with self._lock:
+            self.calls.append(name)
+            self.active += 1
+            self.peak = max(self.peak, self.active)
+        time.sleep(self.latency)
+
+    def _done(self):
+        with self._lock:
+            self.active -= 1
+
+    def _etag(self, data):
+        # Cached by identity: ranged GETs check IfMatch against large objects
+        cached = self._etags.get(id(data))
+        if cached is None or cached[0] is not data:
+            cached = self._etags[id(data)] = (data, '"%s"' % hashlib.md5(data).hexdigest())
+        return cached[1]
+
+    def head_object(self, Bucket, Key):
+        data = self.objects[Key]
+        return {'ContentLength': len(data), 'ETag': self._etag(data)}
+
+    def get_object(self, Bucket, Key, Range=None, IfMatch=None):
+        self._request('get_object')
+        try:
+            data = self.objects[Key]
+            if IfMatch is not None and IfMatch != self._etag(data):
+                raise RuntimeError('PreconditionFailed')
+            if Range is not None:
+                start, end = Range[len('bytes='):].split('-')
+                data = data[int(start):int(end) + 1]
+            return {'Body': _Body(data, self), 'ContentLength': len(data)}
+        finally:
+            self._done()
+
+    def put_object(self, Bucket, Key, Body):
+        self._request('put_object')
+        self.objects[Key] = bytes(Body)
+        self._done()
+
+    def create_multipart_upload(self, Bucket, Key):
+        upload_id = 'u%d' % len(self.uploads)
+        self.uploads[upload_id] = {}
+        return {'UploadId': upload_id}
+
+    def upload_part(self, Bucket, Key, UploadId, PartNumber, Body):
+        self._request('upload_part')
+        try:
+            if self.fail_part == PartNumber:
+                raise RuntimeError('part upload failed')
+            if self.bandwidth:
+                time.sleep(len(Body) / self.bandwidth)
+            self.uploads[UploadId][PartNumber] = bytes(Body)
+            return {'ETag': self._etag(Body)}
+        finally:
+            self._done()
+
+    def complete_multipart_upload(self, Bucket, Key, UploadId, MultipartUpload):
+        parts = self.uploads.pop(UploadId)
+        numbers = [p['PartNumber'] for p in MultipartUpload['Parts']]
+        assert numbers == sorted(parts)
+        for p in MultipartUpload['Parts']:
+            assert p['ETag'] == self._etag(parts[p['PartNumber']])
+        self.objects[Key] = b''.join(parts[n] for n in numbers)
+
+    def abort_multipart_upload(self, Bucket, Key, UploadId):
+        self.uploads.pop(UploadId, None)
+        self.calls.append('abort')
+
+
+class TestDownload:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.s3 = _FakeS3()
+        self.data = os.urandom(3 * MB + 123)
+        self.s3.objects['big'] = self.data
+        self.local = os.path.join(self.temp_dir, 'big')
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_ranges_into_file(self):
+        updates = []
+        size = download_file(self.s3, 'b', 'big', self.local, lambda d, t: updates.append((d, t)),
+                             concurrency=4, part_size=256 * KB)
+        assert size == len(self.data)
+        assert open(self.local, 'rb').read() == self.data
+        assert self.s3.calls.count('get_object') == 13
+        assert updates[-1] == (len(self.data), len(self.data))
+
+    def test_small_object_is_one_request(self):
+        self.s3.objects['small'] = b'tiny'
+        download_file(self.s3, 'b', 'small', self.local, part_size=256 * KB)
+        assert open(self.local, 'rb').read() == b'tiny'
+        assert self.s3.calls == ['get_object']
+
+    def test_replaced_object_fails_without_partial_file(self):
+        etag = '"%s"' % hashlib.md5(b'older version').hexdigest()
+        with pytest.raises(RuntimeError, match='PreconditionFailed'):
+            download_file(self.s3, 'b', 'big', self.local, size=len(self.data), etag=etag,
+                          concurrency=4, part_size=256 * KB)
+        assert not os.path.exists(self.local)
+
+    def test_cancel_from_progress_callback(self):
+        self.s3.bandwidth = 20 * MB
+
+        class Stop(Exception):
+            pass
+
+        def progress(done, total):
+            if done:
+                raise Stop()
+
+        with pytest.raises(Stop):
+            download_file(self.s3, 'b', 'big', self.local, progress, concurrency=2, part_size=256 * KB)
+        assert not os.path.exists(self.local)
+        assert self.s3.calls.count('get_object') < 13
+
+    def test_read_object_and_range_reader(self):
+        assert read_object(self.s3, 'b', 'big', len(self.data), concurrency=4,
+                           part_size=256 * KB) == self.data
+        reader = RangeReader(self.s3, 'b', 'big', len(self.data), concurrency=3, part_size=256 * KB)
+        pieces = []
+        while True:
+            chunk = reader.read(100 * KB)
+            if not chunk:
+                break
+            pieces.append(chunk)
+        assert b''.join(pieces) == self.data
+        reader.seek(1 * MB + 5)
+        assert reader.read(10) == self.data[MB + 5:MB + 15]
+        reader.close()
+
+    def test_part_size_grows_for_huge_objects(self):
+        assert part_size_for(10 * MB) == 8 * MB
+        assert part_size_for(1000 * 1024 * MB) == 103 * MB  # 10,000 parts at most
+
+
+class TestUpload:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.s3 = _FakeS3()
+        self.data = os.urandom(2 * MB + 7)
+        self.local = os.path.join(self.temp_dir, 'up')
+        with open(self.local, 'wb') as f:
+            f.write(self.data)
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_multipart_upload(self):
+        updates = []
+        upload_file(self.s3, 'b', 'up', self.local, lambda d, t: updates.append(d),
+                    concurrency=4, part_size=256 * KB)
+        assert self.s3.objects['up'] == self.data
+        assert self.s3.calls.count('upload_part') == 9
+        assert updates[-1] == len(self.data)
+
+    def test_failed_part_aborts(self):
+        self.s3.fail_part = 3
+        with pytest.raises(RuntimeError):
+            upload_file(self.s3, 'b', 'up', self.local, concurrency=4, part_size=256 * KB)
+        assert 'abort' in self.s3.calls and not self.s3.uploads
+        assert 'up' not in self.s3.objects
+
+    def test_writer_streams_parts(self):
+        self.s3.latency = 0.01
+        writer = MultipartWriter(self.s3, 'b', 'w', concurrency=2, part_size=256 * KB)
+        for start in range(0, len(self.data), 10 * KB):
+            writer.write(self.data[start:start + 10 * KB])
+        assert self.s3.calls.count('upload_part') >= 6  # sent while still writing
+        writer.close()
+        assert self.s3.objects['w'] == self.data
+        assert self.s3.peak <= 2
+
+    def test_writer_small_file_is_one_put(self):
+        writer = MultipartWriter(self.s3, 'b', 'w', part_size=256 * KB)
+        writer.write(b'hello')
+        writer.close()
+        assert self.s3.objects['w'] == b'hello' and self.s3.calls == ['put_object']
+
+    def test_writer_close_after_failed_part_publishes_nothing(self):
+        self.s3.fail_part = 1
+        writer = MultipartWriter(self.s3, 'b', 'w', concurrency=1, part_size=256 * KB)
+        with pytest.raises(RuntimeError):
+            for start in range(0, len(self.data), 10 * KB):
+                writer.write(self.data[start:start + 10 * KB])
+        with pytest.raises(RuntimeError):
+            writer.close()
+        assert 'put_object' not in self.s3.calls and 'w' not in self.s3.objects
+
+    def test_write_file_close_after_failed_write_publishes_nothing(self):
+        from tfm_s3 import S3WriteFile
+        self.s3.fail_part = 1
+        f = S3WriteFile(self.s3, 'b', 'w', 'wb')
+        f._writer = MultipartWriter(self.s3, 'b', 'w', concurrency=1, part_size=256 * KB)
+        with pytest.raises(RuntimeError):
+            for start in range(0, len(self.data), 10 * KB):
+                f.write(self.data[start:start + 10 * KB])
+        with pytest.raises(IOError):
+            f.close()
+        assert 'put_object' not in self.s3.calls and 'w' not in self.s3.objects
+
+
+class TestThroughput:
+
+    def test_concurrency_benchmark(self, tmp_path):
+        """Benchmark: one stream vs eight over connections limited to 40 MB/s each"""
+        s3 = _FakeS3(latency=0.02, bandwidth=40 * MB)
+        data = os.urandom(16 * MB)
+        s3.objects['big'] = data
+        local = str(tmp_path / 'big')
+        rates = {}
+        for concurrency in (1, 8):
+            start = time.perf_counter()
+            download_file(s3, 'b', 'big', local, concurrency=concurrency, part_size=1 * MB)
+            rates[('get', concurrency)] = len(data) / (time.perf_counter() - start) / MB
+            start = time.perf_counter()
+            upload_file(s3, 'b', 'copy', local, concurrency=concurrency, part_size=1 * MB)
+            rates[('put', concurrency)] = len(data) / (time.perf_counter() - start) / MB
+            assert s3.objects['copy'] == data
+        print(f"\n16 MB object, 20 ms latency, 40 MB/s per connection: "
+              f"download {rates[('get', 1)]:.0f} -> {rates[('get', 8)]:.0f} MB/s, "
+              f"upload {rates[('put', 1)]:.0f} -> {rates[('put', 8)]:.0f} MB/s (1 -> 8 parts in flight)")
+        assert rates[('get', 8)] > rates[('get', 1)] * 2
+        assert rates[('put', 8)] > rates[('put', 1)] * 2
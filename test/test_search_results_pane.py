@@ -91,6 +91,23 @@ class FLMVirtual(unittest.TestCase):
         self.flm.refresh_files(pane)
         self.assertEqual([f.name for f in pane["files"]], ["zzz.txt", "aaa.txt"])
 
+    def test_duplicate_groups_stay_together_and_singletons_drop(self):
+        a1 = self._touch("x/a1")
+        b1 = self._touch("y/b1")
+        a2 = self._touch("z/a2")
+        b2 = self._touch("x/b2")
+        pane = self._pane([a1, a2, b1, b2])
+        pane["virtual"].update(kind="duplicates", mode="duplicates", groups={
+            str(a1): 0, str(a2): 0, str(b1): 1, str(b2): 1})
+        self.flm.refresh_files(pane)
+        # name sort within each group, group order kept
+        self.assertEqual([f.name for f in pane["files"]], ["a1", "a2", "b1", "b2"])
+        self.assertEqual(pane["virtual"]["group_count"], 2)
+        os.remove(str(b2))
+        self.flm.refresh_files(pane)
+        self.assertEqual([f.name for f in pane["files"]], ["a1", "a2"])
+        self.assertEqual(pane["virtual"]["group_count"], 1)
+
 
 class AppVirtual(unittest.TestCase):
     """End-to-end through a headless TfmApp on the memory backend."""
@@ -199,6 +216,19 @@ class AppVirtual(unittest.TestCase):
         self.app._refresh(pane)
         self.assertEqual([f.name for f in pane["files"]], ["b.txt"])
 
+    def test_feed_duplicates_groups_rows(self):
+        from tfm_duplicate_finder import DuplicateGroup
+        a1, a2 = self._write("x/a", "aa"), self._write("y/a", "aa")
+        b1, b2, b3 = self._write("x/b", "b"), self._write("y/b", "b"), self._write("z/b", "b")
+        groups = [DuplicateGroup(2, b"\1" * 32, [a1, a2]),
+                  DuplicateGroup(1, b"\2" * 32, [b1, b2, b3])]
+        pane = self.app.active_pane()
+        self.app._feed_duplicates(pane, groups, [Path(self.tmp)])
+        self.assertEqual(pane["virtual"]["kind"], "duplicates")
+        self.assertEqual([str(f) for f in pane["files"]],
+                         [str(p) for p in (a1, a2, b1, b2, b3)])
+        self.assertEqual(pane["virtual"]["meta"][str(b3)]["group"], 2)
+
     def test_navigation_clears_virtual(self):
         sub = self._write("sub/a.txt")
         self.app._feed_search_results("filename", [sub], Path(self.tmp), "txt")
@@ -0,0 +1,265 @@
+"""
+Test suite for tfm_sftp_client (persistent SFTP session)
+
+The client is driven over pipes to OpenSSH's sftp-server, so no ssh daemon or
+network is needed; the tests are skipped where sftp-server is not installed.
+
+Run with: PYTHONPATH=.:src pytest test/test_sftp_client.py -v
+"""
+
+import os
+import shutil
+import tempfile
+import threading
+import time
+
+import pytest
+
+from _sftp_test_server import SFTP_SERVER, DelayedServer
+from tfm_sftp_client import SFTPClient, SFTPConnectionLost, SFTPError, FX_NO_SUCH_FILE
+from tfm_ssh_connection import SSHConnection, SSHPathNotFoundError
+
+pytestmark = pytest.mark.skipif(SFTP_SERVER is None, reason="OpenSSH sftp-server not installed")
+
+
+class TestSFTPClient:
+    """Protocol operations against a local sftp-server"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        os.makedirs(os.path.join(self.temp_dir, 'sub'))
+        with open(os.path.join(self.temp_dir, 'a.txt'), 'wb') as f:
+            f.write(b'hello\n')
+        os.symlink('a.txt', os.path.join(self.temp_dir, 'link'))
+        self.client = SFTPClient.spawn([SFTP_SERVER], timeout=10)
+
+    def teardown_method(self):
+        self.client.close()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _p(self, *names):
+        return os.path.join(self.temp_dir, *names)
+
+    def test_handshake(self):
+        assert self.client.version == 3
+        assert self.client.realpath(self.temp_dir) == os.path.realpath(self.temp_dir)
+
+    def test_listdir_attr(self):
+        """Entries carry structured attributes; symlinks are not followed"""
+        entries = {name: attrs for name, attrs in self.client.listdir_attr(self.temp_dir)
+                   if name not in ('.', '..')}
+        assert set(entries) == {'a.txt', 'link', 'sub'}
+        assert entries['a.txt'].is_file and entries['a.txt'].size == 6
+        assert entries['a.txt'].mtime == int(os.lstat(self._p('a.txt')).st_mtime)
+        assert entries['sub'].is_dir
+        assert entries['link'].is_symlink
+        assert self.client.stat(self._p('link')).is_file
+
+    def test_missing_path(self):
+        with pytest.raises(SFTPError) as info:
+            self.client.lstat(self._p('missing'))
+        assert info.value.code == FX_NO_SUCH_FILE
+
+    def test_file_round_trip(self):
+        """Multi-chunk transfers with many requests in flight"""
+        data = os.urandom(SFTPClient.CHUNK_SIZE * 70 + 123)
+        progress = []
+        self.client.write_file(self._p('big.bin'), data, lambda done, total: progress.append(done))
+        assert progress[-1] == len(data)
+        with open(self._p('big.bin'), 'rb') as f:
+            assert f.read() == data
+        assert self.client.read_file(self._p('big.bin')) == data
+        assert self.client.read_file(self._p('link')) == b'hello\n'
+
+        open(self._p('empty'), 'wb').close()
+        assert self.client.read_file(self._p('empty')) == b''
+
+    def test_directory_operations(self):
+        self.client.mkdir(self._p('new'))
+        self.client.rename(self._p('new'), self._p('renamed'))
+        assert os.path.isdir(self._p('renamed'))
+        self.client.rmdir(self._p('renamed'))
+        self.client.remove(self._p('a.txt'))
+        assert sorted(os.listdir(self.temp_dir)) == ['link', 'sub']
+
+    def test_utime(self):
+        self.client.utime(self._p('a.txt'), 1_400_000_000, 1_500_000_000)
+        assert os.stat(self._p('a.txt')).st_mtime == 1_500_000_000
+        assert self.client.stat(self._p('a.txt')).mtime == 1_500_000_000
+
+    def test_concurrent_requests(self):
+        """Several threads share one channel"""
+        results = []
+
+        def worker():
+            for _ in range(20):
+                results.append(self.client.read_file(self._p('a.txt')))
+
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        assert results == [b'hello\n'] * 80
+
+    def test_streaming_reader(self):
+        """Reads are handed out in order; a head read doesn't fetch the file"""
+        data = os.urandom(SFTPClient.CHUNK_SIZE * 300)
+        with open(self._p('big.bin'), 'wb') as f:
+            f.write(data)
+        with self.client.open_read(self._p('big.bin')) as reader:
+            assert reader.size == len(data)
+            assert reader.read(10) == data[:10]
+            # Raw reads return at most the rest of the current chunk
+            rest = reader.read(SFTPClient.CHUNK_SIZE)
+            assert rest == data[10:SFTPClient.CHUNK_SIZE]
+            # Read-ahead ramps up from a small window
+            assert reader.position <= SFTPClient.CHUNK_SIZE * 2
+        with self.client.open_read(self._p('big.bin')) as reader:
+            assert reader.readall() == data
+
+    def test_streaming_writer(self):
+        """Odd-sized writes are re-chunked; an exception aborts without flushing"""
+        data = os.urandom(SFTPClient.CHUNK_SIZE * 5 + 17)
+        acked = []
+        with self.client.open_write(self._p('out.bin'), len(data),
+                                    lambda done, total: acked.append((done, total))) as writer:
+            for i in range(0, len(data), 10000):
+                writer.write(data[i:i + 10000])
+        with open(self._p('out.bin'), 'rb') as f:
+            assert f.read() == data
+        assert acked[-1] == (len(data), len(data))
+        assert [done for done, _ in acked] == sorted(done for done, _ in acked)
+
+        with pytest.raises(KeyError):
+            with self.client.open_write(self._p('partial.bin')) as writer:
+                writer.write(b'x' * 100)
+                raise KeyError()
+        assert os.path.getsize(self._p('partial.bin')) == 0
+
+    def test_closed_channel(self):
+        self.client.close()
+        with pytest.raises(SFTPConnectionLost):
+            self.client.lstat(self.temp_dir)
+
+
+class TestSSHConnectionSession:
+    """SSHConnection operations go through the persistent session"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        with open(os.path.join(self.temp_dir, 'a.txt'), 'wb') as f:
+            f.write(b'hello\n')
+        self.conn = SSHConnection('sftp-server-test', {})
+        self.conn._sftp_argv = lambda: [SFTP_SERVER]
+        self.conn._sftp_unavailable = False
+        self.conn._connected = True
+        self.conn._cache.clear()
+
+    def teardown_method(self):
+        self.conn._close_sftp_session()
+        self.conn._cache.clear()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_operations(self):
+        entries = self.conn.list_directory(self.temp_dir)
+        assert [(e['name'], e['size'], e['is_file']) for e in entries] == [('a.txt', 6, True)]
+        assert entries[0]['mtime'] == int(os.stat(os.path.join(self.temp_dir, 'a.txt')).st_mtime)
+
+        target = os.path.join(self.temp_dir, 'b.txt')
+        self.conn.write_file(target, b'data')
+        assert self.conn.read_file(target) == b'data'
+        assert self.conn.stat(target)['size'] == 4
+        self.conn.delete_file(target)
+        with pytest.raises(SSHPathNotFoundError):
+            self.conn.stat(target)
+
+    def test_streamed_transfers(self):
+        """download_file / upload_file stream with per-chunk progress"""
+        data = os.urandom(3 * 1024 * 1024 + 5)
+        local = os.path.join(self.temp_dir, 'local.bin')
+        with open(local, 'wb') as f:
+            f.write(data)
+        remote = os.path.join(self.temp_dir, 'remote.bin')
+
+        up = []
+        assert self.conn.upload_file(local, remote, lambda done, total: up.append(done)) == len(data)
+        down = []
+        copy = os.path.join(self.temp_dir, 'copy.bin')
+        assert self.conn.download_file(remote, copy, lambda done, total: down.append(done)) == len(data)
+        with open(copy, 'rb') as f:
+            assert f.read() == data
+        # Byte-accurate progress: many updates, starting at 0, ending at the size
+        for updates in (up, down):
+            assert updates[0] == 0 and updates[-1] == len(data) and len(updates) > 10
+
+        # A missing source leaves no local file behind
+        with pytest.raises(SSHPathNotFoundError):
+            self.conn.download_file(os.path.join(self.temp_dir, 'missing'),
+                                    os.path.join(self.temp_dir, 'nothing'))
+        assert not os.path.exists(os.path.join(self.temp_dir, 'nothing'))
+
+        with self.conn.open_file(remote) as f:
+            assert f.read(1024) == data[:1024]
+
+    def test_reopens_lost_session(self):
+        self.conn.list_directory(self.temp_dir)
+        self.conn._sftp.close()
+        time.sleep(0.1)
+        assert self.conn.read_file(os.path.join(self.temp_dir, 'a.txt')) == b'hello\n'
+
+    def test_listing_latency(self):
+        """Per-listing cost once the session is open (benchmark output)"""
+        for i in range(200):
+            open(os.path.join(self.temp_dir, f'f{i}'), 'wb').close()
+        self.conn.list_directory(self.temp_dir)  # opens the session
+
+        runs = 50
+        start = time.perf_counter()
+        for _ in range(runs):
+            self.conn._cache.clear()
+            assert len(self.conn.list_directory(self.temp_dir)) == 201
+        elapsed = (time.perf_counter() - start) / runs
+        print(f"\nlist_directory over persistent session: {elapsed * 1000:.2f} ms (201 entries)")
+        assert elapsed < 1.0
+
+
+class TestTransferThroughput:
+    """Pipelining against a server with injected reply latency"""
+
+    LATENCY = 0.01
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.path = os.path.join(self.temp_dir, 'data.bin')
+        self.data = os.urandom(2 * 1024 * 1024)
+        with open(self.path, 'wb') as f:
+            f.write(self.data)
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _measure(self, max_requests):
+        client = SFTPClient(DelayedServer(self.LATENCY), timeout=10, max_requests=max_requests)
+        try:
+            start = time.perf_counter()
+            assert client.read_file(self.path) == self.data
+            read_time = time.perf_counter() - start
+            start = time.perf_counter()
+            client.write_file(self.path + '.up', self.data)
+            write_time = time.perf_counter() - start
+        finally:
+            client.close()
+        return read_time, write_time
+
+    def test_pipelining_fills_latency(self):
+        """Benchmark: one request in flight vs the default window"""
+        mb = len(self.data) / (1024 * 1024)
+        serial = self._measure(1)
+        pipelined = self._measure(SFTPClient.MAX_REQUESTS)
+        print(f"\n{self.LATENCY * 1000:.0f} ms reply latency, {mb:.0f} MiB:")
+        for label, (read_time, write_time) in (('1 request', serial),
+                                               (f'{SFTPClient.MAX_REQUESTS} requests', pipelined)):
+            print(f"  {label:>12}: read {mb / read_time:6.1f} MiB/s, write {mb / write_time:6.1f} MiB/s")
+        assert pipelined[0] * 3 < serial[0]
+        assert pipelined[1] * 3 < serial[1]
@@ -0,0 +1,131 @@
+"""
+Test suite for remote-side hashing (SSHConnection.hash_files, tfm_content_digest)
+
+The hash command runs locally through ``sh -c`` in place of ssh, and stat()
+reads the local file system.
+
+Run with: PYTHONPATH=.:src pytest test/test_ssh_remote_hash.py -v
+"""
+
+import hashlib
+import os
+import shutil
+import tempfile
+
+import pytest
+
+from tfm_content_digest import digests_equal, local_sha256
+from tfm_path import Path
+import tfm_ssh_connection
+from tfm_ssh_connection import SSHConnection, SSHConnectionTimeoutError, SSHPathNotFoundError
+
+HAS_HASH_TOOL = bool(shutil.which('sha256sum') or shutil.which('shasum'))
+
+
+def _local_stat(path):
+    try:
+        st = os.stat(path)
+    except FileNotFoundError:
+        raise SSHPathNotFoundError(f"Remote path not found: {path}")
+    return {'name': os.path.basename(path), 'size': st.st_size, 'mtime': int(st.st_mtime),
+            'is_file': os.path.isfile(path), 'is_dir': os.path.isdir(path)}
+
+
+@pytest.mark.skipif(not HAS_HASH_TOOL, reason="sha256sum / shasum not installed")
+class TestHashFiles:
+    """Digests computed by the host and cached by (host, path, size, mtime)"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.commands = []
+        self.conn = SSHConnection('hash-test', {})
+        self.conn._exec_argv = self._exec_argv
+        self.conn.stat = _local_stat
+        self.conn._connected = True
+        self.conn._cache.clear()
+
+    def teardown_method(self):
+        self.conn._cache.clear()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _exec_argv(self, command):
+        self.commands.append(command)
+        return ['sh', '-c', command]
+
+    def _write(self, name, data):
+        path = os.path.join(self.temp_dir, name)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    def test_digests(self):
+        names = ['plain', 'with space', "it's", 'new\nline', '-dash']
+        paths = [self._write(name, name.encode() * 1000) for name in names]
+        missing = os.path.join(self.temp_dir, 'missing')
+        digests = self.conn.hash_files(paths + [missing, self.temp_dir])
+        for path, name in zip(paths, names):
+            assert digests[path] == hashlib.sha256(name.encode() * 1000).hexdigest()
+        assert digests[missing] is None
+        assert digests[self.temp_dir] is None  # directories aren't hashed
+        assert len(self.commands) == 1  # one remote command for the batch
+
+    def test_stalled_host_times_out(self, monkeypatch):
+        """A hash command that stalls raises instead of hanging the caller"""
+        monkeypatch.setattr(tfm_ssh_connection, '_HASH_TIMEOUT', 0.2)
+        path = self._write('f', b'data')
+        self.conn._exec_argv = lambda command: ['sleep', '5']
+        with pytest.raises(SSHConnectionTimeoutError):
+            self.conn.hash_files([path])
+
+    def test_cache_follows_size_and_mtime(self):
+        path = self._write('f', b'one')
+        first = self.conn.hash_file(path)
+        assert self.conn.hash_file(path) == first
+        assert len(self.commands) == 1
+
+        self._write('f', b'two')
+        os.utime(path, (1000, 1000))
+        assert self.conn.hash_file(path) == hashlib.sha256(b'two').hexdigest()
+        assert len(self.commands) == 2
+
+    def test_host_without_hash_tool(self):
+        path = self._write('f', b'data')
+        self.conn._exec_argv = lambda command: ['sh', '-c', 'exit 127']
+        assert self.conn.hash_file(path) is None
+        assert self.conn._remote_hash_supported is False
+
+
+class _RemoteStub:
+    """A Path on storage that hashes files itself."""
+
+    def __init__(self, digest):
+        self.digest = digest
+
+    def content_digest(self):
+        return self.digest
+
+    def get_scheme(self):
+        return 'ssh'
+
+
+class TestDigestsEqual:
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.local = Path(os.path.join(self.temp_dir, 'local'))
+        self.local.write_bytes(b'content')
+
+    def teardown_method(self):
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_remote_against_local(self):
+        same = _RemoteStub(hashlib.sha256(b'content').hexdigest())
+        other = _RemoteStub(hashlib.sha256(b'CONTENT').hexdigest())
+        assert digests_equal(same, self.local) is True
+        assert digests_equal(self.local, other) is False
+        assert local_sha256(self.local) == same.digest
+
+    def test_undecided_falls_back_to_bytes(self):
+        assert digests_equal(self.local, self.local) is None  # both local
+        assert digests_equal(_RemoteStub(None), _RemoteStub('a' * 64)) is None
+        assert digests_equal(_RemoteStub('a' * 64), _RemoteStub('a' * 64)) is True
@@ -0,0 +1,159 @@
+"""
+Test suite for tfm_ssh_transfer (parallel SFTP channels for tree copies)
+
+Channels are local sftp-server processes with injected reply latency standing
+in for sessions on a remote ControlMaster. Skipped where OpenSSH's sftp-server
+is not installed.
+
+Run with: PYTHONPATH=.:src pytest test/test_ssh_transfer.py -v
+"""
+
+import os
+import shutil
+import tempfile
+import threading
+import time
+from types import SimpleNamespace
+
+import pytest
+
+from _sftp_test_server import SFTP_SERVER, DelayedServer
+from tfm_sftp_client import SFTPClient
+from tfm_ssh_connection import SSHConnection, SSHPathNotFoundError
+from tfm_ssh_transfer import TransferJob, channels_for_host, transfer_files
+
+requires_server = pytest.mark.skipif(SFTP_SERVER is None, reason="OpenSSH sftp-server not installed")
+
+
+class TestChannelsForHost:
+
+    def test_defaults_and_overrides(self):
+        config = SimpleNamespace(SSH_TRANSFER_CHANNELS=6,
+                                 SSH_TRANSFER_CHANNELS_PER_HOST={'slow': 1, 'bad': 0})
+        assert channels_for_host(config, 'fast') == 6
+        assert channels_for_host(config, 'slow') == 1
+        assert channels_for_host(config, 'bad') == 1
+        assert channels_for_host(SimpleNamespace(), 'any') == 4
+
+
+@requires_server
+class TestTransferFiles:
+    """Batches of files over several channels"""
+
+    LATENCY = 0.005
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        self.local = os.path.join(self.temp_dir, 'local')
+        self.remote = os.path.join(self.temp_dir, 'remote')
+        os.makedirs(self.local)
+        os.makedirs(self.remote)
+        self.opened = []
+        self.conn = SSHConnection('transfer-test', {})
+        self.conn._open_sftp_session = self._open_session
+        self.conn._sftp_unavailable = False
+        self.conn._connected = True
+        self.conn._cache.clear()
+
+    def teardown_method(self):
+        self.conn._close_sftp_session()
+        self.conn._cache.clear()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _open_session(self):
+        session = SFTPClient(DelayedServer(self.LATENCY), timeout=10)
+        self.opened.append(session)
+        return session
+
+    def _make_files(self, count, size=100):
+        jobs = []
+        for i in range(count):
+            path = os.path.join(self.local, f'f{i:04d}')
+            with open(path, 'wb') as f:
+                f.write(os.urandom(size))
+            jobs.append(TransferJob(path, os.path.join(self.remote, f'f{i:04d}'), True, size))
+        return jobs
+
+    def test_upload_and_download(self):
+        jobs = self._make_files(20, 1000) + self._make_files(1, 3 * 1024 * 1024)
+        done, byte_updates = [], []
+        copied = transfer_files(self.conn, jobs, 3, on_done=lambda job, err: done.append((job, err)),
+                                on_bytes=lambda d, t: byte_updates.append((d, t)))
+        assert copied == len(jobs) and all(err is None for _, err in done)
+        assert len(self.opened) == 3  # the connection's own session and two more
+        deadline = time.monotonic() + 2
+        while any(s.alive for s in self.opened[1:]) and time.monotonic() < deadline:
+            time.sleep(0.01)
+        assert not any(s.alive for s in self.opened[1:])  # extra channels closed
+        assert self.opened[0].alive
+        for job in jobs:
+            with open(job.local_path, 'rb') as a, open(job.remote_path, 'rb') as b:
+                assert a.read() == b.read()
+        total = sum(job.size for job in jobs)
+        assert byte_updates[-1] == (total, total)
+
+        back = os.path.join(self.temp_dir, 'back')
+        os.makedirs(back)
+        down = [TransferJob(os.path.join(back, os.path.basename(j.remote_path)), j.remote_path, False, j.size)
+                for j in jobs]
+        assert transfer_files(self.conn, down, 3) == len(down)
+        assert sorted(os.listdir(back)) == sorted(os.listdir(self.remote))
+
+    def test_failures_are_reported_per_file(self):
+        jobs = self._make_files(4)
+        jobs.append(TransferJob(os.path.join(self.local, 'x'), os.path.join(self.remote, 'missing'), False))
+        errors = []
+        copied = transfer_files(self.conn, jobs, 2,
+                                on_done=lambda job, err: err is not None and errors.append(err))
+        assert copied == 4
+        assert len(errors) == 1 and isinstance(errors[0], SSHPathNotFoundError)
+        assert not os.path.exists(os.path.join(self.local, 'x'))
+
+    def test_lost_channel_is_retried_on_main_session(self):
+        jobs = self._make_files(30)
+        real_open = self._open_session
+
+        def open_flaky():
+            session = real_open()
+            if len(self.opened) == 2:
+                threading.Timer(0.05, session.close).start()
+            return session
+
+        self.conn._open_sftp_session = open_flaky
+        errors = []
+        copied = transfer_files(self.conn, jobs, 2,
+                                on_done=lambda job, err: err is not None and errors.append(err))
+        assert errors == [] and copied == 30
+        assert len(os.listdir(self.remote)) == 30
+
+    def test_cancel_stops_batch(self):
+        jobs = self._make_files(200)
+        done = []
+
+        class Stop(Exception):
+            pass
+
+        def checkpoint():
+            if len(done) >= 10:
+                raise Stop()
+
+        with pytest.raises(Stop):
+            transfer_files(self.conn, jobs, 2, on_done=lambda job, err: done.append(job),
+                           checkpoint=checkpoint)
+        assert len(os.listdir(self.remote)) < 200
+
+    def test_files_per_second(self):
+        """Benchmark: small files over one channel vs four"""
+        jobs = self._make_files(120)
+        rates = {}
+        for channels in (1, 4):
+            for name in os.listdir(self.remote):
+                os.unlink(os.path.join(self.remote, name))
+            self.conn._close_sftp_session()
+            self.conn._sftp_unavailable = False
+            start = time.perf_counter()
+            assert transfer_files(self.conn, jobs, channels) == len(jobs)
+            rates[channels] = len(jobs) / (time.perf_counter() - start)
+        print(f"\n{self.LATENCY * 1000:.0f} ms reply latency, {len(jobs)} x 100 B uploads: "
+              f"1 channel {rates[1]:.0f} files/s, 4 channels {rates[4]:.0f} files/s")
+        assert rates[4] > rates[1] * 2
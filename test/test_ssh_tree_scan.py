@@ -0,0 +1,136 @@
+"""
+Test suite for SSHConnection.scan_tree (bulk remote listing with find -printf)
+
+The remote side is the local machine: find runs through ``sh -c`` instead of
+ssh and listings go to OpenSSH's sftp-server over pipes. Skipped where
+sftp-server or GNU find is not installed.
+
+Run with: PYTHONPATH=.:src pytest test/test_ssh_tree_scan.py -v
+"""
+
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+
+import pytest
+
+from _sftp_test_server import SFTP_SERVER
+from tfm_ssh_connection import SSHConnection, SSHError, SSHPathNotFoundError
+
+
+def _has_gnu_find():
+    try:
+        result = subprocess.run(['find', '/', '-maxdepth', '0', '-printf', '%y'],
+                                capture_output=True, timeout=10)
+    except (OSError, subprocess.TimeoutExpired):
+        return False
+    return result.returncode == 0 and result.stdout == b'd'
+
+
+pytestmark = [
+    pytest.mark.skipif(SFTP_SERVER is None, reason="OpenSSH sftp-server not installed"),
+    pytest.mark.skipif(not _has_gnu_find(), reason="GNU find not available"),
+]
+
+
+def _walk(root):
+    """relative path -> (is_dir, size) with lstat semantics, like the scan."""
+    expected = {}
+    for dirpath, dirnames, filenames in os.walk(root):
+        for name in dirnames + filenames:
+            full = os.path.join(dirpath, name)
+            st = os.lstat(full)
+            is_dir = os.path.isdir(full) and not os.path.islink(full)
+            expected[os.path.relpath(full, root)] = (is_dir, st.st_size)
+    return expected
+
+
+class TestScanTree:
+    """One find per tree instead of one listing per directory"""
+
+    def setup_method(self):
+        self.temp_dir = tempfile.mkdtemp(prefix='tfm_test_')
+        for d in ('a/b/c', 'a/empty', '.hidden/x', 'with space'):
+            os.makedirs(os.path.join(self.temp_dir, *d.split('/')))
+        for f, data in (('top.txt', b'hello'), ('a/b/c/deep.bin', b'x' * 5000),
+                        ('.hidden/x/secret', b'1'), ('with space/new\nline', b'22')):
+            with open(os.path.join(self.temp_dir, *f.split('/')), 'wb') as fh:
+                fh.write(data)
+        os.symlink('a', os.path.join(self.temp_dir, 'link'))
+
+        self.conn = SSHConnection('scan-test', {})
+        self.conn._sftp_argv = lambda: [SFTP_SERVER]
+        self.conn._exec_argv = lambda command: ['sh', '-c', command]
+        self.conn._sftp_unavailable = False
+        self.conn._connected = True
+        self.conn._cache.clear()
+
+    def teardown_method(self):
+        self.conn._close_sftp_session()
+        self.conn._cache.clear()
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _scan(self):
+        return {rel: (e['is_dir'], e['size']) for rel, e in self.conn.scan_tree(self.temp_dir)}
+
+    def test_matches_walk(self):
+        """Every entry, with names containing spaces and newlines; symlinks not followed"""
+        assert self._scan() == _walk(self.temp_dir)
+        entries = dict(self.conn.scan_tree(self.temp_dir))
+        assert entries['link']['is_symlink'] and not entries['link']['is_dir']
+        assert entries['a/b/c/deep.bin']['mtime'] == int(
+            os.stat(os.path.join(self.temp_dir, 'a/b/c/deep.bin')).st_mtime)
+
+    def test_fills_cache(self):
+        """Listings and stats of the whole tree are served without the session"""
+        for _ in self.conn.scan_tree(self.temp_dir):
+            pass
+        self.conn._close_sftp_session()
+        self.conn._sftp_unavailable = True  # any cache miss would now fail
+
+        assert [e['name'] for e in self.conn.list_directory(os.path.join(self.temp_dir, 'a/empty'))] == []
+        assert {e['name'] for e in self.conn.list_directory(self.temp_dir)} == set(os.listdir(self.temp_dir))
+        assert self.conn.stat(os.path.join(self.temp_dir, 'a/b/c/deep.bin'))['size'] == 5000
+
+    def test_abandoned_scan_is_not_cached(self):
+        scan = self.conn.scan_tree(self.temp_dir)
+        next(scan)
+        scan.close()
+        assert self.conn._cache.get('list_directory', 'scan-test', self.temp_dir) is None
+
+    def test_missing_root(self):
+        with pytest.raises(SSHPathNotFoundError):
+            list(self.conn.scan_tree(os.path.join(self.temp_dir, 'missing')))
+        with pytest.raises(SSHError):
+            list(self.conn.scan_tree(os.path.join(self.temp_dir, 'top.txt')))
+
+    def test_fallback_without_find(self):
+        """A host without GNU find is walked directory by directory"""
+        self.conn._exec_argv = lambda command: ['sh', '-c', 'echo "find: unknown predicate" >&2; exit 1']
+        assert self._scan() == _walk(self.temp_dir)
+        assert self.conn._find_scan_supported is False
+
+    def test_scan_vs_listing(self):
+        """Benchmark: one find vs one listing per directory"""
+        for i in range(200):
+            d = os.path.join(self.temp_dir, 'many', f'd{i}')
+            os.makedirs(d)
+            for j in range(5):
+                open(os.path.join(d, f'f{j}'), 'wb').close()
+        self.conn.list_directory(self.temp_dir)  # opens the session
+
+        start = time.perf_counter()
+        scanned = self._scan()
+        scan_time = time.perf_counter() - start
+
+        self.conn._cache.clear()
+        self.conn._find_scan_supported = False
+        start = time.perf_counter()
+        assert self._scan() == scanned
+        listing_time = time.perf_counter() - start
+
+        dirs = sum(1 for is_dir, _ in scanned.values() if is_dir) + 1
+        print(f"\n{len(scanned)} entries in {dirs} directories: find {scan_time * 1000:.1f} ms "
+              f"(1 request), listing {listing_time * 1000:.1f} ms ({dirs} requests)")
@@ -11,11 +11,14 @@ Tests the persistent state management system including:
 Run with: PYTHONPATH=.:src pytest test/test_state_manager.py -v
 """
 
+import sqlite3
 import tempfile
 import threading
 import time
+from contextlib import contextmanager
 from pathlib import Path
 
+import tfm_state_manager
 from tfm_state_manager import StateManager, TFMStateManager
 
 
@@ -322,6 +325,179 @@ def test_performance():
         print(f"✓ Bulk retrieval: {len(all_states)} items in {end_time - start_time:.2f} seconds")
 
 
+def _disk_rows(db_path, query):
+    """Rows as another connection sees them on disk."""
+    conn = sqlite3.connect(str(db_path))
+    try:
+        return conn.execute(query).fetchall()
+    finally:
+        conn.close()
+
+
+def test_write_behind_serves_reads_from_memory():
+    """Saves are visible at once but reach the database only when flushed."""
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        tfm_state = TFMStateManager("test_write_behind", db_path=db_path, flush_delay=60)
+        
+        for i in range(200):
+            tfm_state.save_pane_cursor_position('left', f'/dir{i % 20}', f'file{i}', max_entries=100)
+            tfm_state.set_state('counter', i)
+        
+        assert tfm_state.load_pane_cursor_position('left', '/dir5') == 'file185'
+        assert tfm_state.get_state('counter') == 199
+        assert _disk_rows(db_path, 'SELECT COUNT(*) FROM pane_history') == [(0,)]
+        assert _disk_rows(db_path, "SELECT value FROM app_state WHERE key = 'counter'") == []
+        
+        assert tfm_state.flush()
+        assert _disk_rows(db_path, 'SELECT COUNT(*) FROM pane_history') == [(20,)]
+        assert _disk_rows(db_path, "SELECT value FROM app_state WHERE key = 'counter'") == [('199',)]
+        tfm_state.cleanup_session()
+
+
+def test_writer_thread_commits_after_delay():
+    """Queued changes are committed by the writer thread without a flush call."""
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        tfm_state = TFMStateManager("test_writer", db_path=db_path, flush_delay=0.05)
+        tfm_state.set_state('key', 'value')
+        
+        deadline = time.time() + 5
+        while time.time() < deadline and not _disk_rows(
+                db_path, "SELECT value FROM app_state WHERE key = 'key'"):
+            time.sleep(0.01)
+        assert _disk_rows(db_path, "SELECT value FROM app_state WHERE key = 'key'") == [('"value"',)]
+        tfm_state.cleanup_session()
+
+
+def test_pane_history_rows_survive_restart():
+    """Histories are rows per pane and directory, trimmed to the limit."""
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        tfm_state = TFMStateManager("test_rows", db_path=db_path, flush_delay=60)
+        for i in range(5):
+            tfm_state.save_pane_cursor_position('left', f'/dir{i}', f'file{i}', max_entries=3)
+        tfm_state.save_pane_cursor_position('right', '/dir0', 'other', max_entries=3)
+        tfm_state.save_pane_cursor_position('left', '/dir2', 'again', max_entries=3)
+        tfm_state.cleanup_session()
+        
+        assert sorted(_disk_rows(db_path, 'SELECT pane, path, filename FROM pane_history')) == [
+            ('left', '/dir2', 'again'), ('left', '/dir3', 'file3'), ('left', '/dir4', 'file4'),
+            ('right', '/dir0', 'other')]
+        
+        restarted = TFMStateManager("test_rows_2", db_path=db_path)
+        assert [e['path'] for e in restarted.get_ordered_pane_history('left')] == [
+            '/dir3', '/dir4', '/dir2']
+        assert restarted.get_pane_cursor_positions('right') == {'/dir0': 'other'}
+        restarted.cleanup_session()
+
+
+def test_legacy_history_list_moves_to_rows():
+    """A history saved as one JSON list is read back and rewritten as rows."""
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        StateManager(db_path).set_state(
+            'path_history_left', [[1.0, '/old', 'a.txt'], [2.0, '/newer', 'b.txt']])
+        
+        tfm_state = TFMStateManager("test_legacy", db_path=db_path)
+        assert tfm_state.load_pane_cursor_position('left', '/old') == 'a.txt'
+        assert [e['path'] for e in tfm_state.get_ordered_pane_history('left')] == ['/old', '/newer']
+        tfm_state.cleanup_session()
+        
+        assert _disk_rows(db_path, "SELECT key FROM app_state WHERE key LIKE 'path_history_%'") == []
+        assert sorted(_disk_rows(db_path, 'SELECT path, filename FROM pane_history')) == [
+            ('/newer', 'b.txt'), ('/old', 'a.txt')]
+
+
+def test_failed_commit_is_queued_again():
+    """A batch whose commit fails is retried without overwriting newer changes."""
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        tfm_state = TFMStateManager("test_retry", db_path=db_path, flush_delay=60)
+        tfm_state.set_state('a', 1)
+        tfm_state.set_state('b', 1)
+        tfm_state.save_pane_cursor_position('left', '/dir', 'kept', max_entries=10)
+        
+        connect = tfm_state._get_connection
+        
+        @contextmanager
+        def failing():
+            tfm_state.set_state('b', 2)  # queued while the batch is in flight
+            raise sqlite3.OperationalError("disk I/O error")
+            yield
+        
+        tfm_state._get_connection = failing
+        assert not tfm_state.flush()
+        tfm_state._get_connection = connect
+        assert tfm_state._deadline is not None  # a retry is scheduled
+        assert tfm_state.get_state('b') == 2
+        
+        assert tfm_state.flush()
+        assert sorted(_disk_rows(db_path, "SELECT key, value FROM app_state WHERE key IN ('a', 'b')")) == [
+            ('a', '1'), ('b', '2')]
+        assert _disk_rows(db_path, 'SELECT filename FROM pane_history') == [('kept',)]
+        tfm_state.cleanup_session()
+
+
+def test_mirror_sees_other_instances(monkeypatch):
+    """Commits by another instance reach the mirror; unsaved changes stay."""
+    monkeypatch.setattr(tfm_state_manager, 'MIRROR_CHECK_INTERVAL', 0.0)
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        first = TFMStateManager("test_first", db_path=db_path, flush_delay=60)
+        second = TFMStateManager("test_second", db_path=db_path, flush_delay=60)
+        first.set_state('shared', 1)
+        assert first.flush()
+        assert second.get_state('shared') == 1
+        
+        second.set_state('mine', 'unsaved')
+        second.save_pane_cursor_position('left', '/b', 'second', max_entries=10)
+        first.set_state('shared', 2)
+        first.save_pane_cursor_position('left', '/a', 'first', max_entries=10)
+        assert first.flush()
+        assert second.get_state('shared') == 2
+        assert second.get_state('mine') == 'unsaved'
+        assert second.get_pane_cursor_positions('left') == {'/a': 'first', '/b': 'second'}
+        first.cleanup_session()
+        second.cleanup_session()
+
+
+def test_navigation_latency_benchmark():
+    """Save + load per directory change: write-behind against a JSON history
+    read-modify-written through to the database on every save."""
+    with tempfile.TemporaryDirectory() as temp_dir:
+        db_path = Path(temp_dir) / "test_state.db"
+        tfm_state = TFMStateManager("test_bench", db_path=db_path, flush_delay=60)
+        through = StateManager(Path(temp_dir) / "through.db")
+        moves = 2000
+        
+        start = time.perf_counter()
+        for i in range(moves):
+            directory = f'/home/user/project/dir{i % 150}'
+            tfm_state.load_pane_cursor_position('left', directory)
+            tfm_state.save_pane_cursor_position('left', directory, f'file{i}.txt', max_entries=100)
+        behind = (time.perf_counter() - start) / moves
+        
+        start = time.perf_counter()
+        tfm_state.flush()
+        flush = time.perf_counter() - start
+        
+        start = time.perf_counter()
+        for i in range(moves // 10):
+            directory = f'/home/user/project/dir{i % 150}'
+            history = [e for e in through.get_state('history', []) if e[1] != directory]
+            history.append([time.time(), directory, f'file{i}.txt'])
+            through.set_state('history', history[-100:])
+        direct = (time.perf_counter() - start) / (moves // 10)
+        
+        print(f"\nnavigation save + load: {behind * 1e6:.1f} µs write-behind "
+              f"({flush * 1000:.1f} ms to commit {moves} moves), "
+              f"{direct * 1e6:.0f} µs through to disk")
+        assert _disk_rows(db_path, 'SELECT COUNT(*) FROM pane_history') == [(100,)]
+        assert behind < direct
+        tfm_state.cleanup_session()
+
+
 def run_all_tests():
     """Run all tests."""
     print("Running TFM State Manager tests...\n")
@@ -0,0 +1,191 @@
+"""
+Test suite for tfm_text_width (cell widths, grapheme clusters, truncation)
+
+Run with: PYTHONPATH=.:src pytest test/test_text_width.py -v
+"""
+
+import random
+import time
+import unicodedata
+
+from puikit.text import display_width as puikit_width
+
+from tfm_str_format import abbreviate_path
+from tfm_text_layout import AbbreviationSegment, FilepathSegment
+from tfm_text_width import (cell_measure, display_width, elide_middle, fit_prefix,
+                            fit_suffix, truncate_to_width)
+
+FAMILY = "\U0001F468\u200d\U0001F469\u200d\U0001F467"  # ZWJ sequence
+FLAGS = "\U0001F1EF\U0001F1F5\U0001F1FA\U0001F1F8"  # JP, US
+
+
+class TestDisplayWidth:
+
+    def test_ascii_and_wide(self):
+        assert display_width("") == 0
+        assert display_width("readme.txt") == 10
+        assert display_width("日本語.txt") == 10
+        assert display_width("한국어") == 6
+        assert display_width("ｶﾀｶﾅ") == 4          # halfwidth katakana
+        assert display_width("ＡＢ") == 4           # fullwidth latin
+
+    def test_combining_mark(self):
+        assert display_width("e\u0301") == 1
+
+    def test_matches_puikit_over_the_same_ranges(self):
+        # The renderer draws with PuiKit's widths: the whole string and every
+        # prefix and suffix cut at a cluster boundary must measure the same here
+        samples = [
+            "readme.txt", "tab\there", "日本語.txt", "한국어", "ｶﾀｶﾅ", "ＡＢ",
+            "e\u0301e\u0301", "a\u200bb", "\U0001F44D", "\U0001F44D\U0001F3FD",
+            FAMILY, FAMILY + "x", FLAGS, "\u2764\ufe0f", "\u2764",
+            unicodedata.normalize("NFD", "한국어"), "\r\n",
+        ]
+        for text in samples:
+            assert display_width(text) == puikit_width(text), text
+            for i in range(len(text) + 1):
+                if fit_prefix(text, display_width(text[:i])) != text[:i]:
+                    continue  # inside a cluster
+                assert display_width(text[:i]) == puikit_width(text[:i]), (text, i)
+                assert display_width(text[i:]) == puikit_width(text[i:]), (text, i)
+
+
+class TestTruncation:
+
+    def test_fit_prefix_never_splits_clusters(self):
+        assert fit_prefix("日本語", 3) == "日"
+        assert fit_prefix("e\u0301e\u0301", 1) == "e\u0301"
+        assert fit_prefix(FAMILY + "x", display_width(FAMILY)) == FAMILY
+        assert fit_prefix(FAMILY + "x", display_width(FAMILY) - 1) == ""
+        assert fit_prefix("abc", 0) == ""
+        assert fit_prefix("abc", 2.5) == "ab"
+
+    def test_fit_suffix(self):
+        assert fit_suffix("日本語", 5) == "本語"
+        assert fit_suffix("ab日本", 3) == "本"
+        assert fit_suffix("abc", 10) == "abc"
+        us = FLAGS[2:]
+        assert fit_suffix(FLAGS, display_width(us)) == us
+
+    def test_truncate_and_elide(self):
+        assert truncate_to_width("日本語テキスト", 7) == "日本語…"
+        assert truncate_to_width("abcdef", 4, ellipsis="") == "abcd"
+        assert truncate_to_width("abc", 3) == "abc"
+        assert elide_middle("abcdefghijkl", 7) == "abc…jkl"
+        assert display_width(elide_middle("日本語のファイル名.txt", 10)) <= 10
+
+    def test_fits_are_longest_within_width(self):
+        rng = random.Random(7)
+        alphabet = "ab日本e\u0301\U0001F44D\U0001F3FD\u200d\U0001F1EF\U0001F1F5ｶ"
+        for _ in range(300):
+            text = "".join(rng.choice(alphabet) for _ in range(rng.randint(0, 12)))
+            total = display_width(text)
+            for width in range(0, total + 2):
+                prefix, suffix = fit_prefix(text, width), fit_suffix(text, width)
+                assert text.startswith(prefix) and text.endswith(suffix)
+                assert display_width(prefix) <= width
+                assert display_width(suffix) <= width
+                if width >= total and width > 0:
+                    assert prefix == suffix == text
+
+    def test_cell_measure(self):
+        class Grid:
+            vector_shapes = False
+
+            def measure_text(self, s):
+                return len(s)
+
+        class Vector(Grid):
+            vector_shapes = True
+
+        assert cell_measure(Grid()) is display_width
+        vector = Vector()
+        assert cell_measure(vector) == vector.measure_text
+
+
+class TestCallSites:
+
+    def test_segments_keep_right_portion_by_cells(self):
+        seg = AbbreviationSegment("長いファイル名のテスト.txt", abbrev_position="left")
+        assert seg.shorten(9) == "…スト.txt"
+        path = FilepathSegment("/home/ユーザー/書類/プロジェクト/報告書.pdf")
+        short = path.shorten(24)
+        assert display_width(short) <= 24 and short.endswith("報告書.pdf")
+
+    def test_abbreviate_path_counts_cells_by_default(self):
+        path = "/data/写真/二〇二四年/旅行/京都.jpg"
+        result = abbreviate_path(path, 20, home="/home/me")
+        assert display_width(result) <= 20
+        assert result.endswith("/京都.jpg")
+        assert abbreviate_path(path, 20, measure=lambda s: display_width(s),
+                               home="/home/me") == result
+
+
+def _old_truncate_from_right(text, width):
+    # The per-character loop the segments used before
+    result, current = "", 0
+    for char in reversed(text):
+        w = display_width(char)
+        if current + w > width:
+            break
+        result, current = char + result, current + w
+    return result
+
+
+def _old_fit_prefix(text, budget, measure):
+    # The binary search over measure calls abbreviate_path used before
+    if measure(text) <= budget:
+        return text
+    lo, hi = 0, len(text)
+    while lo < hi:
+        mid = (lo + hi + 1) // 2
+        if measure(text[:mid]) <= budget:
+            lo = mid
+        else:
+            hi = mid - 1
+    return text[:lo]
+
+
+def test_layout_frame_benchmark():
+    # One frame of a 60-row pane: a mix of ASCII and CJK names under long
+    # paths, each laid out at the pane's width. Repeated frames re-measure the
+    # same strings, as a redraw does.
+    rng = random.Random(1)
+    words = ["project", "src", "ドキュメント", "写真", "보고서", "archive", "2024年", "final"]
+    rows = ["/" + "/".join(rng.choice(words) for _ in range(rng.randint(4, 9)))
+            + f"/{rng.choice(words)}_{i}.txt" for i in range(60)]
+
+    def frame():
+        for row in rows:
+            FilepathSegment(row).shorten(40)
+            AbbreviationSegment(row, abbrev_position="left").shorten(30)
+            abbreviate_path(row, 36, home="/home/me")
+
+    def old_frame():
+        for row in rows:
+            _old_truncate_from_right(row, 29)
+            _old_fit_prefix(row, 17, display_width)
+            _old_fit_prefix(row[::-1], 18, display_width)
+
+    frame()
+    start = time.perf_counter()
+    for _ in range(20):
+        frame()
+    per_frame = (time.perf_counter() - start) / 20
+    start = time.perf_counter()
+    for _ in range(20):
+        old_frame()
+    old_per_frame = (time.perf_counter() - start) / 20
+
+    start = time.perf_counter()
+    for _ in range(20):
+        for row in rows:
+            fit_suffix(row, 29)
+            fit_prefix(row, 17)
+            fit_prefix(row[::-1], 18)
+    new_trim = (time.perf_counter() - start) / 20
+
+    print(f"\nlayout frame (60 rows, 3 layouts each): {per_frame * 1000:.2f} ms; "
+          f"trimming alone {new_trim * 1000:.3f} ms vs {old_per_frame * 1000:.2f} ms "
+          f"with per-character and per-candidate measuring")
+    assert new_trim < old_per_frame
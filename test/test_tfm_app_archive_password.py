@@ -23,6 +23,7 @@ sys.path.insert(0, os.path.join(_HERE, ".."))
 import tfm  # noqa: E402
 import tfm_archive as A  # noqa: E402
 from tfm_path import Path  # noqa: E402
+from tfm_task import TaskManager  # noqa: E402
 
 # Same ZipCrypto fixture as test_archive_password.py: message.txt +
 # folder/note.txt, password "s3cr3t".
@@ -62,8 +63,18 @@ def _app():
     return app
 
 
+class _InlineTasks(TaskManager):
+    """Runs submitted tasks inline and headless, so the extraction task has
+    finished by the time ``extract_archive`` / ``on_accept`` returns."""
+
+    def submit(self, task, panel, **kw):
+        kw["background"] = False
+        return super().submit(task, panel, **kw)
+
+
 def _extract_app(entry, dest_dir, *, confirm=False):
     app = _app()
+    app.tasks = _InlineTasks()
     app._focused_entry = lambda: entry
     app.pm = types.SimpleNamespace(get_inactive_pane=lambda: {"path": dest_dir})
     app.refreshes = []
@@ -38,10 +38,13 @@ class StubFLM:
         self._result = {"ok": True, "files": list(files),
                         "file_info": {str(f): {} for f in files}}
         self.compute_calls = 0
+        self.partial = None  # posted through on_partial before the result
 
     def compute_listing(self, path, *, filter_pattern=None, sort_mode="name",
-                        sort_reverse=False):
+                        sort_reverse=False, on_partial=None):
         self.compute_calls += 1
+        if on_partial and self.partial is not None:
+            on_partial(self.partial)
         return self._result
 
     def apply_listing(self, pane, result):
@@ -110,6 +113,28 @@ class ListingIsAsynchronous(unittest.TestCase):
         self.assertEqual(left["files"], ["x"])
 
 
+class StreamingListing(unittest.TestCase):
+    def test_partial_listing_installs_and_keeps_loading(self):
+        left = _pane(FakePath("s3://bucket/big"))
+        app = _app(left, _pane(FakePath("/tmp")), ["a", "b", "c"])
+        app.flm.partial = {"ok": True, "partial": True, "files": ["a"],
+                           "file_info": {"a": {}}}
+        ran = []
+        app._list_pane("left", on_ready=lambda p: ran.append(len(p["files"])))
+        partial = app._result_queue.get(timeout=2)
+        complete = app._result_queue.get(timeout=2)
+        app._result_queue.put(partial)
+        self.assertTrue(app._process_result_queue())
+        self.assertEqual(left["files"], ["a"])
+        self.assertTrue(left["loading"])
+        self.assertEqual(ran, [])
+        app._result_queue.put(complete)
+        self.assertTrue(app._process_result_queue())
+        self.assertEqual(left["files"], ["a", "b", "c"])
+        self.assertFalse(left["loading"])
+        self.assertEqual(ran, [3])
+
+
 class DeferredLoadingIndicator(unittest.TestCase):
     def test_fast_load_never_flashes_the_indicator(self):
         left = _pane(FakePath("/home/me"))
@@ -16,7 +16,6 @@ Run with: PYTHONPATH=.:src pytest test/test_tfm_app_render_livelock.py -v
 """
 
 import os
-import queue
 import sys
 import threading
 import unittest
@@ -66,7 +65,8 @@ def _app():
     app._wake_pending = False
     app._rendering = False
     app._ui_thread_ident = threading.get_ident()
-    app._log_queue = queue.Queue()
+    app._log_ring = tfm.LogRing(tfm.TfmApp._LOG_LINES, lambda record: record.getMessage())
+    app._log_gen = 0
     app.log = FakeLog()
     app.panel = FakePanel()
     # Only the captured-output branch of the pump is under test; the rest report
@@ -91,7 +91,7 @@ def _run_scheduled(app, limit=_RUNAWAY):
 class RenderWriteLivelock(unittest.TestCase):
     def test_write_during_render_settles(self):
         app = _app()
-        stream = tfm._StreamToLog("STDERR", app._log_queue, on_write=app._wake_pump)
+        stream = tfm._StreamToLog("STDERR", app._log_ring, on_write=app._wake_pump)
         # Every render emits a line, exactly as a warning from the draw path would.
         app.panel.on_render = lambda: stream.write("shader failed to compile\n")
 
@@ -106,7 +106,7 @@ class RenderWriteLivelock(unittest.TestCase):
         # The guard must not break what _wake_pump exists for: a worker thread
         # posting output has to reach the log pane.
         app = _app()
-        stream = tfm._StreamToLog("STDERR", app._log_queue, on_write=app._wake_pump)
+        stream = tfm._StreamToLog("STDERR", app._log_ring, on_write=app._wake_pump)
 
         t = threading.Thread(target=lambda: stream.write("from a worker\n"))
         t.start()
@@ -119,7 +119,7 @@ class RenderWriteLivelock(unittest.TestCase):
     def test_worker_write_during_render_is_not_dropped(self):
         # A worker racing a render is NOT the livelock case and must still land.
         app = _app()
-        stream = tfm._StreamToLog("STDERR", app._log_queue, on_write=app._wake_pump)
+        stream = tfm._StreamToLog("STDERR", app._log_ring, on_write=app._wake_pump)
 
         def write_from_worker():
             t = threading.Thread(target=lambda: stream.write("raced the render\n"))
@@ -89,5 +89,62 @@ class TestTreeFlattening(unittest.TestCase):
         self.assertEqual(self._flatten(), [])
 
 
+class TestIncrementalRows(unittest.TestCase):
+    """``_reflow_subtree_locked`` splices one directory's rows and must agree
+    with a full flatten."""
+
+    _flatten = TestTreeFlattening._flatten
+
+    def setUp(self):
+        TestTreeFlattening.setUp(self)
+        self.view.root = self.root
+        self.view.cursor = 0
+        self.view.visible = []
+        self.view._reflow_locked()
+
+    def _spliced(self, node):
+        self.view._reflow_subtree_locked(node)
+        return [n.name for n in self.view.visible]
+
+    def test_expand_and_collapse_splice(self):
+        self.dir2.is_expanded = True
+        self.assertEqual(self._spliced(self.dir2), self._flatten())
+        self.subdir.is_expanded = True
+        self.assertEqual(self._spliced(self.subdir), self._flatten())
+        self.dir2.is_expanded = False
+        self.assertEqual(self._spliced(self.dir2),
+                         ["dir1", "dir2", "file4.txt"])
+
+    def test_hidden_node_is_left_alone(self):
+        before = list(self.view.visible)
+        self.subdir.is_expanded = True  # dir2 is collapsed: not on screen
+        self.view._reflow_subtree_locked(self.subdir)
+        self.assertIs(self.view.visible[0], before[0])
+        self.assertEqual(self.view.visible, before)
+
+
+class TestChildIndex(unittest.TestCase):
+    def test_lookup_survives_direct_appends(self):
+        root = _node("root", 0, None)
+        a = _node("a", 1, root)           # appended to children directly
+        self.assertIs(root.child("a"), a)
+        b = TreeNode("b", None, None, False, DifferenceType.IDENTICAL, 1, False,
+                     parent=root)
+        root.add_child(b)
+        self.assertIs(root.child("b"), b)
+        self.assertIsNone(root.child("c"))
+
+    def test_sibling_span_per_side(self):
+        root = _node("root", 0, None)
+        nodes = [_node(n, 1, root) for n in ("a", "b", "c")]
+        nodes[0].left_path = nodes[1].left_path = object()
+        nodes[2].right_path = object()
+        self.assertEqual(root.sibling_span(nodes[1], True), (1, 0, 1))
+        self.assertEqual(root.sibling_span(nodes[1], False), (1, 2, 2))
+        nodes[1].right_path = object()
+        root.children_changed()
+        self.assertEqual(root.sibling_span(nodes[0], False), (0, 1, 2))
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -23,6 +23,7 @@ was removed after the port (see git history).
 import argparse
 import os
 import platform
+import logging
 import queue
 import re
 import shlex
@@ -73,6 +74,8 @@ from tfm_config import (KeyBindings, config_manager, get_builtin_handler_for_fil
                         get_config, get_favorite_directories, get_program_for_file,
                         has_explicit_association, keys_label_for_action)
 from tfm_file_list_manager import FileListManager  # noqa: E402
+from tfm_log_manager import enable_file_logging  # noqa: E402
+from tfm_logging_handlers import LogRing  # noqa: E402
 from tfm_file_monitor_manager import FileMonitorManager  # noqa: E402
 from tfm_file_pane import FilePane  # noqa: E402
 from tfm_filter_list_dialog import show_filter_list  # noqa: E402
@@ -84,15 +87,18 @@ from tfm_pane_manager import PaneManager  # noqa: E402
 from tfm_path import Path  # noqa: E402
 from tfm_state_manager import get_state_manager  # noqa: E402
 from tfm_str_format import abbreviate_path, format_size  # noqa: E402
+from tfm_text_width import cell_measure  # noqa: E402
 from tfm_batch_rename_dialog import show_batch_rename  # noqa: E402
 from tfm_compare_dialog import show_compare_select  # noqa: E402
 from tfm_compare_selection import compute_compare_selection  # noqa: E402
+from tfm_disk_usage import get_disk_usage_cache  # noqa: E402
+from tfm_duplicate_finder import find_duplicate_groups  # noqa: E402
 from tfm_progress_manager import OperationType  # noqa: E402
 from tfm_diff_viewer import show_diff_viewer  # noqa: E402
 from tfm_directory_diff_viewer import show_directory_diff_viewer  # noqa: E402
 from tfm_file_operations import (FileOperationService, format_op_errors,  # noqa: E402
                                  format_op_summary)
-from tfm_task import Task, TaskManager  # noqa: E402
+from tfm_task import Cancelled, Task, TaskManager  # noqa: E402
 from tfm_text_dialog import show_markdown  # noqa: E402
 from tfm_image_viewer import is_image_file, show_image_viewer  # noqa: E402
 from tfm_text_viewer import looks_binary, show_text_viewer  # noqa: E402
@@ -714,7 +720,11 @@ class PaneHeader(Widget):
         pad_x, pad_y = _bar_pad(ctx)
         avail = max(0.0, ctx.size_units[0] - 2 * pad_x)
         virtual = pane.get("virtual")
-        if virtual:
+        if virtual and virtual["kind"] == "duplicates":
+            n = virtual["group_count"]
+            label = f'⧉ Duplicates — {n} group{"" if n == 1 else "s"}, {len(pane["files"])} files'
+            text = elide(label, avail, where="end", measure=ctx.measure_text)
+        elif virtual:
             # Not a directory: a search-results feed. Say so (and which pane an
             # operation will hit) rather than showing the — misleading — root path.
             mode = "content" if virtual["mode"] == "content" else "filename"
@@ -724,11 +734,11 @@ class PaneHeader(Widget):
         elif self.app._is_archive(pane["path"]):
             # A browsed archive: show [archive.zip]/sub rather than the raw URI.
             label = _archive_header_label(str(pane["path"]))
-            text = abbreviate_path(label, avail, measure=ctx.measure_text)
+            text = abbreviate_path(label, avail, measure=cell_measure(ctx))
         else:
             # Drop whole directory components rather than cutting mid-name, so
             # every name still on screen is one the user can actually read.
-            text = abbreviate_path(str(pane["path"]), avail, measure=ctx.measure_text)
+            text = abbreviate_path(str(pane["path"]), avail, measure=cell_measure(ctx))
         fg = ctx.theme.accent if active else ctx.theme.text
         ctx.draw_text(pad_x, pad_y, text, Style(fg=fg, attr=TextAttribute.BOLD))
 
@@ -760,6 +770,9 @@ class PaneFooter(Widget):
         filt = f"  |  Filter: {pane['filter_pattern']}" if pane["filter_pattern"] else ""
         sort = self.app.flm.get_sort_description(pane)
         text = f"{dirs} dirs, {files} files{sel}  |  {sort}{filt}"
+        usage = pane.get("usage") if pane.get("disk_usage") else None
+        if usage is not None:
+            text += f"  |  {format_size(usage.size)} used"
         fg = ctx.theme.text if active else ctx.theme.muted_text
         style = Style(fg=fg, attr=TextAttribute.BOLD if active else TextAttribute.NORMAL)
 
@@ -849,25 +862,34 @@ class _StreamToLog:
     loggers — stays visible even when there is no terminal behind the GUI.
 
     Writes are line-buffered (a ``print`` that emits its text and its newline as
-    two writes becomes one log line) and complete lines are handed to a
-    thread-safe queue rather than the ``LogView`` directly: output can originate
-    on worker threads (async listings, file ops, archives) that must never touch
-    the widget. The UI thread drains the queue on its monitoring pump."""
-
-    def __init__(self, source: str, sink: "queue.Queue", on_write=None):
+    two writes becomes one log line) and complete lines are published to a
+    ``LogRing`` rather than the ``LogView`` directly: output can originate on
+    worker threads (async listings, file ops, archives) that must never touch
+    the widget. Publishing takes no lock shared with the UI thread, and lines
+    are published under the stream's lock, so they keep their order. The UI
+    thread reads what is new on its monitoring pump."""
+
+    def __init__(self, source: str, sink: LogRing, on_write=None):
         self.source = source  # "STDOUT" or "STDERR"
         self._sink = sink
         self._on_write = on_write  # wakes the UI thread to drain (event-driven mode)
+        self._level = logging.WARNING if source == "STDERR" else logging.INFO
         self._buffer = ""
         self._lock = threading.Lock()
 
+    def _publish(self, line: str) -> None:
+        """Publish one line as a stream-capture record. Caller holds the lock."""
+        record = logging.LogRecord(self.source, self._level, "", 0, line, (), None)
+        record.is_stream_capture = True
+        self._sink.append(record, line)
+
     def write(self, text: str) -> int:
         wrote_line = False
         with self._lock:
             self._buffer += text
             while "\n" in self._buffer:
                 line, self._buffer = self._buffer.split("\n", 1)
-                self._sink.put((self.source, line))
+                self._publish(line)
                 wrote_line = True
         # Wake outside the lock: a worker thread posted a line; the UI thread must
         # drain it. No-op when nothing is draining the queue on a timer already.
@@ -880,7 +902,7 @@ class _StreamToLog:
         restore so a trailing partial line is not silently dropped."""
         with self._lock:
             if self._buffer:
-                self._sink.put((self.source, self._buffer))
+                self._publish(self._buffer)
                 self._buffer = ""
 
     def flush(self) -> None:
@@ -1017,7 +1039,8 @@ class TfmApp:
         )
         # Same chrome inset as the bars: the log's surface fills its slot, its
         # text breathes in from the frame (BAR_PAD_PX on GUI, flush on the grid).
-        self.log = LogView(max_lines=2000, auto_scroll=True, wrap=True, padding_px=BAR_PAD_PX)
+        self.log = LogView(max_lines=self._LOG_LINES, auto_scroll=True, wrap=True,
+                           padding_px=BAR_PAD_PX)
         self.status = StatusBar(self)
         # One Menu model drives the OS-native menu bar on macOS (an NSMenu) and an
         # in-window strip on curses — the Panel resolves which, so we never branch.
@@ -1121,14 +1144,17 @@ class TfmApp:
 
         # Route stdout/stderr into the log pane (as the terminal build does), so
         # output that would otherwise vanish behind the GUI surfaces here: worker
-        # threads post complete lines to ``_log_queue`` and the UI thread drains
+        # threads publish complete lines to ``_log_ring`` and the UI thread drains
         # it on the monitoring pump. Redirected last, once everything above has
         # initialized, and undone in ``run``'s finally.
-        self._log_queue: queue.Queue = queue.Queue()
+        # The ring holds as many lines as the pane, so a burst larger than that
+        # between drains loses only lines the pane would have scrolled out.
+        self._log_ring = LogRing(self._LOG_LINES, lambda record: record.getMessage())
+        self._log_gen = 0
         self._orig_stdout = sys.stdout
         self._orig_stderr = sys.stderr
-        sys.stdout = _StreamToLog("STDOUT", self._log_queue, on_write=self._wake_pump)
-        sys.stderr = _StreamToLog("STDERR", self._log_queue, on_write=self._wake_pump)
+        sys.stdout = _StreamToLog("STDOUT", self._log_ring, on_write=self._wake_pump)
+        sys.stderr = _StreamToLog("STDERR", self._log_ring, on_write=self._wake_pump)
 
     def _pane_column(self, name: str, view: FilePane) -> LayoutView:
         # A LayoutView wraps the header/list/footer sub-layout as a single widget
@@ -1310,21 +1336,19 @@ class TfmApp:
     _STDERR_STYLE = Style(fg=(230, 130, 120))
     _STDOUT_STYLE = Style(attr=TextAttribute.DIM)
 
+    #: Lines the log pane keeps, and the capacity of the capture ring feeding it.
+    _LOG_LINES = 2000
+
     def _drain_captured_output(self) -> bool:
         """Append any stdout/stderr lines captured since the last pump to the log
         pane. Runs on the UI thread (only place the ``LogView`` is touched); the
-        queue is fed by the ``_StreamToLog`` streams, possibly from worker
+        ring is fed by the ``_StreamToLog`` streams, possibly from worker
         threads. Returns True if anything was appended (so the caller redraws)."""
-        appended = False
-        while True:
-            try:
-                source, line = self._log_queue.get_nowait()
-            except queue.Empty:
-                break
-            style = self._STDERR_STYLE if source == "STDERR" else self._STDOUT_STYLE
+        self._log_gen, rows = self._log_ring.read_since(self._log_gen)
+        for line, record in rows:
+            style = self._STDERR_STYLE if record.name == "STDERR" else self._STDOUT_STYLE
             self.log.append(line, style)
-            appended = True
-        return appended
+        return bool(rows)
 
     def _pane_name_of(self, pane: dict) -> str:
         return "left" if pane is self.pm.left_pane else "right"
@@ -1349,9 +1373,15 @@ class TfmApp:
         Single-flight per pane: each call bumps the pane's ``_load_gen``; a result
         whose generation no longer matches (a newer navigation superseded it) is
         dropped. ``on_ready(pane)`` runs once the files are in place (on the tick),
-        for cursor placement etc."""
+        for cursor placement etc.
+
+        A paged (S3) listing streams: the worker also posts the sorted listing so
+        far after each batch of pages (``FileListManager.compute_listing``'s
+        ``on_partial``), which installs with the pane still loading, so the first
+        rows show after one round-trip and fill in as the rest arrives."""
         pane = self.pane(pane_name)
         gen = pane["_load_gen"] = pane.get("_load_gen", 0) + 1
+        pane.pop("_held_focus", None)  # a cursor held for a superseded listing
         pane["loading"] = True
         pane["_load_started"] = time.monotonic()
         pane["_loading_shown"] = False
@@ -1365,12 +1395,34 @@ class TfmApp:
         filter_pattern = pane["filter_pattern"]
         sort_mode = pane["sort_mode"]
         sort_reverse = pane["sort_reverse"]
+        disk_usage = pane.get("disk_usage")
+        # A disk-usage listing may scan a whole tree; a newer listing of the
+        # pane stops the superseded scan instead of letting it run to the end.
+        superseded = pane.get("_load_cancel")
+        if superseded is not None:
+            superseded.set()
+        cancel = pane["_load_cancel"] = threading.Event()
+
+        def on_partial(result) -> None:
+            self._result_queue.put((pane_name, gen, result, None))
+            self._wake_pump()
+
+        def checkpoint() -> None:
+            if cancel.is_set():
+                raise Cancelled()
 
         def worker() -> None:
             result = self.flm.compute_listing(
                 path, filter_pattern=filter_pattern,
                 sort_mode=sort_mode, sort_reverse=sort_reverse,
+                on_partial=None if disk_usage else on_partial,
             )
+            if disk_usage:
+                try:
+                    result = self.flm.apply_disk_usage(result, path, reverse=sort_reverse,
+                                                       checkpoint=checkpoint)
+                except Cancelled:
+                    return
             self._result_queue.put((pane_name, gen, result, on_ready))
             self._wake_pump()  # wake the UI thread to install the listing
 
@@ -1384,7 +1436,8 @@ class TfmApp:
 
     def _process_result_queue(self) -> bool:
         """Install completed async listings on the UI thread, dropping any that a
-        newer navigation superseded (stale generation)."""
+        newer navigation superseded (stale generation). A partial listing of a
+        streaming directory installs too, but leaves the pane loading."""
         applied = False
         while True:
             try:
@@ -1395,12 +1448,18 @@ class TfmApp:
             if gen != pane.get("_load_gen"):
                 continue  # superseded by a newer navigation
             self.flm.apply_listing(pane, result)
+            applied = True
+            # The arriving-text effect plays once per listing: on its first
+            # partial, or on the complete one if nothing was shown before.
+            if pane.get("_shown_gen") != gen:
+                pane["_shown_gen"] = gen
+                self._animate_pane_text(pane_name)
+            if result.get("partial"):
+                continue
             pane["loading"] = False
             pane["_loading_shown"] = False
-            self._animate_pane_text(pane_name)
             if on_ready:
                 on_ready(pane)
-            applied = True
         return applied
 
     def _animate_pane_text(self, pane_name: str) -> None:
@@ -1665,6 +1724,16 @@ class TfmApp:
         self._sync_active()
         self.active_pane()["focused_index"] = index
 
+    def _relist_after_op(self, pane: dict) -> None:
+        """Bring ``pane``'s listing in line after an operation changed its
+        directory, keeping the cursor. A disk-usage pane re-lists on the worker,
+        where the totals the change dropped are rescanned (cancellably);
+        ``refresh_files`` only reuses cached totals."""
+        if pane.get("disk_usage") and not pane.get("virtual"):
+            self._list_pane(self._pane_name_of(pane))
+        else:
+            self.flm.refresh_files(pane)
+
     def _refresh(self, pane: dict, *, on_ready=None) -> None:
         """Re-list ``pane`` after a directory change: reset the cursor, record
         history, and (re)list — synchronously for a local path, on a worker for a
@@ -1863,6 +1932,10 @@ class TfmApp:
         elif action == "search_content":
             self.show_content_search()
             return False
+        elif action == "find_duplicates":
+            return self.find_duplicates()
+        elif action == "toggle_disk_usage":
+            return self.toggle_disk_usage()
         elif action == "history":
             self.show_history()
             return False
@@ -1917,6 +1990,8 @@ class TfmApp:
             return self.move_files()
         elif action == "duplicate_files":
             return self.duplicate_files()
+        elif action == "sync_files":
+            return self.sync_files()
         elif action == "delete_files":
             return self.delete_files()
         elif action == "create_archive":
@@ -2097,6 +2172,8 @@ class TfmApp:
                      enabled=has_files, shortcut=sc("copy_files")),
             MenuItem("Move to Other Pane", on_select=self.move_files,
                      enabled=has_files, shortcut=sc("move_files")),
+            MenuItem("Sync to Other Pane", on_select=self.sync_files,
+                     enabled=has_files, shortcut=sc("sync_files")),
             MenuItem("Delete…", on_select=self.delete_files,
                      enabled=has_files, shortcut=sc("delete_files")),
             SEPARATOR,
@@ -2153,12 +2230,16 @@ class TfmApp:
             MenuItem("Filter…", on_select=self.enter_filter, shortcut=sc("filter")),
             MenuItem("Search Files…", on_select=self.show_search, shortcut=sc("search_dialog")),
             MenuItem("Search Content…", on_select=self.show_content_search, shortcut=sc("search_content")),
+            MenuItem("Find Duplicates", on_select=self.find_duplicates, shortcut=sc("find_duplicates")),
             SEPARATOR,
             MenuItem("Show Hidden Files", on_select=lambda: self._menu("toggle_hidden"),
                      checked=lambda: self.flm.show_hidden, shortcut=sc("toggle_hidden")),
             MenuItem("Reverse Sort", on_select=self._toggle_reverse,
                      checked=lambda: self.active_pane()["sort_reverse"]),
             MenuItem("Sort By", submenu=sort_menu),
+            MenuItem("Disk Usage", on_select=lambda: self._menu("toggle_disk_usage"),
+                     checked=lambda: bool(self.active_pane().get("disk_usage")),
+                     shortcut=sc("toggle_disk_usage")),
             SEPARATOR,
             MenuItem("Theme", submenu=self._theme_menu()),
             MenuItem("Next Theme", on_select=lambda: self._menu("toggle_color_scheme"),
@@ -2384,10 +2465,12 @@ class TfmApp:
         selected = [f for f in files if str(f) in pane["selected_files"]]
         targets = selected if selected else [files[pane["focused_index"]]]
 
-        # Content search-results panes carry a per-file matched line/text map;
-        # empty for a normal or filename-results pane (no extra row then).
+        # Content search-results panes carry a per-file matched line/text map,
+        # duplicates panes a per-file group; empty for a normal or
+        # filename-results pane (no extra row then).
         virtual = pane.get("virtual")
         match_meta = virtual["meta"] if virtual and virtual["mode"] == "content" else {}
+        dupe_meta = virtual["meta"] if virtual and virtual["mode"] == "duplicates" else {}
 
         def _md_escape(text: str) -> str:
             # Keep a filename with Markdown-significant characters (``|`` splits a
@@ -2441,6 +2524,16 @@ class TfmApp:
             m = match_meta.get(str(entry))
             if m is not None:
                 out.append(f"| Match | line {m['line']}: `{_md_escape(m['text'])}` |")
+            d = dupe_meta.get(str(entry))
+            if d is not None:
+                copies = sum(1 for v in dupe_meta.values() if v["group"] == d["group"])
+                out.append(f"| Duplicates | group {d['group']}, {copies} copies |")
+                out.append(f"| SHA-256 | `{d['digest']}` |")
+            # A directory measured by the disk-usage view: its subtree's total.
+            u = get_disk_usage_cache().get(entry)
+            if u is not None:
+                out.append(f"| Disk usage | {u.size:,} bytes in {u.files:,} files, "
+                           f"{u.dirs:,} directories |")
             out.append("")
             return out
 
@@ -2604,8 +2697,10 @@ class TfmApp:
         self._apply_theme(self._theme_index + 1)
 
     def _select_theme(self, index: int) -> None:
-        """Pick a specific palette from the menu, then redraw."""
+        """Pick a specific palette from the menu, then redraw. A menu pick is a
+        deliberate setting, so it is committed now rather than written behind."""
         self._apply_theme(index)
+        self.state_manager.flush()
         self.panel.render()
 
     def _quick_sort(self, mode: str) -> None:
@@ -2634,6 +2729,52 @@ class TfmApp:
         self.log_info(f"Sort: {self.flm.get_sort_description(pane)}")
         self.panel.render()
 
+    def toggle_disk_usage(self) -> bool:
+        """Switch the active pane's disk-usage view (``ncdu`` in a pane) on or
+        off. Turning it on analyzes the pane's directory afresh on the task
+        worker, with a cancellable progress dialog; after that, directories show
+        their subtree's allocated size, everything is ordered by size, and
+        entering a subdirectory reuses the cached totals (see ``tfm_disk_usage``)."""
+        pane = self.active_pane()
+        if pane.get("disk_usage"):
+            pane["disk_usage"] = False
+            self._list_pane(self._pane_name_of(pane))
+            self.log_info("Disk usage view off")
+            return True
+        if pane.get("virtual"):
+            self.log_info("Disk usage: not available on a search-results view")
+            return True
+        path = pane["path"]
+        threads = getattr(self.config, "DISK_USAGE_SCAN_THREADS", 8)
+        task = Task("Analyzing disk usage", config=self.config, kind="compare")
+
+        def run(t: Task) -> dict:
+            prog = t.progress
+            prog.start_operation(OperationType.COPY, 0, description="Scanning")
+
+            def on_progress(files: int, size: int) -> None:
+                prog.update_progress(f"{files:,} files, {format_size(size)}", files)
+
+            usage = get_disk_usage_cache().scan(path, fresh=True, threads=threads,
+                                                checkpoint=t.checkpoint,
+                                                on_progress=on_progress)
+            return {"usage": usage}
+
+        def on_done(res: dict) -> None:
+            usage = res.get("usage")
+            if usage is None:
+                self.log_info("Disk usage analysis cancelled" if task.cancelled()
+                              else f"Disk usage analysis failed: {task.error}")
+            elif pane["path"] == path and not pane.get("virtual"):
+                pane["disk_usage"] = True
+                self._list_pane(self._pane_name_of(pane))
+                self.log_info(f"Disk usage of {path}: {format_size(usage.size)} in "
+                              f"{usage.files:,} files, {usage.dirs:,} directories")
+            self.panel.render()
+
+        self.tasks.submit(task, self.panel, run=run, on_done=on_done)
+        return False
+
     def confirm_quit(self) -> None:
         """A modal confirm before quitting — the canonical message-box pattern."""
         show_message_box(
@@ -2901,6 +3042,88 @@ class TfmApp:
                 self.pm.adjust_scroll_for_focus(pane, self._display_height())
                 return
 
+    def find_duplicates(self) -> bool:
+        """Find files with identical content and feed them, grouped by content,
+        into the active pane (see ``tfm_duplicate_finder``). Searches the
+        selected directories of the active pane, or — with none selected — the
+        directories shown in both panes. Runs on the task worker with a
+        cancellable progress dialog."""
+        pane = self.active_pane()
+        roots = [f for f in pane["files"]
+                 if str(f) in pane["selected_files"] and self.flm._is_dir_safe(f)]
+        if not roots:
+            roots = [p["path"] for p in (pane, self.pm.get_inactive_pane())
+                     if not p.get("virtual")]
+        if not roots:
+            self.log_info("Find duplicates: both panes are search results")
+            return True
+        show_hidden = self.flm.show_hidden
+        threads = getattr(self.config, "DUPLICATE_FINDER_THREADS", 4)
+        task = Task("Finding duplicates", config=self.config, kind="compare")
+        stages = {"scan": "Scanning", "edges": "Comparing file edges",
+                  "hash": "Hashing candidates"}
+
+        def run(t: Task) -> dict:
+            prog = t.progress
+            prog.start_operation(OperationType.COPY, 0, description=stages["scan"])
+            stage = ["scan"]
+
+            def on_progress(name: str, done: int, total: int) -> None:
+                if name != stage[0]:
+                    stage[0] = name
+                    prog.update_operation_total(total, stages[name])
+                prog.update_progress(f"{done:,} files", done)
+
+            groups = find_duplicate_groups(roots, show_hidden=show_hidden, threads=threads,
+                                           checkpoint=t.checkpoint, on_progress=on_progress)
+            return {"groups": groups}
+
+        def on_done(res: dict) -> None:
+            if res.get("groups") is not None:
+                self._feed_duplicates(pane, res["groups"], roots)
+            elif task.cancelled():
+                self.log_info("Find duplicates cancelled")
+            else:
+                self.log_info(f"Find duplicates failed: {task.error}")
+            self.panel.render()
+
+        self.tasks.submit(task, self.panel, run=run, on_done=on_done)
+        return False
+
+    def _feed_duplicates(self, pane: dict, groups: list, roots: list) -> None:
+        """Show duplicate ``groups`` in ``pane`` as a virtual listing, one run of
+        rows per group (most wasted space first). ``virtual['groups']`` maps each
+        path to its group so sorting keeps groups together; ``virtual['meta']``
+        carries the group number and digest for the Info dialog."""
+        if not groups:
+            self.log_info("No duplicate files found")
+            return
+        paths: list = []
+        index: dict[str, int] = {}
+        meta: dict[str, dict] = {}
+        for n, group in enumerate(groups):
+            for p in group.paths:
+                key = str(p)
+                paths.append(p)
+                index[key] = n
+                meta[key] = {"group": n + 1, "digest": group.digest.hex()}
+        try:
+            root = Path(os.path.commonpath([str(r) for r in roots]))
+        except ValueError:  # different drives / storages
+            root = roots[0]
+        pane["virtual"] = {
+            "kind": "duplicates", "root": root, "mode": "duplicates",
+            "query": "", "results": paths, "meta": meta, "groups": index,
+        }
+        pane["filter_pattern"] = ""
+        pane["focused_index"] = 0
+        pane["scroll_offset"] = 0
+        pane["selected_files"].clear()
+        self.flm.refresh_files(pane)
+        wasted = sum(g.wasted for g in groups)
+        self.log_info(f"Duplicates: {len(groups):,} group(s), {len(paths):,} files, "
+                      f"{format_size(wasted)} reclaimable  — ⌫ back")
+
     def _iter_filename_matches(self, root, pattern, cancel, node_cap: int = 50000):
         """Depth-first walk under ``root`` yielding entries whose name matches
         ``pattern`` (case-insensitive glob), checking ``cancel`` between entries so
@@ -2913,6 +3136,36 @@ class TfmApp:
         generator."""
         import fnmatch
         pat = pattern.lower()
+        for e, _ in self._walk_search_tree(root, cancel, node_cap):
+            if fnmatch.fnmatch(e.name.lower(), pat):
+                yield e
+
+    def _walk_search_tree(self, root, cancel, node_cap: int):
+        """The depth-first walk behind both searches: yields ``(entry, is_dir)``
+        below ``root``, skipping (and not descending into) hidden entries unless
+        the pane shows them, checking ``cancel`` between entries and stopping
+        after ``node_cap`` entries. Storage that lists a whole tree in one
+        request (``Path.scan_tree`` — SSH) is read that way rather than with a
+        round-trip per directory."""
+        tree = root.scan_tree()
+        if tree is not None:
+            try:
+                nodes = 0
+                for e, info in tree:
+                    if cancel.is_set() or nodes >= node_cap:
+                        return
+                    if "error" in info:
+                        continue
+                    nodes += 1
+                    if not self.flm.show_hidden and any(
+                            part.startswith(".") for part in str(e.relative_to(root)).split("/")):
+                        continue
+                    yield e, info["is_dir"]
+            except Exception:
+                return
+            finally:
+                tree.close()
+            return
         stack, nodes = [root], 0
         while stack and nodes < node_cap:
             if cancel.is_set():
@@ -2928,12 +3181,12 @@ class TfmApp:
                 if not self.flm.show_hidden and e.name.startswith("."):
                     continue
                 try:
-                    if fnmatch.fnmatch(e.name.lower(), pat):
-                        yield e
-                    if e.is_dir():
-                        stack.append(e)
+                    is_dir = e.is_dir()
                 except Exception:
                     continue
+                if is_dir:
+                    stack.append(e)
+                yield e, is_dir
 
     def _go_to_result(self, entry) -> None:
         pane = self.active_pane()
@@ -3019,35 +3272,21 @@ class TfmApp:
         between entries so a superseded search stops promptly. Binary and (unless
         the pane shows them) hidden entries are skipped; ``node_cap`` bounds the
         walk. The result cap is applied by the dialog consuming this generator."""
-        stack, nodes = [root], 0
-        while stack and nodes < node_cap:
-            if cancel.is_set():
-                return
+        for e, is_dir in self._walk_search_tree(root, cancel, node_cap):
+            if is_dir:
+                continue
             try:
-                entries = list(stack.pop().iterdir())
+                if not self._looks_textual(e):
+                    continue
+                with e.open("r", encoding="utf-8", errors="ignore") as f:
+                    for line_num, line in enumerate(f, 1):
+                        if cancel.is_set():
+                            return
+                        if regex.search(line):
+                            yield {"path": e, "line": line_num,
+                                   "text": line.strip()[:max_line]}
             except Exception:
                 continue
-            for e in entries:
-                if cancel.is_set():
-                    return
-                nodes += 1
-                if not self.flm.show_hidden and e.name.startswith("."):
-                    continue
-                try:
-                    if e.is_dir():
-                        stack.append(e)
-                        continue
-                    if not self._looks_textual(e):
-                        continue
-                    with e.open("r", encoding="utf-8", errors="ignore") as f:
-                        for line_num, line in enumerate(f, 1):
-                            if cancel.is_set():
-                                return
-                            if regex.search(line):
-                                yield {"path": e, "line": line_num,
-                                       "text": line.strip()[:max_line]}
-                except Exception:
-                    continue
 
     def _go_to_content_hit(self, hit) -> None:
         entry = hit["path"]
@@ -3467,6 +3706,14 @@ class TfmApp:
         Returns True when a guard bailed out synchronously (see ``_transfer``)."""
         return self._transfer("move")
 
+    def sync_files(self) -> bool:
+        """Bring the other pane's copies of the selection (or cursor entry) up
+        to date: unchanged files are skipped and changed ones updated by delta,
+        so only what changed is written or sent (``tfm_delta_sync``). Reachable
+        from the menu bar and context menu (no default key). Returns True when
+        a guard bailed out synchronously (see ``_transfer``)."""
+        return self._transfer("sync")
+
     def duplicate_files(self) -> bool:
         """Duplicate the active pane's selection (or cursor entry) in place — a
         Finder-style copy into the same directory, auto-renamed with the shared
@@ -3526,7 +3773,7 @@ class TfmApp:
         must then redraw so the just-logged reason is shown at once rather than on
         the next stray event. Returns False once the operation is handed off: the
         confirm dialog then drives its own redraws."""
-        verb = "Copy" if kind == "copy" else "Move"
+        verb = {"copy": "Copy", "move": "Move", "sync": "Sync"}[kind]
         src_pane = self.active_pane()
         dst_pane = self.pm.get_inactive_pane()
         if dst_pane.get("virtual"):
@@ -3559,15 +3806,16 @@ class TfmApp:
             return True
 
         def on_complete(result: dict) -> None:
-            self.flm.refresh_files(dst_pane)
+            self._relist_after_op(dst_pane)
             if kind == "move":
-                self.flm.refresh_files(src_pane)
+                self._relist_after_op(src_pane)
             src_pane["selected_files"].clear()
             self.log_info(format_op_summary(verb, result))
             self._report_op_failures(verb, result)
             self.panel.render()
 
-        op = self._fileops.copy if kind == "copy" else self._fileops.move
+        op = {"copy": self._fileops.copy, "move": self._fileops.move,
+              "sync": self._fileops.sync}[kind]
         op(self.panel, targets, dest_dir, on_complete=on_complete, log=self.log_info)
         return False
 
@@ -3606,10 +3854,9 @@ class TfmApp:
         (".tar.gz", "tar.gz"), (".tgz", "tar.gz"),
         (".tar.bz2", "tar.bz2"), (".tbz2", "tar.bz2"),
         (".tar.xz", "tar.xz"), (".txz", "tar.xz"),
+        (".tar.zst", "tar.zst"), (".tzst", "tar.zst"), (".tar.lz4", "tar.lz4"),
         (".zip", "zip"), (".tar", "tar"),
     )
-    #: tarfile write modes per format label (zip is handled separately).
-    _TAR_MODES = {"tar": "w", "tar.gz": "w:gz", "tar.bz2": "w:bz2", "tar.xz": "w:xz"}
 
     @classmethod
     def _archive_format(cls, name: str) -> str | None:
@@ -3628,58 +3875,42 @@ class TfmApp:
                 return name[: -len(ext)]
         return name
 
-    @staticmethod
-    def _add_to_zip(zf, path, arcname: str) -> int:
-        """Add ``path`` to an open ZipFile under ``arcname``, recursing into
-        directories (tarfile recurses on its own; zipfile does not). Returns the
-        number of files written."""
-        if path.is_dir() and not path.is_symlink():
-            count = 0
-            for child in path.iterdir():
-                count += TfmApp._add_to_zip(zf, child, f"{arcname}/{child.name}")
-            return count
-        zf.write(str(path), arcname)
-        return 1
-
-    def _write_archive(self, sources: list, archive_path, fmt: str) -> int:
+    def _write_archive(self, sources: list, archive_path, fmt: str,
+                       task: Task | None = None) -> int:
         """Write ``sources`` into a new archive at ``archive_path`` in ``fmt``.
-        Local filesystem paths (this phase); returns the number of files added."""
-        import tarfile
-        import zipfile
-        if fmt == "zip":
-            with zipfile.ZipFile(str(archive_path), "w", zipfile.ZIP_DEFLATED) as zf:
-                return sum(self._add_to_zip(zf, s, s.name) for s in sources)
-        with tarfile.open(str(archive_path), self._TAR_MODES[fmt]) as tf:
-            for s in sources:
-                tf.add(str(s), arcname=s.name)  # tarfile recurses into directories
-            return len(tf.getmembers())
-
-    def _extract_archive(self, archive_path, dest_dir, fmt: str, pwd: bytes | None = None) -> int:
+        Local filesystem paths (this phase); returns the number of members added.
+
+        Compression runs on ``ARCHIVE_COMPRESS_THREADS`` workers (see
+        :mod:`tfm_archive_writer`). With a ``task`` its progress manager gets
+        per-member progress and its checkpoint can cancel mid-file; a failed or
+        cancelled write leaves no partial archive behind."""
+        from tfm_archive_writer import write_archive
+        threads = getattr(self.config, "ARCHIVE_COMPRESS_THREADS", 0)
+        return write_archive(sources, archive_path, fmt, threads=threads,
+                             progress=task.progress if task is not None else None,
+                             checkpoint=task.checkpoint if task is not None else None)
+
+    def _extract_archive(self, archive_path, dest_dir, fmt: str, pwd: bytes | None = None,
+                         task: Task | None = None) -> int:
         """Extract ``archive_path`` into ``dest_dir`` (created if absent). Returns
-        the number of entries. Tar extraction uses the ``data`` filter where
-        available (Python 3.12+) to reject unsafe member paths.
+        the number of entries. Tar members go through ``tarfile.data_filter``
+        where available (Python 3.12+ and recent point releases) to reject unsafe
+        member paths.
 
         ``pwd`` (bytes) is the password for an encrypted zip; it is verified up
         front (:func:`tfm_archive.verify_zip_password`) so a missing/wrong
         password raises *before* any file is written, rather than leaving a
         half-extracted directory behind. A missing/wrong password raises
-        ``RuntimeError``; AES encryption raises ``NotImplementedError``."""
-        import tarfile
-        import zipfile
-        from tfm_archive import verify_zip_password
-        dest_dir.mkdir(parents=True, exist_ok=True)
-        if fmt == "zip":
-            with zipfile.ZipFile(str(archive_path)) as zf:
-                verify_zip_password(zf, pwd)  # no-op unless the zip is encrypted
-                zf.extractall(str(dest_dir), pwd=pwd)
-                return len(zf.namelist())
-        with tarfile.open(str(archive_path)) as tf:
-            members = tf.getmembers()
-            try:
-                tf.extractall(str(dest_dir), filter="data")
-            except TypeError:  # older Python without the extraction filter
-                tf.extractall(str(dest_dir))
-            return len(members)
+        ``RuntimeError``; AES encryption raises ``NotImplementedError``.
+
+        Files are written on ``ARCHIVE_EXTRACT_THREADS`` workers (see
+        :mod:`tfm_archive_extractor`). With a ``task`` its progress manager gets
+        per-member and byte progress and its checkpoint can cancel mid-file."""
+        from tfm_archive_extractor import extract_archive
+        threads = getattr(self.config, "ARCHIVE_EXTRACT_THREADS", 0)
+        return extract_archive(archive_path, dest_dir, fmt, pwd=pwd, threads=threads,
+                               progress=task.progress if task is not None else None,
+                               checkpoint=task.checkpoint if task is not None else None)
 
     def create_archive(self) -> bool:
         """Create an archive from the active pane's selection (or cursor entry)
@@ -3719,14 +3950,34 @@ class TfmApp:
             archive_path = dest_dir / name
 
             def go() -> None:
-                try:
-                    added = self._write_archive(sources, archive_path, fmt)
-                except Exception as exc:
-                    self.log_info(f"Archive creation failed: {exc}")
-                else:
-                    self.log_info(f"Created {name} ({added} file(s)) in {dest_dir}")
-                self.flm.refresh_files(self.pm.get_inactive_pane())
-                self.panel.render()
+                # Compression runs on the task worker behind a cancellable
+                # progress dialog; the result is reported on the main thread.
+                task = Task("Create Archive…", config=self.config, kind="archive_create")
+                task.progress.start_operation(OperationType.ARCHIVE_CREATE, 0,
+                                              description=name)
+
+                def run(t: Task) -> dict:
+                    try:
+                        added = self._write_archive(sources, archive_path, fmt, task=t)
+                    except Cancelled:
+                        return {"cancelled": True}
+                    except Exception as exc:  # noqa: BLE001 — reported to the user
+                        return {"error": exc}
+                    finally:
+                        t.progress.finish_operation()
+                    return {"added": added}
+
+                def on_done(res: dict) -> None:
+                    if res.get("cancelled"):
+                        self.log_info(f"Archive creation cancelled: {name}")
+                    elif res.get("error") is not None:
+                        self.log_info(f"Archive creation failed: {res['error']}")
+                    else:
+                        self.log_info(f"Created {name} ({res.get('added', 0)} file(s)) in {dest_dir}")
+                    self.flm.refresh_files(self.pm.get_inactive_pane())
+                    self.panel.render()
+
+                self.tasks.submit(task, self.panel, run=run, on_done=on_done)
 
             if archive_path.exists():
                 show_message_box(
@@ -3787,33 +4038,65 @@ class TfmApp:
             self.panel.render()
 
         def do_extract(pwd: bytes | None) -> None:
-            """Run the extraction with an optional zip password. A wrong/missing
-            password surfaces as ``RuntimeError`` (verified before any file is
-            written), which re-opens the password prompt with an error."""
-            try:
-                count = self._extract_archive(entry, target, fmt, pwd=pwd)
-            except RuntimeError:
-                # Encrypted zip: the password was missing or wrong. Re-prompt
-                # (nothing was written, thanks to the up-front verify).
-                prompt_password(error="Incorrect password — try again:")
-                return
-            except NotImplementedError:
-                # Defensive: AES is normally caught up front in go(); if a zip
-                # slips through, report it clearly rather than as a raw traceback.
-                self.log_info(
-                    f"Cannot extract {entry.name}: AES-encrypted zips are not supported")
-                self.flm.refresh_files(self.pm.get_inactive_pane())
-                self.panel.render()
-                return
-            except Exception as exc:  # noqa: BLE001 — reported to the user
-                finish(exc, 0)
-                return
-            if pwd is not None:
-                # Remember the working password so browsing this same zip later
-                # doesn't prompt again this session.
-                from tfm_archive import set_archive_password
-                set_archive_password(entry, pwd)
-            finish(None, count)
+            """Run the extraction with an optional zip password. The password is
+            verified here, before the task starts, so a wrong/missing one
+            (``RuntimeError``) re-opens the password prompt with an error and
+            nothing is written. The extraction itself runs on the task worker
+            behind a cancellable progress dialog."""
+            if fmt == "zip":
+                import zipfile
+                from tfm_archive import verify_zip_password
+                try:
+                    with zipfile.ZipFile(str(entry)) as zf:
+                        verify_zip_password(zf, pwd)  # no-op unless encrypted
+                except RuntimeError:
+                    # Encrypted zip: the password was missing or wrong. Re-prompt.
+                    prompt_password(error="Incorrect password — try again:")
+                    return
+                except NotImplementedError:
+                    # Defensive: AES is normally caught up front in go(); if a zip
+                    # slips through, report it clearly rather than as a raw traceback.
+                    self.log_info(
+                        f"Cannot extract {entry.name}: AES-encrypted zips are not supported")
+                    self.flm.refresh_files(self.pm.get_inactive_pane())
+                    self.panel.render()
+                    return
+                except Exception as exc:  # noqa: BLE001 — reported to the user
+                    finish(exc, 0)
+                    return
+
+            task = Task("Extract Archive…", config=self.config, kind="archive_extract")
+            task.progress.start_operation(OperationType.ARCHIVE_EXTRACT, 0,
+                                          description=entry.name)
+
+            def run(t: Task) -> dict:
+                try:
+                    count = self._extract_archive(entry, target, fmt, pwd=pwd, task=t)
+                except Cancelled:
+                    return {"cancelled": True}
+                except Exception as exc:  # noqa: BLE001 — reported to the user
+                    return {"error": exc}
+                finally:
+                    t.progress.finish_operation()
+                return {"count": count}
+
+            def on_done(res: dict) -> None:
+                if res.get("cancelled"):
+                    self.log_info(f"Extraction of {entry.name} cancelled")
+                    self.flm.refresh_files(self.pm.get_inactive_pane())
+                    self.panel.render()
+                    return
+                if res.get("error") is not None:
+                    finish(res["error"], 0)
+                    return
+                if pwd is not None:
+                    # Remember the working password so browsing this same zip
+                    # later doesn't prompt again this session.
+                    from tfm_archive import set_archive_password
+                    set_archive_password(entry, pwd)
+                finish(None, res.get("count", 0))
+
+            self.tasks.submit(task, self.panel, run=run, on_done=on_done)
 
         def prompt_password(error: str | None = None) -> None:
             show_input(
@@ -4217,11 +4500,13 @@ class TfmApp:
             ("clear_filter", "Clear the filename filter"),
             ("search_dialog", "Recursive filename search"),
             ("search_content", "Recursive content (grep) search"),
+            ("find_duplicates", "Find files with identical content"),
         )),
         ("View", (
             ("view_file", "View file (text viewer)"),
             ("diff_files", "Compare two selected files"),
             ("toggle_hidden", "Toggle hidden files"),
+            ("toggle_disk_usage", "Toggle the disk-usage view (sizes of whole directories)"),
             ("toggle_color_scheme", "Cycle color theme"),
             ("sort_menu", "Sort options (menu)"),
             ("quick_sort_name", "Quick-sort by name (repeat: reverse)"),
@@ -4305,6 +4590,7 @@ class TfmApp:
             SEPARATOR,
             MenuItem("Copy to Other Pane", on_select=self.copy_files, enabled=entry is not None),
             MenuItem("Move to Other Pane", on_select=self.move_files, enabled=entry is not None),
+            MenuItem("Sync to Other Pane", on_select=self.sync_files, enabled=entry is not None),
             MenuItem("Delete", on_select=self.delete_files, enabled=entry is not None),
             SEPARATOR,
             MenuItem("Copy Name(s)", on_select=self.copy_names_to_clipboard,
@@ -4415,7 +4701,7 @@ class TfmApp:
             return
 
         def on_complete(result: dict) -> None:
-            self.flm.refresh_files(pane)
+            self._relist_after_op(pane)
             self.log_info(format_op_summary("Copy", result))
             self._report_op_failures("Copy", result)
             self.panel.render()
@@ -4530,6 +4816,9 @@ def create_parser() -> argparse.ArgumentParser:
     # explicitly given directory wins over the one saved from the last session.
     parser.add_argument("--left", default=None, help="left pane startup directory")
     parser.add_argument("--right", default=None, help="right pane startup directory")
+    parser.add_argument("--log-file", default=None, metavar="PATH",
+                        help="also write log messages to PATH (rotation and format "
+                             "from LOG_FILE_MAX_BYTES, LOG_FILE_BACKUP_COUNT, LOG_FILE_FORMAT)")
     return parser
 
 
@@ -4542,6 +4831,8 @@ def main() -> None:
     # rather than re-sniffing sys.argv. Set before get_config()/TfmApp load the
     # config below.
     os.environ["TFM_BACKEND"] = backend_name
+    # Opened before anything logs, so the whole session is in the file
+    log_file = enable_file_logging(args.log_file, get_config()) if args.log_file else None
     # The native GUI backend persists and restores the window's position and size
     # via the NSWindow frame-autosave feature; curses and the web backend (whose
     # window is a browser tab) ignore it, and WebBackend takes no such kwarg.
@@ -4569,15 +4860,19 @@ def main() -> None:
         # UI font if the bundled files are unavailable; size comes from base_font
         # (both share FONT_SIZE).
         backend_kwargs["ui_font"] = Font(family=cfg.UI_FONT_NAME)
-    backend = create_backend(backend_name, **backend_kwargs)
-    with backend:
-        TfmApp(
-            backend,
-            args.left if args.left is not None else ".",
-            args.right if args.right is not None else ".",
-            left_provided=args.left is not None,
-            right_provided=args.right is not None,
-        ).run()
+    try:
+        backend = create_backend(backend_name, **backend_kwargs)
+        with backend:
+            TfmApp(
+                backend,
+                args.left if args.left is not None else ".",
+                args.right if args.right is not None else ".",
+                left_provided=args.left is not None,
+                right_provided=args.right is not None,
+            ).run()
+    finally:
+        if log_file is not None:
+            log_file.close()  # writes out what is still queued
 
 
 if __name__ == "__main__":
@@ -0,0 +1,18 @@
+#!/usr/bin/env python3
+"""Decode a binary TFM log file (``LOG_FILE_FORMAT = 'binary'``) to text.
+
+Prints the lines a text log would have held, in order:
+
+    python tools/decode_log.py tfm.log
+    python tools/decode_log.py tfm.log.1 | grep ERROR
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "src"))
+
+from tfm_log_format import main  # noqa: E402
+
+if __name__ == "__main__":
+    sys.exit(main())